@@ -0,0 +1,19 @@
+// Bindless heap shared by every pipeline, see vk/bindless.hpp
+// Resources are addressed by the u32 index returned when they were allocated through vulkan::context
+// Include it first thing after enabling GL_GOOGLE_include_directive
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (set = 0, binding = 0) uniform texture2D bindless_textures[];
+layout (set = 0, binding = 2) uniform sampler bindless_samplers[];
+
+// Storage buffers are typed by the shader, one declaration per element type sharing binding 1:
+//     BINDLESS_STORAGE_BUFFER(vertex_t, bindless_vertices);
+//     bindless_vertices[nonuniformEXT(index)].data[i]
+#define BINDLESS_STORAGE_BUFFER(type, name) \
+    layout (set = 0, binding = 1) readonly buffer name##_block { type data[]; } name[]
+
+vec4 bindless_sample(uint texture_index, uint sampler_index, vec2 uv)
+{
+    return texture(sampler2D(bindless_textures[nonuniformEXT(texture_index)], bindless_samplers[nonuniformEXT(sampler_index)]), uv);
+}
@@ -0,0 +1,173 @@
+// Meshlet layout, see meshlet.hpp and clusters.hpp for the matching C++ structs
+#extension GL_EXT_buffer_reference : require
+
+#include "lights.glsl"
+#include "occlusion.glsl"
+
+const uint MESHLET_MAX_VERTICES = 64;
+const uint MESHLET_MAX_TRIANGLES = 124;
+const uint CLUSTERS_MAX_VISIBLE = 1 << 14;
+const uint CLUSTERS_TASK_GROUP_SIZE = 32;
+
+const uint CLUSTER_FLAG_CONE_CULLING = 1 << 0;
+const uint CLUSTER_FLAG_MESHLET_COLORS = 1 << 1;
+
+// NOTE: after CULL_PHASE_EARLY and CULL_PHASE_LATE, the color pass of the mesh shader path culls once more
+const uint CLUSTER_PHASE_COLOR = 2;
+
+struct cluster_frame_t {
+    mat4 view_projection;
+    vec4 planes[6];
+    vec4 camera_position;
+    pyramid_t pyramid;
+    uint meshlet_count;
+    uint instance_count;
+    uint flags;
+    uint pad[3];
+};
+
+struct cluster_instance_t {
+    vec4 position_scale; // xyz position, w uniform scale
+    uint color;
+    uint pad[3];
+};
+
+struct meshlet_t {
+    vec4 sphere;
+    vec4 cone;
+    uint vertex_offset;
+    uint triangle_offset; // bytes
+    uint vertex_count;
+    uint triangle_count;
+};
+
+struct draw_command_t {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+// NOTE: a VkDrawIndexedIndirectCommand per phase for the compute path followed by the stats counters
+struct cluster_draw_t {
+    draw_command_t commands[2];
+    uint visible[2];
+    uint occluded;
+    uint pad[3];
+};
+
+// NOTE: the task shader culls CLUSTERS_TASK_GROUP_SIZE meshlets of one instance, one mesh workgroup per survivor
+struct task_payload_t {
+    uint instance;
+    uint meshlets[CLUSTERS_TASK_GROUP_SIZE];
+};
+
+layout (buffer_reference, std430, buffer_reference_align = 16) readonly buffer frame_buffer_t { cluster_frame_t data; };
+layout (buffer_reference, std430, buffer_reference_align = 16) readonly buffer instance_buffer_t { cluster_instance_t data[]; };
+layout (buffer_reference, std430, buffer_reference_align = 16) readonly buffer meshlet_buffer_t { meshlet_t data[]; };
+layout (buffer_reference, std430, buffer_reference_align = 4) readonly buffer meshlet_vertex_buffer_t { uint data[]; };
+// NOTE: u8 local indices read as whole words, every meshlet starts on a word
+layout (buffer_reference, std430, buffer_reference_align = 4) readonly buffer meshlet_triangle_buffer_t { uint data[]; };
+// NOTE: raw words, 12 per vertex_attributes_t
+layout (buffer_reference, std430, buffer_reference_align = 4) readonly buffer vertex_buffer_t { uint data[]; };
+// NOTE: (instance, meshlet) per surviving meshlet, the compacted indices point into it
+layout (buffer_reference, std430, buffer_reference_align = 8) buffer visible_buffer_t { uvec2 data[]; };
+layout (buffer_reference, std430, buffer_reference_align = 4) writeonly buffer index_buffer_t { uint data[]; };
+layout (buffer_reference, std430, buffer_reference_align = 4) buffer draw_buffer_t { cluster_draw_t data; };
+// NOTE: one word per (instance, meshlet), whether the last late phase saw it
+layout (buffer_reference, std430, buffer_reference_align = 4) buffer visibility_buffer_t { uint data[]; };
+
+layout (push_constant) uniform cluster_push_constants_t {
+    light_frame_buffer_t lights; // first in every block, scene.frag reads it at offset 0
+    frame_buffer_t frame;
+    instance_buffer_t instances;
+    meshlet_buffer_t meshlets;
+    meshlet_vertex_buffer_t meshlet_vertices;
+    meshlet_triangle_buffer_t meshlet_triangles;
+    vertex_buffer_t vertices;
+    visible_buffer_t visible;
+    index_buffer_t indices;
+    draw_buffer_t draw;
+    visibility_buffer_t visibility;
+    uint phase;
+} pc;
+
+bool meshlet_visible(meshlet_t meshlet, vec3 center, float radius)
+{
+    for (uint i = 0; i < 6; i++) {
+        vec4 plane = pc.frame.data.planes[i];
+        if (dot(plane.xyz, center) + plane.w < -radius) {
+            return false;
+        }
+    }
+
+    if ((pc.frame.data.flags & CLUSTER_FLAG_CONE_CULLING) != 0u) {
+        vec3 view = center - pc.frame.data.camera_position.xyz;
+        if (dot(view, meshlet.cone.xyz) >= meshlet.cone.w * length(view) + radius) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// NOTE: whether the phase draws the meshlet, the late phase also records what it saw for the next early one
+bool cull_meshlet(meshlet_t meshlet, uint instance_index, uint meshlet_index)
+{
+    uint visibility_index = instance_index * pc.frame.data.meshlet_count + meshlet_index;
+    if (pc.phase == CULL_PHASE_EARLY && pc.visibility.data[visibility_index] == 0u) {
+        return false;
+    }
+
+    // NOTE: instances only translate and scale uniformly, the cone axis is the same in world space
+    cluster_instance_t instance = pc.instances.data[instance_index];
+    vec3 center = meshlet.sphere.xyz * instance.position_scale.w + instance.position_scale.xyz;
+    float radius = meshlet.sphere.w * instance.position_scale.w;
+
+    bool visible = meshlet_visible(meshlet, center, radius);
+    if (pc.phase == CULL_PHASE_EARLY) {
+        return visible;
+    }
+
+    if (visible && occluded(pc.frame.data.pyramid, pc.frame.data.view_projection, center, radius)) {
+        if (pc.phase == CULL_PHASE_LATE) {
+            atomicAdd(pc.draw.data.occluded, 1);
+        }
+        visible = false;
+    }
+
+    // NOTE: the same test against the same pyramid as the late phase, without depending on its visibility writes
+    if (pc.phase == CLUSTER_PHASE_COLOR) {
+        return visible;
+    }
+
+    bool drawn = pc.visibility.data[visibility_index] != 0u;
+    pc.visibility.data[visibility_index] = visible ? 1u : 0u;
+    return visible && !drawn;
+}
+
+uint local_index(uint byte_offset)
+{
+    uint word = pc.meshlet_triangles.data[byte_offset >> 2];
+    return (word >> ((byte_offset & 3u) * 8u)) & 0xFFu;
+}
+
+void load_vertex(uint index, out vec3 position, out vec3 normal)
+{
+    uint base = index * 12;
+    position = uintBitsToFloat(uvec3(pc.vertices.data[base], pc.vertices.data[base + 1], pc.vertices.data[base + 2]));
+    normal = uintBitsToFloat(uvec3(pc.vertices.data[base + 3], pc.vertices.data[base + 4], pc.vertices.data[base + 5]));
+}
+
+vec3 cluster_color(cluster_instance_t instance, uint meshlet)
+{
+    if ((pc.frame.data.flags & CLUSTER_FLAG_MESHLET_COLORS) != 0u) {
+        uint h = meshlet * 0x9E3779B9u;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        return unpackUnorm4x8(h | 0x40404040u).rgb;
+    }
+    return unpackUnorm4x8(instance.color).rgb;
+}
@@ -0,0 +1,32 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "cluster.glsl"
+
+layout (location = 0) out vec3 fragColor;
+layout (location = 1) out vec3 fragNormal;
+layout (location = 2) out vec3 fragWorld;
+
+// NOTE: the color pass tests against the depth prepass with LESS_OR_EQUAL, both must compute the same positions
+invariant gl_Position;
+
+void main()
+{
+    // NOTE: indices written by cluster_cull.comp, visible slot * MESHLET_MAX_VERTICES + meshlet local vertex
+    uvec2 visible = pc.visible.data[gl_VertexIndex / MESHLET_MAX_VERTICES];
+    meshlet_t meshlet = pc.meshlets.data[visible.y];
+    cluster_instance_t instance = pc.instances.data[visible.x];
+
+    uint index = pc.meshlet_vertices.data[meshlet.vertex_offset + gl_VertexIndex % MESHLET_MAX_VERTICES];
+
+    vec3 position;
+    vec3 normal;
+    load_vertex(index, position, normal);
+
+    vec3 world = position * instance.position_scale.w + instance.position_scale.xyz;
+    gl_Position = pc.frame.data.view_projection * vec4(world, 1.0f);
+
+    fragColor = cluster_color(instance, visible.y);
+    fragNormal = normal;
+    fragWorld = world;
+}
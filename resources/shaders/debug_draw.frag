@@ -0,0 +1,11 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+layout (location = 0) in vec4 fragColor;
+
+layout (location = 0) out vec4 outColor;
+
+void main()
+{
+    outColor = fragColor;
+}
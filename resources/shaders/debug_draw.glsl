@@ -0,0 +1,23 @@
+// Debug draw primitives, see debug_draw.hpp for the matching C++ structs
+#extension GL_EXT_buffer_reference : require
+
+const uint DEBUG_PRIMITIVE_TYPE_LINE = 0;
+const uint DEBUG_PRIMITIVE_TYPE_BOX = 1;
+const uint DEBUG_PRIMITIVE_TYPE_SPHERE = 2;
+
+const uint DEBUG_DRAW_SPHERE_SEGMENTS = 32;
+
+struct debug_primitive_t {
+    vec3 a; // line start, box min corner, sphere center
+    uint color; // 0xAABBGGRR, a zero alpha is skipped
+    vec3 b; // line end, box max corner, sphere radii
+    uint pad;
+};
+
+layout (buffer_reference, std430, buffer_reference_align = 16) readonly buffer debug_primitive_buffer_t { debug_primitive_t data[]; };
+
+layout (push_constant) uniform debug_draw_push_constants_t {
+    mat4 view_projection;
+    debug_primitive_buffer_t primitives; // the region of the current type
+    uint type;
+} pc;
@@ -0,0 +1,45 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "debug_draw.glsl"
+
+layout (location = 0) out vec4 fragColor;
+
+// NOTE: the 12 box edges as pairs of corners, bit i of a corner picks the max over the min on axis i
+const uint box_edges[24] = uint[](
+    0, 1, 2, 3, 4, 5, 6, 7,
+    0, 2, 1, 3, 4, 6, 5, 7,
+    0, 4, 1, 5, 2, 6, 3, 7);
+
+void main()
+{
+    // NOTE: not instanced, every primitive owns a fixed run of line list vertices
+    uint per_primitive = pc.type == DEBUG_PRIMITIVE_TYPE_LINE ? 2
+        : pc.type == DEBUG_PRIMITIVE_TYPE_BOX ? 24
+        : 6 * DEBUG_DRAW_SPHERE_SEGMENTS;
+    uint vertex = uint(gl_VertexIndex) % per_primitive;
+    debug_primitive_t primitive = pc.primitives.data[uint(gl_VertexIndex) / per_primitive];
+
+    vec3 position;
+    if (pc.type == DEBUG_PRIMITIVE_TYPE_LINE) {
+        position = vertex == 0 ? primitive.a : primitive.b;
+    } else if (pc.type == DEBUG_PRIMITIVE_TYPE_BOX) {
+        uint corner = box_edges[vertex];
+        position = mix(primitive.a, primitive.b, vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1));
+    } else {
+        // NOTE: a circle in each axis plane, segment s joins points s and s + 1
+        uint circle = vertex / (2 * DEBUG_DRAW_SPHERE_SEGMENTS);
+        uint point = (vertex % (2 * DEBUG_DRAW_SPHERE_SEGMENTS) + 1) / 2;
+        float angle = float(point) * (6.2831853f / float(DEBUG_DRAW_SPHERE_SEGMENTS));
+        vec2 c = vec2(cos(angle), sin(angle));
+        vec3 unit = circle == 0 ? vec3(c, 0.0f) : circle == 1 ? vec3(c.x, 0.0f, c.y) : vec3(0.0f, c);
+        position = primitive.a + unit * primitive.b;
+    }
+
+    // NOTE: zeroed records fill the unused tails of claimed blocks, outside the clip volume they are never rasterized
+    gl_Position = (primitive.color >> 24) == 0 ? vec4(2.0f, 2.0f, 2.0f, 1.0f) : pc.view_projection * vec4(position, 1.0f);
+
+    // NOTE: premultiplied alpha to match the blend state
+    vec4 color = unpackUnorm4x8(primitive.color);
+    fragColor = vec4(color.rgb * color.a, color.a);
+}
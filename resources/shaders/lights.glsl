@@ -0,0 +1,86 @@
+// Clustered forward lighting, see lights.hpp for the matching C++ structs
+#extension GL_EXT_buffer_reference : require
+
+const uint LIGHTS_GRID_X = 16;
+const uint LIGHTS_GRID_Y = 9;
+const uint LIGHTS_GRID_Z = 24;
+const uint LIGHTS_FROXEL_COUNT = LIGHTS_GRID_X * LIGHTS_GRID_Y * LIGHTS_GRID_Z;
+const uint LIGHTS_MAX_PER_FROXEL = 64;
+
+const uint LIGHT_TYPE_POINT = 0;
+const uint LIGHT_TYPE_SPOT = 1;
+
+const uint LIGHTS_FLAG_HEATMAP = 1 << 0;
+
+struct light_t {
+    vec4 position_range; // xyz world position, w distance where the contribution reaches zero
+    vec4 color; // rgb premultiplied by the intensity
+    vec4 direction; // xyz spot axis
+    float cos_outer;
+    float sin_outer;
+    float cos_inner;
+    uint type;
+};
+
+layout (buffer_reference, std430, buffer_reference_align = 16) readonly buffer light_buffer_t { light_t data[]; };
+// NOTE: (offset into the index list, light count) per froxel
+layout (buffer_reference, std430, buffer_reference_align = 8) buffer froxel_buffer_t { uvec2 data[]; };
+layout (buffer_reference, std430, buffer_reference_align = 4) buffer light_index_buffer_t { uint data[]; };
+layout (buffer_reference, std430, buffer_reference_align = 4) buffer light_counters_buffer_t {
+    uint indices;
+    uint truncated;
+};
+
+struct light_frame_t {
+    mat4 view;
+    light_buffer_t lights;
+    froxel_buffer_t froxels;
+    light_index_buffer_t indices;
+    light_counters_buffer_t counters;
+    vec2 tan_half_fov; // x and y
+    vec2 tile_size; // froxel footprint in pixels
+    float z_near;
+    float z_far;
+    float slice_scale; // slice = log(view depth) * slice_scale + slice_bias
+    float slice_bias;
+    uint light_count; // 0 until the grid has been binned once
+    uint flags;
+    uint pad[2];
+};
+
+layout (buffer_reference, std430, buffer_reference_align = 16) readonly buffer light_frame_buffer_t { light_frame_t data; };
+
+// NOTE: inverse of the [0, 1] perspective depth of camera::projection
+float linear_depth(light_frame_t frame, float depth)
+{
+    return frame.z_near * frame.z_far / (frame.z_far - depth * (frame.z_far - frame.z_near));
+}
+
+uint froxel_index(light_frame_t frame, vec4 frag_coord)
+{
+    float slice = log(linear_depth(frame, frag_coord.z)) * frame.slice_scale + frame.slice_bias;
+    uint z = uint(clamp(slice, 0.0f, float(LIGHTS_GRID_Z - 1)));
+    uvec2 tile = min(uvec2(frag_coord.xy / frame.tile_size), uvec2(LIGHTS_GRID_X - 1, LIGHTS_GRID_Y - 1));
+    return (z * LIGHTS_GRID_Y + tile.y) * LIGHTS_GRID_X + tile.x;
+}
+
+vec3 shade_light(light_t light, vec3 world, vec3 normal)
+{
+    vec3 to_light = light.position_range.xyz - world;
+    float distance_sq = dot(to_light, to_light);
+    float range_sq = light.position_range.w * light.position_range.w;
+    if (distance_sq >= range_sq) {
+        return vec3(0.0f);
+    }
+
+    // NOTE: inverse square falloff windowed to reach zero at the range, the binning relies on that bound
+    float window = 1.0f - (distance_sq * distance_sq) / (range_sq * range_sq);
+    float attenuation = window * window / max(distance_sq, 0.01f);
+
+    vec3 l = to_light * inversesqrt(max(distance_sq, 1e-8f));
+    if (light.type == LIGHT_TYPE_SPOT) {
+        attenuation *= smoothstep(light.cos_outer, light.cos_inner, dot(-l, light.direction.xyz));
+    }
+
+    return light.color.rgb * max(dot(normal, l), 0.0f) * attenuation;
+}
@@ -0,0 +1,71 @@
+// Hi-Z pyramid built by depth_pyramid.comp, see occlusion.hpp for the matching C++ struct
+#extension GL_EXT_buffer_reference : require
+
+const uint CULL_PHASE_EARLY = 0;
+const uint CULL_PHASE_LATE = 1;
+
+layout (buffer_reference, std430, buffer_reference_align = 4) readonly buffer pyramid_buffer_t { float data[]; };
+
+struct pyramid_t {
+    pyramid_buffer_t levels; // farthest depth per texel, every level back to back
+    uint width; // of the depth target, level n is ceil(width / 2^(n + 1)) texels wide
+    uint height;
+    uint level_count;
+    uint enabled;
+};
+
+// NOTE: true when the whole sphere lies behind the farthest depth the pyramid holds over its screen rectangle,
+// conservative everywhere else: spheres crossing the near plane or covering the whole target are never occluded
+bool occluded(pyramid_t pyramid, mat4 view_projection, vec3 center, float radius)
+{
+    if (pyramid.enabled == 0u) {
+        return false;
+    }
+
+    // NOTE: the corners of the box around the sphere bound its projection, depth is [0, 1] with far at 1
+    vec2 lo = vec2(1.0f);
+    vec2 hi = vec2(-1.0f);
+    float nearest = 1.0f;
+    for (uint i = 0; i < 8; i++) {
+        vec3 corner = center + radius * vec3((i & 1u) != 0u ? 1.0f : -1.0f, (i & 2u) != 0u ? 1.0f : -1.0f, (i & 4u) != 0u ? 1.0f : -1.0f);
+        vec4 clip = view_projection * vec4(corner, 1.0f);
+        if (clip.w <= 1e-5f) {
+            return false;
+        }
+
+        vec3 ndc = clip.xyz / clip.w;
+        lo = min(lo, ndc.xy);
+        hi = max(hi, ndc.xy);
+        nearest = min(nearest, ndc.z);
+    }
+
+    if (nearest <= 0.0f) {
+        return false;
+    }
+
+    vec2 size = vec2(pyramid.width, pyramid.height);
+    uvec2 p0 = uvec2(clamp((lo * 0.5f + 0.5f) * size, vec2(0.0f), size - 1.0f));
+    uvec2 p1 = uvec2(clamp((hi * 0.5f + 0.5f) * size, vec2(0.0f), size - 1.0f));
+
+    // NOTE: the first level where the rectangle spans at most 2x2 texels, level n texels cover 2^(n + 1) pixels
+    uvec2 span = p1 - p0 + 1u;
+    uint level = uint(max(findMSB(max(span.x, span.y) - 1u) + 1, 1));
+    level = min(level, pyramid.level_count);
+
+    uint offset = 0;
+    uvec2 dims = uvec2(pyramid.width, pyramid.height);
+    for (uint l = 1; l <= level; l++) {
+        dims = (dims + 1u) / 2u;
+        if (l < level) {
+            offset += dims.x * dims.y;
+        }
+    }
+
+    uvec2 t0 = min(p0 >> level, dims - 1u);
+    uvec2 t1 = min(t0 + 1u, dims - 1u);
+    float farthest = max(
+        max(pyramid.levels.data[offset + t0.y * dims.x + t0.x], pyramid.levels.data[offset + t0.y * dims.x + t1.x]),
+        max(pyramid.levels.data[offset + t1.y * dims.x + t0.x], pyramid.levels.data[offset + t1.y * dims.x + t1.x]));
+
+    return nearest > farthest;
+}
@@ -0,0 +1,47 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "lights.glsl"
+
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec3 fragNormal;
+layout (location = 2) in vec3 fragWorld;
+
+layout (location = 0) out vec4 outColor;
+
+// NOTE: shared by the scene and clusters pipelines, both push constant blocks start with the light frame
+layout (push_constant) uniform lighting_push_constants_t {
+    light_frame_buffer_t lights;
+} pc;
+
+void main()
+{
+    vec3 normal = normalize(fragNormal);
+
+    const vec3 sun = normalize(vec3(0.4f, 1.0f, 0.3f));
+    float diffuse = max(dot(normal, sun), 0.0f);
+
+    // NOTE: no lights, or the grid has not been binned yet
+    light_frame_t frame = pc.lights.data;
+    if (frame.light_count == 0u) {
+        outColor = vec4(fragColor * (0.2f + 0.8f * diffuse), 1.0f);
+        return;
+    }
+
+    // NOTE: the sun is dimmed so the local lights stand out
+    vec3 radiance = vec3(0.1f + 0.3f * diffuse);
+
+    // NOTE: only the lights binned into this froxel, at most LIGHTS_MAX_PER_FROXEL whatever the total
+    uvec2 froxel = frame.froxels.data[froxel_index(frame, gl_FragCoord)];
+    for (uint i = 0; i < froxel.y; i++) {
+        radiance += shade_light(frame.lights.data[frame.indices.data[froxel.x + i]], fragWorld, normal);
+    }
+
+    if ((frame.flags & LIGHTS_FLAG_HEATMAP) != 0u) {
+        float heat = float(froxel.y) / float(LIGHTS_MAX_PER_FROXEL);
+        outColor = vec4(mix(vec3(0.0f, 0.0f, 1.0f), vec3(1.0f, 0.0f, 0.0f), heat) * (0.25f + 0.75f * sqrt(heat)), 1.0f);
+        return;
+    }
+
+    outColor = vec4(fragColor * radiance, 1.0f);
+}
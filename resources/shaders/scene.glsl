@@ -0,0 +1,72 @@
+// GPU driven scene layout, see scene.hpp for the matching C++ structs
+#extension GL_EXT_buffer_reference : require
+
+#include "lights.glsl"
+#include "occlusion.glsl"
+
+const uint SCENE_MAX_INSTANCES = 1 << 20;
+const uint SCENE_MAX_LODS = 4;
+
+struct scene_frame_t {
+    mat4 view_projection;
+    vec4 planes[6];
+    vec4 camera_position;
+    pyramid_t pyramid;
+    float lod_scale;
+    uint instance_count;
+};
+
+struct instance_t {
+    vec4 position_scale; // xyz position, w uniform scale
+    uint mesh;
+    uint color;
+    uint pad[2];
+};
+
+struct mesh_lod_t {
+    uint first_index;
+    uint index_count;
+};
+
+struct mesh_t {
+    vec4 position_offset; // xyz, dequantization of quantized positions
+    vec4 position_scale;
+    float radius;
+    int vertex_offset;
+    uint lod_count;
+    uint pad;
+    mesh_lod_t lods[SCENE_MAX_LODS];
+};
+
+struct draw_command_t {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+layout (buffer_reference, std430, buffer_reference_align = 16) readonly buffer frame_buffer_t { scene_frame_t data; };
+layout (buffer_reference, std430, buffer_reference_align = 16) readonly buffer instance_buffer_t { instance_t data[]; };
+layout (buffer_reference, std430, buffer_reference_align = 16) readonly buffer mesh_buffer_t { mesh_t data[]; };
+// NOTE: raw words, 12 per vertex_attributes_t or 5 per quantized_vertex_t, see vertex_format.hpp
+layout (buffer_reference, std430, buffer_reference_align = 4) readonly buffer vertex_buffer_t { uint data[]; };
+layout (buffer_reference, std430, buffer_reference_align = 4) writeonly buffer draw_buffer_t { draw_command_t data[]; };
+layout (buffer_reference, std430, buffer_reference_align = 4) buffer counts_buffer_t {
+    uint draws[2];
+    uint occluded;
+    uint pad;
+};
+layout (buffer_reference, std430, buffer_reference_align = 4) buffer visibility_buffer_t { uint data[]; };
+
+layout (push_constant) uniform scene_push_constants_t {
+    light_frame_buffer_t lights; // first in every block, scene.frag reads it at offset 0
+    frame_buffer_t frame;
+    instance_buffer_t instances;
+    mesh_buffer_t meshes;
+    vertex_buffer_t vertices;
+    draw_buffer_t draws;
+    counts_buffer_t counts;
+    visibility_buffer_t visibility;
+    uint phase;
+} pc;
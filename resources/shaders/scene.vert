@@ -0,0 +1,53 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "scene.glsl"
+
+layout (constant_id = 0) const uint FEATURES = 0;
+const bool FEATURE_QUANTIZED = (FEATURES & 1u) != 0u;
+
+layout (location = 0) out vec3 fragColor;
+layout (location = 1) out vec3 fragNormal;
+layout (location = 2) out vec3 fragWorld;
+
+// NOTE: the color pass tests against the depth prepass with LESS_OR_EQUAL, both must compute the same positions
+invariant gl_Position;
+
+vec3 decode_octahedral(uint packed)
+{
+    vec2 e = unpackSnorm2x16(packed);
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    // NOTE: firstInstance carries the instance index and vertexOffset is already part of gl_VertexIndex
+    instance_t instance = pc.instances.data[gl_InstanceIndex];
+
+    vec3 position;
+    vec3 normal;
+    if (FEATURE_QUANTIZED) {
+        mesh_t mesh = pc.meshes.data[instance.mesh];
+        uint base = gl_VertexIndex * 5;
+        uint xy = pc.vertices.data[base];
+        uint z = pc.vertices.data[base + 1] & 0xFFFFu;
+
+        position = mesh.position_offset.xyz + vec3(xy & 0xFFFFu, xy >> 16, z) * mesh.position_scale.xyz;
+        normal = decode_octahedral(pc.vertices.data[base + 2]);
+    } else {
+        uint base = gl_VertexIndex * 12;
+        position = uintBitsToFloat(uvec3(pc.vertices.data[base], pc.vertices.data[base + 1], pc.vertices.data[base + 2]));
+        normal = uintBitsToFloat(uvec3(pc.vertices.data[base + 3], pc.vertices.data[base + 4], pc.vertices.data[base + 5]));
+    }
+
+    vec3 world = position * instance.position_scale.w + instance.position_scale.xyz;
+    gl_Position = pc.frame.data.view_projection * vec4(world, 1.0f);
+
+    fragColor = unpackUnorm4x8(instance.color).rgb;
+    fragNormal = normal;
+    fragWorld = world;
+}
@@ -0,0 +1,16 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
+#include "sprite.glsl"
+
+layout (location = 0) in vec2 fragUV;
+layout (location = 1) in vec4 fragColor;
+layout (location = 2) flat in uint fragTexture;
+
+layout (location = 0) out vec4 outColor;
+
+void main()
+{
+    outColor = bindless_sample(fragTexture, pc.sampler_index, fragUV) * fragColor;
+}
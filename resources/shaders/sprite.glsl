@@ -0,0 +1,19 @@
+// Batched sprites, see sprites.hpp for the matching C++ structs
+#extension GL_EXT_buffer_reference : require
+
+struct sprite_t {
+    vec2 position; // center, in pixels
+    vec2 half_size;
+    float rotation; // radians
+    float depth; // only used for sorting
+    uint color; // 0xAABBGGRR, multiplied with the texture
+    uint texture; // bindless index
+};
+
+layout (buffer_reference, std430, buffer_reference_align = 16) readonly buffer sprite_buffer_t { sprite_t data[]; };
+
+layout (push_constant) uniform sprite_push_constants_t {
+    sprite_buffer_t sprites;
+    vec2 pixel_to_ndc; // 2 / extent
+    uint sampler_index;
+} pc;
@@ -0,0 +1,32 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "sprite.glsl"
+
+layout (location = 0) out vec2 fragUV;
+layout (location = 1) out vec4 fragColor;
+layout (location = 2) flat out uint fragTexture;
+
+// NOTE: two counter clockwise triangles, expanded from one sprite_t per instance
+const vec2 corners[6] = vec2[](
+    vec2(-1.0f, -1.0f), vec2(1.0f, -1.0f), vec2(1.0f, 1.0f),
+    vec2(-1.0f, -1.0f), vec2(1.0f, 1.0f), vec2(-1.0f, 1.0f));
+
+void main()
+{
+    sprite_t sprite = pc.sprites.data[gl_InstanceIndex];
+    vec2 corner = corners[gl_VertexIndex];
+
+    float s = sin(sprite.rotation);
+    float c = cos(sprite.rotation);
+    vec2 local = corner * sprite.half_size;
+    vec2 position = sprite.position + vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+
+    gl_Position = vec4(position * pc.pixel_to_ndc - 1.0f, 0.0f, 1.0f);
+
+    // NOTE: premultiplied alpha to match the blend state
+    vec4 color = unpackUnorm4x8(sprite.color);
+    fragColor = vec4(color.rgb * color.a, color.a);
+    fragUV = corner * 0.5f + 0.5f;
+    fragTexture = sprite.texture;
+}
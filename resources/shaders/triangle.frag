@@ -1,8 +1,15 @@
 #version 450
 
+layout (constant_id = 0) const uint FEATURES = 0;
+const bool FEATURE_GRAYSCALE = (FEATURES & 1u) != 0u;
+
 layout (location = 0) in vec3 inColor;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(inColor, 1.0);
+    vec3 color = inColor;
+    if (FEATURE_GRAYSCALE) {
+        color = vec3(dot(color, vec3(0.2126, 0.7152, 0.0722)));
+    }
+    outColor = vec4(color, 1.0);
 }
@@ -1,12 +1,24 @@
 #version 450
+#extension GL_EXT_buffer_reference : require
 
-layout (location = 0) in vec2 inPosition;
-layout (location = 1) in vec3 inColor;
+// NOTE: vertex_t in renderer.cpp, 12 bytes { vec2 pos; uint color; } read as raw words
+// since std430 would pad a vec2 + uint struct to 16 bytes
+layout (buffer_reference, std430, buffer_reference_align = 4) readonly buffer vertex_buffer_t {
+    uint words[];
+};
+
+layout (push_constant) uniform draw_push_constants_t {
+    vertex_buffer_t vertices;
+} pc;
 
 layout (location = 0) out vec3 fragColor;
 
 void main() 
 {
-    gl_Position = vec4(inPosition, 0.0f, 1.0f);
-    fragColor = inColor;
+    uint base = gl_VertexIndex * 3;
+    vec2 position = vec2(uintBitsToFloat(pc.vertices.words[base]), uintBitsToFloat(pc.vertices.words[base + 1]));
+    vec4 color = unpackUnorm4x8(pc.vertices.words[base + 2]);
+
+    gl_Position = vec4(position, 0.0f, 1.0f);
+    fragColor = color.rgb;
 }
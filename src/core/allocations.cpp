@@ -0,0 +1,383 @@
+#include "allocations.hpp"
+
+#include "core/hash.hpp"
+#include "core/logger.hpp"
+#include "core/profiler.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(RIN_TRACK_ALLOCATIONS) && defined(__GLIBC__)
+#define RIN_ALLOCATIONS_HOOKED
+#include <dlfcn.h>
+#endif
+
+namespace rin::allocations {
+
+struct site_slot_t {
+    std::atomic<uintptr_t> address; // 0 while the slot is free, slots are never released
+    std::atomic<u64> frame_count;
+    std::atomic<u64> total_count;
+    std::atomic<const char*> region;
+    std::atomic<bool> reported;
+};
+
+// NOTE: plain statics rather than a created state, allocations start before main and outlive the engine
+static site_slot_t sites[ALLOCATIONS_MAX_SITES];
+static std::atomic<u64> frame_calls;
+static std::atomic<u64> frame_bytes;
+static std::atomic<u64> frame_frees;
+static std::atomic<u64> dropped_sites; // allocations whose call site did not fit in the table
+static std::atomic<u64> violations;
+static std::atomic<bool> armed; // past the warm up, regions are enforced
+static std::atomic<violation_mode_t> mode { VIOLATION_MODE_LOG };
+
+// NOTE: main thread only, end_frame() and report() are called from the engine loop
+#ifdef RIN_ALLOCATIONS_HOOKED
+static u64 frame_index;
+#endif
+static u64 steady_frames;
+static u64 steady_allocating_frames; // steady state frames with at least one allocation
+static u64 steady_calls;
+static u64 steady_max_calls;
+
+static thread_local const char* region = nullptr;
+static thread_local bool in_hook = false; // the tracking itself, logging included, is never counted
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+no_alloc_scope_t::no_alloc_scope_t(const char* name)
+{
+    previous = region;
+    region = name;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+no_alloc_scope_t::~no_alloc_scope_t()
+{
+    region = previous;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+allow_alloc_scope_t::allow_alloc_scope_t(const char* reason)
+{
+    (void)reason;
+    previous = region;
+    region = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+allow_alloc_scope_t::~allow_alloc_scope_t()
+{
+    region = previous;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool enabled(void)
+{
+#ifdef RIN_ALLOCATIONS_HOOKED
+    return true;
+#else
+    return false;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void set_violation_mode(violation_mode_t violation_mode)
+{
+    mode.store(violation_mode, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+violation_mode_t violation_mode(void)
+{
+    return mode.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void describe(uintptr_t address, char* out, u32 size)
+{
+#ifdef RIN_ALLOCATIONS_HOOKED
+    // NOTE: symbols of the executable itself need it linked with exported symbols, see RIN_TRACK_ALLOCATIONS
+    Dl_info info {};
+    if (dladdr((void*)address, &info) != 0) {
+        if (info.dli_sname != nullptr) {
+            snprintf(out, size, "%s+0x%lx", info.dli_sname, (unsigned long)(address - (uintptr_t)info.dli_saddr));
+            return;
+        }
+
+        if (info.dli_fname != nullptr) {
+            snprintf(out, size, "%s+0x%lx", info.dli_fname, (unsigned long)(address - (uintptr_t)info.dli_fbase));
+            return;
+        }
+    }
+#endif
+
+    snprintf(out, size, "%p", (void*)address);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static site_slot_t* find_site(uintptr_t address)
+{
+    // NOTE: open addressing with lock free inserts, a slot is claimed once and keeps its address forever
+    u32 index = (u32)hash::combine(hash::FNV_OFFSET_BASIS, address) % ALLOCATIONS_MAX_SITES;
+    for (u32 probe = 0; probe < ALLOCATIONS_MAX_SITES; probe++) {
+        site_slot_t* site = &sites[(index + probe) % ALLOCATIONS_MAX_SITES];
+
+        uintptr_t current = site->address.load(std::memory_order_acquire);
+        if (current == 0 && site->address.compare_exchange_strong(current, address, std::memory_order_acq_rel)) {
+            return site;
+        }
+
+        if (current == address) {
+            return site;
+        }
+    }
+
+    return nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+[[maybe_unused]] static void record(u64 size, uintptr_t address)
+{
+    if (in_hook) {
+        return;
+    }
+    in_hook = true;
+
+    frame_calls.fetch_add(1, std::memory_order_relaxed);
+    frame_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    site_slot_t* site = find_site(address);
+    if (site != nullptr) {
+        site->frame_count.fetch_add(1, std::memory_order_relaxed);
+        site->total_count.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        dropped_sites.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (region != nullptr && armed.load(std::memory_order_relaxed)) {
+        violations.fetch_add(1, std::memory_order_relaxed);
+        if (site != nullptr) {
+            site->region.store(region, std::memory_order_relaxed);
+        }
+
+        if (mode.load(std::memory_order_relaxed) == VIOLATION_MODE_ABORT) {
+            char name[256];
+            describe(address, name, sizeof(name));
+            log::error("allocations -> %llu bytes allocated in no alloc region %s from %s", (unsigned long long)size, region, name);
+            abort();
+        }
+    }
+
+    in_hook = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+[[maybe_unused]] static void record_free(void)
+{
+    if (!in_hook) {
+        frame_frees.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void end_frame(void)
+{
+#ifdef RIN_ALLOCATIONS_HOOKED
+    in_hook = true;
+
+    u64 calls = frame_calls.exchange(0, std::memory_order_relaxed);
+    u64 bytes = frame_bytes.exchange(0, std::memory_order_relaxed);
+    u64 frees = frame_frees.exchange(0, std::memory_order_relaxed);
+    profiler::record("frame allocations", "calls", (f64)calls);
+    profiler::record("frame frees", "calls", (f64)frees);
+    profiler::record("frame allocated", "KB", (f64)bytes / 1024.0);
+
+    if (armed.load(std::memory_order_relaxed)) {
+        steady_frames += 1;
+        steady_calls += calls;
+        steady_allocating_frames += calls > 0 ? 1 : 0;
+        steady_max_calls = calls > steady_max_calls ? calls : steady_max_calls;
+    }
+
+    for (u32 i = 0; i < ALLOCATIONS_MAX_SITES; i++) {
+        site_slot_t& site = sites[i];
+        if (site.address.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        site.frame_count.store(0, std::memory_order_relaxed);
+
+        const char* site_region = site.region.load(std::memory_order_relaxed);
+        if (site_region != nullptr && !site.reported.exchange(true, std::memory_order_relaxed)) {
+            char name[256];
+            describe(site.address.load(std::memory_order_relaxed), name, sizeof(name));
+            log::warn("allocations -> allocation in no alloc region %s from %s", site_region, name);
+        }
+    }
+
+    frame_index += 1;
+    if (frame_index == ALLOCATIONS_WARMUP_FRAMES) {
+        log::info("allocations -> warm up over, enforcing no alloc regions");
+        armed.store(true, std::memory_order_relaxed);
+    }
+
+    in_hook = false;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 snapshot(site_t* out, u32 max_count)
+{
+    // NOTE: insertion into the output, which stays sorted by total count and only keeps the busiest sites
+    u32 count = 0;
+    for (u32 i = 0; i < ALLOCATIONS_MAX_SITES; i++) {
+        const site_slot_t& slot = sites[i];
+        uintptr_t address = slot.address.load(std::memory_order_relaxed);
+        if (address == 0) {
+            continue;
+        }
+
+        site_t site {
+            .address = address,
+            .frame_count = slot.frame_count.load(std::memory_order_relaxed),
+            .total_count = slot.total_count.load(std::memory_order_relaxed),
+            .region = slot.region.load(std::memory_order_relaxed),
+        };
+
+        u32 position = count;
+        while (position > 0 && out[position - 1].total_count < site.total_count) {
+            if (position < max_count) {
+                out[position] = out[position - 1];
+            }
+            position--;
+        }
+
+        if (position < max_count) {
+            out[position] = site;
+            count = count < max_count ? count + 1 : count;
+        }
+    }
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool report(void)
+{
+    if (!enabled()) {
+        return true;
+    }
+    in_hook = true;
+
+    log::info("allocations -> %llu steady state frames, %llu of them allocated, %.2f calls per frame, at most %llu",
+        (unsigned long long)steady_frames, (unsigned long long)steady_allocating_frames,
+        steady_frames > 0 ? (f64)steady_calls / (f64)steady_frames : 0.0, (unsigned long long)steady_max_calls);
+
+    site_t busiest[ALLOCATIONS_REPORT_SITES];
+    u32 count = snapshot(busiest, ALLOCATIONS_REPORT_SITES);
+    for (u32 i = 0; i < count; i++) {
+        char name[256];
+        describe(busiest[i].address, name, sizeof(name));
+        log::info("allocations ->   %llu from %s%s%s", (unsigned long long)busiest[i].total_count, name,
+            busiest[i].region != nullptr ? " in " : "", busiest[i].region != nullptr ? busiest[i].region : "");
+    }
+
+    if (dropped_sites.load(std::memory_order_relaxed) > 0) {
+        log::warn("allocations -> %llu allocations from call sites past the table", (unsigned long long)dropped_sites.load());
+    }
+
+    u64 count_in_regions = violations.load(std::memory_order_relaxed);
+    if (count_in_regions > 0) {
+        log::error("allocations -> %llu allocations in no alloc regions after the warm up", (unsigned long long)count_in_regions);
+    }
+
+    in_hook = false;
+    return count_in_regions == 0;
+}
+
+}
+
+#ifdef RIN_ALLOCATIONS_HOOKED
+
+// NOTE: the executable defines the allocator entry points, the dynamic linker binds every caller to them, libraries
+// and the driver included, and they forward to the glibc implementation
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* memory, size_t size);
+void __libc_free(void* memory);
+
+void* malloc(size_t size) noexcept
+{
+    rin::allocations::record(size, (uintptr_t)__builtin_return_address(0));
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    rin::allocations::record(count * size, (uintptr_t)__builtin_return_address(0));
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* memory, size_t size) noexcept
+{
+    if (size > 0) {
+        rin::allocations::record(size, (uintptr_t)__builtin_return_address(0));
+    }
+    return __libc_realloc(memory, size);
+}
+
+void free(void* memory) noexcept
+{
+    if (memory != nullptr) {
+        rin::allocations::record_free();
+    }
+    __libc_free(memory);
+}
+}
+
+// NOTE: replaced as well so the call site is the caller of new rather than the standard library
+void* operator new(size_t size)
+{
+    rin::allocations::record(size, (uintptr_t)__builtin_return_address(0));
+    void* memory = __libc_malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        abort(); // built without exceptions, there is no std::bad_alloc to throw
+    }
+    return memory;
+}
+
+void* operator new[](size_t size)
+{
+    rin::allocations::record(size, (uintptr_t)__builtin_return_address(0));
+    void* memory = __libc_malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        abort();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+#endif
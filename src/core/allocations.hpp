@@ -0,0 +1,70 @@
+#pragma once
+
+#include "core/defines.hpp"
+
+namespace rin::allocations {
+
+constexpr u32 ALLOCATIONS_MAX_SITES = 1024; // distinct call sites tracked, further ones are only counted
+constexpr u32 ALLOCATIONS_WARMUP_FRAMES = 120; // regions are enforced once pipelines, caches and the GUI settled
+constexpr u32 ALLOCATIONS_REPORT_SITES = 8;
+
+enum violation_mode_t {
+    VIOLATION_MODE_LOG, // reported once per call site at the end of the frame
+    VIOLATION_MODE_ABORT, // logged and aborted on the spot, the debugger stops in the offending call
+};
+
+struct site_t {
+    uintptr_t address; // return address of the allocation call
+    u64 frame_count; // this frame
+    u64 total_count;
+    const char* region; // RIN_NO_ALLOC region it allocated in after the warm up, nullptr if none
+};
+
+// Marks the rest of the enclosing scope as a region that must not allocate on this thread, see RIN_NO_ALLOC.
+struct no_alloc_scope_t {
+    explicit no_alloc_scope_t(const char* name);
+    ~no_alloc_scope_t();
+
+    const char* previous;
+};
+
+// Lifts the enclosing region for the rest of the scope, for rare user triggered paths that are expected to allocate
+// (resizes, buffer growth, new pipeline variants), see RIN_ALLOW_ALLOC. reason documents the call site.
+struct allow_alloc_scope_t {
+    explicit allow_alloc_scope_t(const char* reason);
+    ~allow_alloc_scope_t();
+
+    const char* previous;
+};
+
+// Allocation tracking is compiled in with RIN_TRACK_ALLOCATIONS, it interposes malloc, calloc, realloc, free and the
+// global operator new and delete (glibc only). Without it every function here is a no-op and report() passes.
+bool enabled(void);
+
+void set_violation_mode(violation_mode_t mode);
+violation_mode_t violation_mode(void);
+
+// Records the allocations of the frame as profiler stats, reports new violations and resets the frame counters.
+// Called once per frame by the engine loop.
+void end_frame(void);
+
+// Copies up to max_count call sites, most allocations first, and returns how many were written.
+u32 snapshot(site_t* out, u32 max_count);
+
+// Symbol and offset of a call site when the binary exports it, the raw address otherwise.
+void describe(uintptr_t address, char* out, u32 size);
+
+// Logs the steady state counters and the busiest call sites, false when a region allocated after the warm up.
+bool report(void);
+
+}
+
+#ifdef RIN_TRACK_ALLOCATIONS
+#define RIN_NO_ALLOC_CONCAT_INNER(a, b) a##b
+#define RIN_NO_ALLOC_CONCAT(a, b) RIN_NO_ALLOC_CONCAT_INNER(a, b)
+#define RIN_NO_ALLOC(name) ::rin::allocations::no_alloc_scope_t RIN_NO_ALLOC_CONCAT(no_alloc_, __LINE__) { name }
+#define RIN_ALLOW_ALLOC(reason) ::rin::allocations::allow_alloc_scope_t RIN_NO_ALLOC_CONCAT(allow_alloc_, __LINE__) { reason }
+#else
+#define RIN_NO_ALLOC(name)
+#define RIN_ALLOW_ALLOC(reason)
+#endif
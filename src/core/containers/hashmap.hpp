@@ -0,0 +1,188 @@
+#pragma once
+
+#include "core/defines.hpp"
+
+#include <cstdlib>
+
+namespace rin {
+
+constexpr i32 HASHMAP_DEFAULT_CAPACITY = 16;
+
+// Open addressing map with linear probing keyed on precomputed 64 bit hashes.
+// Key 0 marks an empty slot, so a 0 hash is remapped to 1 on every access.
+template<typename T>
+struct hashmap {
+    u64* keys;
+    T* values;
+    size_t len;
+    size_t capacity; // always a power of two
+
+    hashmap() = delete;
+    hashmap(const hashmap&) = delete;
+    hashmap& operator=(const hashmap&) = delete;
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    hashmap(hashmap&& other) noexcept
+    {
+        keys = other.keys;
+        values = other.values;
+        len = other.len;
+        capacity = other.capacity;
+        other.keys = nullptr;
+        other.values = nullptr;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    hashmap& operator=(hashmap&& other) noexcept
+    {
+        if (&other == this) {
+            return *this;
+        }
+
+        keys = other.keys;
+        values = other.values;
+        other.keys = nullptr;
+        other.values = nullptr;
+        len = other.len;
+        capacity = other.capacity;
+        return *this;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    hashmap(u64 initial_capacity) noexcept
+    {
+        capacity = HASHMAP_DEFAULT_CAPACITY;
+        while (capacity < initial_capacity) {
+            capacity *= 2;
+        }
+
+        keys = (u64*)calloc(capacity, sizeof(u64));
+        values = (T*)calloc(capacity, sizeof(T));
+        len = 0;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ~hashmap(void) noexcept
+    {
+        if (keys != nullptr) {
+            free(keys);
+        }
+
+        if (values != nullptr) {
+            free(values);
+        }
+
+        keys = nullptr;
+        values = nullptr;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    T* find(u64 key) noexcept
+    {
+        key = key == 0 ? 1 : key;
+        size_t mask = capacity - 1;
+        for (size_t i = key & mask;; i = (i + 1) & mask) {
+            if (keys[i] == key) {
+                return &values[i];
+            }
+
+            if (keys[i] == 0) {
+                return nullptr;
+            }
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Inserts or overwrites the value stored at key, returns the stored value.
+    T* insert(u64 key, const T& value) noexcept
+    {
+        // NOTE: keep the load factor under 0.75 so probe chains stay short
+        if ((len + 1) * 4 > capacity * 3) {
+            rehash(capacity * 2);
+        }
+
+        key = key == 0 ? 1 : key;
+        size_t mask = capacity - 1;
+        size_t i = key & mask;
+        while (keys[i] != 0 && keys[i] != key) {
+            i = (i + 1) & mask;
+        }
+
+        if (keys[i] == 0) {
+            len += 1;
+        }
+
+        keys[i] = key;
+        values[i] = value;
+        return &values[i];
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    bool remove(u64 key) noexcept
+    {
+        key = key == 0 ? 1 : key;
+        size_t mask = capacity - 1;
+        size_t i = key & mask;
+        while (keys[i] != key) {
+            if (keys[i] == 0) {
+                return false;
+            }
+            i = (i + 1) & mask;
+        }
+
+        // NOTE: backward shift deletion, no tombstones needed
+        size_t hole = i;
+        for (size_t j = (hole + 1) & mask; keys[j] != 0; j = (j + 1) & mask) {
+            size_t home = keys[j] & mask;
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                keys[hole] = keys[j];
+                values[hole] = values[j];
+                hole = j;
+            }
+        }
+
+        keys[hole] = 0;
+        len -= 1;
+        return true;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void clear(void) noexcept
+    {
+        for (size_t i = 0; i < capacity; i++) {
+            keys[i] = 0;
+        }
+        len = 0;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    void rehash(size_t new_capacity) noexcept
+    {
+        u64* old_keys = keys;
+        T* old_values = values;
+        size_t old_capacity = capacity;
+
+        keys = (u64*)calloc(new_capacity, sizeof(u64));
+        values = (T*)calloc(new_capacity, sizeof(T));
+        capacity = new_capacity;
+
+        size_t mask = capacity - 1;
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_keys[i] == 0) {
+                continue;
+            }
+
+            size_t j = old_keys[i] & mask;
+            while (keys[j] != 0) {
+                j = (j + 1) & mask;
+            }
+            keys[j] = old_keys[i];
+            values[j] = old_values[i];
+        }
+
+        free(old_keys);
+        free(old_values);
+    }
+};
+
+}
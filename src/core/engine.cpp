@@ -1,7 +1,10 @@
 #include "engine.hpp"
 
+#include "core/allocations.hpp"
 #include "core/clock.hpp"
+#include "core/jobs.hpp"
 #include "core/logger.hpp"
+#include "core/profiler.hpp"
 #include "systems/renderer/renderer.hpp"
 #include "systems/window/window.hpp"
 
@@ -25,11 +28,18 @@ bool initialize(application* app)
     }
 
     clock::init();
+    profiler::initialize();
 
     log::info("initializing engine");
     state = (state_t*)calloc(1, sizeof(state_t));
     state->app = app;
 
+    if (!jobs::initialize(0)) {
+        log::error("engine::create -> failed to initialize job system");
+        shutdown();
+        return false;
+    }
+
     if (!window::initialize(app->config.window_width, app->config.window_height, app->config.name)) {
         log::error("engine::create -> failed to initialize window system");
         shutdown();
@@ -53,10 +63,12 @@ void shutdown(void)
 
     renderer::shutdown();
     window::shutdown();
+    jobs::shutdown();
 
     free(state);
     state = nullptr;
     log::info("engine shut down");
+    profiler::shutdown();
     clock::shutdown();
 }
 
@@ -72,6 +84,7 @@ bool run(void)
     state->is_running = true;
 
     while (state->is_running) {
+        RIN_NO_ALLOC("engine::run");
         clock::track_update();
 
         if (!renderer::draw()) {
@@ -83,6 +96,13 @@ bool run(void)
 
         window::poll();
         state->is_running = !window::should_close();
+        allocations::end_frame();
+    }
+
+    // NOTE: the exit status is what a benchmark run checks, allocating in a no alloc region fails it
+    if (!allocations::report()) {
+        log::error("engine::run -> allocations in no alloc regions");
+        return false;
     }
 
     return true;
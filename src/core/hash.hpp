@@ -0,0 +1,42 @@
+#pragma once
+
+#include "core/defines.hpp"
+
+#include <cstddef>
+
+namespace rin::hash {
+
+constexpr u64 FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+constexpr u64 FNV_PRIME = 0x100000001b3ull;
+
+// FNV-1a over a raw byte range, `seed` allows chaining multiple ranges into one key.
+inline u64 fnv1a(const void* data, size_t len, u64 seed = FNV_OFFSET_BASIS)
+{
+    const u8* bytes = (const u8*)data;
+    u64 hash = seed;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// NOTE: only feed scalars or padding-free structs, padding bytes would end up in the key
+template<typename T>
+inline u64 combine(u64 seed, const T& value)
+{
+    return fnv1a(&value, sizeof(T), seed);
+}
+
+// Integer finalizer (lowbias32), cheap stateless randomness indexed by element so it can be filled in parallel.
+inline u32 mix32(u32 x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+}
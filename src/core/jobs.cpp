@@ -0,0 +1,296 @@
+#include "jobs.hpp"
+
+#include "core/containers/darray.hpp"
+#include "core/logger.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace rin::jobs {
+
+constexpr u32 JOBS_QUEUE_INITIAL_CAPACITY = 256;
+
+struct job_t {
+    job_fn fn;
+    void* data;
+    counter_t* counter;
+};
+
+struct ring_t {
+    darray<job_t> jobs; // len is unused
+    u32 head;
+    u32 count;
+};
+
+struct state_t {
+    u32 worker_count;
+    bool running;
+    ring_t queue;
+    ring_t background; // only popped by workers, see submit_background()
+};
+
+struct parallel_for_t {
+    range_fn fn;
+    void* data;
+    u32 count;
+    u32 batch_size;
+    std::atomic<u32> next;
+};
+
+static state_t* state = nullptr;
+
+// NOTE: sync primitives and threads are not trivially constructible, so they live outside of the calloc'ed state
+static std::mutex queue_mutex;
+static std::condition_variable queue_signal;
+static std::thread workers[JOBS_MAX_WORKERS];
+static thread_local u32 local_thread_index = 0;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool pop(ring_t* ring, job_t* out)
+{
+    if (ring->count == 0) {
+        return false;
+    }
+
+    *out = ring->jobs[ring->head];
+    ring->head = (ring->head + 1) % ring->jobs.capacity;
+    ring->count -= 1;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void push(ring_t* ring, const job_t& job)
+{
+    if (ring->count == ring->jobs.capacity) {
+        // NOTE: unroll the ring into a bigger one, keeps FIFO order
+        u32 capacity = ring->jobs.capacity;
+        darray<job_t> grown { capacity * 2, true };
+        for (u32 i = 0; i < ring->count; i++) {
+            grown[i] = ring->jobs[(ring->head + i) % capacity];
+        }
+        ring->jobs.~darray();
+        ring->jobs = std::move(grown);
+        ring->head = 0;
+    }
+
+    u32 tail = (ring->head + ring->count) % ring->jobs.capacity;
+    ring->jobs[tail] = job;
+    ring->count += 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void execute(const job_t& job)
+{
+    job.fn(job.data);
+    if (job.counter != nullptr) {
+        job.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void worker_main(u32 index)
+{
+    local_thread_index = index;
+
+    while (true) {
+        job_t job;
+        {
+            std::unique_lock<std::mutex> lock { queue_mutex };
+            queue_signal.wait(lock, [] {
+                return !state->running || state->queue.count > 0 || state->background.count > 0;
+            });
+
+            // NOTE: frame work first, a long background job must not hold back a parallel_for
+            if (!pop(&state->queue, &job) && !pop(&state->background, &job)) {
+                return; // stopped and drained
+            }
+        }
+
+        execute(job);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool initialize(u32 worker_count)
+{
+    if (state != nullptr) {
+        log::error("jobs::initialize -> job system already initialized");
+        return false;
+    }
+
+    if (worker_count == 0) {
+        u32 hardware = std::thread::hardware_concurrency();
+        worker_count = hardware > 1 ? hardware - 1 : 1;
+    }
+
+    if (worker_count > JOBS_MAX_WORKERS) {
+        worker_count = JOBS_MAX_WORKERS;
+    }
+
+    state = (state_t*)calloc(1, sizeof(state_t));
+    state->queue.jobs = darray<job_t> { JOBS_QUEUE_INITIAL_CAPACITY, true };
+    state->background.jobs = darray<job_t> { JOBS_QUEUE_INITIAL_CAPACITY, true };
+    state->worker_count = worker_count;
+    state->running = true;
+
+    for (u32 i = 0; i < worker_count; i++) {
+        workers[i] = std::thread { worker_main, i + 1 };
+    }
+
+    log::info("job system started with %u workers", worker_count);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void shutdown(void)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock { queue_mutex };
+        state->running = false;
+    }
+    queue_signal.notify_all();
+
+    for (u32 i = 0; i < state->worker_count; i++) {
+        workers[i].join();
+    }
+
+    state->queue.jobs.~darray();
+    state->background.jobs.~darray();
+    free(state);
+    state = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void submit(job_fn fn, void* data, counter_t* counter)
+{
+    if (counter != nullptr) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock { queue_mutex };
+        push(&state->queue, job_t { fn, data, counter });
+    }
+
+    queue_signal.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void submit_background(job_fn fn, void* data, counter_t* counter)
+{
+    if (counter != nullptr) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock { queue_mutex };
+        push(&state->background, job_t { fn, data, counter });
+    }
+
+    queue_signal.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool is_done(const counter_t* counter)
+{
+    return counter->pending.load(std::memory_order_acquire) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void wait(counter_t* counter)
+{
+    while (!is_done(counter)) {
+        job_t job;
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock { queue_mutex };
+            found = pop(&state->queue, &job);
+        }
+
+        if (found) {
+            execute(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void parallel_for_job(void* data)
+{
+    parallel_for_t* work = (parallel_for_t*)data;
+
+    while (true) {
+        u32 batch = work->next.fetch_add(1, std::memory_order_relaxed);
+        u32 begin = batch * work->batch_size;
+        if (begin >= work->count) {
+            return;
+        }
+
+        u32 end = begin + work->batch_size;
+        work->fn(begin, end < work->count ? end : work->count, work->data);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void parallel_for(u32 count, u32 batch_size, range_fn fn, void* data)
+{
+    if (count == 0) {
+        return;
+    }
+
+    if (batch_size == 0) {
+        batch_size = 1;
+    }
+
+    u32 batches = (count + batch_size - 1) / batch_size;
+    if (state == nullptr || batches == 1) {
+        fn(0, count, data);
+        return;
+    }
+
+    // NOTE: every helper pulls batches from the shared cursor until it runs dry,
+    // so nothing is allocated per batch and idle workers balance the load
+    parallel_for_t work {};
+    work.fn = fn;
+    work.data = data;
+    work.count = count;
+    work.batch_size = batch_size;
+    work.next.store(0, std::memory_order_relaxed);
+
+    counter_t counter {};
+    u32 helpers = batches - 1 < state->worker_count ? batches - 1 : state->worker_count;
+    for (u32 i = 0; i < helpers; i++) {
+        submit(parallel_for_job, &work, &counter);
+    }
+
+    parallel_for_job(&work);
+    wait(&counter);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 worker_count(void)
+{
+    return state != nullptr ? state->worker_count : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 thread_index(void)
+{
+    return local_thread_index;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 queue_depth(void)
+{
+    std::lock_guard<std::mutex> lock { queue_mutex };
+    return state != nullptr ? state->queue.count + state->background.count : 0;
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "core/defines.hpp"
+
+#include <atomic>
+
+namespace rin::jobs {
+
+constexpr u32 JOBS_MAX_WORKERS = 32;
+
+typedef void (*job_fn)(void* data);
+typedef void (*range_fn)(u32 begin, u32 end, void* data);
+
+// Tracks how many submitted jobs are still running, zeroed memory is a valid idle counter.
+struct counter_t {
+    std::atomic<u32> pending;
+};
+
+bool initialize(u32 worker_count); // 0 picks hardware threads - 1
+void shutdown(void);
+
+void submit(job_fn fn, void* data, counter_t* counter);
+bool is_done(const counter_t* counter);
+void wait(counter_t* counter); // the calling thread runs queued jobs while waiting
+
+// For long jobs like pipeline compiles: only workers run them, wait() never picks one up on the calling thread.
+void submit_background(job_fn fn, void* data, counter_t* counter);
+
+// Splits [0, count) in batches of batch_size and runs them across all workers and the calling thread.
+void parallel_for(u32 count, u32 batch_size, range_fn fn, void* data);
+
+u32 worker_count(void);
+u32 thread_index(void); // 0 for the main thread, 1..worker_count for workers
+u32 queue_depth(void);
+
+}
@@ -0,0 +1,107 @@
+#include "profiler.hpp"
+
+#include "core/logger.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+namespace rin::profiler {
+
+static constexpr f64 AVERAGE_WEIGHT = 0.05;
+
+struct state_t {
+    stat_t stats[PROFILER_MAX_STATS];
+    u32 count;
+};
+
+static state_t* state = nullptr;
+static std::mutex stats_mutex;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void initialize(void)
+{
+    if (state != nullptr) {
+        return;
+    }
+
+    state = (state_t*)calloc(1, sizeof(state_t));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void shutdown(void)
+{
+    std::lock_guard<std::mutex> lock { stats_mutex };
+    free(state);
+    state = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static stat_t* find_or_add(const char* name, const char* unit)
+{
+    for (u32 i = 0; i < state->count; i++) {
+        if (state->stats[i].name == name || strcmp(state->stats[i].name, name) == 0) {
+            return &state->stats[i];
+        }
+    }
+
+    if (state->count == PROFILER_MAX_STATS) {
+        return nullptr;
+    }
+
+    stat_t* stat = &state->stats[state->count];
+    state->count += 1;
+    stat->name = name;
+    stat->unit = unit;
+    return stat;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void record(const char* name, const char* unit, f64 value)
+{
+    std::lock_guard<std::mutex> lock { stats_mutex };
+    if (state == nullptr) {
+        return;
+    }
+
+    stat_t* stat = find_or_add(name, unit);
+    if (stat == nullptr) {
+        log::warn("profiler::record -> stat table full, dropping %s", name);
+        return;
+    }
+
+    stat->last = value;
+    stat->average = stat->samples == 0 ? value : stat->average + (value - stat->average) * AVERAGE_WEIGHT;
+    stat->max = value > stat->max ? value : stat->max;
+    stat->samples += 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 snapshot(stat_t* out, u32 max_count)
+{
+    std::lock_guard<std::mutex> lock { stats_mutex };
+    if (state == nullptr) {
+        return 0;
+    }
+
+    u32 count = state->count < max_count ? state->count : max_count;
+    memcpy(out, state->stats, sizeof(stat_t) * count);
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void reset(void)
+{
+    std::lock_guard<std::mutex> lock { stats_mutex };
+    if (state == nullptr) {
+        return;
+    }
+
+    for (u32 i = 0; i < state->count; i++) {
+        state->stats[i].average = 0;
+        state->stats[i].max = 0;
+        state->stats[i].samples = 0;
+    }
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "core/defines.hpp"
+
+namespace rin::profiler {
+
+constexpr u32 PROFILER_MAX_STATS = 64;
+
+struct stat_t {
+    const char* name; // must be a string literal, stats are matched by pointer first
+    const char* unit;
+    f64 last;
+    f64 average; // exponential moving average
+    f64 max;
+    u64 samples;
+};
+
+void initialize(void);
+void shutdown(void);
+
+// Thread safe, creates the stat on its first sample.
+void record(const char* name, const char* unit, f64 value);
+
+// Copies up to max_count stats into out and returns how many were written.
+u32 snapshot(stat_t* out, u32 max_count);
+void reset(void);
+
+}
@@ -0,0 +1,65 @@
+#include "sort.hpp"
+
+#include <cstring>
+
+namespace rin::sort {
+
+constexpr u32 RADIX_BITS = 8;
+constexpr u32 RADIX_BUCKETS = 1 << RADIX_BITS;
+constexpr u32 RADIX_PASSES = 32 / RADIX_BITS;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void radix_sort(u32* keys, u32* values, u32* keys_scratch, u32* values_scratch, u32 count)
+{
+    // NOTE: every histogram is built in a single read of the keys, the passes only scatter
+    u32 histograms[RADIX_PASSES][RADIX_BUCKETS];
+    memset(histograms, 0, sizeof(histograms));
+
+    for (u32 i = 0; i < count; i++) {
+        u32 key = keys[i];
+        for (u32 pass = 0; pass < RADIX_PASSES; pass++) {
+            histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    u32* src_keys = keys;
+    u32* src_values = values;
+    u32* dst_keys = keys_scratch;
+    u32* dst_values = values_scratch;
+
+    for (u32 pass = 0; pass < RADIX_PASSES; pass++) {
+        u32* histogram = histograms[pass];
+        u32 shift = pass * RADIX_BITS;
+
+        if (count == 0 || histogram[(src_keys[0] >> shift) & (RADIX_BUCKETS - 1)] == count) {
+            continue;
+        }
+
+        u32 offset = 0;
+        for (u32 bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+            u32 bucket_count = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucket_count;
+        }
+
+        for (u32 i = 0; i < count; i++) {
+            u32 slot = histogram[(src_keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+            dst_keys[slot] = src_keys[i];
+            dst_values[slot] = src_values[i];
+        }
+
+        u32* tmp_keys = src_keys;
+        u32* tmp_values = src_values;
+        src_keys = dst_keys;
+        src_values = dst_values;
+        dst_keys = tmp_keys;
+        dst_values = tmp_values;
+    }
+
+    if (src_keys != keys) {
+        memcpy(keys, src_keys, sizeof(u32) * count);
+        memcpy(values, src_values, sizeof(u32) * count);
+    }
+}
+
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "core/defines.hpp"
+
+namespace rin::sort {
+
+// LSD radix sort of (key, value) pairs by key, 8 bits per pass, stable.
+// Passes where every key shares the same byte are skipped, so narrow keys only pay for the bytes they use.
+// The scratch arrays must hold count elements, the sorted result is always written back to keys/values.
+void radix_sort(u32* keys, u32* values, u32* keys_scratch, u32* values_scratch, u32 count);
+
+}
@@ -0,0 +1,929 @@
+#include "bvh.hpp"
+
+#include "core/clock.hpp"
+#include "core/hash.hpp"
+#include "core/jobs.hpp"
+#include "core/profiler.hpp"
+
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <imgui.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define BVH_SSE2 1
+#include <emmintrin.h>
+#else
+#define BVH_SSE2 0
+#endif
+
+namespace rin::renderer::bvh {
+
+constexpr u32 BVH_STACK_SIZE = BVH_MAX_DEPTH * (BVH_WIDTH - 1) + 1; // traversal never holds more pending nodes
+constexpr f32 BVH_TRAVERSAL_COST = 1.0f; // relative to testing a single primitive
+constexpr u32 BVH_REFIT_BATCH_SIZE = 4096;
+constexpr u32 BENCHMARK_QUERIES = 100000;
+constexpr f32 BENCHMARK_WORLD_SIZE = 1000.0f;
+
+struct build_primitive_t {
+    aabb_t bounds;
+    glm::vec3 centroid;
+    u32 index;
+};
+
+struct build_node_t {
+    aabb_t bounds;
+    u32 left; // right is left + 1
+    u32 first; // into build_t::primitives
+    u32 count; // 0 for inner nodes
+};
+
+struct build_t {
+    const aabb_t* bounds;
+    build_primitive_t* primitives; // partitioned in place, every node owns a contiguous range
+    build_node_t* nodes; // sized for the worst case, 2 * count - 1
+    std::atomic<u32> node_count;
+};
+
+struct build_task_t {
+    build_t* build;
+    u32 node;
+    u32 begin;
+    u32 end;
+    aabb_t bounds;
+    aabb_t centroid_bounds;
+    u32 depth;
+};
+
+struct bin_t {
+    aabb_t bounds;
+    u32 count;
+};
+
+struct refit_t {
+    bvh_t* bvh;
+    const aabb_t* bounds;
+};
+
+struct ray_entry_t {
+    u32 node;
+    f32 t; // entry distance, skipped once a closer hit is known
+};
+
+struct benchmark_t {
+    bvh_t bvh;
+    darray<aabb_t> bounds;
+    darray<u32> results;
+    i32 count;
+    u32 built_count;
+    f64 build_ms;
+    f64 refit_ms;
+    f64 rays_per_ms;
+    f64 frustum_ms;
+    f64 boxes_per_ms;
+    u32 ray_hits;
+    u32 frustum_hits;
+    u32 box_hits;
+};
+
+static benchmark_t* benchmark = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static aabb_t empty_aabb(void)
+{
+    // NOTE: FLT_MAX rather than infinity so the centers and extents of empty slots stay finite
+    return aabb_t {
+        .min = glm::vec3(FLT_MAX),
+        .max = glm::vec3(-FLT_MAX),
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void grow(aabb_t* box, const aabb_t& other)
+{
+    box->min = glm::min(box->min, other.min);
+    box->max = glm::max(box->max, other.max);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static f32 half_area(const aabb_t& box)
+{
+    glm::vec3 d = box.max - box.min;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void set_slot(node_t* node, u32 slot, const aabb_t& box)
+{
+    node->min_x[slot] = box.min.x;
+    node->min_y[slot] = box.min.y;
+    node->min_z[slot] = box.min.z;
+    node->max_x[slot] = box.max.x;
+    node->max_y[slot] = box.max.y;
+    node->max_z[slot] = box.max.z;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static aabb_t node_bounds(const node_t& node)
+{
+    aabb_t box = empty_aabb();
+    for (u32 i = 0; i < BVH_WIDTH; i++) {
+        grow(&box,
+            aabb_t {
+                .min = glm::vec3(node.min_x[i], node.min_y[i], node.min_z[i]),
+                .max = glm::vec3(node.max_x[i], node.max_y[i], node.max_z[i]),
+            });
+    }
+    return box;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bvh_t create(void)
+{
+    return bvh_t {
+        .nodes = darray<node_t>(false),
+        .primitives = darray<u32>(false),
+        .bounds = darray<aabb_t>(false),
+        .depth = 0,
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void fill_primitives(u32 begin, u32 end, void* data)
+{
+    build_t* build = (build_t*)data;
+    for (u32 i = begin; i < end; i++) {
+        build->primitives[i] = build_primitive_t {
+            .bounds = build->bounds[i],
+            .centroid = (build->bounds[i].min + build->bounds[i].max) * 0.5f,
+            .index = i,
+        };
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 bin_index(f32 centroid, f32 min, f32 scale)
+{
+    u32 bin = (u32)((centroid - min) * scale);
+    return bin < BVH_BINS ? bin : BVH_BINS - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void range_bounds(const build_t& build, u32 begin, u32 end, aabb_t* bounds, aabb_t* centroid_bounds)
+{
+    *bounds = empty_aabb();
+    *centroid_bounds = empty_aabb();
+    for (u32 i = begin; i < end; i++) {
+        const build_primitive_t& primitive = build.primitives[i];
+        grow(bounds, primitive.bounds);
+        centroid_bounds->min = glm::min(centroid_bounds->min, primitive.centroid);
+        centroid_bounds->max = glm::max(centroid_bounds->max, primitive.centroid);
+    }
+}
+
+static void build_range(build_t* build, u32 index, u32 begin, u32 end, const aabb_t& bounds,
+    const aabb_t& centroid_bounds, u32 depth);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void build_job(void* data)
+{
+    build_task_t* task = (build_task_t*)data;
+    build_range(task->build, task->node, task->begin, task->end, task->bounds, task->centroid_bounds, task->depth);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// NOTE: bounds come from the parent, its bins give the ones of both children and the partition pass their centroid
+// bounds, so every level reads its primitives twice: once to bin them and once to partition them
+static void build_range(build_t* build, u32 index, u32 begin, u32 end, const aabb_t& bounds,
+    const aabb_t& centroid_bounds, u32 depth)
+{
+    u32 count = end - begin;
+    build_node_t* node = &build->nodes[index];
+    *node = build_node_t {
+        .bounds = bounds,
+        .left = BVH_INVALID,
+        .first = begin,
+        .count = count,
+    };
+
+    if (count <= 1 || depth >= BVH_MAX_DEPTH) {
+        return;
+    }
+
+    // NOTE: centroids are binned on all three axes at once, the SAH is then evaluated at every bin boundary from
+    // prefix and suffix sweeps over the bins
+    glm::vec3 extent = centroid_bounds.max - centroid_bounds.min;
+    f32 scale[3];
+    bin_t bins[3][BVH_BINS];
+    for (u32 axis = 0; axis < 3; axis++) {
+        scale[axis] = extent[axis] > 0.0f ? (f32)BVH_BINS / extent[axis] : 0.0f;
+        for (u32 b = 0; b < BVH_BINS; b++) {
+            bins[axis][b] = bin_t { empty_aabb(), 0 };
+        }
+    }
+
+    for (u32 i = begin; i < end; i++) {
+        const build_primitive_t& primitive = build->primitives[i];
+        for (u32 axis = 0; axis < 3; axis++) {
+            bin_t* bin = &bins[axis][bin_index(primitive.centroid[axis], centroid_bounds.min[axis], scale[axis])];
+            grow(&bin->bounds, primitive.bounds);
+            bin->count++;
+        }
+    }
+
+    f32 best_cost = FLT_MAX;
+    u32 best_axis = 0;
+    u32 best_split = 0;
+    for (u32 axis = 0; axis < 3; axis++) {
+        f32 right_area[BVH_BINS];
+        u32 right_count[BVH_BINS];
+        aabb_t right = empty_aabb();
+        u32 right_total = 0;
+        for (u32 b = BVH_BINS - 1; b > 0; b--) {
+            grow(&right, bins[axis][b].bounds);
+            right_total += bins[axis][b].count;
+            right_area[b] = half_area(right);
+            right_count[b] = right_total;
+        }
+
+        aabb_t left = empty_aabb();
+        u32 left_total = 0;
+        for (u32 split = 1; split < BVH_BINS; split++) {
+            grow(&left, bins[axis][split - 1].bounds);
+            left_total += bins[axis][split - 1].count;
+            if (left_total == 0 || right_count[split] == 0) {
+                continue;
+            }
+
+            f32 cost = half_area(left) * left_total + right_area[split] * right_count[split];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = split;
+            }
+        }
+    }
+
+    u32 mid = begin;
+    aabb_t child_bounds[2];
+    aabb_t child_centroid_bounds[2];
+    if (best_cost == FLT_MAX) {
+        // NOTE: every centroid is in the same spot, no plane separates them
+        if (count <= BVH_MAX_LEAF_SIZE) {
+            return;
+        }
+        mid = begin + count / 2;
+        range_bounds(*build, begin, mid, &child_bounds[0], &child_centroid_bounds[0]);
+        range_bounds(*build, mid, end, &child_bounds[1], &child_centroid_bounds[1]);
+    } else {
+        f32 area = half_area(bounds);
+        f32 split_cost = area > 0.0f ? BVH_TRAVERSAL_COST + best_cost / area : FLT_MAX;
+        if (count <= BVH_MAX_LEAF_SIZE && (f32)count <= split_cost) {
+            return;
+        }
+
+        for (u32 c = 0; c < 2; c++) {
+            child_bounds[c] = empty_aabb();
+            child_centroid_bounds[c] = empty_aabb();
+        }
+        for (u32 b = 0; b < BVH_BINS; b++) {
+            grow(&child_bounds[b < best_split ? 0 : 1], bins[best_axis][b].bounds);
+        }
+
+        // NOTE: the records move rather than indices to them, so every pass over a range reads memory linearly
+        for (u32 i = begin; i < end; i++) {
+            build_primitive_t primitive = build->primitives[i];
+            u32 side = bin_index(primitive.centroid[best_axis], centroid_bounds.min[best_axis], scale[best_axis])
+                    < best_split
+                ? 0
+                : 1;
+            aabb_t* centroids = &child_centroid_bounds[side];
+            centroids->min = glm::min(centroids->min, primitive.centroid);
+            centroids->max = glm::max(centroids->max, primitive.centroid);
+            if (side == 0) {
+                build->primitives[i] = build->primitives[mid];
+                build->primitives[mid] = primitive;
+                mid++;
+            }
+        }
+    }
+
+    u32 left = build->node_count.fetch_add(2, std::memory_order_relaxed);
+    node->left = left;
+    node->count = 0;
+
+    if (count > BVH_PARALLEL_THRESHOLD && jobs::worker_count() > 0) {
+        // NOTE: the task lives on this stack frame, wait() runs other queued jobs until the right half is done
+        build_task_t task {
+            .build = build,
+            .node = left + 1,
+            .begin = mid,
+            .end = end,
+            .bounds = child_bounds[1],
+            .centroid_bounds = child_centroid_bounds[1],
+            .depth = depth + 1,
+        };
+        jobs::counter_t counter {};
+        jobs::submit(build_job, &task, &counter);
+        build_range(build, left, begin, mid, child_bounds[0], child_centroid_bounds[0], depth + 1);
+        jobs::wait(&counter);
+    } else {
+        build_range(build, left, begin, mid, child_bounds[0], child_centroid_bounds[0], depth + 1);
+        build_range(build, left + 1, mid, end, child_bounds[1], child_centroid_bounds[1], depth + 1);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 collapse(bvh_t* bvh, const build_t& build, u32 binary, u32 depth)
+{
+    // NOTE: open the inner child with the largest area until the node is full, it is the most likely to be visited
+    u32 slots[BVH_WIDTH] = { binary };
+    u32 slot_count = 1;
+    while (slot_count < BVH_WIDTH) {
+        u32 best = BVH_INVALID;
+        f32 best_area = -1.0f;
+        for (u32 i = 0; i < slot_count; i++) {
+            const build_node_t& child = build.nodes[slots[i]];
+            f32 area = half_area(child.bounds);
+            if (child.count == 0 && area > best_area) {
+                best = i;
+                best_area = area;
+            }
+        }
+
+        if (best == BVH_INVALID) {
+            break;
+        }
+
+        u32 left = build.nodes[slots[best]].left;
+        slots[best] = left;
+        slots[slot_count++] = left + 1;
+    }
+
+    node_t empty {};
+    for (u32 i = 0; i < BVH_WIDTH; i++) {
+        set_slot(&empty, i, empty_aabb());
+        empty.child[i] = BVH_INVALID;
+    }
+
+    u32 index = (u32)bvh->nodes.len;
+    bvh->nodes.push(empty);
+    bvh->depth = depth > bvh->depth ? depth : bvh->depth;
+
+    // NOTE: bvh->nodes may move while children are collapsed, so the node is always indexed again
+    for (u32 i = 0; i < slot_count; i++) {
+        const build_node_t& child = build.nodes[slots[i]];
+        set_slot(&bvh->nodes[index], i, child.bounds);
+
+        if (child.count > 0) {
+            bvh->nodes[index].child[i] = (u32)bvh->primitives.len;
+            bvh->nodes[index].count[i] = child.count;
+            for (u32 k = 0; k < child.count; k++) {
+                const build_primitive_t& primitive = build.primitives[child.first + k];
+                bvh->primitives.push(primitive.index);
+                bvh->bounds.push(primitive.bounds);
+            }
+        } else {
+            u32 node = collapse(bvh, build, slots[i], depth + 1);
+            bvh->nodes[index].child[i] = node;
+        }
+    }
+
+    return index;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void build(bvh_t* bvh, const aabb_t* bounds, u32 count)
+{
+    bvh->nodes.clear();
+    bvh->primitives.clear();
+    bvh->bounds.clear();
+    bvh->depth = 0;
+
+    if (count == 0) {
+        return;
+    }
+
+    darray<build_primitive_t> primitives { count, false };
+    darray<build_node_t> nodes { 2 * (u64)count - 1, false };
+
+    build_t build {
+        .bounds = bounds,
+        .primitives = primitives.data,
+        .nodes = nodes.data,
+        .node_count = 1,
+    };
+    jobs::parallel_for(count, BVH_REFIT_BATCH_SIZE, fill_primitives, &build);
+    aabb_t root_bounds;
+    aabb_t root_centroid_bounds;
+    range_bounds(build, 0, count, &root_bounds, &root_centroid_bounds);
+    build_range(&build, 0, 0, count, root_bounds, root_centroid_bounds, 0);
+
+    bvh->nodes.reserve(build.node_count.load() / 2 + 1);
+    bvh->primitives.reserve(count);
+    bvh->bounds.reserve(count);
+    collapse(bvh, build, 0, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void refit_primitives(u32 begin, u32 end, void* data)
+{
+    refit_t* refit = (refit_t*)data;
+    for (u32 i = begin; i < end; i++) {
+        refit->bvh->bounds[i] = refit->bounds[refit->bvh->primitives[i]];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void refit_leaves(u32 begin, u32 end, void* data)
+{
+    bvh_t* bvh = ((refit_t*)data)->bvh;
+    for (u32 n = begin; n < end; n++) {
+        node_t* node = &bvh->nodes[n];
+        for (u32 i = 0; i < BVH_WIDTH; i++) {
+            if (node->child[i] == BVH_INVALID || node->count[i] == 0) {
+                continue;
+            }
+
+            aabb_t box = empty_aabb();
+            for (u32 k = 0; k < node->count[i]; k++) {
+                grow(&box, bvh->bounds[node->child[i] + k]);
+            }
+            set_slot(node, i, box);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void refit(bvh_t* bvh, const aabb_t* bounds)
+{
+    refit_t refit {
+        .bvh = bvh,
+        .bounds = bounds,
+    };
+    jobs::parallel_for((u32)bvh->primitives.len, BVH_REFIT_BATCH_SIZE, refit_primitives, &refit);
+    jobs::parallel_for((u32)bvh->nodes.len, BVH_REFIT_BATCH_SIZE, refit_leaves, &refit);
+
+    // NOTE: children always come after their parent, walking backwards sees every child refit before its parent
+    for (u32 n = (u32)bvh->nodes.len; n-- > 0;) {
+        node_t* node = &bvh->nodes[n];
+        for (u32 i = 0; i < BVH_WIDTH; i++) {
+            if (node->child[i] != BVH_INVALID && node->count[i] == 0) {
+                set_slot(node, i, node_bounds(bvh->nodes[node->child[i]]));
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 valid_slots(const node_t& node)
+{
+    u32 mask = 0;
+    for (u32 i = 0; i < BVH_WIDTH; i++) {
+        mask |= (node.child[i] != BVH_INVALID ? 1u : 0u) << i;
+    }
+    return mask;
+}
+
+// The slot tests below return one bit per child passing the test, SSE2 checks the four children at once
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 ray_slots(const node_t& node, const glm::vec3& origin, const glm::vec3& inv_direction, f32 t_max, f32* t)
+{
+#if BVH_SSE2
+    __m128 ox = _mm_set1_ps(origin.x);
+    __m128 oy = _mm_set1_ps(origin.y);
+    __m128 oz = _mm_set1_ps(origin.z);
+    __m128 ix = _mm_set1_ps(inv_direction.x);
+    __m128 iy = _mm_set1_ps(inv_direction.y);
+    __m128 iz = _mm_set1_ps(inv_direction.z);
+
+    __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_x), ox), ix);
+    __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_x), ox), ix);
+    __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_y), oy), iy);
+    __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_y), oy), iy);
+    __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_z), oz), iz);
+    __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_z), oz), iz);
+
+    __m128 t_near = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+        _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+    __m128 t_far = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+        _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(t_max)));
+
+    _mm_storeu_ps(t, t_near);
+    return (u32)_mm_movemask_ps(_mm_cmple_ps(t_near, t_far)) & valid_slots(node);
+#else
+    u32 mask = 0;
+    for (u32 i = 0; i < BVH_WIDTH; i++) {
+        f32 x0 = (node.min_x[i] - origin.x) * inv_direction.x;
+        f32 x1 = (node.max_x[i] - origin.x) * inv_direction.x;
+        f32 y0 = (node.min_y[i] - origin.y) * inv_direction.y;
+        f32 y1 = (node.max_y[i] - origin.y) * inv_direction.y;
+        f32 z0 = (node.min_z[i] - origin.z) * inv_direction.z;
+        f32 z1 = (node.max_z[i] - origin.z) * inv_direction.z;
+        f32 t_near = fmaxf(fmaxf(fminf(x0, x1), fminf(y0, y1)), fmaxf(fminf(z0, z1), 0.0f));
+        f32 t_far = fminf(fminf(fmaxf(x0, x1), fmaxf(y0, y1)), fminf(fmaxf(z0, z1), t_max));
+        t[i] = t_near;
+        mask |= (t_near <= t_far ? 1u : 0u) << i;
+    }
+    return mask & valid_slots(node);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 frustum_slots(const node_t& node, const camera::frustum_t& frustum)
+{
+#if BVH_SSE2
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 min_x = _mm_load_ps(node.min_x);
+    __m128 min_y = _mm_load_ps(node.min_y);
+    __m128 min_z = _mm_load_ps(node.min_z);
+    __m128 max_x = _mm_load_ps(node.max_x);
+    __m128 max_y = _mm_load_ps(node.max_y);
+    __m128 max_z = _mm_load_ps(node.max_z);
+    __m128 cx = _mm_mul_ps(_mm_add_ps(min_x, max_x), half);
+    __m128 cy = _mm_mul_ps(_mm_add_ps(min_y, max_y), half);
+    __m128 cz = _mm_mul_ps(_mm_add_ps(min_z, max_z), half);
+    __m128 ex = _mm_mul_ps(_mm_sub_ps(max_x, min_x), half);
+    __m128 ey = _mm_mul_ps(_mm_sub_ps(max_y, min_y), half);
+    __m128 ez = _mm_mul_ps(_mm_sub_ps(max_z, min_z), half);
+
+    __m128 outside = _mm_setzero_ps();
+    for (u32 p = 0; p < 6; p++) {
+        const glm::vec4& plane = frustum.planes[p];
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx),
+                                             _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+                                  _mm_mul_ps(_mm_set1_ps(plane.z), cz)),
+            _mm_set1_ps(plane.w));
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(fabsf(plane.x)), ex),
+                                  _mm_mul_ps(_mm_set1_ps(fabsf(plane.y)), ey)),
+            _mm_mul_ps(_mm_set1_ps(fabsf(plane.z)), ez));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+    }
+    return ~(u32)_mm_movemask_ps(outside) & valid_slots(node);
+#else
+    u32 mask = 0;
+    for (u32 i = 0; i < BVH_WIDTH; i++) {
+        glm::vec3 center = glm::vec3(node.min_x[i] + node.max_x[i], node.min_y[i] + node.max_y[i],
+                               node.min_z[i] + node.max_z[i])
+            * 0.5f;
+        glm::vec3 extent = glm::vec3(node.max_x[i] - node.min_x[i], node.max_y[i] - node.min_y[i],
+                               node.max_z[i] - node.min_z[i])
+            * 0.5f;
+
+        bool outside = false;
+        for (u32 p = 0; p < 6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            f32 d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+            f32 r = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+            outside |= d + r < 0.0f;
+        }
+        mask |= (outside ? 0u : 1u) << i;
+    }
+    return mask & valid_slots(node);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 aabb_slots(const node_t& node, const aabb_t& box)
+{
+#if BVH_SSE2
+    __m128 overlap = _mm_and_ps(_mm_cmple_ps(_mm_set1_ps(box.min.x), _mm_load_ps(node.max_x)),
+        _mm_cmpge_ps(_mm_set1_ps(box.max.x), _mm_load_ps(node.min_x)));
+    overlap = _mm_and_ps(overlap, _mm_cmple_ps(_mm_set1_ps(box.min.y), _mm_load_ps(node.max_y)));
+    overlap = _mm_and_ps(overlap, _mm_cmpge_ps(_mm_set1_ps(box.max.y), _mm_load_ps(node.min_y)));
+    overlap = _mm_and_ps(overlap, _mm_cmple_ps(_mm_set1_ps(box.min.z), _mm_load_ps(node.max_z)));
+    overlap = _mm_and_ps(overlap, _mm_cmpge_ps(_mm_set1_ps(box.max.z), _mm_load_ps(node.min_z)));
+    return (u32)_mm_movemask_ps(overlap) & valid_slots(node);
+#else
+    u32 mask = 0;
+    for (u32 i = 0; i < BVH_WIDTH; i++) {
+        bool overlap = box.min.x <= node.max_x[i] && box.max.x >= node.min_x[i] && box.min.y <= node.max_y[i]
+            && box.max.y >= node.min_y[i] && box.min.z <= node.max_z[i] && box.max.z >= node.min_z[i];
+        mask |= (overlap ? 1u : 0u) << i;
+    }
+    return mask & valid_slots(node);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool ray_box(const aabb_t& box, const glm::vec3& origin, const glm::vec3& inv_direction, f32 t_max, f32* t)
+{
+    glm::vec3 t0 = (box.min - origin) * inv_direction;
+    glm::vec3 t1 = (box.max - origin) * inv_direction;
+    f32 t_near = fmaxf(fmaxf(fminf(t0.x, t1.x), fminf(t0.y, t1.y)), fmaxf(fminf(t0.z, t1.z), 0.0f));
+    f32 t_far = fminf(fminf(fmaxf(t0.x, t1.x), fmaxf(t0.y, t1.y)), fminf(fmaxf(t0.z, t1.z), t_max));
+    *t = t_near;
+    return t_near <= t_far;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool box_visible(const camera::frustum_t& frustum, const aabb_t& box)
+{
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+    for (u32 p = 0; p < 6; p++) {
+        const glm::vec4& plane = frustum.planes[p];
+        f32 d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        f32 r = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+        if (d + r < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool box_overlap(const aabb_t& a, const aabb_t& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool raycast(const bvh_t& bvh, const ray_t& ray, ray_hit_t* hit)
+{
+    if (bvh.nodes.len == 0) {
+        return false;
+    }
+
+    glm::vec3 inv_direction = 1.0f / ray.direction;
+    f32 best_t = ray.t_max;
+    u32 best = BVH_INVALID;
+
+    ray_entry_t stack[BVH_STACK_SIZE];
+    u32 top = 0;
+    stack[top++] = ray_entry_t { 0, 0.0f };
+
+    while (top > 0) {
+        ray_entry_t entry = stack[--top];
+        if (entry.t > best_t) {
+            continue;
+        }
+
+        const node_t& node = bvh.nodes[entry.node];
+        f32 t[BVH_WIDTH];
+        u32 mask = ray_slots(node, ray.origin, inv_direction, best_t, t);
+
+        // NOTE: inner children are pushed far to near, so the closest is popped first and shrinks best_t early
+        ray_entry_t inner[BVH_WIDTH];
+        u32 inner_count = 0;
+        for (u32 i = 0; i < BVH_WIDTH; i++) {
+            if ((mask & (1u << i)) == 0) {
+                continue;
+            }
+
+            if (node.count[i] > 0) {
+                for (u32 k = node.child[i]; k < node.child[i] + node.count[i]; k++) {
+                    f32 t_hit;
+                    if (ray_box(bvh.bounds[k], ray.origin, inv_direction, best_t, &t_hit) && t_hit < best_t) {
+                        best_t = t_hit;
+                        best = k;
+                    }
+                }
+                continue;
+            }
+
+            u32 slot = inner_count++;
+            while (slot > 0 && inner[slot - 1].t < t[i]) {
+                inner[slot] = inner[slot - 1];
+                slot--;
+            }
+            inner[slot] = ray_entry_t { node.child[i], t[i] };
+        }
+
+        for (u32 i = 0; i < inner_count; i++) {
+            stack[top++] = inner[i];
+        }
+    }
+
+    if (best == BVH_INVALID) {
+        return false;
+    }
+
+    *hit = ray_hit_t {
+        .primitive = bvh.primitives[best],
+        .t = best_t,
+    };
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 query_frustum(const bvh_t& bvh, const camera::frustum_t& frustum, u32* out, u32 max_count)
+{
+    if (bvh.nodes.len == 0 || max_count == 0) {
+        return 0;
+    }
+
+    u32 stack[BVH_STACK_SIZE];
+    u32 top = 0;
+    stack[top++] = 0;
+
+    u32 count = 0;
+    while (top > 0) {
+        const node_t& node = bvh.nodes[stack[--top]];
+        u32 mask = frustum_slots(node, frustum);
+        for (u32 i = 0; i < BVH_WIDTH; i++) {
+            if ((mask & (1u << i)) == 0) {
+                continue;
+            }
+
+            if (node.count[i] == 0) {
+                stack[top++] = node.child[i];
+                continue;
+            }
+
+            for (u32 k = node.child[i]; k < node.child[i] + node.count[i]; k++) {
+                if (box_visible(frustum, bvh.bounds[k])) {
+                    out[count++] = bvh.primitives[k];
+                    if (count == max_count) {
+                        return count;
+                    }
+                }
+            }
+        }
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 query_aabb(const bvh_t& bvh, const aabb_t& box, u32* out, u32 max_count)
+{
+    if (bvh.nodes.len == 0 || max_count == 0) {
+        return 0;
+    }
+
+    u32 stack[BVH_STACK_SIZE];
+    u32 top = 0;
+    stack[top++] = 0;
+
+    u32 count = 0;
+    while (top > 0) {
+        const node_t& node = bvh.nodes[stack[--top]];
+        u32 mask = aabb_slots(node, box);
+        for (u32 i = 0; i < BVH_WIDTH; i++) {
+            if ((mask & (1u << i)) == 0) {
+                continue;
+            }
+
+            if (node.count[i] == 0) {
+                stack[top++] = node.child[i];
+                continue;
+            }
+
+            for (u32 k = node.child[i]; k < node.child[i] + node.count[i]; k++) {
+                if (box_overlap(box, bvh.bounds[k])) {
+                    out[count++] = bvh.primitives[k];
+                    if (count == max_count) {
+                        return count;
+                    }
+                }
+            }
+        }
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static f32 unit_float(u32 bits)
+{
+    return (f32)(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static glm::vec3 random_vec3(u32 seed)
+{
+    return glm::vec3(
+        unit_float(hash::mix32(seed)), unit_float(hash::mix32(seed + 1)), unit_float(hash::mix32(seed + 2)));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void fill_benchmark(u32 begin, u32 end, void* data)
+{
+    f32 offset = *(f32*)data;
+    for (u32 i = begin; i < end; i++) {
+        glm::vec3 center = (random_vec3(i * 4) - 0.5f) * BENCHMARK_WORLD_SIZE;
+        glm::vec3 extent = glm::vec3(0.25f + unit_float(hash::mix32(i * 4 + 3)) * 1.0f);
+        center += (random_vec3(i * 4 + 1) - 0.5f) * offset;
+        benchmark->bounds[i] = aabb_t {
+            .min = center - extent,
+            .max = center + extent,
+        };
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void run_benchmark(void)
+{
+    u32 count = (u32)benchmark->count;
+    benchmark->bounds.reserve(count);
+    benchmark->bounds.len = count;
+    benchmark->results.reserve(count);
+
+    f32 offset = 0.0f;
+    jobs::parallel_for(count, BVH_REFIT_BATCH_SIZE, fill_benchmark, &offset);
+
+    f64 start = clock::get_time_s();
+    build(&benchmark->bvh, benchmark->bounds.data, count);
+    benchmark->build_ms = (clock::get_time_s() - start) * ms_per_s;
+    benchmark->built_count = count;
+
+    // NOTE: every primitive moves a few units, like a frame of simulation
+    offset = 4.0f;
+    jobs::parallel_for(count, BVH_REFIT_BATCH_SIZE, fill_benchmark, &offset);
+    start = clock::get_time_s();
+    refit(&benchmark->bvh, benchmark->bounds.data);
+    benchmark->refit_ms = (clock::get_time_s() - start) * ms_per_s;
+
+    benchmark->ray_hits = 0;
+    start = clock::get_time_s();
+    for (u32 i = 0; i < BENCHMARK_QUERIES; i++) {
+        ray_t ray {
+            .origin = (random_vec3(i * 6) - 0.5f) * BENCHMARK_WORLD_SIZE,
+            .direction = glm::normalize(random_vec3(i * 6 + 3) - 0.5f),
+            .t_max = BENCHMARK_WORLD_SIZE,
+        };
+        ray_hit_t hit;
+        benchmark->ray_hits += raycast(benchmark->bvh, ray, &hit) ? 1 : 0;
+    }
+    f64 ray_ms = (clock::get_time_s() - start) * ms_per_s;
+    benchmark->rays_per_ms = ray_ms > 0.0 ? BENCHMARK_QUERIES / ray_ms : 0.0;
+
+    camera::camera_t camera {
+        .position = glm::vec3(0.0f),
+        .yaw = 0.3f,
+        .pitch = 0.1f,
+        .fov_y = 1.2f,
+        .z_near = 0.1f,
+        .z_far = BENCHMARK_WORLD_SIZE,
+    };
+    camera::frustum_t frustum
+        = camera::extract_frustum(camera::projection(camera, 16.0f / 9.0f) * camera::view(camera));
+    start = clock::get_time_s();
+    benchmark->frustum_hits = query_frustum(benchmark->bvh, frustum, benchmark->results.data, count);
+    benchmark->frustum_ms = (clock::get_time_s() - start) * ms_per_s;
+
+    benchmark->box_hits = 0;
+    start = clock::get_time_s();
+    for (u32 i = 0; i < BENCHMARK_QUERIES; i++) {
+        glm::vec3 center = (random_vec3(i * 3 + 7) - 0.5f) * BENCHMARK_WORLD_SIZE;
+        aabb_t box {
+            .min = center - 5.0f,
+            .max = center + 5.0f,
+        };
+        benchmark->box_hits += query_aabb(benchmark->bvh, box, benchmark->results.data, count);
+    }
+    f64 box_ms = (clock::get_time_s() - start) * ms_per_s;
+    benchmark->boxes_per_ms = box_ms > 0.0 ? BENCHMARK_QUERIES / box_ms : 0.0;
+
+    profiler::record("bvh build", "ms", benchmark->build_ms);
+    profiler::record("bvh refit", "ms", benchmark->refit_ms);
+    profiler::record("bvh rays", "rays/ms", benchmark->rays_per_ms);
+    profiler::record("bvh frustum", "ms", benchmark->frustum_ms);
+    profiler::record("bvh boxes", "queries/ms", benchmark->boxes_per_ms);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    if (benchmark == nullptr) {
+        benchmark = (benchmark_t*)calloc(1, sizeof(benchmark_t));
+        benchmark->bvh = create();
+        benchmark->bounds = darray<aabb_t>(false);
+        benchmark->results = darray<u32>(false);
+        benchmark->count = 1 << 20;
+    }
+
+    ImGui::SliderInt("Primitives", &benchmark->count, 1000, 4000000, "%d", ImGuiSliderFlags_Logarithmic);
+    if (ImGui::Button("Run benchmark##bvh")) {
+        run_benchmark();
+    }
+
+    if (benchmark->built_count == 0) {
+        return;
+    }
+
+    ImGui::Text("%u primitives, %zu nodes, depth %u", benchmark->built_count, benchmark->bvh.nodes.len,
+        benchmark->bvh.depth);
+    ImGui::Text("Build %.3f ms, refit %.3f ms", benchmark->build_ms, benchmark->refit_ms);
+    ImGui::Text("Rays: %.0f / ms, %u of %u hit", benchmark->rays_per_ms, benchmark->ray_hits, BENCHMARK_QUERIES);
+    ImGui::Text("Frustum: %.3f ms, %u visible", benchmark->frustum_ms, benchmark->frustum_hits);
+    ImGui::Text("Boxes: %.0f / ms, %u overlaps", benchmark->boxes_per_ms, benchmark->box_hits);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void shutdown(void)
+{
+    if (benchmark == nullptr) {
+        return;
+    }
+
+    benchmark->bvh.~bvh_t();
+    benchmark->bounds.~darray();
+    benchmark->results.~darray();
+    free(benchmark);
+    benchmark = nullptr;
+}
+
+}
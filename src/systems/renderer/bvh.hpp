@@ -0,0 +1,79 @@
+#pragma once
+
+#include "camera.hpp"
+#include "core/containers/darray.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rin::renderer::bvh {
+
+constexpr u32 BVH_WIDTH = 4; // children per node, one SSE register per bound component
+constexpr u32 BVH_BINS = 16; // SAH candidates per axis
+constexpr u32 BVH_MAX_LEAF_SIZE = 4; // SAH may stop splitting below this
+constexpr u32 BVH_MAX_DEPTH = 64; // of the binary build tree, deeper ranges become a single leaf
+constexpr u32 BVH_PARALLEL_THRESHOLD = 16384; // ranges larger than this build their right half on the job system
+constexpr u32 BVH_INVALID = ~0u;
+
+struct aabb_t {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Four children with their bounds stored component by component, two cache lines per node. A slot is:
+//   - a leaf when count > 0: child is the first entry of its range in bvh_t::primitives
+//   - an inner node when count == 0: child indexes bvh_t::nodes
+//   - empty when child == BVH_INVALID, its bounds are inverted so they never grow the union of a node
+struct node_t {
+    f32 min_x[BVH_WIDTH];
+    f32 min_y[BVH_WIDTH];
+    f32 min_z[BVH_WIDTH];
+    f32 max_x[BVH_WIDTH];
+    f32 max_y[BVH_WIDTH];
+    f32 max_z[BVH_WIDTH];
+    u32 child[BVH_WIDTH];
+    u32 count[BVH_WIDTH];
+};
+
+// Nodes are stored depth first, a node always comes before its children and the leaves of any subtree cover a
+// contiguous range of primitives.
+struct bvh_t {
+    darray<node_t> nodes; // nodes[0] is the root
+    darray<u32> primitives; // primitive index of every leaf entry
+    darray<aabb_t> bounds; // primitive bounds in the same order as primitives
+    u32 depth; // in nodes, 0 when empty
+};
+
+struct ray_t {
+    glm::vec3 origin;
+    glm::vec3 direction; // does not have to be normalized, hit distances are in multiples of it
+    f32 t_max;
+};
+
+struct ray_hit_t {
+    u32 primitive;
+    f32 t; // entry distance into the primitive bounds, 0 when the origin is inside
+};
+
+bvh_t create(void);
+
+// Binned SAH build over the primitive bounds, the top of the tree is split across the job system. The binary tree is
+// then collapsed into BVH_WIDTH wide nodes by opening the largest children first.
+void build(bvh_t* bvh, const aabb_t* bounds, u32 count);
+
+// Recomputes every node bound bottom up after primitives moved, bounds must hold as many entries as the last build.
+// The topology is kept, rebuild once the tree quality drops too far.
+void refit(bvh_t* bvh, const aabb_t* bounds);
+
+// Closest primitive whose bounds the ray enters within [0, t_max].
+bool raycast(const bvh_t& bvh, const ray_t& ray, ray_hit_t* hit);
+
+// Both write the index of every primitive whose bounds pass the test to out, stop once max_count are written and
+// return how many were.
+u32 query_frustum(const bvh_t& bvh, const camera::frustum_t& frustum, u32* out, u32 max_count);
+u32 query_aabb(const bvh_t& bvh, const aabb_t& box, u32* out, u32 max_count);
+
+// Build, refit and query benchmark over random primitives, its buffers are released by shutdown().
+void draw_gui(void);
+void shutdown(void);
+
+}
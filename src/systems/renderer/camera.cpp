@@ -0,0 +1,68 @@
+#include "camera.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace rin::renderer::camera {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+glm::vec3 forward(const camera_t& camera)
+{
+    return glm::vec3(
+        -glm::sin(camera.yaw) * glm::cos(camera.pitch),
+        glm::sin(camera.pitch),
+        -glm::cos(camera.yaw) * glm::cos(camera.pitch));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+glm::mat4 view(const camera_t& camera)
+{
+    return glm::lookAt(camera.position, camera.position + forward(camera), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+glm::mat4 projection(const camera_t& camera, f32 aspect)
+{
+    glm::mat4 proj = glm::perspectiveRH_ZO(camera.fov_y, aspect, camera.z_near, camera.z_far);
+    proj[1][1] *= -1.0f;
+    return proj;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+frustum_t extract_frustum(const glm::mat4& m)
+{
+    // NOTE: Gribb/Hartmann on the rows of the column major matrix, near is row 2 alone since depth is [0, 1]
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    frustum_t frustum {
+        .planes = {
+            row3 + row0,
+            row3 - row0,
+            row3 + row1,
+            row3 - row1,
+            row2,
+            row3 - row2,
+        },
+    };
+
+    for (u32 i = 0; i < 6; i++) {
+        frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+    }
+
+    return frustum;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool sphere_visible(const frustum_t& frustum, const glm::vec3& center, f32 radius)
+{
+    for (u32 i = 0; i < 6; i++) {
+        if (glm::dot(glm::vec3(frustum.planes[i]), center) + frustum.planes[i].w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
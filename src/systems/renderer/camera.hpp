@@ -0,0 +1,33 @@
+#pragma once
+
+#include "core/defines.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rin::renderer::camera {
+
+struct camera_t {
+    glm::vec3 position;
+    f32 yaw; // radians around +Y, 0 looks down -Z
+    f32 pitch; // radians, positive looks up
+    f32 fov_y; // radians
+    f32 z_near;
+    f32 z_far;
+};
+
+// Planes point inside the frustum: xyz is the normal and w the distance, a point p is inside when dot(xyz, p) + w >= 0
+// Order is left, right, bottom, top, near, far
+struct frustum_t {
+    glm::vec4 planes[6];
+};
+
+glm::vec3 forward(const camera_t& camera);
+glm::mat4 view(const camera_t& camera);
+
+// Vulkan clip space: depth in [0, 1] and Y pointing down
+glm::mat4 projection(const camera_t& camera, f32 aspect);
+
+frustum_t extract_frustum(const glm::mat4& view_projection);
+bool sphere_visible(const frustum_t& frustum, const glm::vec3& center, f32 radius);
+
+}
@@ -0,0 +1,554 @@
+#include "capture.hpp"
+
+#include "core/allocations.hpp"
+#include "core/clock.hpp"
+#include "core/containers/darray.hpp"
+#include "core/logger.hpp"
+#include "core/profiler.hpp"
+#include "vk/context.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <imgui.h>
+#include <mutex>
+#include <thread>
+
+namespace rin::renderer::capture {
+
+constexpr u32 PNG_STORED_BLOCK = 65535; // largest uncompressed deflate block
+constexpr u32 ADLER_MODULO = 65521;
+constexpr u32 ADLER_BATCH = 5552; // bytes summed before the modulo can overflow 32 bits
+
+constexpr const char* FORMAT_NAMES[CAPTURE_FORMAT_COUNT] = {
+    "PNG",
+    "Raw RGBA8",
+};
+
+enum slot_status_t : u32 {
+    SLOT_STATUS_FREE,
+    SLOT_STATUS_COPYING, // recorded, the frame has not completed yet
+    SLOT_STATUS_ENCODING, // owned by the encoder thread until it sets it free again
+};
+
+struct slot_t {
+    vulkan::buffer_t buffer;
+    u32 width, height;
+    bool swizzle; // BGRA source, written out as RGBA
+    capture_format_t format;
+    u64 frame; // deletion queue frame of the submit holding the copy
+    u64 index; // capture number, names the file
+    std::atomic<u32> status;
+};
+
+struct state_t {
+    vulkan::context_t* context;
+    bool available; // the swapchain images support transfer reads
+    slot_t slots[CAPTURE_RING_SIZE];
+    u32 next_slot;
+    capture_format_t format;
+    bool continuous;
+    u32 remaining; // frames still requested
+    u64 captured;
+    u64 skipped; // requested while every buffer was busy
+    std::atomic<u64> written;
+    u32 queue[CAPTURE_RING_SIZE]; // slots handed to the encoder, in order
+    u32 queue_head;
+    u32 queue_count;
+    bool stopping;
+};
+
+static state_t* state = nullptr;
+
+// NOTE: a thread of its own rather than a job, jobs::wait() runs queued jobs on the waiting thread and a multi
+// millisecond encode would end up inside the frame of whoever waits on a parallel_for
+static std::thread encoder;
+static std::mutex queue_mutex;
+static std::condition_variable queue_signal;
+static u32 crc_table[256];
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 crc32(u32 crc, const u8* data, u64 size)
+{
+    for (u64 i = 0; i < size; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void put_u32_be(u8* out, u32 value)
+{
+    out[0] = (u8)(value >> 24);
+    out[1] = (u8)(value >> 16);
+    out[2] = (u8)(value >> 8);
+    out[3] = (u8)value;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void write_chunk(std::ofstream& file, const char* type, const u8* data, u32 size)
+{
+    u8 header[8];
+    put_u32_be(header, size);
+    memcpy(header + 4, type, 4);
+
+    u32 crc = crc32(0xffffffffu, header + 4, 4);
+    crc = crc32(crc, data, size) ^ 0xffffffffu;
+
+    u8 footer[4];
+    put_u32_be(footer, crc);
+
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)data, size);
+    file.write((const char*)footer, sizeof(footer));
+}
+
+// NOTE: a zlib stream of stored deflate blocks, no compression, the encoder only has to keep up with the frame rate
+struct zlib_writer_t {
+    u8* out;
+    u64 at;
+    u64 remaining; // payload bytes not yet assigned to a block
+    u32 block_left; // payload bytes left in the current block
+    u32 adler_a, adler_b;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void zlib_put(zlib_writer_t* writer, const u8* data, u64 size)
+{
+    while (size > 0) {
+        if (writer->block_left == 0) {
+            u32 block = writer->remaining < PNG_STORED_BLOCK ? (u32)writer->remaining : PNG_STORED_BLOCK;
+            writer->remaining -= block;
+
+            u8* header = writer->out + writer->at;
+            header[0] = writer->remaining == 0 ? 1 : 0; // BFINAL on the last block, BTYPE 00 stored
+            header[1] = (u8)block;
+            header[2] = (u8)(block >> 8);
+            header[3] = (u8)~block;
+            header[4] = (u8)(~block >> 8);
+            writer->at += 5;
+            writer->block_left = block;
+        }
+
+        u32 count = size < writer->block_left ? (u32)size : writer->block_left;
+        memcpy(writer->out + writer->at, data, count);
+
+        for (u32 begin = 0; begin < count; begin += ADLER_BATCH) {
+            u32 end = begin + ADLER_BATCH < count ? begin + ADLER_BATCH : count;
+            for (u32 i = begin; i < end; i++) {
+                writer->adler_a += data[i];
+                writer->adler_b += writer->adler_a;
+            }
+            writer->adler_a %= ADLER_MODULO;
+            writer->adler_b %= ADLER_MODULO;
+        }
+
+        writer->at += count;
+        writer->block_left -= count;
+        data += count;
+        size -= count;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void convert_row(const slot_t& slot, u32 y, u8* out)
+{
+    const u8* row = (const u8*)slot.buffer.allocation_info.pMappedData + (u64)y * slot.width * 4;
+    for (u32 x = 0; x < slot.width; x++) {
+        const u8* texel = row + x * 4;
+        out[x * 4 + 0] = slot.swizzle ? texel[2] : texel[0];
+        out[x * 4 + 1] = texel[1];
+        out[x * 4 + 2] = slot.swizzle ? texel[0] : texel[2];
+        out[x * 4 + 3] = 255; // presented opaque, whatever the alpha channel holds
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool encode(const slot_t& slot, darray<u8>* stream, darray<u8>* row)
+{
+    u64 row_bytes = (u64)slot.width * 4;
+    row->reserve(row_bytes + 1);
+
+    char path[256];
+    if (slot.format == CAPTURE_FORMAT_PNG) {
+        snprintf(path, sizeof(path), "%s/frame_%06llu.png", CAPTURE_DIRECTORY, (unsigned long long)slot.index);
+    } else {
+        snprintf(path, sizeof(path), "%s/frame_%06llu_%ux%u.rgba", CAPTURE_DIRECTORY, (unsigned long long)slot.index,
+            slot.width, slot.height);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        log::error("capture::encode -> failed to open %s", path);
+        return false;
+    }
+
+    if (slot.format == CAPTURE_FORMAT_RAW) {
+        for (u32 y = 0; y < slot.height; y++) {
+            convert_row(slot, y, row->data);
+            file.write((const char*)row->data, (std::streamsize)row_bytes);
+        }
+        return file.good();
+    }
+
+    // NOTE: every row is prefixed with filter type 0, the stream adds 5 bytes per block, its header and the adler32
+    u64 payload = (row_bytes + 1) * slot.height;
+    u64 blocks = (payload + PNG_STORED_BLOCK - 1) / PNG_STORED_BLOCK;
+    stream->reserve(2 + payload + blocks * 5 + 4);
+
+    zlib_writer_t writer {
+        .out = stream->data,
+        .at = 0,
+        .remaining = payload,
+        .block_left = 0,
+        .adler_a = 1,
+        .adler_b = 0,
+    };
+
+    writer.out[writer.at++] = 0x78; // deflate, 32K window
+    writer.out[writer.at++] = 0x01; // no preset dictionary, fastest level, header multiple of 31
+
+    row->data[0] = 0;
+    for (u32 y = 0; y < slot.height; y++) {
+        convert_row(slot, y, row->data + 1);
+        zlib_put(&writer, row->data, row_bytes + 1);
+    }
+
+    put_u32_be(writer.out + writer.at, (writer.adler_b << 16) | writer.adler_a);
+    writer.at += 4;
+
+    u8 ihdr[13];
+    put_u32_be(ihdr, slot.width);
+    put_u32_be(ihdr + 4, slot.height);
+    ihdr[8] = 8; // bits per channel
+    ihdr[9] = 6; // RGBA
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering
+    ihdr[12] = 0; // not interlaced
+
+    constexpr u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    file.write((const char*)signature, sizeof(signature));
+    write_chunk(file, "IHDR", ihdr, sizeof(ihdr));
+    write_chunk(file, "IDAT", writer.out, (u32)writer.at);
+    write_chunk(file, "IEND", nullptr, 0);
+    return file.good();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void encoder_main(void)
+{
+    darray<u8> stream { false };
+    darray<u8> row { false };
+    bool directory_ready = false;
+
+    for (;;) {
+        u32 index = 0;
+        {
+            std::unique_lock<std::mutex> lock { queue_mutex };
+            queue_signal.wait(lock, [] { return state->queue_count > 0 || state->stopping; });
+            if (state->queue_count == 0) {
+                break; // stopping and drained
+            }
+
+            index = state->queue[state->queue_head];
+            state->queue_head = (state->queue_head + 1) % CAPTURE_RING_SIZE;
+            state->queue_count -= 1;
+        }
+
+        if (!directory_ready) {
+            std::error_code error;
+            std::filesystem::create_directories(CAPTURE_DIRECTORY, error);
+            directory_ready = true;
+        }
+
+        slot_t& slot = state->slots[index];
+        f64 start = clock::get_time_s();
+        if (encode(slot, &stream, &row)) {
+            state->written.fetch_add(1, std::memory_order_relaxed);
+        }
+        profiler::record("capture encode", "ms", (clock::get_time_s() - start) * ms_per_s);
+
+        slot.status.store(SLOT_STATUS_FREE, std::memory_order_release);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(vulkan::context_t* context)
+{
+    if (state != nullptr) {
+        log::error("capture::create -> frame capture has been already created");
+        return false;
+    }
+
+    state = (state_t*)calloc(1, sizeof(state_t));
+    state->context = context;
+    state->format = CAPTURE_FORMAT_PNG;
+
+    for (u32 i = 0; i < CAPTURE_RING_SIZE; i++) {
+        state->slots[i].buffer.bindless_index = BINDLESS_INVALID_INDEX;
+    }
+
+    for (u32 i = 0; i < 256; i++) {
+        u32 crc = i;
+        for (u32 bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+        }
+        crc_table[i] = crc;
+    }
+
+    // NOTE: not fatal, the swapchain only asks for transfer reads when the surface allows them
+    state->available = context->swapchain->usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    if (!state->available) {
+        log::warn("capture::create -> swapchain images cannot be copied from, frame capture disabled");
+        return true;
+    }
+
+    encoder = std::thread { encoder_main };
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(void)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    if (encoder.joinable()) {
+        update(UINT64_MAX);
+        {
+            std::lock_guard<std::mutex> lock { queue_mutex };
+            state->stopping = true;
+        }
+        queue_signal.notify_one();
+        encoder.join();
+    }
+
+    for (u32 i = 0; i < CAPTURE_RING_SIZE; i++) {
+        vulkan::context::destroy_buffer(&state->slots[i].buffer);
+    }
+
+    free(state);
+    state = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void update(u64 completed_frame)
+{
+    for (u32 i = 0; i < CAPTURE_RING_SIZE; i++) {
+        slot_t& slot = state->slots[i];
+        if (slot.status.load(std::memory_order_relaxed) != SLOT_STATUS_COPYING || slot.frame > completed_frame) {
+            continue;
+        }
+
+        // NOTE: readback memory is cached when the device has it, the copy is only visible after an invalidate
+        vmaInvalidateAllocation(state->context->vma, slot.buffer.memory, 0, VK_WHOLE_SIZE);
+        slot.status.store(SLOT_STATUS_ENCODING, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> lock { queue_mutex };
+            state->queue[(state->queue_head + state->queue_count) % CAPTURE_RING_SIZE] = i;
+            state->queue_count += 1;
+        }
+        queue_signal.notify_one();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static slot_t* acquire_slot(void)
+{
+    for (u32 i = 0; i < CAPTURE_RING_SIZE; i++) {
+        u32 index = (state->next_slot + i) % CAPTURE_RING_SIZE;
+        if (state->slots[index].status.load(std::memory_order_acquire) == SLOT_STATUS_FREE) {
+            state->next_slot = (index + 1) % CAPTURE_RING_SIZE;
+            return &state->slots[index];
+        }
+    }
+
+    return nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool record(VkCommandBuffer cmd, VkImage image, VkExtent2D extent, VkFormat format)
+{
+    if (!state->available || (state->remaining == 0 && !state->continuous)) {
+        return false;
+    }
+
+    bool swizzle = false;
+    switch (format) {
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+        swizzle = true;
+        break;
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_R8G8B8A8_UNORM:
+        break;
+    default:
+        log::warn("capture::record -> unsupported swapchain format %d, capture cancelled", (i32)format);
+        state->remaining = 0;
+        state->continuous = false;
+        return false;
+    }
+
+    slot_t* slot = acquire_slot();
+    if (slot == nullptr) {
+        state->skipped += 1; // the request stays, a later frame is captured instead
+        return false;
+    }
+
+    u64 size = (u64)extent.width * extent.height * 4;
+    if (slot->buffer.size < size) {
+        RIN_ALLOW_ALLOC("capture::record readback buffer growth");
+
+        // NOTE: a free slot is no longer read by the encoder, but an earlier frame may still be copying into it
+        vulkan::context::retire_buffer(&slot->buffer);
+
+        vulkan::buffer_create_info_t info {
+            .size = size,
+            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = false,
+            .tag = vulkan::MEMORY_TAG_CAPTURE,
+        };
+
+        if (!vulkan::context::allocate_buffer(info, &slot->buffer)) {
+            log::error("capture::record -> failed to allocate readback buffer");
+            state->remaining = 0;
+            state->continuous = false;
+            return false;
+        }
+    }
+
+    VkImageMemoryBarrier2 to_transfer = vulkan::context::image_layout_transition(
+        image, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_ACCESS_2_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_2_COPY_BIT);
+
+    VkDependencyInfo to_transfer_dep {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 0,
+        .pMemoryBarriers = nullptr,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = nullptr,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &to_transfer,
+    };
+    vkCmdPipelineBarrier2(cmd, &to_transfer_dep);
+
+    VkBufferImageCopy2 region {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2,
+        .pNext = nullptr,
+        .bufferOffset = 0,
+        .bufferRowLength = 0, // tightly packed
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = { extent.width, extent.height, 1 },
+    };
+
+    VkCopyImageToBufferInfo2 copy_info {
+        .sType = VK_STRUCTURE_TYPE_COPY_IMAGE_TO_BUFFER_INFO_2,
+        .pNext = nullptr,
+        .srcImage = image,
+        .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .dstBuffer = slot->buffer.handle,
+        .regionCount = 1,
+        .pRegions = &region,
+    };
+    vkCmdCopyImageToBuffer2(cmd, &copy_info);
+
+    VkBufferMemoryBarrier2 to_host {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+        .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = slot->buffer.handle,
+        .offset = 0,
+        .size = size,
+    };
+
+    VkDependencyInfo to_host_dep {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 0,
+        .pMemoryBarriers = nullptr,
+        .bufferMemoryBarrierCount = 1,
+        .pBufferMemoryBarriers = &to_host,
+        .imageMemoryBarrierCount = 0,
+        .pImageMemoryBarriers = nullptr,
+    };
+    vkCmdPipelineBarrier2(cmd, &to_host_dep);
+
+    slot->width = extent.width;
+    slot->height = extent.height;
+    slot->swizzle = swizzle;
+    slot->format = state->format;
+    slot->frame = state->context->deletion->frame;
+    slot->index = state->captured;
+    slot->status.store(SLOT_STATUS_COPYING, std::memory_order_relaxed);
+
+    state->captured += 1;
+    if (!state->continuous) {
+        state->remaining -= 1;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void request(u32 count)
+{
+    state->remaining += count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    if (!state->available) {
+        ImGui::TextDisabled("The swapchain images cannot be copied from");
+        return;
+    }
+
+    i32 format = (i32)state->format;
+    if (ImGui::Combo("Format", &format, FORMAT_NAMES, CAPTURE_FORMAT_COUNT)) {
+        state->format = (capture_format_t)format;
+    }
+
+    if (ImGui::Button("Capture frame")) {
+        request(1);
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Capture every frame", &state->continuous);
+
+    u32 busy = 0;
+    for (u32 i = 0; i < CAPTURE_RING_SIZE; i++) {
+        busy += state->slots[i].status.load(std::memory_order_relaxed) != SLOT_STATUS_FREE ? 1 : 0;
+    }
+
+    ImGui::Text("Captured %llu, written %llu to %s/", (unsigned long long)state->captured,
+        (unsigned long long)state->written.load(std::memory_order_relaxed), CAPTURE_DIRECTORY);
+    ImGui::Text("Buffers busy: %u / %u, frames skipped with the ring full: %llu", busy, CAPTURE_RING_SIZE,
+        (unsigned long long)state->skipped);
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "vk/types.hpp"
+
+namespace rin::renderer::capture {
+
+constexpr u32 CAPTURE_RING_SIZE = 6; // readback buffers, frames in flight plus the encoder backlog
+constexpr const char* CAPTURE_DIRECTORY = "captures";
+
+enum capture_format_t {
+    CAPTURE_FORMAT_PNG, // uncompressed deflate, lossless and readable by any tool, for golden images
+    CAPTURE_FORMAT_RAW, // tightly packed RGBA8 rows, cheapest to write, for video
+    CAPTURE_FORMAT_COUNT,
+};
+
+// Frame capture: the final image is copied into a ring of host visible readback buffers, which are only read once
+// the deletion queue frame of their submit completed, and written to disk by an encoder thread. When the ring is
+// full the frame is skipped rather than waited for, capturing never stalls the frame.
+bool create(vulkan::context_t* context);
+
+// The device must be idle, copies still pending are encoded before the encoder thread exits.
+void destroy(void);
+
+// Hands the copies of completed frames to the encoder, called after the frame fence wait.
+void update(u64 completed_frame);
+
+// Copies image, in VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, when a capture is requested and a buffer is free.
+// Returns true when it did, the image is then left in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL.
+bool record(VkCommandBuffer cmd, VkImage image, VkExtent2D extent, VkFormat format);
+
+// Captures the next count frames, every frame while continuous is set.
+void request(u32 count);
+
+void draw_gui(void);
+
+}
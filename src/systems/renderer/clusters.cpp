@@ -0,0 +1,765 @@
+#include "clusters.hpp"
+
+#include "camera.hpp"
+#include "core/clock.hpp"
+#include "core/containers/darray.hpp"
+#include "core/hash.hpp"
+#include "core/logger.hpp"
+#include "core/profiler.hpp"
+#include "lights.hpp"
+#include "mesh_optimizer.hpp"
+#include "meshlet.hpp"
+#include "vertex_format.hpp"
+#include "vk/context.hpp"
+#include "vk/host_memory.hpp"
+#include "vk/pipeline.hpp"
+#include "vk/pipeline_table.hpp"
+#include "vk/utils.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <glm/gtc/constants.hpp>
+#include <imgui.h>
+
+namespace rin::renderer::clusters {
+
+constexpr u32 CLUSTERS_DEFAULT_GRID = 4; // instances are laid out on a grid x grid square
+constexpr u32 CLUSTERS_MAX_GRID = 8;
+constexpr f32 CLUSTERS_SPACING = 2.5f;
+
+// NOTE: dense enough that a single mesh splits into hundreds of meshlets
+constexpr u32 KNOT_SEGMENTS = 512;
+constexpr u32 KNOT_SIDES = 32;
+constexpr f32 KNOT_TUBE_RADIUS = 0.1f;
+
+static_assert(CLUSTERS_MAX_GRID * CLUSTERS_MAX_GRID <= CLUSTERS_MAX_INSTANCES);
+static_assert(meshlet::MESHLET_MAX_VERTICES == 64, "cluster.glsl and the mesh shader output limits assume 64");
+
+struct frame_resources_t {
+    vulkan::buffer_t frame; // host visible cluster_frame_t
+    vulkan::buffer_t draw; // cluster_draw_t, reset by cull()
+    vulkan::buffer_t visible; // (instance, meshlet) per survivor of the compute path
+    vulkan::buffer_t indices; // compacted by the compute path
+    vulkan::buffer_t readback; // counters copied back for the stats
+    VkDeviceAddress lights; // light grid of the same slot
+};
+
+struct state_t {
+    vulkan::context_t* context;
+    darray<frame_resources_t> frames;
+    vulkan::buffer_t instances;
+    vulkan::buffer_t meshlets;
+    vulkan::buffer_t meshlet_vertices;
+    vulkan::buffer_t meshlet_triangles;
+    vulkan::buffer_t vertices;
+    vulkan::buffer_t visibility; // shared by every frame, each late phase leaves it for the next early one
+    bool reset_visibility; // instances changed, cleared by the next early cull()
+    u32 meshlet_count;
+    u32 triangle_count;
+    u32 instance_count;
+    i32 grid;
+    i32 requested_grid; // applied at the start of the next cull()
+    VkShaderModule cull_module;
+    VkShaderModule vert_module;
+    VkShaderModule frag_module;
+    VkShaderModule task_module; // only loaded when the device has mesh shaders
+    VkShaderModule mesh_module;
+    VkPipelineLayout layout; // owned by the pipeline table
+    u64 cull_key;
+    u64 depth_key;
+    u64 draw_key;
+    u64 mesh_depth_key;
+    u64 mesh_key;
+    VkPipelineStageFlags2 cull_stages; // every stage that may have written the counters
+    cluster_path_t path;
+    u32 flags;
+    bool ready; // pipelines of the current path resolved for the current frame
+    VkPipeline cull_pipeline;
+    VkPipeline depth_pipeline;
+    VkPipeline draw_pipeline;
+    camera::camera_t camera;
+    bool orbit;
+    u32 visible[2]; // per occlusion::cull_phase_t, of the last frame read back
+    u32 occluded;
+    f64 record_time_s;
+};
+
+static state_t* state = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static glm::vec3 knot_point(f32 t)
+{
+    // NOTE: (2, 3) torus knot lying on the XZ plane
+    f32 r = 2.0f + glm::cos(3.0f * t);
+    return glm::vec3(r * glm::cos(2.0f * t), -glm::sin(3.0f * t), r * glm::sin(2.0f * t)) * 0.25f;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void add_torus_knot(darray<vertex_format::vertex_attributes_t>& vertices, darray<u32>& indices)
+{
+    const f32 tau = 2.0f * glm::pi<f32>();
+
+    for (u32 j = 0; j < KNOT_SEGMENTS; j++) {
+        f32 t = tau * (f32)j / (f32)KNOT_SEGMENTS;
+        glm::vec3 center = knot_point(t);
+        glm::vec3 next = knot_point(t + 0.01f);
+
+        glm::vec3 tangent = glm::normalize(next - center);
+        glm::vec3 bitangent = glm::normalize(glm::cross(tangent, next + center));
+        glm::vec3 normal = glm::cross(bitangent, tangent);
+
+        for (u32 i = 0; i < KNOT_SIDES; i++) {
+            f32 angle = tau * (f32)i / (f32)KNOT_SIDES;
+            glm::vec3 offset = normal * glm::cos(angle) + bitangent * glm::sin(angle);
+
+            vertices.push(vertex_format::vertex_attributes_t {
+                .position = center + offset * KNOT_TUBE_RADIUS,
+                .normal = offset,
+                .tangent = glm::vec4(tangent, 1.0f),
+                .uv = glm::vec2((f32)j / (f32)KNOT_SEGMENTS, (f32)i / (f32)KNOT_SIDES),
+            });
+        }
+    }
+
+    for (u32 j = 0; j < KNOT_SEGMENTS; j++) {
+        for (u32 i = 0; i < KNOT_SIDES; i++) {
+            u32 j1 = (j + 1) % KNOT_SEGMENTS;
+            u32 i1 = (i + 1) % KNOT_SIDES;
+            const u32 quad[2][3] = {
+                { j * KNOT_SIDES + i, j1 * KNOT_SIDES + i, j1 * KNOT_SIDES + i1 },
+                { j * KNOT_SIDES + i, j1 * KNOT_SIDES + i1, j * KNOT_SIDES + i1 },
+            };
+
+            // NOTE: outward facing counter clockwise winding, whichever way the frame turns
+            for (u32 k = 0; k < 2; k++) {
+                u32 a = quad[k][0], b = quad[k][1], c = quad[k][2];
+                glm::vec3 face = glm::cross(vertices[b].position - vertices[a].position, vertices[c].position - vertices[a].position);
+                if (glm::dot(face, vertices[a].normal) < 0.0f) {
+                    u32 tmp = b;
+                    b = c;
+                    c = tmp;
+                }
+
+                indices.push(a);
+                indices.push(b);
+                indices.push(c);
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool upload_geometry(void)
+{
+    darray<vertex_format::vertex_attributes_t> vertices { (u64)KNOT_SEGMENTS * KNOT_SIDES, false };
+    darray<u32> indices { (u64)KNOT_SEGMENTS * KNOT_SIDES * 6, false };
+    add_torus_knot(vertices, indices);
+
+    u32 vertex_count = (u32)vertices.len;
+    u32 index_count = (u32)indices.len;
+    mesh_optimizer::optimize_vertex_cache(indices.data, index_count, vertex_count);
+    mesh_optimizer::optimize_vertex_fetch(vertices.data, indices.data, index_count, vertex_count, sizeof(vertex_format::vertex_attributes_t));
+
+    meshlet::meshlet_data_t data {
+        .meshlets = darray<meshlet::meshlet_t> { true },
+        .vertices = darray<u32> { true },
+        .triangles = darray<u8> { true },
+    };
+    meshlet::build(indices.data, index_count, vertices.data, vertex_count, &data);
+
+    state->meshlet_count = (u32)data.meshlets.len;
+    state->triangle_count = index_count / 3;
+
+    u32 culling_cones = 0;
+    for (size_t i = 0; i < data.meshlets.len; i++) {
+        culling_cones += data.meshlets[i].cone.w < 1.0f ? 1 : 0;
+    }
+    log::info("clusters: %u triangles in %u meshlets, %.1f triangles and %.1f vertices on average, %u with a usable cone",
+        state->triangle_count, state->meshlet_count, (f32)state->triangle_count / (f32)state->meshlet_count,
+        (f32)data.vertices.len / (f32)state->meshlet_count, culling_cones);
+
+    struct upload_t {
+        vulkan::buffer_t* buffer;
+        const void* data;
+        u64 size;
+    };
+
+    const upload_t uploads[] = {
+        { &state->meshlets, data.meshlets.data, sizeof(meshlet::meshlet_t) * data.meshlets.len },
+        { &state->meshlet_vertices, data.vertices.data, sizeof(u32) * data.vertices.len },
+        { &state->meshlet_triangles, data.triangles.data, data.triangles.len },
+        { &state->vertices, vertices.data, sizeof(vertex_format::vertex_attributes_t) * vertices.len },
+    };
+
+    for (const upload_t& upload : uploads) {
+        vulkan::buffer_create_info_t info {
+            .size = upload.size,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = true,
+            .tag = vulkan::MEMORY_TAG_CLUSTERS,
+        };
+
+        if (!vulkan::context::allocate_buffer(info, upload.buffer)
+            || !vulkan::context::upload_buffer(*upload.buffer, 0, upload.data, upload.size)) {
+            log::error("clusters::upload_geometry -> failed to upload meshlets");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool upload_instances(u32 grid)
+{
+    cluster_instance_t instances[CLUSTERS_MAX_INSTANCES];
+    f32 half = (f32)(grid - 1) * CLUSTERS_SPACING * 0.5f;
+
+    for (u32 z = 0; z < grid; z++) {
+        for (u32 x = 0; x < grid; x++) {
+            u32 i = z * grid + x;
+            instances[i] = cluster_instance_t {
+                .position_scale = glm::vec4((f32)x * CLUSTERS_SPACING - half, 0.0f, (f32)z * CLUSTERS_SPACING - half, 1.0f),
+                .color = hash::mix32(i) | 0xFF000000u,
+                .pad = { 0, 0, 0 },
+            };
+        }
+    }
+
+    if (!vulkan::context::upload_buffer(state->instances, 0, instances, sizeof(cluster_instance_t) * grid * grid)) {
+        log::error("clusters::upload_instances -> failed to upload %u instances", grid * grid);
+        return false;
+    }
+
+    state->grid = (i32)grid;
+    state->instance_count = grid * grid;
+    state->reset_visibility = true;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(vulkan::context_t* context, u32 frame_count, VkFormat color_format, VkFormat depth_format)
+{
+    if (state != nullptr) {
+        log::error("clusters::create -> clusters have been already created");
+        return false;
+    }
+
+    state = (state_t*)calloc(1, sizeof(state_t));
+    state->context = context;
+    state->frames = darray<frame_resources_t> { frame_count, true };
+    state->frames.len = frame_count;
+    state->requested_grid = CLUSTERS_DEFAULT_GRID;
+    state->flags = CLUSTER_FLAG_CONE_CULLING;
+    state->orbit = true;
+    state->camera = camera::camera_t {
+        .position = glm::vec3(0.0f),
+        .yaw = 0.0f,
+        .pitch = 0.0f,
+        .fov_y = glm::radians(60.0f),
+        .z_near = 0.05f,
+        .z_far = 100.0f,
+    };
+
+    bool mesh_shader = context->device->mesh_shader;
+    state->path = mesh_shader ? CLUSTER_PATH_MESH_SHADER : CLUSTER_PATH_COMPUTE;
+    state->cull_stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | (mesh_shader ? VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT : 0);
+
+    for (u32 i = 0; i < frame_count; i++) {
+        frame_resources_t& frame = state->frames[i];
+        frame.lights = lights::frame_address(i);
+
+        vulkan::buffer_create_info_t frame_info {
+            .size = sizeof(cluster_frame_t),
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = false,
+            .tag = vulkan::MEMORY_TAG_CLUSTERS,
+        };
+
+        vulkan::buffer_create_info_t draw_info {
+            .size = sizeof(cluster_draw_t),
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = true,
+            .tag = vulkan::MEMORY_TAG_CLUSTERS,
+        };
+
+        vulkan::buffer_create_info_t visible_info {
+            .size = sizeof(u32) * 2 * CLUSTERS_MAX_VISIBLE,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = true,
+            .tag = vulkan::MEMORY_TAG_CLUSTERS,
+        };
+
+        vulkan::buffer_create_info_t indices_info {
+            .size = sizeof(u32) * 3 * meshlet::MESHLET_MAX_TRIANGLES * CLUSTERS_MAX_VISIBLE,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = true,
+            .tag = vulkan::MEMORY_TAG_CLUSTERS,
+        };
+
+        vulkan::buffer_create_info_t readback_info {
+            .size = sizeof(u32) * 3,
+            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = false,
+            .tag = vulkan::MEMORY_TAG_CLUSTERS,
+        };
+
+        if (!vulkan::context::allocate_buffer(frame_info, &frame.frame)
+            || !vulkan::context::allocate_buffer(draw_info, &frame.draw)
+            || !vulkan::context::allocate_buffer(visible_info, &frame.visible)
+            || !vulkan::context::allocate_buffer(indices_info, &frame.indices)
+            || !vulkan::context::allocate_buffer(readback_info, &frame.readback)) {
+            log::error("clusters::create -> failed to allocate frame buffers");
+            destroy();
+            return false;
+        }
+        memset(frame.readback.allocation_info.pMappedData, 0, sizeof(u32) * 3);
+        vmaFlushAllocation(context->vma, frame.readback.memory, 0, VK_WHOLE_SIZE);
+    }
+
+    vulkan::buffer_create_info_t instance_info {
+        .size = sizeof(cluster_instance_t) * CLUSTERS_MAX_INSTANCES,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = true,
+        .tag = vulkan::MEMORY_TAG_CLUSTERS,
+    };
+
+    if (!vulkan::context::allocate_buffer(instance_info, &state->instances)) {
+        log::error("clusters::create -> failed to allocate instance buffer");
+        destroy();
+        return false;
+    }
+
+    if (!upload_geometry()) {
+        log::error("clusters::create -> failed to upload cluster data");
+        destroy();
+        return false;
+    }
+
+    vulkan::buffer_create_info_t visibility_info {
+        .size = sizeof(u32) * CLUSTERS_MAX_INSTANCES * state->meshlet_count,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = true,
+        .tag = vulkan::MEMORY_TAG_CLUSTERS,
+    };
+
+    if (!vulkan::context::allocate_buffer(visibility_info, &state->visibility) || !upload_instances(CLUSTERS_DEFAULT_GRID)) {
+        log::error("clusters::create -> failed to set up cluster instances");
+        destroy();
+        return false;
+    }
+
+    VkDevice device = context->device->logical_device;
+    vulkan::reflection::shader_reflection_t reflections[5] = {};
+    const vulkan::reflection::shader_reflection_t* stages[5] = {};
+    u32 stage_count = 3;
+
+    if (!vulkan::utils::load_shader_module(device, "resources/shaders/cluster_cull.comp.spv", &state->cull_module, &reflections[0])
+        || !vulkan::utils::load_shader_module(device, "resources/shaders/cluster.vert.spv", &state->vert_module, &reflections[1])
+        || !vulkan::utils::load_shader_module(device, "resources/shaders/scene.frag.spv", &state->frag_module, &reflections[2])) {
+        log::error("clusters::create -> failed to load shader modules");
+        destroy();
+        return false;
+    }
+
+    // NOTE: modules declaring the mesh shading capability are invalid on devices without the extension
+    if (mesh_shader) {
+        if (!vulkan::utils::load_shader_module(device, "resources/shaders/cluster.task.spv", &state->task_module, &reflections[3])
+            || !vulkan::utils::load_shader_module(device, "resources/shaders/cluster.mesh.spv", &state->mesh_module, &reflections[4])) {
+            log::error("clusters::create -> failed to load mesh shader modules");
+            destroy();
+            return false;
+        }
+        stage_count = 5;
+    }
+
+    // NOTE: one layout for both paths, the push constants are shared
+    for (u32 i = 0; i < stage_count; i++) {
+        stages[i] = &reflections[i];
+    }
+
+    if (!vulkan::pipeline_table::get_layout(stages, stage_count, &state->layout)) {
+        log::error("clusters::create -> failed to create pipeline layout");
+        destroy();
+        return false;
+    }
+
+    vulkan::pipeline_builder_t cull_builder {};
+    cull_builder
+        .set_compute_shader(state->cull_module)
+        .set_layout(state->layout);
+    state->cull_key = vulkan::pipeline_table::request(cull_builder);
+
+    vulkan::pipeline_builder_t draw_builder {};
+    draw_builder
+        .set_multisampling_none()
+        .disable_blending()
+        .enable_depthtest(false, VK_COMPARE_OP_LESS_OR_EQUAL)
+        .set_color_attachment_format(color_format)
+        .set_depth_format(depth_format)
+        .set_cull_mode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE)
+        .set_polygon_mode(VK_POLYGON_MODE_FILL)
+        .set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+        .set_shaders(state->vert_module, state->frag_module)
+        .set_layout(state->layout);
+    state->draw_key = vulkan::pipeline_table::request(draw_builder);
+
+    vulkan::pipeline_builder_t depth_builder = draw_builder;
+    depth_builder
+        .enable_depthtest(true, VK_COMPARE_OP_LESS)
+        .set_color_attachment_format(VK_FORMAT_UNDEFINED)
+        .set_shaders(state->vert_module, VK_NULL_HANDLE);
+    state->depth_key = vulkan::pipeline_table::request(depth_builder);
+
+    if (mesh_shader) {
+        draw_builder.set_mesh_shaders(state->task_module, state->mesh_module, state->frag_module);
+        state->mesh_key = vulkan::pipeline_table::request(draw_builder);
+
+        depth_builder.set_mesh_shaders(state->task_module, state->mesh_module, VK_NULL_HANDLE);
+        state->mesh_depth_key = vulkan::pipeline_table::request(depth_builder);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(void)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    VkDevice device = state->context->device->logical_device;
+    vkDeviceWaitIdle(device);
+
+    VkShaderModule modules[] = { state->cull_module, state->vert_module, state->frag_module, state->task_module, state->mesh_module };
+    for (VkShaderModule module : modules) {
+        if (module != VK_NULL_HANDLE) {
+            vkDestroyShaderModule(device, module, vulkan::host_memory::callbacks());
+        }
+    }
+
+    for (size_t i = 0; i < state->frames.len; i++) {
+        vulkan::context::destroy_buffer(&state->frames[i].frame);
+        vulkan::context::destroy_buffer(&state->frames[i].draw);
+        vulkan::context::destroy_buffer(&state->frames[i].visible);
+        vulkan::context::destroy_buffer(&state->frames[i].indices);
+        vulkan::context::destroy_buffer(&state->frames[i].readback);
+    }
+    state->frames.~darray();
+
+    vulkan::context::destroy_buffer(&state->instances);
+    vulkan::context::destroy_buffer(&state->meshlets);
+    vulkan::context::destroy_buffer(&state->meshlet_vertices);
+    vulkan::context::destroy_buffer(&state->meshlet_triangles);
+    vulkan::context::destroy_buffer(&state->vertices);
+    vulkan::context::destroy_buffer(&state->visibility);
+
+    free(state);
+    state = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static cluster_push_constants_t push_constants(const frame_resources_t& frame, u32 phase)
+{
+    return cluster_push_constants_t {
+        .lights = frame.lights,
+        .frame = frame.frame.address,
+        .instances = state->instances.address,
+        .meshlets = state->meshlets.address,
+        .meshlet_vertices = state->meshlet_vertices.address,
+        .meshlet_triangles = state->meshlet_triangles.address,
+        .vertices = state->vertices.address,
+        .visible = frame.visible.address,
+        .indices = frame.indices.address,
+        .draw = frame.draw.address,
+        .visibility = state->visibility.address,
+        .phase = phase,
+        .pad = 0,
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void memory_barrier(VkCommandBuffer cmd, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access,
+    VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access)
+{
+    VkMemoryBarrier2 barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = src_stage,
+        .srcAccessMask = src_access,
+        .dstStageMask = dst_stage,
+        .dstAccessMask = dst_access,
+    };
+
+    VkDependencyInfo dep {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = nullptr,
+        .imageMemoryBarrierCount = 0,
+        .pImageMemoryBarriers = nullptr,
+    };
+    vkCmdPipelineBarrier2(cmd, &dep);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void cull_late(VkCommandBuffer cmd, const frame_resources_t& frame)
+{
+    vulkan::context::begin_label(cmd, "cluster cull late", { 0, 1, 1, 1 });
+
+    if (state->path == CLUSTER_PATH_COMPUTE) {
+        cluster_push_constants_t constants = push_constants(frame, occlusion::CULL_PHASE_LATE);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, state->cull_pipeline);
+        vkCmdPushConstants(cmd, state->layout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+        vkCmdDispatch(cmd, (state->meshlet_count + CLUSTERS_CULL_GROUP_SIZE - 1) / CLUSTERS_CULL_GROUP_SIZE, state->instance_count, 1);
+
+        memory_barrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+            VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+    } else {
+        // NOTE: the late task shaders rewrite the visibility the early ones read, and keep counting
+        memory_barrier(cmd, VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    }
+
+    vulkan::context::end_label(cmd);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void cull(VkCommandBuffer cmd, u32 frame_index, VkExtent2D extent, occlusion::cull_phase_t phase)
+{
+    f64 start = clock::get_time_s();
+    frame_resources_t& frame = state->frames[frame_index];
+
+    if (phase == occlusion::CULL_PHASE_LATE) {
+        if (state->ready) {
+            cull_late(cmd, frame);
+            state->record_time_s += clock::get_time_s() - start;
+        }
+        return;
+    }
+
+    if (state->requested_grid != state->grid) {
+        upload_instances((u32)state->requested_grid);
+        state->requested_grid = state->grid;
+    }
+
+    if (state->path == CLUSTER_PATH_MESH_SHADER) {
+        state->ready = vulkan::pipeline_table::resolve(state->mesh_depth_key, &state->depth_pipeline) == vulkan::pipeline_table::PIPELINE_STATUS_READY
+            && vulkan::pipeline_table::resolve(state->mesh_key, &state->draw_pipeline) == vulkan::pipeline_table::PIPELINE_STATUS_READY;
+    } else {
+        state->ready = vulkan::pipeline_table::resolve(state->cull_key, &state->cull_pipeline) == vulkan::pipeline_table::PIPELINE_STATUS_READY
+            && vulkan::pipeline_table::resolve(state->depth_key, &state->depth_pipeline) == vulkan::pipeline_table::PIPELINE_STATUS_READY
+            && vulkan::pipeline_table::resolve(state->draw_key, &state->draw_pipeline) == vulkan::pipeline_table::PIPELINE_STATUS_READY;
+    }
+
+    if (!state->ready) {
+        return;
+    }
+
+    // NOTE: the fence of this frame slot has been waited on, the readback holds the counters from two uses ago,
+    // readback memory may be cached and is only up to date after an invalidate
+    vmaInvalidateAllocation(state->context->vma, frame.readback.memory, 0, VK_WHOLE_SIZE);
+    const u32* counters = (const u32*)frame.readback.allocation_info.pMappedData;
+    state->visible[occlusion::CULL_PHASE_EARLY] = counters[0];
+    state->visible[occlusion::CULL_PHASE_LATE] = counters[1];
+    state->occluded = counters[2];
+
+    f32 radius = (f32)state->grid * CLUSTERS_SPACING * 0.8f + 2.0f;
+    if (state->orbit) {
+        f32 angle = (f32)clock::get_time_s() * 0.2f;
+        state->camera.position = glm::vec3(glm::sin(angle) * radius, radius * 0.4f, glm::cos(angle) * radius);
+        state->camera.yaw = angle;
+        state->camera.pitch = -glm::atan(0.4f);
+    }
+    state->camera.z_far = radius * 3.0f;
+
+    f32 aspect = (f32)extent.width / (f32)extent.height;
+    glm::mat4 view_projection = camera::projection(state->camera, aspect) * camera::view(state->camera);
+    camera::frustum_t frustum = camera::extract_frustum(view_projection);
+
+    cluster_frame_t* data = (cluster_frame_t*)frame.frame.allocation_info.pMappedData;
+    data->view_projection = view_projection;
+    memcpy(data->planes, frustum.planes, sizeof(data->planes));
+    data->camera_position = glm::vec4(state->camera.position, 1.0f);
+    data->pyramid = occlusion::pyramid();
+    data->meshlet_count = state->meshlet_count;
+    data->instance_count = state->instance_count;
+    data->flags = state->flags;
+
+    vulkan::context::begin_label(cmd, "cluster cull early", { 0, 1, 1, 1 });
+
+    // NOTE: the counters left by the last use of this slot go to the readback before the reset,
+    // either path may have written them since the GUI can switch in between, and so the visibility
+    memory_barrier(cmd, state->cull_stages, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+    VkBufferCopy region {
+        .srcOffset = offsetof(cluster_draw_t, visible),
+        .dstOffset = 0,
+        .size = sizeof(u32) * 3,
+    };
+    vkCmdCopyBuffer(cmd, frame.draw.handle, frame.readback.handle, 1, &region);
+
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_NONE,
+        VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+    const VkDrawIndexedIndirectCommand command {
+        .indexCount = 0,
+        .instanceCount = 1,
+        .firstIndex = 0,
+        .vertexOffset = 0,
+        .firstInstance = 0,
+    };
+    cluster_draw_t reset {
+        .commands = { command, command },
+        .visible = { 0, 0 },
+        .occluded = 0,
+        .pad = { 0, 0, 0 },
+    };
+    vkCmdUpdateBuffer(cmd, frame.draw.handle, 0, sizeof(reset), &reset);
+
+    if (state->reset_visibility) {
+        // NOTE: nothing was seen yet, the late phase draws the first frame on its own
+        vkCmdFillBuffer(cmd, state->visibility.handle, 0, sizeof(u32) * state->instance_count * state->meshlet_count, 0);
+        state->reset_visibility = false;
+    }
+
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        state->cull_stages | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+        VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+
+    if (state->path == CLUSTER_PATH_COMPUTE) {
+        cluster_push_constants_t constants = push_constants(frame, occlusion::CULL_PHASE_EARLY);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, state->cull_pipeline);
+        vkCmdPushConstants(cmd, state->layout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+        vkCmdDispatch(cmd, (state->meshlet_count + CLUSTERS_CULL_GROUP_SIZE - 1) / CLUSTERS_CULL_GROUP_SIZE, state->instance_count, 1);
+
+        // NOTE: the late phase reads the early counters to append after them
+        memory_barrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT
+                | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT
+                | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    }
+
+    vulkan::context::end_label(cmd);
+    state->record_time_s = clock::get_time_s() - start;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void draw_phase(VkCommandBuffer cmd, const frame_resources_t& frame, VkPipeline pipeline, u32 phase)
+{
+    cluster_push_constants_t constants = push_constants(frame, phase);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdPushConstants(cmd, state->layout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+
+    if (state->path == CLUSTER_PATH_MESH_SHADER) {
+        vkCmdDrawMeshTasksEXT(cmd, (state->meshlet_count + CLUSTERS_TASK_GROUP_SIZE - 1) / CLUSTERS_TASK_GROUP_SIZE, state->instance_count, 1);
+        return;
+    }
+
+    // NOTE: the color pass draws the commands of both phases, they index disjoint ranges of the same buffer
+    u32 first = phase == CLUSTER_PHASE_COLOR ? occlusion::CULL_PHASE_EARLY : phase;
+    u32 last = phase == CLUSTER_PHASE_COLOR ? occlusion::CULL_PHASE_LATE : phase;
+
+    vkCmdBindIndexBuffer(cmd, frame.indices.handle, 0, VK_INDEX_TYPE_UINT32);
+    for (u32 i = first; i <= last; i++) {
+        vkCmdDrawIndexedIndirect(cmd, frame.draw.handle, sizeof(VkDrawIndexedIndirectCommand) * i, 1, sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_depth(VkCommandBuffer cmd, u32 frame_index, occlusion::cull_phase_t phase)
+{
+    if (!state->ready) {
+        return;
+    }
+
+    f64 start = clock::get_time_s();
+
+    vulkan::context::begin_label(cmd, phase == occlusion::CULL_PHASE_EARLY ? "cluster depth early" : "cluster depth late", { 0, 1, 1, 1 });
+    draw_phase(cmd, state->frames[frame_index], state->depth_pipeline, phase);
+    vulkan::context::end_label(cmd);
+
+    state->record_time_s += clock::get_time_s() - start;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw(VkCommandBuffer cmd, u32 frame_index)
+{
+    if (!state->ready) {
+        return;
+    }
+
+    f64 start = clock::get_time_s();
+
+    vulkan::context::begin_label(cmd, "cluster draw", { 0, 1, 1, 1 });
+    draw_phase(cmd, state->frames[frame_index], state->draw_pipeline, CLUSTER_PHASE_COLOR);
+    vulkan::context::end_label(cmd);
+
+    u32 visible = state->visible[occlusion::CULL_PHASE_EARLY] + state->visible[occlusion::CULL_PHASE_LATE];
+    state->record_time_s += clock::get_time_s() - start;
+    profiler::record("clusters record", "ms", state->record_time_s * ms_per_s);
+    profiler::record("clusters visible", "meshlets", (f64)visible);
+    profiler::record("clusters occluded", "meshlets", (f64)state->occluded);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+camera::camera_t current_camera(void)
+{
+    return state->camera;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+glm::vec3 half_extent(void)
+{
+    // NOTE: the grid of upload_instances() plus about the size of a knot, which is centered on y = 0
+    f32 half = (f32)(state->grid - 1) * CLUSTERS_SPACING * 0.5f + 1.0f;
+    return glm::vec3(half, 1.0f, half);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    ImGui::SliderInt("Grid", &state->requested_grid, 1, CLUSTERS_MAX_GRID);
+    ImGui::Checkbox("Orbit camera##clusters", &state->orbit);
+    ImGui::CheckboxFlags("Cone culling", &state->flags, CLUSTER_FLAG_CONE_CULLING);
+    ImGui::CheckboxFlags("Meshlet colors", &state->flags, CLUSTER_FLAG_MESHLET_COLORS);
+
+    if (state->context->device->mesh_shader) {
+        i32 path = (i32)state->path;
+        ImGui::RadioButton("Compute + index buffer", &path, CLUSTER_PATH_COMPUTE);
+        ImGui::SameLine();
+        ImGui::RadioButton("Task + mesh shaders", &path, CLUSTER_PATH_MESH_SHADER);
+        state->path = (cluster_path_t)path;
+    } else {
+        ImGui::TextDisabled("No VK_EXT_mesh_shader, compute path only");
+    }
+
+    u32 total = state->meshlet_count * state->instance_count;
+    u32 early = state->visible[occlusion::CULL_PHASE_EARLY];
+    u32 late = state->visible[occlusion::CULL_PHASE_LATE];
+    ImGui::Text("Meshlets: %u per mesh, %u triangles", state->meshlet_count, state->triangle_count);
+    ImGui::Text("Visible: %u / %u meshlets", early + late, total);
+    ImGui::Text("Early: %u, late: %u, occluded: %u", early, late, state->occluded);
+    if (state->path == CLUSTER_PATH_COMPUTE && early + late > CLUSTERS_MAX_VISIBLE) {
+        ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "Over capacity, %u meshlets dropped", early + late - CLUSTERS_MAX_VISIBLE);
+    }
+    ImGui::Text("CPU record: %.3f ms", state->record_time_s * ms_per_s);
+}
+
+}
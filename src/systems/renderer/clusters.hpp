@@ -0,0 +1,88 @@
+#pragma once
+
+#include "camera.hpp"
+#include "occlusion.hpp"
+#include "vk/types.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rin::renderer::clusters {
+
+constexpr u32 CLUSTERS_MAX_INSTANCES = 64;
+constexpr u32 CLUSTERS_MAX_VISIBLE = 1 << 14; // meshlets per frame on the compute path, must match cluster.glsl
+constexpr u32 CLUSTERS_CULL_GROUP_SIZE = 64; // local_size_x in cluster_cull.comp
+constexpr u32 CLUSTERS_TASK_GROUP_SIZE = 32; // local_size_x in cluster.task
+constexpr u32 CLUSTER_PHASE_COLOR = 2; // after the occlusion::cull_phase_t values, must match cluster.glsl
+
+// NOTE: must match the CLUSTER_FLAG bits in cluster.glsl
+enum cluster_flag_t {
+    CLUSTER_FLAG_CONE_CULLING = 1 << 0,
+    CLUSTER_FLAG_MESHLET_COLORS = 1 << 1,
+};
+
+enum cluster_path_t {
+    CLUSTER_PATH_COMPUTE, // cull pass compacting the survivors into an index buffer, works everywhere
+    CLUSTER_PATH_MESH_SHADER, // task shader culling into mesh shader payloads, needs VK_EXT_mesh_shader
+};
+
+// NOTE: the structs below mirror resources/shaders/cluster.glsl, std430 layout
+struct cluster_frame_t {
+    glm::mat4 view_projection;
+    glm::vec4 planes[6];
+    glm::vec4 camera_position;
+    occlusion::pyramid_t pyramid;
+    u32 meshlet_count;
+    u32 instance_count;
+    u32 flags; // cluster_flag_t
+    u32 pad[3];
+};
+
+struct cluster_instance_t {
+    glm::vec4 position_scale; // xyz position, w uniform scale
+    u32 color; // 0xAABBGGRR
+    u32 pad[3];
+};
+
+// NOTE: the commands are only drawn by the compute path, the late one starts where the early one ends,
+// the counters are filled by both paths
+struct cluster_draw_t {
+    VkDrawIndexedIndirectCommand commands[2]; // per occlusion::cull_phase_t
+    u32 visible[2]; // meshlets kept by each phase
+    u32 occluded; // in the frustum but rejected by the late phase
+    u32 pad[3];
+};
+
+struct cluster_push_constants_t {
+    VkDeviceAddress lights; // lights::light_frame_t, first in every block so scene.frag finds it at offset 0
+    VkDeviceAddress frame;
+    VkDeviceAddress instances;
+    VkDeviceAddress meshlets;
+    VkDeviceAddress meshlet_vertices;
+    VkDeviceAddress meshlet_triangles;
+    VkDeviceAddress vertices;
+    VkDeviceAddress visible;
+    VkDeviceAddress indices;
+    VkDeviceAddress draw;
+    VkDeviceAddress visibility; // one u32 per (instance, meshlet), whether the last late phase saw it
+    u32 phase; // occlusion::cull_phase_t, or CLUSTER_PHASE_COLOR for the color pass of the mesh shader path
+    u32 pad;
+};
+
+// Needs lights::create() to have run, every frame slot draws with the light grid of the same slot.
+bool create(vulkan::context_t* context, u32 frame_count, VkFormat color_format, VkFormat depth_format);
+void destroy(void);
+
+// All record into the frame command buffer: cull() outside of any rendering scope, the draws inside one.
+// Every phase is culled then drawn into depth, see occlusion.hpp, and draw() shades what both phases kept.
+// On the mesh shader path cull() only resets the counters, the task shader culls while drawing.
+void cull(VkCommandBuffer cmd, u32 frame, VkExtent2D extent, occlusion::cull_phase_t phase);
+void draw_depth(VkCommandBuffer cmd, u32 frame, occlusion::cull_phase_t phase);
+void draw(VkCommandBuffer cmd, u32 frame);
+
+// Camera of the last early cull() and half size of the box the instances fill around the origin, for the lights.
+camera::camera_t current_camera(void);
+glm::vec3 half_extent(void);
+
+void draw_gui(void);
+
+}
@@ -0,0 +1,588 @@
+#include "culling.hpp"
+
+#include "core/clock.hpp"
+#include "core/hash.hpp"
+#include "core/jobs.hpp"
+#include "core/profiler.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <imgui.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define CULLING_SSE2 1
+#include <emmintrin.h>
+#else
+#define CULLING_SSE2 0
+#endif
+
+// NOTE: the build targets baseline x86-64, the AVX2 kernels are compiled through the target attribute and only
+// picked when the CPU reports support at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CULLING_AVX2 1
+#include <immintrin.h>
+#else
+#define CULLING_AVX2 0
+#endif
+
+namespace rin::renderer::culling {
+
+constexpr u32 BENCHMARK_REPEATS = 8; // best of, to keep the numbers stable across frames
+constexpr f32 BENCHMARK_WORLD_SIZE = 1000.0f;
+
+enum benchmark_kind_t {
+    BENCHMARK_KIND_SPHERES,
+    BENCHMARK_KIND_AABBS,
+    BENCHMARK_KIND_COUNT,
+};
+
+struct cull_job_t {
+    const camera::frustum_t* frustum;
+    const sphere_set_t* spheres; // exactly one of the two is set
+    const aabb_set_t* aabbs;
+    culling_isa_t isa;
+    u32* visible;
+    u32* counts; // per parallel_for batch
+    u32 job_size;
+};
+
+struct benchmark_t {
+    sphere_set_t spheres;
+    aabb_set_t aabbs;
+    darray<u32> visible;
+    i32 count;
+    u32 visible_count[BENCHMARK_KIND_COUNT];
+    f64 objects_per_ms[BENCHMARK_KIND_COUNT][CULLING_ISA_COUNT][2]; // single threaded, parallel
+};
+
+static benchmark_t* benchmark = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u64 padded(u64 count)
+{
+    u64 capacity = (count + CULLING_BATCH_SIZE - 1) / CULLING_BATCH_SIZE * CULLING_BATCH_SIZE;
+    return capacity > 0 ? capacity : CULLING_BATCH_SIZE;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+sphere_set_t create_sphere_set(u32 capacity)
+{
+    u64 size = padded(capacity);
+    return sphere_set_t {
+        .center_x = darray<f32>(size, false),
+        .center_y = darray<f32>(size, false),
+        .center_z = darray<f32>(size, false),
+        .radius = darray<f32>(size, false),
+        .count = 0,
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+aabb_set_t create_aabb_set(u32 capacity)
+{
+    u64 size = padded(capacity);
+    return aabb_set_t {
+        .center_x = darray<f32>(size, false),
+        .center_y = darray<f32>(size, false),
+        .center_z = darray<f32>(size, false),
+        .extent_x = darray<f32>(size, false),
+        .extent_y = darray<f32>(size, false),
+        .extent_z = darray<f32>(size, false),
+        .count = 0,
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void push(sphere_set_t* set, const glm::vec3& center, f32 radius)
+{
+    // NOTE: capacities start as a multiple of the batch size and darray doubles them, so they stay one
+    set->center_x.push(center.x);
+    set->center_y.push(center.y);
+    set->center_z.push(center.z);
+    set->radius.push(radius);
+    set->count++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void push(aabb_set_t* set, const glm::vec3& min, const glm::vec3& max)
+{
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    set->center_x.push(center.x);
+    set->center_y.push(center.y);
+    set->center_z.push(center.z);
+    set->extent_x.push(extent.x);
+    set->extent_y.push(extent.y);
+    set->extent_z.push(extent.z);
+    set->count++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void clear(sphere_set_t* set)
+{
+    set->center_x.clear();
+    set->center_y.clear();
+    set->center_z.clear();
+    set->radius.clear();
+    set->count = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void clear(aabb_set_t* set)
+{
+    set->center_x.clear();
+    set->center_y.clear();
+    set->center_z.clear();
+    set->extent_x.clear();
+    set->extent_y.clear();
+    set->extent_z.clear();
+    set->count = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+culling_isa_t detect_isa(void)
+{
+    static culling_isa_t isa = []() {
+#if CULLING_AVX2
+        // NOTE: also checks that the OS saves the YMM registers
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return CULLING_ISA_AVX2;
+        }
+#endif
+        return CULLING_SSE2 ? CULLING_ISA_SSE2 : CULLING_ISA_SCALAR;
+    }();
+    return isa;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+const char* isa_name(culling_isa_t isa)
+{
+    switch (isa) {
+    case CULLING_ISA_SCALAR:
+        return "scalar";
+    case CULLING_ISA_SSE2:
+        return "SSE2";
+    case CULLING_ISA_AVX2:
+        return "AVX2";
+    default:
+        return "unknown";
+    }
+}
+
+// The kernels below cull [begin, end), begin being a multiple of CULLING_BATCH_SIZE, and append the visible indices
+// to out. They all evaluate dot(n, c) + w < -r with the same operation order and no fused multiply add, so every
+// path keeps exactly the same volumes. An AABB is a sphere whose radius depends on the plane: dot(|n|, extent).
+// NOTE: the lane loops store unconditionally and only advance on visible lanes, which keeps them branch free
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 spheres_scalar(const camera::frustum_t& frustum, const sphere_set_t& set, u32 begin, u32 end, u32* out)
+{
+    u32 count = 0;
+    for (u32 i = begin; i < end; i++) {
+        bool outside = false;
+        for (u32 p = 0; p < 6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            f32 d = plane.x * set.center_x[i] + plane.y * set.center_y[i] + plane.z * set.center_z[i] + plane.w;
+            outside |= d < -set.radius[i];
+        }
+        out[count] = i;
+        count += outside ? 0 : 1;
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 aabbs_scalar(const camera::frustum_t& frustum, const aabb_set_t& set, u32 begin, u32 end, u32* out)
+{
+    u32 count = 0;
+    for (u32 i = begin; i < end; i++) {
+        bool outside = false;
+        for (u32 p = 0; p < 6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            f32 d = plane.x * set.center_x[i] + plane.y * set.center_y[i] + plane.z * set.center_z[i] + plane.w;
+            f32 r = fabsf(plane.x) * set.extent_x[i] + fabsf(plane.y) * set.extent_y[i]
+                + fabsf(plane.z) * set.extent_z[i];
+            outside |= d < -r;
+        }
+        out[count] = i;
+        count += outside ? 0 : 1;
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 append_lanes(u32 mask, u32 lanes, u32 first, u32* out, u32 count)
+{
+    for (u32 lane = 0; lane < lanes; lane++) {
+        out[count] = first + lane;
+        count += (mask >> lane) & 1;
+    }
+    return count;
+}
+
+#if CULLING_SSE2
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 spheres_sse2(const camera::frustum_t& frustum, const sphere_set_t& set, u32 begin, u32 end, u32* out)
+{
+    __m128 nx[6], ny[6], nz[6], nw[6];
+    for (u32 p = 0; p < 6; p++) {
+        nx[p] = _mm_set1_ps(frustum.planes[p].x);
+        ny[p] = _mm_set1_ps(frustum.planes[p].y);
+        nz[p] = _mm_set1_ps(frustum.planes[p].z);
+        nw[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+
+    // NOTE: the arrays are padded to the batch size, lanes past the end read garbage and are dropped by append_lanes
+    u32 count = 0;
+    for (u32 i = begin; i < end; i += 4) {
+        __m128 cx = _mm_load_ps(set.center_x.data + i);
+        __m128 cy = _mm_load_ps(set.center_y.data + i);
+        __m128 cz = _mm_load_ps(set.center_z.data + i);
+        __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), _mm_load_ps(set.radius.data + i));
+
+        __m128 outside = _mm_setzero_ps();
+        for (u32 p = 0; p < 6; p++) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+                                      _mm_mul_ps(nz[p], cz)),
+                nw[p]);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, neg_r));
+        }
+
+        u32 lanes = end - i < 4 ? end - i : 4;
+        count = append_lanes(~(u32)_mm_movemask_ps(outside), lanes, i, out, count);
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 aabbs_sse2(const camera::frustum_t& frustum, const aabb_set_t& set, u32 begin, u32 end, u32* out)
+{
+    __m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+    for (u32 p = 0; p < 6; p++) {
+        nx[p] = _mm_set1_ps(frustum.planes[p].x);
+        ny[p] = _mm_set1_ps(frustum.planes[p].y);
+        nz[p] = _mm_set1_ps(frustum.planes[p].z);
+        nw[p] = _mm_set1_ps(frustum.planes[p].w);
+        ax[p] = _mm_set1_ps(fabsf(frustum.planes[p].x));
+        ay[p] = _mm_set1_ps(fabsf(frustum.planes[p].y));
+        az[p] = _mm_set1_ps(fabsf(frustum.planes[p].z));
+    }
+
+    u32 count = 0;
+    for (u32 i = begin; i < end; i += 4) {
+        __m128 cx = _mm_load_ps(set.center_x.data + i);
+        __m128 cy = _mm_load_ps(set.center_y.data + i);
+        __m128 cz = _mm_load_ps(set.center_z.data + i);
+        __m128 ex = _mm_load_ps(set.extent_x.data + i);
+        __m128 ey = _mm_load_ps(set.extent_y.data + i);
+        __m128 ez = _mm_load_ps(set.extent_z.data + i);
+
+        __m128 outside = _mm_setzero_ps();
+        for (u32 p = 0; p < 6; p++) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+                                      _mm_mul_ps(nz[p], cz)),
+                nw[p]);
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_sub_ps(_mm_setzero_ps(), r)));
+        }
+
+        u32 lanes = end - i < 4 ? end - i : 4;
+        count = append_lanes(~(u32)_mm_movemask_ps(outside), lanes, i, out, count);
+    }
+    return count;
+}
+#endif
+
+#if CULLING_AVX2
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx2"))) static u32 spheres_avx2(
+    const camera::frustum_t& frustum, const sphere_set_t& set, u32 begin, u32 end, u32* out)
+{
+    __m256 nx[6], ny[6], nz[6], nw[6];
+    for (u32 p = 0; p < 6; p++) {
+        nx[p] = _mm256_set1_ps(frustum.planes[p].x);
+        ny[p] = _mm256_set1_ps(frustum.planes[p].y);
+        nz[p] = _mm256_set1_ps(frustum.planes[p].z);
+        nw[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+
+    // NOTE: darray storage comes from malloc, 16 byte aligned only, hence the unaligned loads
+    u32 count = 0;
+    for (u32 i = begin; i < end; i += CULLING_BATCH_SIZE) {
+        __m256 cx = _mm256_loadu_ps(set.center_x.data + i);
+        __m256 cy = _mm256_loadu_ps(set.center_y.data + i);
+        __m256 cz = _mm256_loadu_ps(set.center_z.data + i);
+        __m256 neg_r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(set.radius.data + i));
+
+        __m256 outside = _mm256_setzero_ps();
+        for (u32 p = 0; p < 6; p++) {
+            __m256 d = _mm256_add_ps(
+                _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)),
+                    _mm256_mul_ps(nz[p], cz)),
+                nw[p]);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, neg_r, _CMP_LT_OQ));
+        }
+
+        u32 lanes = end - i < CULLING_BATCH_SIZE ? end - i : CULLING_BATCH_SIZE;
+        count = append_lanes(~(u32)_mm256_movemask_ps(outside), lanes, i, out, count);
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx2"))) static u32 aabbs_avx2(
+    const camera::frustum_t& frustum, const aabb_set_t& set, u32 begin, u32 end, u32* out)
+{
+    __m256 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+    for (u32 p = 0; p < 6; p++) {
+        nx[p] = _mm256_set1_ps(frustum.planes[p].x);
+        ny[p] = _mm256_set1_ps(frustum.planes[p].y);
+        nz[p] = _mm256_set1_ps(frustum.planes[p].z);
+        nw[p] = _mm256_set1_ps(frustum.planes[p].w);
+        ax[p] = _mm256_set1_ps(fabsf(frustum.planes[p].x));
+        ay[p] = _mm256_set1_ps(fabsf(frustum.planes[p].y));
+        az[p] = _mm256_set1_ps(fabsf(frustum.planes[p].z));
+    }
+
+    u32 count = 0;
+    for (u32 i = begin; i < end; i += CULLING_BATCH_SIZE) {
+        __m256 cx = _mm256_loadu_ps(set.center_x.data + i);
+        __m256 cy = _mm256_loadu_ps(set.center_y.data + i);
+        __m256 cz = _mm256_loadu_ps(set.center_z.data + i);
+        __m256 ex = _mm256_loadu_ps(set.extent_x.data + i);
+        __m256 ey = _mm256_loadu_ps(set.extent_y.data + i);
+        __m256 ez = _mm256_loadu_ps(set.extent_z.data + i);
+
+        __m256 outside = _mm256_setzero_ps();
+        for (u32 p = 0; p < 6; p++) {
+            __m256 d = _mm256_add_ps(
+                _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)),
+                    _mm256_mul_ps(nz[p], cz)),
+                nw[p]);
+            __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)),
+                _mm256_mul_ps(az[p], ez));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, _mm256_sub_ps(_mm256_setzero_ps(), r), _CMP_LT_OQ));
+        }
+
+        u32 lanes = end - i < CULLING_BATCH_SIZE ? end - i : CULLING_BATCH_SIZE;
+        count = append_lanes(~(u32)_mm256_movemask_ps(outside), lanes, i, out, count);
+    }
+    return count;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 cull_range(const cull_job_t& job, u32 begin, u32 end, u32* out)
+{
+    switch (job.isa) {
+#if CULLING_AVX2
+    case CULLING_ISA_AVX2:
+        return job.spheres != nullptr ? spheres_avx2(*job.frustum, *job.spheres, begin, end, out)
+                                      : aabbs_avx2(*job.frustum, *job.aabbs, begin, end, out);
+#endif
+#if CULLING_SSE2
+    case CULLING_ISA_SSE2:
+        return job.spheres != nullptr ? spheres_sse2(*job.frustum, *job.spheres, begin, end, out)
+                                      : aabbs_sse2(*job.frustum, *job.aabbs, begin, end, out);
+#endif
+    default:
+        return job.spheres != nullptr ? spheres_scalar(*job.frustum, *job.spheres, begin, end, out)
+                                      : aabbs_scalar(*job.frustum, *job.aabbs, begin, end, out);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void cull_batch(u32 begin, u32 end, void* data)
+{
+    cull_job_t* job = (cull_job_t*)data;
+    job->counts[begin / job->job_size] = cull_range(*job, begin, end, job->visible + begin);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 cull(cull_job_t* job, u32 count, bool parallel)
+{
+    if (!parallel || count <= CULLING_PARALLEL_THRESHOLD) {
+        return cull_range(*job, 0, count, job->visible);
+    }
+
+    // NOTE: each batch compacts into its own slice of visible, the slices are then packed on this thread, which keeps
+    // the indices sorted without any atomic and the counts on the stack
+    u32 job_size = (count + CULLING_MAX_JOBS - 1) / CULLING_MAX_JOBS;
+    job_size = (u32)padded(job_size < CULLING_JOB_SIZE ? CULLING_JOB_SIZE : job_size);
+
+    u32 counts[CULLING_MAX_JOBS];
+    job->counts = counts;
+    job->job_size = job_size;
+    jobs::parallel_for(count, job_size, cull_batch, job);
+
+    u32 visible_count = counts[0];
+    u32 batch_count = (count + job_size - 1) / job_size;
+    for (u32 i = 1; i < batch_count; i++) {
+        memmove(job->visible + visible_count, job->visible + i * job_size, counts[i] * sizeof(u32));
+        visible_count += counts[i];
+    }
+    return visible_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static culling_isa_t resolve_isa(culling_isa_t isa)
+{
+    culling_isa_t best = detect_isa();
+    return isa > best ? best : isa;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 cull_spheres(const camera::frustum_t& frustum, const sphere_set_t& set, u32* visible, culling_isa_t isa,
+    bool parallel)
+{
+    cull_job_t job {
+        .frustum = &frustum,
+        .spheres = &set,
+        .aabbs = nullptr,
+        .isa = resolve_isa(isa),
+        .visible = visible,
+        .counts = nullptr,
+        .job_size = 0,
+    };
+    return cull(&job, set.count, parallel);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 cull_aabbs(const camera::frustum_t& frustum, const aabb_set_t& set, u32* visible, culling_isa_t isa,
+    bool parallel)
+{
+    cull_job_t job {
+        .frustum = &frustum,
+        .spheres = nullptr,
+        .aabbs = &set,
+        .isa = resolve_isa(isa),
+        .visible = visible,
+        .counts = nullptr,
+        .job_size = 0,
+    };
+    return cull(&job, set.count, parallel);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static f32 unit_float(u32 bits)
+{
+    return (f32)(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void fill_benchmark(u32 count)
+{
+    clear(&benchmark->spheres);
+    clear(&benchmark->aabbs);
+    benchmark->visible.clear();
+    benchmark->visible.reserve(count);
+
+    for (u32 i = 0; i < count; i++) {
+        u32 seed = i * 5;
+        glm::vec3 center = (glm::vec3(unit_float(hash::mix32(seed)), unit_float(hash::mix32(seed + 1)),
+                                unit_float(hash::mix32(seed + 2)))
+                               - 0.5f)
+            * BENCHMARK_WORLD_SIZE;
+        f32 size = 0.5f + unit_float(hash::mix32(seed + 3)) * 4.0f;
+        glm::vec3 extent = glm::vec3(size, size * 0.5f, size) * (0.5f + unit_float(hash::mix32(seed + 4)));
+
+        push(&benchmark->spheres, center, size);
+        push(&benchmark->aabbs, center - extent, center + extent);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void run_benchmark(void)
+{
+    u32 count = (u32)benchmark->count;
+    if (benchmark->spheres.count != count) {
+        fill_benchmark(count);
+    }
+
+    // NOTE: a wide camera at the center of the volumes, roughly a sixth of them are in view
+    camera::camera_t camera {
+        .position = glm::vec3(0.0f),
+        .yaw = 0.3f,
+        .pitch = 0.1f,
+        .fov_y = 1.2f,
+        .z_near = 0.1f,
+        .z_far = BENCHMARK_WORLD_SIZE,
+    };
+    camera::frustum_t frustum
+        = camera::extract_frustum(camera::projection(camera, 16.0f / 9.0f) * camera::view(camera));
+
+    memset(benchmark->objects_per_ms, 0, sizeof(benchmark->objects_per_ms));
+    for (u32 kind = 0; kind < BENCHMARK_KIND_COUNT; kind++) {
+        for (u32 isa = 0; isa <= (u32)detect_isa(); isa++) {
+            for (u32 parallel = 0; parallel < 2; parallel++) {
+                f64 best_ms = 0.0;
+                for (u32 repeat = 0; repeat < BENCHMARK_REPEATS; repeat++) {
+                    f64 start = clock::get_time_s();
+                    benchmark->visible_count[kind] = kind == BENCHMARK_KIND_SPHERES
+                        ? cull_spheres(frustum, benchmark->spheres, benchmark->visible.data, (culling_isa_t)isa,
+                              parallel == 1)
+                        : cull_aabbs(frustum, benchmark->aabbs, benchmark->visible.data, (culling_isa_t)isa,
+                              parallel == 1);
+                    f64 ms = (clock::get_time_s() - start) * ms_per_s;
+                    best_ms = repeat == 0 || ms < best_ms ? ms : best_ms;
+                }
+                benchmark->objects_per_ms[kind][isa][parallel] = best_ms > 0.0 ? count / best_ms : 0.0;
+            }
+        }
+    }
+
+    culling_isa_t best = detect_isa();
+    profiler::record("cpu culling spheres", "objects/ms", benchmark->objects_per_ms[BENCHMARK_KIND_SPHERES][best][1]);
+    profiler::record("cpu culling aabbs", "objects/ms", benchmark->objects_per_ms[BENCHMARK_KIND_AABBS][best][1]);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    if (benchmark == nullptr) {
+        benchmark = (benchmark_t*)calloc(1, sizeof(benchmark_t));
+        benchmark->spheres = create_sphere_set(0);
+        benchmark->aabbs = create_aabb_set(0);
+        benchmark->visible = darray<u32>(false);
+        benchmark->count = 1 << 20;
+    }
+
+    ImGui::Text("Best ISA: %s", isa_name(detect_isa()));
+    ImGui::SliderInt("Volumes", &benchmark->count, 1000, 8000000, "%d", ImGuiSliderFlags_Logarithmic);
+    if (ImGui::Button("Run benchmark")) {
+        run_benchmark();
+    }
+
+    if (benchmark->spheres.count == 0) {
+        return;
+    }
+
+    ImGui::Text("Visible: %u spheres, %u AABBs of %u", benchmark->visible_count[BENCHMARK_KIND_SPHERES],
+        benchmark->visible_count[BENCHMARK_KIND_AABBS], benchmark->spheres.count);
+    for (u32 isa = 0; isa <= (u32)detect_isa(); isa++) {
+        ImGui::Text("%-6s spheres %9.0f / %9.0f, AABBs %9.0f / %9.0f objects/ms", isa_name((culling_isa_t)isa),
+            benchmark->objects_per_ms[BENCHMARK_KIND_SPHERES][isa][0],
+            benchmark->objects_per_ms[BENCHMARK_KIND_SPHERES][isa][1],
+            benchmark->objects_per_ms[BENCHMARK_KIND_AABBS][isa][0],
+            benchmark->objects_per_ms[BENCHMARK_KIND_AABBS][isa][1]);
+    }
+    ImGui::TextDisabled("single threaded / parallel");
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void shutdown(void)
+{
+    if (benchmark == nullptr) {
+        return;
+    }
+
+    benchmark->spheres.~sphere_set_t();
+    benchmark->aabbs.~aabb_set_t();
+    benchmark->visible.~darray();
+    free(benchmark);
+    benchmark = nullptr;
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "camera.hpp"
+#include "core/containers/darray.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rin::renderer::culling {
+
+constexpr u32 CULLING_BATCH_SIZE = 8; // volumes per SIMD iteration, set arrays are padded to a multiple of it
+constexpr u32 CULLING_PARALLEL_THRESHOLD = 16384; // smaller sets are culled on the calling thread
+constexpr u32 CULLING_JOB_SIZE = 4096; // volumes per parallel_for batch, grown so there are at most CULLING_MAX_JOBS
+constexpr u32 CULLING_MAX_JOBS = 256;
+
+enum culling_isa_t {
+    CULLING_ISA_SCALAR,
+    CULLING_ISA_SSE2, // 4 wide, twice per batch
+    CULLING_ISA_AVX2, // 8 wide, picked at runtime when both the CPU and the OS support it
+    CULLING_ISA_COUNT,
+};
+
+// Bounding volumes in SoA layout, one array per component so a whole batch loads with a single instruction.
+// Use push() to fill them, it keeps the capacity a multiple of CULLING_BATCH_SIZE.
+struct sphere_set_t {
+    darray<f32> center_x;
+    darray<f32> center_y;
+    darray<f32> center_z;
+    darray<f32> radius;
+    u32 count;
+};
+
+struct aabb_set_t {
+    darray<f32> center_x;
+    darray<f32> center_y;
+    darray<f32> center_z;
+    darray<f32> extent_x; // half size
+    darray<f32> extent_y;
+    darray<f32> extent_z;
+    u32 count;
+};
+
+sphere_set_t create_sphere_set(u32 capacity);
+aabb_set_t create_aabb_set(u32 capacity);
+
+void push(sphere_set_t* set, const glm::vec3& center, f32 radius);
+void push(aabb_set_t* set, const glm::vec3& min, const glm::vec3& max);
+void clear(sphere_set_t* set);
+void clear(aabb_set_t* set);
+
+// Best instruction set this CPU runs, detected once.
+culling_isa_t detect_isa(void);
+const char* isa_name(culling_isa_t isa);
+
+// Writes the index of every volume intersecting the frustum to visible, in increasing order, and returns how many.
+// visible must hold set.count entries. Sets larger than CULLING_PARALLEL_THRESHOLD are spread across the job
+// system when parallel is set. Volumes straddling a plane are visible, like camera::sphere_visible.
+// isa is clamped to detect_isa(), passing CULLING_ISA_COUNT picks the best one.
+u32 cull_spheres(const camera::frustum_t& frustum, const sphere_set_t& set, u32* visible,
+    culling_isa_t isa = CULLING_ISA_COUNT, bool parallel = true);
+u32 cull_aabbs(const camera::frustum_t& frustum, const aabb_set_t& set, u32* visible,
+    culling_isa_t isa = CULLING_ISA_COUNT, bool parallel = true);
+
+// Throughput benchmark over random volumes, run from the tool window, its buffers are released by shutdown().
+void draw_gui(void);
+void shutdown(void);
+
+}
@@ -0,0 +1,434 @@
+#include "debug_draw.hpp"
+
+#include "core/allocations.hpp"
+#include "core/clock.hpp"
+#include "core/containers/darray.hpp"
+#include "core/hash.hpp"
+#include "core/jobs.hpp"
+#include "core/logger.hpp"
+#include "core/profiler.hpp"
+#include "vk/context.hpp"
+#include "vk/host_memory.hpp"
+#include "vk/pipeline.hpp"
+#include "vk/pipeline_table.hpp"
+#include "vk/utils.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <imgui.h>
+
+namespace rin::renderer::debug_draw {
+
+constexpr u32 DEBUG_DRAW_STRESS_BATCH = 16384;
+constexpr u32 DEBUG_DRAW_MAX_THREADS = jobs::JOBS_MAX_WORKERS + 1; // workers and the main thread
+
+// NOTE: line list vertices each primitive expands to, indexed by debug_primitive_type_t
+constexpr u32 VERTICES_PER_PRIMITIVE[DEBUG_PRIMITIVE_TYPE_COUNT] = {
+    2,
+    24, // 12 edges
+    3 * DEBUG_DRAW_SPHERE_SEGMENTS * 2, // a circle around each axis
+};
+
+constexpr const char* TYPE_NAMES[DEBUG_PRIMITIVE_TYPE_COUNT] = {
+    "Lines",
+    "Boxes",
+    "Spheres",
+};
+
+struct frame_t {
+    vulkan::buffer_t buffer; // host visible, one region per type, read by debug_draw.vert
+    u32 capacity[DEBUG_PRIMITIVE_TYPE_COUNT];
+    u32 count[DEBUG_PRIMITIVE_TYPE_COUNT];
+    u64 offset[DEBUG_PRIMITIVE_TYPE_COUNT]; // bytes from the start of the buffer
+};
+
+// NOTE: only ever touched by the thread it belongs to, between two end() calls, a cache line each
+struct alignas(64) thread_t {
+    u32 next[DEBUG_PRIMITIVE_TYPE_COUNT]; // next record of the claimed block
+    u32 end[DEBUG_PRIMITIVE_TYPE_COUNT];
+    u32 dropped[DEBUG_PRIMITIVE_TYPE_COUNT];
+};
+
+struct state_t {
+    vulkan::context_t* context;
+    darray<frame_t> frames; // frames in flight plus the one being written
+    u32 write_frame;
+    u32 sealed_frame; // drawn by draw(), UINT32_MAX before the first end()
+    debug_primitive_t* regions[DEBUG_PRIMITIVE_TYPE_COUNT]; // mapped regions of the frame being written
+    u32 capacity[DEBUG_PRIMITIVE_TYPE_COUNT];
+    std::atomic<u32> cursor[DEBUG_PRIMITIVE_TYPE_COUNT]; // first record no thread has claimed yet
+    u32 demand[DEBUG_PRIMITIVE_TYPE_COUNT]; // pushed last frame, dropped ones included
+    u32 dropped[DEBUG_PRIMITIVE_TYPE_COUNT];
+    VkShaderModule vert_module;
+    VkShaderModule frag_module;
+    VkPipelineLayout layout; // owned by the pipeline table
+    u64 pipeline_key;
+    bool stress;
+    i32 stress_count;
+    f64 fill_ms;
+    f64 seal_ms;
+};
+
+struct stress_data_t {
+    glm::vec3 half_extent;
+    f32 time;
+};
+
+static state_t* state = nullptr;
+static thread_t threads[DEBUG_DRAW_MAX_THREADS];
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static f32 unit_float(u32 x)
+{
+    return (f32)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 grown_capacity(u32 current, u32 demand)
+{
+    u32 capacity = current == 0 ? DEBUG_DRAW_INITIAL_CAPACITY : current;
+    while (capacity < demand && capacity < DEBUG_DRAW_MAX_CAPACITY) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool ensure_frame_capacity(frame_t& frame)
+{
+    u32 capacity[DEBUG_PRIMITIVE_TYPE_COUNT];
+    bool grow = false;
+    for (u32 type = 0; type < DEBUG_PRIMITIVE_TYPE_COUNT; type++) {
+        capacity[type] = grown_capacity(frame.capacity[type], state->demand[type]);
+        grow |= capacity[type] != frame.capacity[type];
+    }
+
+    if (!grow) {
+        return true;
+    }
+
+    RIN_ALLOW_ALLOC("debug_draw buffer growth");
+
+    // NOTE: the buffer was last drawn by a frame whose fence has been waited on, it is no longer read
+    vulkan::context::destroy_buffer(&frame.buffer);
+    memset(frame.capacity, 0, sizeof(frame.capacity));
+
+    u64 size = 0;
+    for (u32 type = 0; type < DEBUG_PRIMITIVE_TYPE_COUNT; type++) {
+        frame.offset[type] = size;
+        size += sizeof(debug_primitive_t) * capacity[type];
+    }
+
+    vulkan::buffer_create_info_t info {
+        .size = size,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = false,
+        .tag = vulkan::MEMORY_TAG_DEBUG_DRAW,
+    };
+
+    if (!vulkan::context::allocate_buffer(info, &frame.buffer)) {
+        log::error("debug_draw::ensure_frame_capacity -> failed to allocate %llu bytes", (unsigned long long)size);
+        return false;
+    }
+
+    memcpy(frame.capacity, capacity, sizeof(frame.capacity));
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void begin_frame(u32 frame_index)
+{
+    frame_t& frame = state->frames[frame_index];
+    state->write_frame = frame_index;
+
+    // NOTE: a failed allocation leaves every capacity at zero, pushes are then dropped until it succeeds
+    ensure_frame_capacity(frame);
+
+    u8* mapped = (u8*)frame.buffer.allocation_info.pMappedData;
+    for (u32 type = 0; type < DEBUG_PRIMITIVE_TYPE_COUNT; type++) {
+        state->regions[type] = mapped != nullptr ? (debug_primitive_t*)(mapped + frame.offset[type]) : nullptr;
+        state->capacity[type] = frame.capacity[type];
+        state->cursor[type].store(0, std::memory_order_relaxed);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(vulkan::context_t* context, u32 frame_count, VkFormat color_format, VkFormat depth_format)
+{
+    if (state != nullptr) {
+        log::error("debug_draw::create -> debug draw has been already created");
+        return false;
+    }
+
+    state = (state_t*)calloc(1, sizeof(state_t));
+    state->context = context;
+    state->frames = darray<frame_t> { frame_count + 1, true };
+    state->frames.len = frame_count + 1;
+    state->sealed_frame = UINT32_MAX;
+    state->stress_count = 1000000;
+
+    for (size_t i = 0; i < state->frames.len; i++) {
+        state->frames[i].buffer.bindless_index = vulkan::BINDLESS_INVALID_INDEX;
+    }
+
+    VkDevice device = context->device->logical_device;
+
+    vulkan::reflection::shader_reflection_t vert_reflection {};
+    vulkan::reflection::shader_reflection_t frag_reflection {};
+
+    if (!vulkan::utils::load_shader_module(device, "resources/shaders/debug_draw.vert.spv", &state->vert_module, &vert_reflection)
+        || !vulkan::utils::load_shader_module(device, "resources/shaders/debug_draw.frag.spv", &state->frag_module, &frag_reflection)) {
+        log::error("debug_draw::create -> failed to load shader modules");
+        destroy();
+        return false;
+    }
+
+    const vulkan::reflection::shader_reflection_t* stages[] = { &vert_reflection, &frag_reflection };
+    if (!vulkan::pipeline_table::get_layout(stages, 2, &state->layout)) {
+        log::error("debug_draw::create -> failed to create pipeline layout");
+        destroy();
+        return false;
+    }
+
+    // NOTE: every primitive type is expanded to a line list by the vertex shader, so one pipeline draws them all,
+    // tested against the scene depth without writing it
+    vulkan::pipeline_builder_t builder {};
+    builder
+        .set_multisampling_none()
+        .enable_blending_alpha()
+        .enable_depthtest(false, VK_COMPARE_OP_LESS_OR_EQUAL)
+        .set_color_attachment_format(color_format)
+        .set_depth_format(depth_format)
+        .set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE)
+        .set_polygon_mode(VK_POLYGON_MODE_FILL)
+        .set_input_topology(VK_PRIMITIVE_TOPOLOGY_LINE_LIST)
+        .set_shaders(state->vert_module, state->frag_module)
+        .set_layout(state->layout);
+    state->pipeline_key = vulkan::pipeline_table::request(builder);
+
+    begin_frame(0);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(void)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    VkDevice device = state->context->device->logical_device;
+    vkDeviceWaitIdle(device);
+
+    if (state->vert_module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, state->vert_module, vulkan::host_memory::callbacks());
+    }
+
+    if (state->frag_module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, state->frag_module, vulkan::host_memory::callbacks());
+    }
+
+    for (size_t i = 0; i < state->frames.len; i++) {
+        vulkan::context::destroy_buffer(&state->frames[i].buffer);
+    }
+
+    state->frames.~darray();
+
+    free(state);
+    state = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool claim(thread_t& thread, u32 type)
+{
+    // NOTE: the load keeps a full buffer from being hammered with atomic adds by every further push
+    u32 capacity = state->capacity[type];
+    if (state->cursor[type].load(std::memory_order_relaxed) >= capacity) {
+        return false;
+    }
+
+    u32 first = state->cursor[type].fetch_add(DEBUG_DRAW_BLOCK_SIZE, std::memory_order_relaxed);
+    if (first >= capacity) {
+        return false;
+    }
+
+    thread.next[type] = first;
+    thread.end[type] = capacity - first < DEBUG_DRAW_BLOCK_SIZE ? capacity : first + DEBUG_DRAW_BLOCK_SIZE;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void push(u32 type, const glm::vec3& a, const glm::vec3& b, u32 color)
+{
+    thread_t& thread = threads[jobs::thread_index()];
+    if (thread.next[type] == thread.end[type] && !claim(thread, type)) {
+        thread.dropped[type] += 1;
+        return;
+    }
+
+    // NOTE: written in one go and in order, the buffer is write combined memory
+    state->regions[type][thread.next[type]++] = debug_primitive_t {
+        .a = a,
+        .color = color,
+        .b = b,
+        .pad = 0,
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void line(const glm::vec3& a, const glm::vec3& b, u32 color)
+{
+    push(DEBUG_PRIMITIVE_TYPE_LINE, a, b, color);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void box(const glm::vec3& min, const glm::vec3& max, u32 color)
+{
+    push(DEBUG_PRIMITIVE_TYPE_BOX, min, max, color);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void sphere(const glm::vec3& center, f32 radius, u32 color)
+{
+    push(DEBUG_PRIMITIVE_TYPE_SPHERE, center, glm::vec3(radius), color);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void end(void)
+{
+    f64 start = clock::get_time_s();
+    frame_t& frame = state->frames[state->write_frame];
+    u32 total = 0;
+
+    for (u32 type = 0; type < DEBUG_PRIMITIVE_TYPE_COUNT; type++) {
+        u32 used = state->cursor[type].load(std::memory_order_relaxed);
+        used = used < state->capacity[type] ? used : state->capacity[type];
+
+        // NOTE: the unwritten tails of claimed blocks are drawn too, a zero color makes the shader clip them
+        u32 dropped = 0;
+        for (u32 i = 0; i < DEBUG_DRAW_MAX_THREADS; i++) {
+            thread_t& thread = threads[i];
+            for (u32 hole = thread.next[type]; hole < thread.end[type]; hole++) {
+                state->regions[type][hole] = debug_primitive_t {};
+            }
+
+            dropped += thread.dropped[type];
+            thread.next[type] = 0;
+            thread.end[type] = 0;
+            thread.dropped[type] = 0;
+        }
+
+        frame.count[type] = used;
+        state->dropped[type] = dropped;
+        state->demand[type] = used + dropped;
+        total += used;
+    }
+
+    state->sealed_frame = state->write_frame;
+    begin_frame((state->write_frame + 1) % (u32)state->frames.len);
+
+    state->seal_ms = (clock::get_time_s() - start) * ms_per_s;
+    profiler::record("debug draw primitives", "count", (f64)total);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw(VkCommandBuffer cmd, const glm::mat4& view_projection)
+{
+    if (state->sealed_frame == UINT32_MAX) {
+        return;
+    }
+
+    const frame_t& frame = state->frames[state->sealed_frame];
+    if (frame.count[DEBUG_PRIMITIVE_TYPE_LINE] == 0 && frame.count[DEBUG_PRIMITIVE_TYPE_BOX] == 0
+        && frame.count[DEBUG_PRIMITIVE_TYPE_SPHERE] == 0) {
+        return;
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (vulkan::pipeline_table::resolve(state->pipeline_key, &pipeline) != vulkan::pipeline_table::PIPELINE_STATUS_READY) {
+        return;
+    }
+
+    vulkan::context::begin_label(cmd, "debug draw", { 0, 1, 1, 1 });
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    // NOTE: not instanced, a handful of vertices per instance wastes most of each wave on some hardware
+    for (u32 type = 0; type < DEBUG_PRIMITIVE_TYPE_COUNT; type++) {
+        if (frame.count[type] == 0) {
+            continue;
+        }
+
+        debug_draw_push_constants_t constants {
+            .view_projection = view_projection,
+            .primitives = frame.buffer.address + frame.offset[type],
+            .type = type,
+        };
+
+        vkCmdPushConstants(cmd, state->layout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+        vkCmdDraw(cmd, frame.count[type] * VERTICES_PER_PRIMITIVE[type], 1, 0, 0);
+    }
+
+    vulkan::context::end_label(cmd);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool stress_enabled(void)
+{
+    return state->stress;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void fill_stress(u32 begin, u32 end, void* data)
+{
+    stress_data_t* stress = (stress_data_t*)data;
+
+    for (u32 i = begin; i < end; i++) {
+        u32 seed = i * 5;
+        glm::vec3 origin = glm::vec3(unit_float(hash::mix32(seed)), unit_float(hash::mix32(seed + 1)),
+                               unit_float(hash::mix32(seed + 2)))
+                * 2.0f - 1.0f;
+        u32 bits = hash::mix32(seed + 3);
+        f32 length = 0.005f + unit_float(hash::mix32(seed + 4)) * 0.02f;
+
+        f32 angle = unit_float(bits) * 6.2831853f + stress->time;
+        glm::vec3 direction = glm::vec3(glm::cos(angle), glm::sin(angle * 0.7f), glm::sin(angle)) * length;
+
+        origin *= stress->half_extent;
+        line(origin, origin + direction * stress->half_extent, (bits & 0x00FFFFFFu) | 0xFF000000u);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void stress(const glm::vec3& half_extent)
+{
+    f64 start = clock::get_time_s();
+
+    stress_data_t data {
+        .half_extent = half_extent,
+        .time = (f32)clock::get_time_s(),
+    };
+    jobs::parallel_for((u32)state->stress_count, DEBUG_DRAW_STRESS_BATCH, fill_stress, &data);
+
+    state->fill_ms = (clock::get_time_s() - start) * ms_per_s;
+    profiler::record("debug draw fill", "ms", state->fill_ms);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    ImGui::Checkbox("Stress test", &state->stress);
+    ImGui::SliderInt("Lines", &state->stress_count, 1000, 4000000, "%d", ImGuiSliderFlags_Logarithmic);
+
+    if (state->sealed_frame != UINT32_MAX) {
+        const frame_t& frame = state->frames[state->sealed_frame];
+        for (u32 type = 0; type < DEBUG_PRIMITIVE_TYPE_COUNT; type++) {
+            ImGui::Text("%s: %u of %u, %u dropped", TYPE_NAMES[type], frame.count[type], frame.capacity[type],
+                state->dropped[type]);
+        }
+    }
+
+    ImGui::Text("Fill %.3f ms, seal %.3f ms", state->fill_ms, state->seal_ms);
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "vk/types.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rin::renderer::debug_draw {
+
+constexpr u32 DEBUG_DRAW_INITIAL_CAPACITY = 1 << 14; // per type and frame, buffers grow to the demand
+constexpr u32 DEBUG_DRAW_MAX_CAPACITY = 1 << 22; // per type and frame, further primitives are dropped
+constexpr u32 DEBUG_DRAW_BLOCK_SIZE = 1024; // primitives a thread claims at once, the only shared write
+constexpr u32 DEBUG_DRAW_SPHERE_SEGMENTS = 32; // per circle, mirrors resources/shaders/debug_draw.glsl
+
+enum debug_primitive_type_t {
+    DEBUG_PRIMITIVE_TYPE_LINE,
+    DEBUG_PRIMITIVE_TYPE_BOX,
+    DEBUG_PRIMITIVE_TYPE_SPHERE,
+    DEBUG_PRIMITIVE_TYPE_COUNT,
+};
+
+// NOTE: mirrors resources/shaders/debug_draw.glsl, std430 layout, expanded into line segments by debug_draw.vert
+struct debug_primitive_t {
+    glm::vec3 a; // line start, box min corner, sphere center
+    u32 color; // 0xAABBGGRR, a zero alpha is skipped
+    glm::vec3 b; // line end, box max corner, sphere radii
+    u32 pad;
+};
+
+struct debug_draw_push_constants_t {
+    glm::mat4 view_projection;
+    VkDeviceAddress primitives;
+    u32 type;
+};
+
+// Immediate mode world space debug primitives: pushed every frame they should be seen, drawn once and forgotten.
+// frame_count is the number of frames in flight, one more buffer is kept so the one being written is never in use.
+bool create(vulkan::context_t* context, u32 frame_count, VkFormat color_format, VkFormat depth_format);
+void destroy(void);
+
+// Thread safe without locks from the main thread and the job workers, each writes its own blocks of the mapped
+// buffer directly. Pushes land in the frame of the next end(), which must not run concurrently with them.
+void line(const glm::vec3& a, const glm::vec3& b, u32 color);
+void box(const glm::vec3& min, const glm::vec3& max, u32 color);
+void sphere(const glm::vec3& center, f32 radius, u32 color);
+
+// Seals the primitives pushed so far for draw() and starts the next buffer. Called after the fence wait of the frame.
+void end(void);
+
+// One vkCmdDraw per primitive type, inside a rendering scope with a depth attachment to test against.
+void draw(VkCommandBuffer cmd, const glm::mat4& view_projection);
+
+// Stress benchmark, pushes up to millions of animated lines every frame from the job workers while it is enabled.
+bool stress_enabled(void);
+void stress(const glm::vec3& half_extent);
+void draw_gui(void);
+
+}
@@ -2,6 +2,7 @@
 
 #include "core/logger.hpp"
 #include "systems/window/window.hpp"
+#include "vk/host_memory.hpp"
 
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
@@ -62,7 +63,7 @@ bool initialize(vulkan::context_t* vk_context)
 
     VkResult result = VK_SUCCESS;
 
-    result = vkCreateDescriptorPool(state->device, &pool_info, nullptr, &state->pool);
+    result = vkCreateDescriptorPool(state->device, &pool_info, vulkan::host_memory::callbacks(), &state->pool);
 
     if (result != VK_SUCCESS) {
         log::error("renderer::gui::initialize -> failed to create descriptor pool");
@@ -120,7 +121,7 @@ bool initialize(vulkan::context_t* vk_context)
         .DescriptorPoolSize = 0,
         .UseDynamicRendering = true,
         .PipelineRenderingCreateInfo = rendering_info,
-        .Allocator = nullptr,
+        .Allocator = vulkan::host_memory::callbacks(),
         .CheckVkResultFn = nullptr,
         .MinAllocationSize = 1024 * 1024,
     };
@@ -140,7 +141,7 @@ void shutdown(void)
     ImGui_ImplVulkan_Shutdown();
 
     if (state->pool != VK_NULL_HANDLE) {
-        vkDestroyDescriptorPool(state->device, state->pool, nullptr);
+        vkDestroyDescriptorPool(state->device, state->pool, vulkan::host_memory::callbacks());
     }
 
     window::shutdown_imgui();
@@ -0,0 +1,397 @@
+#include "lights.hpp"
+
+#include "core/clock.hpp"
+#include "core/containers/darray.hpp"
+#include "core/hash.hpp"
+#include "core/jobs.hpp"
+#include "core/logger.hpp"
+#include "core/profiler.hpp"
+#include "vk/context.hpp"
+#include "vk/host_memory.hpp"
+#include "vk/pipeline.hpp"
+#include "vk/pipeline_table.hpp"
+#include "vk/utils.hpp"
+
+#include <cstring>
+#include <glm/gtc/constants.hpp>
+#include <imgui.h>
+
+namespace rin::renderer::lights {
+
+constexpr u32 LIGHTS_DEFAULT_COUNT = 1024;
+constexpr u32 LIGHTS_FILL_BATCH = 1024;
+constexpr f32 LIGHTS_SPOT_OUTER_DEGREES = 30.0f;
+constexpr f32 LIGHTS_SPOT_INNER_DEGREES = 20.0f;
+
+static_assert(sizeof(light_t) == 64, "light_t must match the std430 layout in lights.glsl");
+static_assert(sizeof(light_frame_t) == 144, "light_frame_t must match the std430 layout in lights.glsl");
+
+// NOTE: must match the push constant block declared in light_bin.comp
+struct bin_push_constants_t {
+    VkDeviceAddress frame;
+};
+
+struct frame_resources_t {
+    vulkan::buffer_t frame; // host visible light_frame_t
+    vulkan::buffer_t lights; // host visible, refilled by every bin()
+    vulkan::buffer_t froxels; // (offset, count) per froxel
+    vulkan::buffer_t indices; // LIGHTS_MAX_PER_FROXEL entries per froxel at worst
+    vulkan::buffer_t counters; // light_counters_t, reset by every bin()
+    vulkan::buffer_t readback; // counters copied back for the stats
+};
+
+struct state_t {
+    vulkan::context_t* context;
+    darray<frame_resources_t> frames;
+    VkShaderModule module;
+    VkPipelineLayout layout; // owned by the pipeline table
+    u64 key;
+    VkPipeline pipeline;
+    bool ready; // set by the first bin() that found the pipeline compiled
+    i32 light_count;
+    f32 intensity;
+    bool animate;
+    u32 flags;
+    f64 time_s; // of the animation, frozen while animate is off
+    light_counters_t counters; // of the last frame read back
+    f64 fill_time_s;
+};
+
+struct fill_data_t {
+    light_t* lights;
+    glm::vec3 half_extent;
+    f32 spacing; // average distance between neighbouring lights
+    f32 intensity;
+    f32 time;
+    f32 cos_outer; // of the spot lights
+    f32 sin_outer;
+    f32 cos_inner;
+};
+
+static state_t* state = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static f32 unit_float(u32 x)
+{
+    return (f32)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void fill_lights(u32 begin, u32 end, void* data)
+{
+    fill_data_t* fill = (fill_data_t*)data;
+
+    for (u32 i = begin; i < end; i++) {
+        u32 seed = i * 6;
+        glm::vec3 base {
+            (unit_float(hash::mix32(seed + 0)) * 2.0f - 1.0f) * fill->half_extent.x,
+            (unit_float(hash::mix32(seed + 1)) * 2.0f - 1.0f) * fill->half_extent.y,
+            (unit_float(hash::mix32(seed + 2)) * 2.0f - 1.0f) * fill->half_extent.z,
+        };
+        f32 phase = unit_float(hash::mix32(seed + 3)) * 2.0f * glm::pi<f32>();
+        f32 speed = 0.3f + 0.7f * unit_float(hash::mix32(seed + 4));
+        u32 bits = hash::mix32(seed + 5);
+
+        f32 angle = fill->time * speed + phase;
+        glm::vec3 orbit = glm::vec3(glm::cos(angle), 0.0f, glm::sin(angle)) * (fill->spacing * 0.5f);
+
+        // NOTE: every fourth light is a spot aimed mostly downwards, sweeping around as it orbits
+        bool spot = (i & 3) == 3;
+        f32 range = fill->spacing * (spot ? 3.0f : 1.5f + 1.5f * unit_float(bits));
+        glm::vec3 direction = glm::normalize(glm::vec3(glm::cos(angle) * 0.5f, -1.0f, glm::sin(angle) * 0.5f));
+
+        // NOTE: scaled with the range squared so every light is about as bright halfway through its range
+        glm::vec3 hue = glm::vec3((f32)(bits & 0xFF), (f32)((bits >> 8) & 0xFF), (f32)((bits >> 16) & 0xFF)) / 255.0f;
+        glm::vec3 color = (hue * 0.8f + 0.2f) * (fill->intensity * range * range * 0.25f);
+
+        fill->lights[i] = light_t {
+            .position_range = glm::vec4(base + orbit, range),
+            .color = glm::vec4(color, 1.0f),
+            .direction = glm::vec4(direction, 0.0f),
+            .cos_outer = spot ? fill->cos_outer : -1.0f,
+            .sin_outer = spot ? fill->sin_outer : 0.0f,
+            .cos_inner = spot ? fill->cos_inner : -1.0f,
+            .type = spot ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT,
+        };
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(vulkan::context_t* context, u32 frame_count)
+{
+    if (state != nullptr) {
+        log::error("lights::create -> lights have been already created");
+        return false;
+    }
+
+    state = (state_t*)calloc(1, sizeof(state_t));
+    state->context = context;
+    state->frames = darray<frame_resources_t> { frame_count, true };
+    state->frames.len = frame_count;
+    state->light_count = LIGHTS_DEFAULT_COUNT;
+    state->intensity = 1.0f;
+    state->animate = true;
+
+    for (u32 i = 0; i < frame_count; i++) {
+        frame_resources_t& frame = state->frames[i];
+
+        vulkan::buffer_create_info_t frame_info {
+            .size = sizeof(light_frame_t),
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = false,
+            .tag = vulkan::MEMORY_TAG_LIGHTS,
+        };
+
+        vulkan::buffer_create_info_t lights_info {
+            .size = sizeof(light_t) * LIGHTS_MAX_LIGHTS,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = false,
+            .tag = vulkan::MEMORY_TAG_LIGHTS,
+        };
+
+        vulkan::buffer_create_info_t froxels_info {
+            .size = sizeof(u32) * 2 * LIGHTS_FROXEL_COUNT,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = true,
+            .tag = vulkan::MEMORY_TAG_LIGHTS,
+        };
+
+        vulkan::buffer_create_info_t indices_info {
+            .size = sizeof(u32) * LIGHTS_MAX_PER_FROXEL * LIGHTS_FROXEL_COUNT,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = true,
+            .tag = vulkan::MEMORY_TAG_LIGHTS,
+        };
+
+        vulkan::buffer_create_info_t counters_info {
+            .size = sizeof(light_counters_t),
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = true,
+            .tag = vulkan::MEMORY_TAG_LIGHTS,
+        };
+
+        vulkan::buffer_create_info_t readback_info {
+            .size = sizeof(light_counters_t),
+            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = false,
+            .tag = vulkan::MEMORY_TAG_LIGHTS,
+        };
+
+        if (!vulkan::context::allocate_buffer(frame_info, &frame.frame)
+            || !vulkan::context::allocate_buffer(lights_info, &frame.lights)
+            || !vulkan::context::allocate_buffer(froxels_info, &frame.froxels)
+            || !vulkan::context::allocate_buffer(indices_info, &frame.indices)
+            || !vulkan::context::allocate_buffer(counters_info, &frame.counters)
+            || !vulkan::context::allocate_buffer(readback_info, &frame.readback)) {
+            log::error("lights::create -> failed to allocate frame buffers");
+            destroy();
+            return false;
+        }
+
+        // NOTE: a zero light count keeps fragments away from the grid until the first bin() of the slot
+        memset(frame.frame.allocation_info.pMappedData, 0, sizeof(light_frame_t));
+        memset(frame.readback.allocation_info.pMappedData, 0, sizeof(light_counters_t));
+        vmaFlushAllocation(context->vma, frame.readback.memory, 0, VK_WHOLE_SIZE);
+    }
+
+    VkDevice device = context->device->logical_device;
+    vulkan::reflection::shader_reflection_t reflection {};
+    if (!vulkan::utils::load_shader_module(device, "resources/shaders/light_bin.comp.spv", &state->module, &reflection)) {
+        log::error("lights::create -> failed to load shader module");
+        destroy();
+        return false;
+    }
+
+    const vulkan::reflection::shader_reflection_t* stages[] = { &reflection };
+    if (!vulkan::pipeline_table::get_layout(stages, 1, &state->layout)) {
+        log::error("lights::create -> failed to create pipeline layout");
+        destroy();
+        return false;
+    }
+
+    vulkan::pipeline_builder_t builder {};
+    builder
+        .set_compute_shader(state->module)
+        .set_layout(state->layout);
+    state->key = vulkan::pipeline_table::request(builder);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(void)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    VkDevice device = state->context->device->logical_device;
+    vkDeviceWaitIdle(device);
+
+    if (state->module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, state->module, vulkan::host_memory::callbacks());
+    }
+
+    for (size_t i = 0; i < state->frames.len; i++) {
+        vulkan::context::destroy_buffer(&state->frames[i].frame);
+        vulkan::context::destroy_buffer(&state->frames[i].lights);
+        vulkan::context::destroy_buffer(&state->frames[i].froxels);
+        vulkan::context::destroy_buffer(&state->frames[i].indices);
+        vulkan::context::destroy_buffer(&state->frames[i].counters);
+        vulkan::context::destroy_buffer(&state->frames[i].readback);
+    }
+    state->frames.~darray();
+
+    free(state);
+    state = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void memory_barrier(VkCommandBuffer cmd, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access,
+    VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access)
+{
+    VkMemoryBarrier2 barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = src_stage,
+        .srcAccessMask = src_access,
+        .dstStageMask = dst_stage,
+        .dstAccessMask = dst_access,
+    };
+
+    VkDependencyInfo dep {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = nullptr,
+        .imageMemoryBarrierCount = 0,
+        .pImageMemoryBarriers = nullptr,
+    };
+    vkCmdPipelineBarrier2(cmd, &dep);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void bin(VkCommandBuffer cmd, u32 frame_index, const camera::camera_t& camera, VkExtent2D extent, const glm::vec3& half_extent)
+{
+    frame_resources_t& frame = state->frames[frame_index];
+    light_frame_t* data = (light_frame_t*)frame.frame.allocation_info.pMappedData;
+
+    if (!state->ready) {
+        state->ready = vulkan::pipeline_table::resolve(state->key, &state->pipeline) == vulkan::pipeline_table::PIPELINE_STATUS_READY;
+    }
+
+    if (!state->ready || state->light_count == 0) {
+        data->light_count = 0;
+        return;
+    }
+
+    // NOTE: the fence of this frame slot has been waited on, so the counters from its last use are final, readback
+    // memory may be cached and is only up to date after an invalidate
+    vmaInvalidateAllocation(state->context->vma, frame.readback.memory, 0, VK_WHOLE_SIZE);
+    state->counters = *(light_counters_t*)frame.readback.allocation_info.pMappedData;
+
+    if (state->animate) {
+        state->time_s = clock::get_time_s();
+    }
+
+    f64 start = clock::get_time_s();
+    u32 count = (u32)state->light_count;
+    glm::vec3 size = glm::max(half_extent, glm::vec3(0.5f));
+    fill_data_t fill {
+        .lights = (light_t*)frame.lights.allocation_info.pMappedData,
+        .half_extent = size,
+        .spacing = glm::pow(8.0f * size.x * size.y * size.z / (f32)count, 1.0f / 3.0f),
+        .intensity = state->intensity,
+        .time = (f32)state->time_s,
+        .cos_outer = glm::cos(glm::radians(LIGHTS_SPOT_OUTER_DEGREES)),
+        .sin_outer = glm::sin(glm::radians(LIGHTS_SPOT_OUTER_DEGREES)),
+        .cos_inner = glm::cos(glm::radians(LIGHTS_SPOT_INNER_DEGREES)),
+    };
+    jobs::parallel_for(count, LIGHTS_FILL_BATCH, fill_lights, &fill);
+    state->fill_time_s = clock::get_time_s() - start;
+
+    f32 tan_y = glm::tan(camera.fov_y * 0.5f);
+    f32 log_ratio = glm::log(camera.z_far / camera.z_near);
+
+    *data = light_frame_t {
+        .view = camera::view(camera),
+        .lights = frame.lights.address,
+        .froxels = frame.froxels.address,
+        .indices = frame.indices.address,
+        .counters = frame.counters.address,
+        .tan_half_fov = glm::vec2(tan_y * (f32)extent.width / (f32)extent.height, tan_y),
+        .tile_size = glm::vec2((f32)extent.width / (f32)LIGHTS_GRID_X, (f32)extent.height / (f32)LIGHTS_GRID_Y),
+        .z_near = camera.z_near,
+        .z_far = camera.z_far,
+        .slice_scale = (f32)LIGHTS_GRID_Z / log_ratio,
+        .slice_bias = -(f32)LIGHTS_GRID_Z * glm::log(camera.z_near) / log_ratio,
+        .light_count = count,
+        .flags = state->flags,
+        .pad = { 0, 0 },
+    };
+
+    vulkan::context::begin_label(cmd, "light binning", { 1, 0.5f, 0, 1 });
+
+    // NOTE: the last use of this slot is over, only the previous frame may still read its own grid
+    vkCmdFillBuffer(cmd, frame.counters.handle, 0, sizeof(light_counters_t), 0);
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+    bin_push_constants_t constants {
+        .frame = frame.frame.address,
+    };
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, state->pipeline);
+    vkCmdPushConstants(cmd, state->layout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+    vkCmdDispatch(cmd, (LIGHTS_FROXEL_COUNT + LIGHTS_BIN_GROUP_SIZE - 1) / LIGHTS_BIN_GROUP_SIZE, 1, 1);
+
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT,
+        VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
+
+    VkBufferCopy region {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = sizeof(light_counters_t),
+    };
+    vkCmdCopyBuffer(cmd, frame.counters.handle, frame.readback.handle, 1, &region);
+
+    vulkan::context::end_label(cmd);
+
+    profiler::record("lights fill", "ms", state->fill_time_s * ms_per_s);
+    profiler::record("lights binned", "entries", (f64)state->counters.indices);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+VkDeviceAddress frame_address(u32 frame)
+{
+    return state->frames[frame].frame.address;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    ImGui::SliderInt("Lights", &state->light_count, 0, LIGHTS_MAX_LIGHTS);
+    ImGui::SliderFloat("Intensity", &state->intensity, 0.1f, 4.0f);
+    ImGui::Checkbox("Animate##lights", &state->animate);
+    ImGui::CheckboxFlags("Froxel heatmap", &state->flags, LIGHTS_FLAG_HEATMAP);
+
+    ImGui::Text("Grid: %ux%ux%u froxels, up to %u lights each", LIGHTS_GRID_X, LIGHTS_GRID_Y, LIGHTS_GRID_Z,
+        LIGHTS_MAX_PER_FROXEL);
+    ImGui::Text("Binned: %u entries, %.1f lights per froxel on average", state->counters.indices,
+        (f64)state->counters.indices / (f64)LIGHTS_FROXEL_COUNT);
+    if (state->counters.truncated > 0) {
+        ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "Over capacity: %u froxels dropped lights", state->counters.truncated);
+    }
+    ImGui::Text("CPU fill: %.3f ms", state->fill_time_s * ms_per_s);
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "camera.hpp"
+#include "vk/types.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rin::renderer::lights {
+
+// NOTE: must match the constants in lights.glsl
+constexpr u32 LIGHTS_GRID_X = 16; // froxel columns across the target
+constexpr u32 LIGHTS_GRID_Y = 9;
+constexpr u32 LIGHTS_GRID_Z = 24; // exponential depth slices between the near and far planes
+constexpr u32 LIGHTS_FROXEL_COUNT = LIGHTS_GRID_X * LIGHTS_GRID_Y * LIGHTS_GRID_Z;
+constexpr u32 LIGHTS_MAX_PER_FROXEL = 64; // bounds the per fragment cost, extra lights are dropped and counted
+constexpr u32 LIGHTS_MAX_LIGHTS = 1 << 13;
+constexpr u32 LIGHTS_BIN_GROUP_SIZE = 64; // local_size_x in light_bin.comp
+
+// NOTE: must match the LIGHT_TYPE constants in lights.glsl
+enum light_type_t {
+    LIGHT_TYPE_POINT,
+    LIGHT_TYPE_SPOT,
+};
+
+// NOTE: must match the LIGHTS_FLAG bits in lights.glsl
+enum lights_flag_t {
+    LIGHTS_FLAG_HEATMAP = 1 << 0, // shades every fragment by the light count of its froxel
+};
+
+// NOTE: the structs below mirror resources/shaders/lights.glsl, std430 layout
+struct light_t {
+    glm::vec4 position_range; // xyz world position, w distance where the contribution reaches zero
+    glm::vec4 color; // rgb premultiplied by the intensity
+    glm::vec4 direction; // xyz spot axis
+    f32 cos_outer;
+    f32 sin_outer;
+    f32 cos_inner;
+    u32 type; // light_type_t
+};
+
+struct light_frame_t {
+    glm::mat4 view;
+    VkDeviceAddress lights;
+    VkDeviceAddress froxels; // (offset into indices, light count) per froxel
+    VkDeviceAddress indices; // light lists of every froxel back to back
+    VkDeviceAddress counters; // light_counters_t
+    glm::vec2 tan_half_fov; // x and y
+    glm::vec2 tile_size; // froxel footprint in pixels
+    f32 z_near;
+    f32 z_far;
+    f32 slice_scale; // slice = log(view depth) * slice_scale + slice_bias
+    f32 slice_bias;
+    u32 light_count; // 0 until the grid has been binned once, fragments then skip the lookup
+    u32 flags; // lights_flag_t
+    u32 pad[2];
+};
+
+struct light_counters_t {
+    u32 indices; // entries reserved in the light lists
+    u32 truncated; // froxels that touched more than LIGHTS_MAX_PER_FROXEL lights
+};
+
+bool create(vulkan::context_t* context, u32 frame_count);
+void destroy(void);
+
+// Animates the lights over the box the scene covers, centered on the origin, and bins them into the froxel grid of
+// the camera. Records outside of any rendering scope, the lists are visible to fragment shaders afterwards.
+void bin(VkCommandBuffer cmd, u32 frame, const camera::camera_t& camera, VkExtent2D extent, const glm::vec3& half_extent);
+
+// Handed to the scene and clusters draws as the first push constant, valid even before bin() has run.
+VkDeviceAddress frame_address(u32 frame);
+
+void draw_gui(void);
+
+}
@@ -0,0 +1,120 @@
+#include "mesh.hpp"
+
+#include "core/containers/darray.hpp"
+#include "core/logger.hpp"
+#include "mesh_optimizer.hpp"
+#include "vk/context.hpp"
+
+#include <cstring>
+
+namespace rin::renderer::mesh {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+VkIndexType index_type(u32 vertex_count)
+{
+    return vertex_count <= 0x10000 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 index_size(VkIndexType type)
+{
+    return type == VK_INDEX_TYPE_UINT16 ? sizeof(u16) : sizeof(u32);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void write_indices(VkIndexType type, const u32* indices, u32 count, void* out)
+{
+    if (type == VK_INDEX_TYPE_UINT32) {
+        memcpy(out, indices, sizeof(u32) * count);
+        return;
+    }
+
+    u16* narrow = (u16*)out;
+    for (u32 i = 0; i < count; i++) {
+        narrow[i] = (u16)indices[i];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool import(const char* name, const void* vertices, u32 vertex_count, u32 stride, gpu_mesh_t* out)
+{
+    darray<u8> unique { (u64)vertex_count * stride, false };
+    darray<u32> indices { vertex_count, false };
+
+    u32 unique_count = mesh_optimizer::deduplicate(vertices, vertex_count, stride, unique.data, indices.data);
+    mesh_optimizer::cache_stats_t before = mesh_optimizer::analyze_vertex_cache(
+        indices.data, vertex_count, unique_count, mesh_optimizer::MESH_OPTIMIZER_FIFO_SIZE);
+
+    mesh_optimizer::optimize_vertex_cache(indices.data, vertex_count, unique_count);
+    unique_count = mesh_optimizer::optimize_vertex_fetch(unique.data, indices.data, vertex_count, unique_count, stride);
+
+    mesh_optimizer::cache_stats_t after = mesh_optimizer::analyze_vertex_cache(
+        indices.data, vertex_count, unique_count, mesh_optimizer::MESH_OPTIMIZER_FIFO_SIZE);
+
+    log::info("mesh %s: %u -> %u vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+        name, vertex_count, unique_count, before.acmr, after.acmr, before.atvr, after.atvr);
+
+    return create(unique.data, unique_count, stride, indices.data, vertex_count, out);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(const void* vertices, u32 vertex_count, u32 stride, const u32* indices, u32 index_count, gpu_mesh_t* out)
+{
+    out->index_type = index_type(vertex_count);
+    out->index_count = index_count;
+    out->vertex_count = vertex_count;
+
+    u64 index_bytes = (u64)index_count * index_size(out->index_type);
+    darray<u8> packed { index_bytes, false };
+    write_indices(out->index_type, indices, index_count, packed.data);
+
+    vulkan::buffer_create_info_t vertex_info {
+        .size = (u64)vertex_count * stride,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = true,
+        .tag = vulkan::MEMORY_TAG_GEOMETRY,
+    };
+
+    vulkan::buffer_create_info_t index_info {
+        .size = index_bytes,
+        .usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = true,
+        .tag = vulkan::MEMORY_TAG_GEOMETRY,
+    };
+
+    if (!vulkan::context::allocate_buffer(vertex_info, &out->vertices)
+        || !vulkan::context::allocate_buffer(index_info, &out->indices)) {
+        log::error("mesh::create -> failed to allocate mesh buffers");
+        destroy(out);
+        return false;
+    }
+
+    if (!vulkan::context::upload_buffer(out->vertices, 0, vertices, vertex_info.size)
+        || !vulkan::context::upload_buffer(out->indices, 0, packed.data, index_bytes)) {
+        log::error("mesh::create -> failed to upload mesh data");
+        destroy(out);
+        return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(gpu_mesh_t* mesh)
+{
+    vulkan::context::destroy_buffer(&mesh->vertices);
+    vulkan::context::destroy_buffer(&mesh->indices);
+    mesh->index_count = 0;
+    mesh->vertex_count = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw(VkCommandBuffer cmd, const gpu_mesh_t& mesh, u32 instance_count)
+{
+    vkCmdBindIndexBuffer(cmd, mesh.indices.handle, 0, mesh.index_type);
+    vkCmdDrawIndexed(cmd, mesh.index_count, instance_count, 0, 0, 0);
+}
+
+}
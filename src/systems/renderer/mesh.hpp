@@ -0,0 +1,34 @@
+#pragma once
+
+#include "vk/types.hpp"
+
+namespace rin::renderer::mesh {
+
+// Indexed geometry in device local memory, vertices are pulled by the shaders through their address
+struct gpu_mesh_t {
+    vulkan::buffer_t vertices;
+    vulkan::buffer_t indices;
+    VkIndexType index_type;
+    u32 index_count;
+    u32 vertex_count;
+};
+
+// 16 bit indices whenever every vertex is reachable with them, 32 bit otherwise
+VkIndexType index_type(u32 vertex_count);
+u32 index_size(VkIndexType type);
+
+// Narrows indices to type into out, which must hold count * index_size(type) bytes.
+void write_indices(VkIndexType type, const u32* indices, u32 count, void* out);
+
+// Import time path for an unindexed triangle list: deduplicates the vertices, optimizes the triangle and
+// vertex order with mesh_optimizer, logs ACMR before and after, then uploads the result.
+bool import(const char* name, const void* vertices, u32 vertex_count, u32 stride, gpu_mesh_t* out);
+
+// Uploads already indexed geometry as is.
+bool create(const void* vertices, u32 vertex_count, u32 stride, const u32* indices, u32 index_count, gpu_mesh_t* out);
+void destroy(gpu_mesh_t* mesh);
+
+// Binds the index buffer and draws every index, the pipeline and vertex address push constants are up to the caller.
+void draw(VkCommandBuffer cmd, const gpu_mesh_t& mesh, u32 instance_count);
+
+}
@@ -0,0 +1,254 @@
+#include "mesh_optimizer.hpp"
+
+#include "core/containers/darray.hpp"
+#include "core/hash.hpp"
+
+#include <cmath>
+#include <cstring>
+
+namespace rin::renderer::mesh_optimizer {
+
+constexpr u32 INVALID_INDEX = ~0u;
+
+// NOTE: scoring constants from Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+constexpr f32 CACHE_DECAY_POWER = 1.5f;
+constexpr f32 LAST_TRIANGLE_SCORE = 0.75f;
+constexpr f32 VALENCE_BOOST_SCALE = 2.0f;
+constexpr f32 VALENCE_BOOST_POWER = 0.5f;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 deduplicate(const void* vertices, u32 vertex_count, u32 stride, void* out_vertices, u32* out_indices)
+{
+    const u8* src = (const u8*)vertices;
+    u8* dst = (u8*)out_vertices;
+
+    // NOTE: open addressing on the full vertex bytes, a power of two at least twice the vertex count
+    u32 table_size = 16;
+    while (table_size < vertex_count * 2) {
+        table_size *= 2;
+    }
+
+    darray<u32> table { table_size, false };
+    table.len = table_size;
+    memset(table.data, 0xFF, sizeof(u32) * table_size);
+
+    u32 unique_count = 0;
+    for (u32 i = 0; i < vertex_count; i++) {
+        const u8* vertex = src + (u64)i * stride;
+        u32 slot = (u32)hash::fnv1a(vertex, stride) & (table_size - 1);
+
+        while (table[slot] != INVALID_INDEX && memcmp(dst + (u64)table[slot] * stride, vertex, stride) != 0) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        if (table[slot] == INVALID_INDEX) {
+            memcpy(dst + (u64)unique_count * stride, vertex, stride);
+            table[slot] = unique_count++;
+        }
+
+        out_indices[i] = table[slot];
+    }
+
+    return unique_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static f32 vertex_score(const f32* cache_scores, i32 cache_position, u32 remaining)
+{
+    if (remaining == 0) {
+        return -1.0f;
+    }
+
+    f32 score = cache_position < 0 ? 0.0f : cache_scores[cache_position];
+    return score + VALENCE_BOOST_SCALE * powf((f32)remaining, -VALENCE_BOOST_POWER);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void optimize_vertex_cache(u32* indices, u32 index_count, u32 vertex_count)
+{
+    const u32 triangle_count = index_count / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // NOTE: the three vertices of the last triangle score the same, whatever order they were pushed in
+    f32 cache_scores[MESH_OPTIMIZER_CACHE_SIZE];
+    for (u32 i = 0; i < MESH_OPTIMIZER_CACHE_SIZE; i++) {
+        if (i < 3) {
+            cache_scores[i] = LAST_TRIANGLE_SCORE;
+        } else {
+            f32 scaler = 1.0f - (f32)(i - 3) / (f32)(MESH_OPTIMIZER_CACHE_SIZE - 3);
+            cache_scores[i] = powf(scaler, CACHE_DECAY_POWER);
+        }
+    }
+
+    // NOTE: per vertex list of the triangles still to emit, emitted ones are swapped past remaining[v]
+    darray<u32> remaining { vertex_count, true };
+    darray<u32> offsets { vertex_count, false };
+    darray<u32> adjacency { index_count, false };
+    darray<i32> cache_position { vertex_count, false };
+    darray<f32> scores { vertex_count, false };
+    darray<f32> triangle_scores { triangle_count, false };
+    darray<u8> emitted { triangle_count, true };
+
+    for (u32 i = 0; i < index_count; i++) {
+        remaining[indices[i]]++;
+    }
+
+    u32 offset = 0;
+    for (u32 v = 0; v < vertex_count; v++) {
+        offsets[v] = offset;
+        offset += remaining[v];
+        remaining[v] = 0;
+        cache_position[v] = -1;
+    }
+
+    for (u32 t = 0; t < triangle_count; t++) {
+        for (u32 k = 0; k < 3; k++) {
+            u32 v = indices[t * 3 + k];
+            adjacency[offsets[v] + remaining[v]++] = t;
+        }
+    }
+
+    for (u32 v = 0; v < vertex_count; v++) {
+        scores[v] = vertex_score(cache_scores, -1, remaining[v]);
+    }
+
+    u32 best = 0;
+    for (u32 t = 0; t < triangle_count; t++) {
+        const u32* tri = indices + t * 3;
+        triangle_scores[t] = scores[tri[0]] + scores[tri[1]] + scores[tri[2]];
+        if (triangle_scores[t] > triangle_scores[best]) {
+            best = t;
+        }
+    }
+
+    darray<u32> output { index_count, false };
+    u32 cache[MESH_OPTIMIZER_CACHE_SIZE + 3];
+    u32 next_cache[MESH_OPTIMIZER_CACHE_SIZE + 3];
+    u32 cache_count = 0;
+    u32 cursor = 0; // first triangle that may not be emitted yet, for when the cache has no candidate
+
+    for (u32 emitted_count = 0; emitted_count < triangle_count; emitted_count++) {
+        if (best == INVALID_INDEX) {
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        const u32* tri = indices + best * 3;
+        memcpy(output.data + emitted_count * 3, tri, sizeof(u32) * 3);
+        emitted[best] = 1;
+
+        u32 next_count = 0;
+        for (u32 k = 0; k < 3; k++) {
+            u32 v = tri[k];
+
+            u32* list = adjacency.data + offsets[v];
+            for (u32 j = 0; j < remaining[v]; j++) {
+                if (list[j] == best) {
+                    list[j] = list[remaining[v] - 1];
+                    list[remaining[v] - 1] = best;
+                    break;
+                }
+            }
+            remaining[v]--;
+            next_cache[next_count++] = v;
+        }
+
+        for (u32 i = 0; i < cache_count; i++) {
+            u32 v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                next_cache[next_count++] = v;
+            }
+        }
+
+        // NOTE: vertices pushed past the cache size fall out, their score drops to the valence term only
+        for (u32 i = MESH_OPTIMIZER_CACHE_SIZE; i < next_count; i++) {
+            u32 v = next_cache[i];
+            cache_position[v] = -1;
+            scores[v] = vertex_score(cache_scores, -1, remaining[v]);
+        }
+
+        cache_count = next_count < MESH_OPTIMIZER_CACHE_SIZE ? next_count : MESH_OPTIMIZER_CACHE_SIZE;
+        for (u32 i = 0; i < cache_count; i++) {
+            u32 v = next_cache[i];
+            cache[i] = v;
+            cache_position[v] = (i32)i;
+            scores[v] = vertex_score(cache_scores, (i32)i, remaining[v]);
+        }
+
+        // NOTE: only triangles touching the cache are candidates, the rest keeps its stale score until it does
+        best = INVALID_INDEX;
+        f32 best_score = -1.0f;
+        for (u32 i = 0; i < next_count; i++) {
+            u32 v = next_cache[i];
+            const u32* list = adjacency.data + offsets[v];
+
+            for (u32 j = 0; j < remaining[v]; j++) {
+                u32 t = list[j];
+                const u32* candidate = indices + t * 3;
+                triangle_scores[t] = scores[candidate[0]] + scores[candidate[1]] + scores[candidate[2]];
+
+                if (i < cache_count && triangle_scores[t] > best_score) {
+                    best_score = triangle_scores[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output.data, sizeof(u32) * index_count);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 optimize_vertex_fetch(void* vertices, u32* indices, u32 index_count, u32 vertex_count, u32 stride)
+{
+    u8* data = (u8*)vertices;
+
+    darray<u32> remap { vertex_count, false };
+    remap.len = vertex_count;
+    memset(remap.data, 0xFF, sizeof(u32) * vertex_count);
+
+    darray<u8> reordered { (u64)vertex_count * stride, false };
+
+    u32 next = 0;
+    for (u32 i = 0; i < index_count; i++) {
+        u32 v = indices[i];
+        if (remap[v] == INVALID_INDEX) {
+            remap[v] = next;
+            memcpy(reordered.data + (u64)next * stride, data + (u64)v * stride, stride);
+            next++;
+        }
+        indices[i] = remap[v];
+    }
+
+    memcpy(data, reordered.data, (u64)next * stride);
+    return next;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+cache_stats_t analyze_vertex_cache(const u32* indices, u32 index_count, u32 vertex_count, u32 cache_size)
+{
+    // NOTE: a vertex is still in the FIFO if fewer than cache_size misses happened since it was loaded
+    darray<u32> loaded_at { vertex_count, true };
+    u32 timestamp = cache_size + 1;
+    u32 misses = 0;
+
+    for (u32 i = 0; i < index_count; i++) {
+        u32 v = indices[i];
+        if (timestamp - loaded_at[v] > cache_size) {
+            loaded_at[v] = timestamp++;
+            misses++;
+        }
+    }
+
+    u32 triangle_count = index_count / 3;
+    return cache_stats_t {
+        .acmr = triangle_count == 0 ? 0.0f : (f32)misses / (f32)triangle_count,
+        .atvr = vertex_count == 0 ? 0.0f : (f32)misses / (f32)vertex_count,
+    };
+}
+
+}
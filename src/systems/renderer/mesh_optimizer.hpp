@@ -0,0 +1,30 @@
+#pragma once
+
+#include "core/defines.hpp"
+
+namespace rin::renderer::mesh_optimizer {
+
+constexpr u32 MESH_OPTIMIZER_CACHE_SIZE = 32; // LRU size the triangle order is optimized for
+constexpr u32 MESH_OPTIMIZER_FIFO_SIZE = 16; // FIFO size used to measure it, close to real post-transform caches
+
+struct cache_stats_t {
+    f32 acmr; // vertex shader invocations per triangle, 0.5 is the ideal for a large regular grid
+    f32 atvr; // vertex shader invocations per vertex, 1.0 is the ideal
+};
+
+// Builds an index buffer from a triangle list of vertex_count vertices, merging byte identical vertices.
+// Writes the unique vertices to out_vertices (vertex_count * stride bytes is always enough) and
+// vertex_count indices to out_indices, returns the unique vertex count.
+u32 deduplicate(const void* vertices, u32 vertex_count, u32 stride, void* out_vertices, u32* out_indices);
+
+// Reorders triangles in place so consecutive triangles reuse recently transformed vertices (Forsyth).
+void optimize_vertex_cache(u32* indices, u32 index_count, u32 vertex_count);
+
+// Reorders vertices in place in the order the indices first reference them and rewrites the indices,
+// unreferenced vertices are dropped. Run it after optimize_vertex_cache, returns the new vertex count.
+u32 optimize_vertex_fetch(void* vertices, u32* indices, u32 index_count, u32 vertex_count, u32 stride);
+
+// Simulates a FIFO post-transform cache of cache_size entries over the triangle list.
+cache_stats_t analyze_vertex_cache(const u32* indices, u32 index_count, u32 vertex_count, u32 cache_size);
+
+}
@@ -0,0 +1,222 @@
+#include "meshlet.hpp"
+
+#include <cstring>
+
+namespace rin::renderer::meshlet {
+
+constexpr u8 UNUSED_VERTEX = 0xFF;
+constexpr u32 INVALID_TRIANGLE = ~0u;
+
+// NOTE: past ~84 degrees between the axis and a normal the cone is almost a half space, it would never cull
+constexpr f32 MIN_CONE_COSINE = 0.1f;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void compute_bounds(meshlet_t& meshlet, const meshlet_data_t& data, const vertex_format::vertex_attributes_t* vertices)
+{
+    const u32* local = data.vertices.data + meshlet.vertex_offset;
+    const u8* triangles = data.triangles.data + meshlet.triangle_offset;
+
+    glm::vec3 center = glm::vec3(0.0f);
+    for (u32 i = 0; i < meshlet.vertex_count; i++) {
+        center += vertices[local[i]].position;
+    }
+    center /= (f32)meshlet.vertex_count;
+
+    f32 radius = 0.0f;
+    for (u32 i = 0; i < meshlet.vertex_count; i++) {
+        radius = glm::max(radius, glm::length(vertices[local[i]].position - center));
+    }
+    meshlet.sphere = glm::vec4(center, radius);
+
+    // NOTE: the axis averages the triangle normals, the cutoff comes from the normal furthest away from it
+    glm::vec3 normals[MESHLET_MAX_TRIANGLES];
+    glm::vec3 axis = glm::vec3(0.0f);
+    for (u32 t = 0; t < meshlet.triangle_count; t++) {
+        glm::vec3 a = vertices[local[triangles[t * 3 + 0]]].position;
+        glm::vec3 b = vertices[local[triangles[t * 3 + 1]]].position;
+        glm::vec3 c = vertices[local[triangles[t * 3 + 2]]].position;
+
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        f32 area = glm::length(normal);
+        normals[t] = area > 0.0f ? normal / area : glm::vec3(0.0f);
+        axis += normals[t];
+    }
+
+    meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    f32 axis_length = glm::length(axis);
+    if (axis_length == 0.0f) {
+        return;
+    }
+    axis /= axis_length;
+
+    f32 min_cosine = 1.0f;
+    for (u32 t = 0; t < meshlet.triangle_count; t++) {
+        // NOTE: degenerate triangles are never rasterized, they don't widen the cone
+        if (normals[t] != glm::vec3(0.0f)) {
+            min_cosine = glm::min(min_cosine, glm::dot(normals[t], axis));
+        }
+    }
+
+    if (min_cosine <= MIN_CONE_COSINE) {
+        return;
+    }
+
+    // NOTE: every normal is within acos(min_cosine) of the axis, so they all face away from a viewer whose
+    // direction is within 90 degrees minus that of the axis, whose cosine is the sine of the spread
+    meshlet.cone = glm::vec4(axis, glm::sqrt(1.0f - min_cosine * min_cosine));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void finish_meshlet(meshlet_t& meshlet, const vertex_format::vertex_attributes_t* vertices, darray<u8>& local,
+    meshlet_data_t* out)
+{
+    // NOTE: keeps the next triangle_offset aligned so shaders can read the indices as whole words
+    while (out->triangles.len % 4 != 0) {
+        out->triangles.push(0);
+    }
+
+    compute_bounds(meshlet, *out, vertices);
+    out->meshlets.push(meshlet);
+
+    for (u32 i = 0; i < meshlet.vertex_count; i++) {
+        local[out->vertices[meshlet.vertex_offset + i]] = UNUSED_VERTEX;
+    }
+
+    meshlet = meshlet_t {
+        .sphere = glm::vec4(0.0f),
+        .cone = glm::vec4(0.0f),
+        .vertex_offset = (u32)out->vertices.len,
+        .triangle_offset = (u32)out->triangles.len,
+        .vertex_count = 0,
+        .triangle_count = 0,
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 added_vertices(const u32* triangle, const darray<u8>& local)
+{
+    u32 added = 0;
+    for (u32 k = 0; k < 3; k++) {
+        bool present = local[triangle[k]] != UNUSED_VERTEX;
+        for (u32 j = 0; j < k; j++) {
+            present |= triangle[j] == triangle[k];
+        }
+        added += present ? 0 : 1;
+    }
+    return added;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void build(const u32* indices, u32 index_count, const vertex_format::vertex_attributes_t* vertices, u32 vertex_count,
+    meshlet_data_t* out)
+{
+    const u32 triangle_count = index_count / 3;
+
+    // NOTE: triangles around every vertex, laid out like in mesh_optimizer::optimize_vertex_cache
+    darray<u32> offsets { (u64)vertex_count + 1, true };
+    darray<u32> adjacency { (u64)triangle_count * 3, false };
+    darray<u8> emitted { triangle_count, true };
+
+    for (u32 i = 0; i < triangle_count * 3; i++) {
+        offsets[indices[i] + 1]++;
+    }
+    for (u32 v = 0; v < vertex_count; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+    for (u32 i = 0; i < triangle_count * 3; i++) {
+        adjacency[offsets[indices[i]]++] = i / 3;
+    }
+    for (u32 v = vertex_count; v > 0; v--) {
+        offsets[v] = offsets[v - 1];
+    }
+    offsets[0] = 0;
+
+    // NOTE: local index of every mesh vertex in the meshlet being filled, UNUSED_VERTEX when it isn't part of it
+    darray<u8> local { vertex_count, false };
+    local.len = vertex_count;
+    memset(local.data, UNUSED_VERTEX, vertex_count);
+
+    meshlet_t meshlet {
+        .sphere = glm::vec4(0.0f),
+        .cone = glm::vec4(0.0f),
+        .vertex_offset = (u32)out->vertices.len,
+        .triangle_offset = (u32)out->triangles.len,
+        .vertex_count = 0,
+        .triangle_count = 0,
+    };
+    glm::vec3 position_sum = glm::vec3(0.0f);
+    u32 cursor = 0; // seeds go in index order, the first triangle that may not be emitted yet
+
+    for (u32 emitted_count = 0; emitted_count < triangle_count; emitted_count++) {
+        // NOTE: grows from the triangles sharing a vertex with the meshlet, the fewest new vertices first
+        // and then the closest to its center, which keeps meshlets round and their normal cones tight
+        u32 best = INVALID_TRIANGLE;
+        u32 best_added = 4;
+        f32 best_distance = 0.0f;
+        glm::vec3 center = position_sum / (f32)glm::max(meshlet.vertex_count, 1u);
+
+        for (u32 i = 0; i < meshlet.vertex_count; i++) {
+            u32 v = out->vertices[meshlet.vertex_offset + i];
+
+            for (u32 j = offsets[v]; j < offsets[v + 1]; j++) {
+                u32 t = adjacency[j];
+                if (emitted[t]) {
+                    continue;
+                }
+
+                const u32* triangle = indices + t * 3;
+                u32 added = added_vertices(triangle, local);
+                if (added > best_added) {
+                    continue;
+                }
+
+                glm::vec3 centroid = (vertices[triangle[0]].position + vertices[triangle[1]].position
+                    + vertices[triangle[2]].position) / 3.0f;
+                f32 distance = glm::length(centroid - center);
+
+                if (added < best_added || distance < best_distance) {
+                    best = t;
+                    best_added = added;
+                    best_distance = distance;
+                }
+            }
+        }
+
+        bool full = best == INVALID_TRIANGLE
+            || meshlet.vertex_count + best_added > MESHLET_MAX_VERTICES
+            || meshlet.triangle_count == MESHLET_MAX_TRIANGLES;
+
+        if (full) {
+            if (meshlet.triangle_count > 0) {
+                finish_meshlet(meshlet, vertices, local, out);
+                position_sum = glm::vec3(0.0f);
+            }
+
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        const u32* triangle = indices + best * 3;
+        for (u32 k = 0; k < 3; k++) {
+            u32 v = triangle[k];
+            if (local[v] == UNUSED_VERTEX) {
+                local[v] = (u8)meshlet.vertex_count++;
+                out->vertices.push(v);
+                position_sum += vertices[v].position;
+            }
+            out->triangles.push(local[v]);
+        }
+
+        meshlet.triangle_count++;
+        emitted[best] = 1;
+    }
+
+    if (meshlet.triangle_count > 0) {
+        finish_meshlet(meshlet, vertices, local, out);
+    }
+}
+
+}
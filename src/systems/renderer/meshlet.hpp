@@ -0,0 +1,41 @@
+#pragma once
+
+#include "core/containers/darray.hpp"
+#include "vertex_format.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rin::renderer::meshlet {
+
+// NOTE: 124 * 3 local indices stay a multiple of 4 bytes, both limits must match resources/shaders/cluster.glsl
+constexpr u32 MESHLET_MAX_VERTICES = 64;
+constexpr u32 MESHLET_MAX_TRIANGLES = 124;
+
+// NOTE: mirrors resources/shaders/cluster.glsl, std430 layout
+struct meshlet_t {
+    glm::vec4 sphere; // xyz center, w radius, in mesh space
+    glm::vec4 cone; // xyz axis, w cutoff, see build() for the test
+    u32 vertex_offset; // into meshlet_data_t::vertices
+    u32 triangle_offset; // into meshlet_data_t::triangles, in bytes, always a multiple of 4
+    u32 vertex_count;
+    u32 triangle_count;
+};
+
+struct meshlet_data_t {
+    darray<meshlet_t> meshlets;
+    darray<u32> vertices; // mesh vertex index of every meshlet local vertex
+    darray<u8> triangles; // 3 local vertex indices per triangle, every meshlet padded to 4 bytes
+};
+
+// Splits an indexed triangle list into meshlets grown from a seed triangle, adding the neighbouring triangle that
+// brings the fewest new vertices until either limit is reached. Seeds follow index order, so running
+// mesh_optimizer::optimize_vertex_cache first keeps consecutive meshlets close. Appends to out, so several meshes
+// can share the same buffers.
+//
+// A meshlet seen from camera is entirely back facing, and can be culled, when
+//     dot(center - camera, cone.xyz) >= cone.w * length(center - camera) + sphere.w
+// Meshlets whose normals spread too much get a zero axis and a cutoff of 1 so the test never passes.
+void build(const u32* indices, u32 index_count, const vertex_format::vertex_attributes_t* vertices, u32 vertex_count,
+    meshlet_data_t* out);
+
+}
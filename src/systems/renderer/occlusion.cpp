@@ -0,0 +1,368 @@
+#include "occlusion.hpp"
+
+#include "core/logger.hpp"
+#include "vk/bindless.hpp"
+#include "vk/context.hpp"
+#include "vk/host_memory.hpp"
+#include "vk/pipeline.hpp"
+#include "vk/pipeline_table.hpp"
+#include "vk/utils.hpp"
+
+#include <glm/glm.hpp>
+#include <imgui.h>
+#include <vulkan/vk_enum_string_helper.h>
+
+namespace rin::renderer::occlusion {
+
+// NOTE: must match the push constant block declared in depth_pyramid.comp
+struct pyramid_push_constants_t {
+    VkDeviceAddress src; // previous level, unused when reducing the depth target
+    VkDeviceAddress dst;
+    u32 src_width;
+    u32 src_height;
+    u32 dst_width;
+    u32 dst_height;
+    u32 depth_texture; // bindless index of the depth target for the first level, BINDLESS_INVALID_INDEX after
+    u32 sampler_index;
+};
+
+struct state_t {
+    vulkan::context_t* context;
+    vulkan::buffer_t levels;
+    u32 max_width; // of the depth target, the levels buffer fits every extent up to it
+    u32 max_height;
+    u32 width; // rendered area, see set_extent()
+    u32 height;
+    u32 level_count;
+    VkSampler sampler; // nearest, depth is never filtered
+    u32 sampler_index;
+    VkShaderModule module;
+    VkPipelineLayout layout; // owned by the pipeline table
+    u64 key;
+    VkPipeline pipeline;
+    bool ready; // set by the first build() that found the pipeline compiled
+    bool enabled;
+};
+
+static state_t* state = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(vulkan::context_t* context)
+{
+    if (state != nullptr) {
+        log::error("occlusion::create -> occlusion has been already created");
+        return false;
+    }
+
+    state = (state_t*)calloc(1, sizeof(state_t));
+    state->context = context;
+    state->sampler_index = vulkan::BINDLESS_INVALID_INDEX;
+    state->enabled = true;
+
+    VkDevice device = context->device->logical_device;
+
+    VkSamplerCreateInfo sampler_info {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_NEVER,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+        .unnormalizedCoordinates = VK_FALSE,
+    };
+
+    VkResult result = vkCreateSampler(device, &sampler_info, vulkan::host_memory::callbacks(), &state->sampler);
+    if (result != VK_SUCCESS) {
+        log::error("occlusion::create -> failed to create sampler: %s", string_VkResult(result));
+        destroy();
+        return false;
+    }
+
+    state->sampler_index = vulkan::bindless::register_sampler(state->sampler);
+    if (state->sampler_index == vulkan::BINDLESS_INVALID_INDEX) {
+        log::error("occlusion::create -> failed to register sampler");
+        destroy();
+        return false;
+    }
+
+    vulkan::reflection::shader_reflection_t reflection {};
+    if (!vulkan::utils::load_shader_module(device, "resources/shaders/depth_pyramid.comp.spv", &state->module, &reflection)) {
+        log::error("occlusion::create -> failed to load shader module");
+        destroy();
+        return false;
+    }
+
+    const vulkan::reflection::shader_reflection_t* stages[] = { &reflection };
+    if (!vulkan::pipeline_table::get_layout(stages, 1, &state->layout)) {
+        log::error("occlusion::create -> failed to create pipeline layout");
+        destroy();
+        return false;
+    }
+
+    vulkan::pipeline_builder_t builder {};
+    builder
+        .set_compute_shader(state->module)
+        .set_layout(state->layout);
+    state->key = vulkan::pipeline_table::request(builder);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(void)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    VkDevice device = state->context->device->logical_device;
+    vkDeviceWaitIdle(device);
+
+    if (state->module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, state->module, vulkan::host_memory::callbacks());
+    }
+
+    if (state->sampler != VK_NULL_HANDLE) {
+        vulkan::bindless::release(vulkan::BINDLESS_TYPE_SAMPLER, state->sampler_index);
+        vkDestroySampler(device, state->sampler, vulkan::host_memory::callbacks());
+    }
+
+    vulkan::context::destroy_buffer(&state->levels);
+
+    free(state);
+    state = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool resize(u32 width, u32 height)
+{
+    vulkan::context::retire_buffer(&state->levels);
+
+    u64 texels = 0;
+    u32 level_count = 0;
+    for (u32 w = width, h = height; w > 1 || h > 1; level_count++) {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        texels += (u64)w * h;
+    }
+
+    // NOTE: a 1x1 target has nothing to reduce, the single level stays around so the buffer is never empty
+    if (level_count == 0) {
+        level_count = 1;
+        texels = 1;
+    }
+
+    vulkan::buffer_create_info_t info {
+        .size = sizeof(f32) * texels,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = true,
+        .tag = vulkan::MEMORY_TAG_OCCLUSION,
+    };
+
+    if (!vulkan::context::allocate_buffer(info, &state->levels)) {
+        log::error("occlusion::resize -> failed to allocate a %ux%u pyramid", width, height);
+        return false;
+    }
+
+    state->max_width = width;
+    state->max_height = height;
+    state->width = width;
+    state->height = height;
+    state->level_count = level_count;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void set_extent(u32 width, u32 height)
+{
+    // NOTE: every level of a smaller extent is at most as large, the levels buffer needs no resize
+    width = glm::clamp(width, 1u, state->max_width);
+    height = glm::clamp(height, 1u, state->max_height);
+
+    u32 level_count = 0;
+    for (u32 w = width, h = height; w > 1 || h > 1; level_count++) {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+
+    state->width = width;
+    state->height = height;
+    state->level_count = glm::max(level_count, 1u);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void build(VkCommandBuffer cmd, const vulkan::image_t& depth)
+{
+    if (!state->enabled || depth.bindless_index == vulkan::BINDLESS_INVALID_INDEX) {
+        return;
+    }
+
+    if (!state->ready) {
+        state->ready = vulkan::pipeline_table::resolve(state->key, &state->pipeline) == vulkan::pipeline_table::PIPELINE_STATUS_READY;
+        if (!state->ready) {
+            return;
+        }
+    }
+
+    VkPipelineStageFlags2 readers = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+        | (state->context->device->mesh_shader ? VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT : 0);
+
+    vulkan::context::begin_label(cmd, "depth pyramid", { 1, 1, 0, 1 });
+
+    // NOTE: the previous frame may still be testing against the pyramid, only an execution dependency is needed
+    VkMemoryBarrier2 reuse_barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = readers,
+        .srcAccessMask = VK_ACCESS_2_NONE,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_NONE,
+    };
+
+    VkImageMemoryBarrier2 to_sampled = vulkan::context::image_layout_transition(
+        depth.handle, VK_IMAGE_ASPECT_DEPTH_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+        VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+        VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+
+    VkDependencyInfo before_dep {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &reuse_barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = nullptr,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &to_sampled,
+    };
+    vkCmdPipelineBarrier2(cmd, &before_dep);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, state->pipeline);
+
+    VkMemoryBarrier2 level_barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+    };
+
+    VkDependencyInfo level_dep {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &level_barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = nullptr,
+        .imageMemoryBarrierCount = 0,
+        .pImageMemoryBarriers = nullptr,
+    };
+
+    // NOTE: one dispatch per level, each reads the one before it, the first one reads the depth target
+    VkDeviceAddress src = 0;
+    VkDeviceAddress dst = state->levels.address;
+    u32 src_width = state->width;
+    u32 src_height = state->height;
+
+    for (u32 level = 0; level < state->level_count; level++) {
+        u32 dst_width = (src_width + 1) / 2;
+        u32 dst_height = (src_height + 1) / 2;
+
+        pyramid_push_constants_t constants {
+            .src = src,
+            .dst = dst,
+            .src_width = src_width,
+            .src_height = src_height,
+            .dst_width = dst_width,
+            .dst_height = dst_height,
+            .depth_texture = level == 0 ? depth.bindless_index : vulkan::BINDLESS_INVALID_INDEX,
+            .sampler_index = state->sampler_index,
+        };
+        vkCmdPushConstants(cmd, state->layout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+        vkCmdDispatch(cmd, (dst_width + OCCLUSION_GROUP_SIZE - 1) / OCCLUSION_GROUP_SIZE,
+            (dst_height + OCCLUSION_GROUP_SIZE - 1) / OCCLUSION_GROUP_SIZE, 1);
+
+        if (level + 1 < state->level_count) {
+            vkCmdPipelineBarrier2(cmd, &level_dep);
+        }
+
+        src = dst;
+        dst += sizeof(f32) * dst_width * dst_height;
+        src_width = dst_width;
+        src_height = dst_height;
+    }
+
+    VkMemoryBarrier2 done_barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .dstStageMask = readers,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+    };
+
+    VkImageMemoryBarrier2 to_attachment = vulkan::context::image_layout_transition(
+        depth.handle, VK_IMAGE_ASPECT_DEPTH_BIT,
+        VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+        VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+        VK_ACCESS_2_NONE,
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT);
+
+    VkDependencyInfo after_dep {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &done_barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = nullptr,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &to_attachment,
+    };
+    vkCmdPipelineBarrier2(cmd, &after_dep);
+
+    vulkan::context::end_label(cmd);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+pyramid_t pyramid(void)
+{
+    // NOTE: stays disabled until build() has run once, culling passes recorded before it see no pyramid
+    return pyramid_t {
+        .levels = state->levels.address,
+        .width = state->width,
+        .height = state->height,
+        .level_count = state->level_count,
+        .enabled = state->enabled && state->ready ? 1u : 0u,
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    ImGui::Checkbox("Occlusion culling", &state->enabled);
+    ImGui::Text("Depth pyramid: %ux%u, %u levels, %.2f MB", (state->width + 1) / 2, (state->height + 1) / 2,
+        state->level_count, (f64)state->levels.allocation_info.size / (1024.0 * 1024.0));
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "vk/types.hpp"
+
+namespace rin::renderer::occlusion {
+
+constexpr u32 OCCLUSION_GROUP_SIZE = 8; // local_size_x and local_size_y in depth_pyramid.comp
+
+// Two phase culling, both phases record a cull pass followed by a depth only pass:
+//   - early: what was visible last frame and is still in the frustum, without any occlusion test
+//   - late: everything else in the frustum, tested against the pyramid built from the early depth
+// The late pass also refreshes the visibility the next early pass starts from.
+// NOTE: must match the CULL_PHASE constants in occlusion.glsl
+enum cull_phase_t {
+    CULL_PHASE_EARLY,
+    CULL_PHASE_LATE,
+};
+
+// NOTE: mirrors resources/shaders/occlusion.glsl, std430 layout, embedded in the frame data of the culling passes
+struct pyramid_t {
+    VkDeviceAddress levels; // f32 farthest depth per texel, every level back to back
+    u32 width; // of the depth target, level n is ceil(width / 2^(n + 1)) texels wide
+    u32 height;
+    u32 level_count; // down to a single texel
+    u32 enabled; // 0 makes every occlusion test pass
+};
+
+bool create(vulkan::context_t* context);
+void destroy(void);
+
+// Sizes the pyramid after the depth target, call it whenever that one is recreated. The previous levels buffer is
+// retired, frames in flight may still be reading it.
+bool resize(u32 width, u32 height);
+
+// Limits the pyramid to the top left corner of the depth target the frame renders into, at most the resize() size.
+// Call it before the first cull of the frame so every phase sees the same pyramid.
+void set_extent(u32 width, u32 height);
+
+// Reduces the depth target, left in VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL by the early depth pass, into the
+// pyramid and hands it back in the same layout. The pyramid is visible to compute and task shaders afterwards.
+void build(VkCommandBuffer cmd, const vulkan::image_t& depth);
+
+pyramid_t pyramid(void);
+
+void draw_gui(void);
+
+}
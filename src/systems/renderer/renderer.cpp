@@ -1,11 +1,29 @@
 #include "renderer.hpp"
 
+#include "bvh.hpp"
+#include "camera.hpp"
+#include "capture.hpp"
+#include "clusters.hpp"
+#include "core/allocations.hpp"
 #include "core/clock.hpp"
 #include "core/logger.hpp"
+#include "core/profiler.hpp"
+#include "culling.hpp"
+#include "debug_draw.hpp"
 #include "gui.hpp"
+#include "lights.hpp"
+#include "mesh.hpp"
+#include "occlusion.hpp"
+#include "resolution.hpp"
+#include "scene.hpp"
+#include "sprites.hpp"
 #include "systems/window/window.hpp"
+#include "vk/bindless.hpp"
 #include "vk/context.hpp"
+#include "vk/host_memory.hpp"
+#include "vk/memory.hpp"
 #include "vk/pipeline.hpp"
+#include "vk/pipeline_table.hpp"
 #include "vk/swapchain.hpp"
 #include "vk/types.hpp"
 #include "vk/utils.hpp"
@@ -22,60 +40,61 @@ constexpr bool ENABLE_VALIDATION = true;
 #endif
 
 constexpr u32 MAX_CONCURRENT_FRAMES = 2;
+constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+constexpr VkFormat HDR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+constexpr f64 RESIZE_DEBOUNCE_S = 0.1; // a drag resize recreates the swapchain once the size has settled
+constexpr u32 MAX_QUEUED_PRESENTS = 3;
+
+constexpr const char* PRESENT_POLICY_NAMES[vulkan::PRESENT_POLICY_COUNT] = {
+    "FIFO",
+    "FIFO relaxed",
+    "Mailbox",
+    "Immediate",
+};
+
+// NOTE: must match the FEATURES bits in triangle.frag
+enum triangle_feature_t {
+    TRIANGLE_FEATURE_GRAYSCALE = 1 << 0,
+};
 
 struct state_t {
     vulkan::context_t* context;
     bool resize_requested;
+    f64 resize_time; // of the last resize event or suboptimal result, see RESIZE_DEBOUNCE_S
+    bool recreate_requested; // present policy change, applied at the end of the frame without debounce
+    u32 queued_presents; // presents allowed to wait for the display, 0 leaves them uncapped
     darray<VkSemaphore> image_acquired;
     darray<VkFence> fences;
     darray<VkCommandPool> command_pools;
     darray<VkCommandBuffer> command_buffers;
-    VkPipeline pipeline;
-    VkPipelineLayout pipeline_layout;
+    vulkan::pipeline_table::variant_set_t* variants; // triangle shaders specialized per triangle_feature_t mask
+    u32 features;
+    VkPipeline fallback; // last ready variant, drawn while the requested one compiles
+    VkPipelineLayout pipeline_layout; // owned by the pipeline table
+    VkShaderModule vert_module; // kept alive since modules are part of the pipeline table keys
+    VkShaderModule frag_module;
     u32 in_flight_count; // configurable via gui between 1-MAX_CONCURRENT_FRAMES
     u32 current_frame;
-    vulkan::buffer_t vertex_buffer;
+    u64 slot_frames[MAX_CONCURRENT_FRAMES]; // deletion queue frame of the last submit of each slot
+    mesh::gpu_mesh_t quad;
+    vulkan::image_t render_target; // HDR color, at least the swapchain size, the scene only covers the scaled corner
+    vulkan::image_t depth; // same size as render_target, both only grow on resize
+    bool scene_enabled; // GPU driven scene instead of the triangle
+    bool clusters_enabled; // meshlet culling demo instead of both
 };
 
+// NOTE: fetched and decoded by triangle.vert through the buffer address, there is no fixed function vertex input
 struct vertex_t {
     glm::vec2 pos;
     u32 color;
+};
 
-    static VkVertexInputBindingDescription binding()
-    {
-        VkVertexInputBindingDescription desc {
-            .binding = 0,
-            .stride = sizeof(vertex_t),
-            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-        };
-        return desc;
-    }
-
-    static darray<VkVertexInputAttributeDescription> attributes()
-    {
-        darray<VkVertexInputAttributeDescription> desc { 2, true };
-
-        VkVertexInputAttributeDescription position {
-            .location = 0,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32_SFLOAT,
-            .offset = offsetof(vertex_t, pos),
-        };
-        desc.push(position);
-
-        VkVertexInputAttributeDescription color {
-            .location = 1,
-            .binding = 0,
-            .format = VK_FORMAT_R8G8B8A8_UNORM,
-            .offset = offsetof(vertex_t, color),
-        };
-        desc.push(color);
-
-        return desc;
-    }
+// NOTE: must match the push constant block declared in triangle.vert
+struct draw_push_constants_t {
+    VkDeviceAddress vertices;
 };
 
-// color format -> 0xAABBGGRR
+// color format -> 0xAABBGGRR, an unindexed triangle list turned into 4 vertices and 6 indices by mesh::import
 constexpr vertex_t vertices[6] = {
     { { 0.5, 0.5 }, 0xFFFFFFFF }, // in alto a destra - blu
     { { -0.5, 0.5 }, 0xFFFFFFFF }, // in alto a sinistra - verde
@@ -87,6 +106,64 @@ constexpr vertex_t vertices[6] = {
 
 struct state_t* state = nullptr;
 
+static bool create_depth_target(VkExtent2D extent)
+{
+    vulkan::image_create_info_t info {
+        .format = DEPTH_FORMAT,
+        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, // sampled by the depth pyramid
+        .width = extent.width,
+        .height = extent.height,
+        .allocation_info = {
+            .flags = 0,
+            .usage = VMA_MEMORY_USAGE_AUTO,
+            .requiredFlags = 0,
+            .preferredFlags = 0,
+            .memoryTypeBits = 0,
+            .pool = VK_NULL_HANDLE,
+            .pUserData = nullptr,
+            .priority = 1.0f,
+        },
+        .type = vulkan::IMAGE_TYPE_DEPTH,
+        .tag = vulkan::MEMORY_TAG_TARGETS,
+    };
+
+    if (!vulkan::context::allocate_image(info, &state->depth)) {
+        return false;
+    }
+
+    vulkan::memory::set_movable(&state->depth);
+    return true;
+}
+
+static bool create_render_target(VkExtent2D extent)
+{
+    vulkan::image_create_info_t info {
+        .format = HDR_FORMAT,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, // blitted into the swapchain
+        .width = extent.width,
+        .height = extent.height,
+        .allocation_info = {
+            .flags = 0,
+            .usage = VMA_MEMORY_USAGE_AUTO,
+            .requiredFlags = 0,
+            .preferredFlags = 0,
+            .memoryTypeBits = 0,
+            .pool = VK_NULL_HANDLE,
+            .pUserData = nullptr,
+            .priority = 1.0f,
+        },
+        .type = vulkan::IMAGE_TYPE_COLOR,
+        .tag = vulkan::MEMORY_TAG_TARGETS,
+    };
+
+    if (!vulkan::context::allocate_image(info, &state->render_target)) {
+        return false;
+    }
+
+    vulkan::memory::set_movable(&state->render_target);
+    return true;
+}
+
 bool initialize(const char* app_name)
 {
     if (state != nullptr) {
@@ -123,7 +200,7 @@ bool initialize(const char* app_name)
             .flags = 0,
         };
 
-        result = vkCreateSemaphore(device, &sem_info, nullptr, &state->image_acquired[i]);
+        result = vkCreateSemaphore(device, &sem_info, vulkan::host_memory::callbacks(), &state->image_acquired[i]);
         if (result != VK_SUCCESS) {
             log::error("renderer::initialize -> failed to create semaphore: %s", string_VkResult(result));
             shutdown();
@@ -136,7 +213,7 @@ bool initialize(const char* app_name)
             .flags = VK_FENCE_CREATE_SIGNALED_BIT,
         };
 
-        result = vkCreateFence(device, &fence_info, nullptr, &state->fences[i]);
+        result = vkCreateFence(device, &fence_info, vulkan::host_memory::callbacks(), &state->fences[i]);
         if (result != VK_SUCCESS) {
             log::error("renderer::initialize -> failed to create fence: %s", string_VkResult(result));
             shutdown();
@@ -150,7 +227,7 @@ bool initialize(const char* app_name)
             .queueFamilyIndex = (u32)state->context->device->graphics_queue.family,
         };
 
-        result = vkCreateCommandPool(device, &pool_info, nullptr, &state->command_pools[i]);
+        result = vkCreateCommandPool(device, &pool_info, vulkan::host_memory::callbacks(), &state->command_pools[i]);
         if (result != VK_SUCCESS) {
             log::error("renderer::initialize -> failed to create command pool: %s", string_VkResult(result));
             shutdown();
@@ -173,72 +250,104 @@ bool initialize(const char* app_name)
         }
     }
 
-    vulkan::buffer_create_info_t buffer_info {
-        .size = sizeof(vertices[0]) * 6,
-        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        .memory_usage = VMA_MEMORY_USAGE_AUTO,
-    };
-    vulkan::context::allocate_buffer(buffer_info, &state->vertex_buffer);
+    VkExtent2D target_extent = state->context->swapchain->extent;
+    if (!create_depth_target(target_extent) || !create_render_target(target_extent)) {
+        log::error("renderer::initialize -> failed to create render targets");
+        shutdown();
+        return false;
+    }
+
+    if (!resolution::create(state->context, MAX_CONCURRENT_FRAMES)) {
+        log::error("renderer::initialize -> failed to create dynamic resolution");
+        shutdown();
+        return false;
+    }
+
+    if (!capture::create(state->context)) {
+        log::error("renderer::initialize -> failed to create frame capture");
+        shutdown();
+        return false;
+    }
+
+    if (!occlusion::create(state->context) || !occlusion::resize(state->depth.width, state->depth.height)) {
+        log::error("renderer::initialize -> failed to create depth pyramid");
+        shutdown();
+        return false;
+    }
 
-    VkShaderModule vert_mod, frag_mod;
+    if (!mesh::import("quad", vertices, 6, sizeof(vertex_t), &state->quad)) {
+        log::error("renderer::initialize -> failed to import quad mesh");
+        shutdown();
+        return false;
+    }
 
-    if (!vulkan::utils::load_shader_module(device, "resources/shaders/triangle.vert.spv", &vert_mod)) {
+    vulkan::reflection::shader_reflection_t vert_reflection {};
+    if (!vulkan::utils::load_shader_module(device, "resources/shaders/triangle.vert.spv", &state->vert_module, &vert_reflection)) {
         log::error("renderer::initialize -> failed to load vertex shader module");
         shutdown();
         return false;
     }
 
-    if (!vulkan::utils::load_shader_module(device, "resources/shaders/triangle.frag.spv", &frag_mod)) {
+    vulkan::reflection::shader_reflection_t frag_reflection {};
+    if (!vulkan::utils::load_shader_module(device, "resources/shaders/triangle.frag.spv", &state->frag_module, &frag_reflection)) {
         log::error("renderer::initialize -> failed to load fragment shader module");
-        vkDestroyShaderModule(device, vert_mod, nullptr);
         shutdown();
         return false;
     }
 
-    VkPipelineLayoutCreateInfo layout_info {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-        .setLayoutCount = 0,
-        .pSetLayouts = nullptr,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges = nullptr,
-    };
-    result = vkCreatePipelineLayout(device, &layout_info, nullptr, &state->pipeline_layout);
-    if (result != VK_SUCCESS) {
-        log::error("renderer::initialize -> failed to create pipeline layout: %s", string_VkResult(result));
+    const vulkan::reflection::shader_reflection_t* stages[] = { &vert_reflection, &frag_reflection };
+    if (!vulkan::pipeline_table::get_layout(stages, 2, &state->pipeline_layout)) {
+        log::error("renderer::initialize -> failed to create pipeline layout");
         shutdown();
         return false;
     }
 
-    auto bindings = vertex_t::binding();
-    auto attributes = vertex_t::attributes();
-
     vulkan::pipeline_builder_t pipeline_builder {};
     pipeline_builder
         .set_multisampling_none()
         .disable_blending()
         .disable_depthtest()
-        .set_color_attachment_format(state->context->swapchain->format.format)
-        .set_depth_format(VK_FORMAT_UNDEFINED)
+        .set_color_attachment_format(HDR_FORMAT)
+        .set_depth_format(DEPTH_FORMAT)
         .set_cull_mode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_CLOCKWISE)
         .set_polygon_mode(VK_POLYGON_MODE_FILL)
         .set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
-        .set_shaders(vert_mod, frag_mod)
-        .set_vertex_state(1, &bindings, attributes.len, attributes.data)
+        .set_shaders(state->vert_module, state->frag_module)
         .set_layout(state->pipeline_layout);
 
-    if (!pipeline_builder.build(state->context->device->logical_device, &state->pipeline)) {
-        log::error("renderer::initialize -> failed to create offscreen rendering pipeline");
-        vkDestroyShaderModule(device, vert_mod, nullptr);
-        vkDestroyShaderModule(device, frag_mod, nullptr);
+    state->variants = vulkan::pipeline_table::create_variant_set(pipeline_builder);
+    vulkan::pipeline_table::request_variant(state->variants, state->features);
+
+    if (!lights::create(state->context, MAX_CONCURRENT_FRAMES)) {
+        log::error("renderer::initialize -> failed to create lights");
+        shutdown();
+        return false;
+    }
+
+    if (!scene::create(state->context, MAX_CONCURRENT_FRAMES, HDR_FORMAT, DEPTH_FORMAT)) {
+        log::error("renderer::initialize -> failed to create scene");
+        shutdown();
+        return false;
+    }
+    state->scene_enabled = true;
+
+    if (!clusters::create(state->context, MAX_CONCURRENT_FRAMES, HDR_FORMAT, DEPTH_FORMAT)) {
+        log::error("renderer::initialize -> failed to create meshlet clusters");
         shutdown();
         return false;
     }
 
-    vkDestroyShaderModule(device, vert_mod, nullptr);
-    vkDestroyShaderModule(device, frag_mod, nullptr);
+    if (!sprites::create(state->context, MAX_CONCURRENT_FRAMES, HDR_FORMAT, DEPTH_FORMAT)) {
+        log::error("renderer::initialize -> failed to create sprite renderer");
+        shutdown();
+        return false;
+    }
 
+    if (!debug_draw::create(state->context, MAX_CONCURRENT_FRAMES, HDR_FORMAT, DEPTH_FORMAT)) {
+        log::error("renderer::initialize -> failed to create debug draw");
+        shutdown();
+        return false;
+    }
     return true;
 }
 
@@ -248,56 +357,78 @@ void shutdown(void)
         return;
     }
 
+    // NOTE: pending compiles reference the shader modules destroyed below
+    vulkan::pipeline_table::drain();
+
     VkDevice device = state->context->device->logical_device;
     vkDeviceWaitIdle(device);
-
-    if (state->pipeline_layout != VK_NULL_HANDLE) {
-        vkDestroyPipelineLayout(device, state->pipeline_layout, nullptr);
+    vulkan::memory::end_defragmentation();
+
+    debug_draw::destroy();
+    sprites::destroy();
+    clusters::destroy();
+    scene::destroy();
+    lights::destroy();
+    occlusion::destroy();
+    resolution::destroy();
+    capture::destroy();
+    culling::shutdown();
+    bvh::shutdown();
+    vulkan::pipeline_table::destroy_variant_set(state->variants);
+
+    if (state->vert_module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, state->vert_module, vulkan::host_memory::callbacks());
     }
 
-    if (state->pipeline != VK_NULL_HANDLE) {
-        vkDestroyPipeline(device, state->pipeline, nullptr);
+    if (state->frag_module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, state->frag_module, vulkan::host_memory::callbacks());
     }
 
     for (u32 i = 0; i < MAX_CONCURRENT_FRAMES; i++) {
         if (state->command_pools[i] != VK_NULL_HANDLE) {
-            vkDestroyCommandPool(device, state->command_pools[i], nullptr);
+            vkDestroyCommandPool(device, state->command_pools[i], vulkan::host_memory::callbacks());
         }
 
         if (state->image_acquired[i] != VK_NULL_HANDLE) {
-            vkDestroySemaphore(device, state->image_acquired[i], nullptr);
+            vkDestroySemaphore(device, state->image_acquired[i], vulkan::host_memory::callbacks());
         }
 
         if (state->fences[i] != VK_NULL_HANDLE) {
-            vkDestroyFence(device, state->fences[i], nullptr);
+            vkDestroyFence(device, state->fences[i], vulkan::host_memory::callbacks());
         }
     }
 
-    if (state->vertex_buffer.handle != VK_NULL_HANDLE) {
-        vmaDestroyBuffer(state->context->vma, state->vertex_buffer.handle, state->vertex_buffer.memory);
-    }
+    mesh::destroy(&state->quad);
+    vulkan::context::destroy_image(&state->depth);
+    vulkan::context::destroy_image(&state->render_target);
 
     gui::shutdown();
 
-    // if (state->render_target.handle != VK_NULL_HANDLE) {
-    //     vkDestroyImageView(device, state->render_target.view, nullptr);
-    //     vmaDestroyImage(state->context->vma, state->render_target.handle, state->render_target.memory);
-    // }
-
     vulkan::context::destroy();
     state->context = nullptr;
 
+    state->image_acquired.~darray();
+    state->fences.~darray();
+    state->command_pools.~darray();
+    state->command_buffers.~darray();
     free(state);
     state = nullptr;
 }
 
 void request_resize(void)
 {
+    if (state == nullptr) {
+        return;
+    }
+
     state->resize_requested = true;
+    state->resize_time = clock::get_time_s();
 }
 
 static bool resize(void)
 {
+    RIN_ALLOW_ALLOC("renderer swapchain resize");
+
     u32 width = 0, height = 0;
     window::get_size(&width, &height);
 
@@ -306,27 +437,166 @@ static bool resize(void)
         window::get_size(&width, &height);
     }
 
+    // NOTE: no device wait, the frames in flight finish on the retired swapchain and targets
     if (!vulkan::swapchain::resize({ width, height })) {
         return false;
     }
-
     state->resize_requested = false;
-    return true;
+    state->recreate_requested = false;
+
+    // NOTE: the targets only grow, a smaller swapchain renders into their top left corner like a lower render scale
+    VkExtent2D extent = state->context->swapchain->extent;
+    if (extent.width <= state->depth.width && extent.height <= state->depth.height) {
+        return true;
+    }
+
+    VkExtent2D target_extent {
+        .width = glm::max(extent.width, state->depth.width),
+        .height = glm::max(extent.height, state->depth.height),
+    };
+
+    vulkan::context::retire_image(&state->depth);
+    vulkan::context::retire_image(&state->render_target);
+    return create_depth_target(target_extent) && create_render_target(target_extent)
+        && occlusion::resize(target_extent.width, target_extent.height);
+}
+
+static void cull(VkCommandBuffer cmd, VkExtent2D extent, occlusion::cull_phase_t phase)
+{
+    if (state->clusters_enabled) {
+        clusters::cull(cmd, state->current_frame, extent, phase);
+    } else {
+        scene::cull(cmd, state->current_frame, extent, phase);
+    }
+}
+
+static void bin_lights(VkCommandBuffer cmd, VkExtent2D extent)
+{
+    if (state->clusters_enabled) {
+        lights::bin(cmd, state->current_frame, clusters::current_camera(), extent, clusters::half_extent());
+    } else {
+        lights::bin(cmd, state->current_frame, scene::current_camera(), extent, scene::half_extent());
+    }
+}
+
+static void set_viewport(VkCommandBuffer cmd, VkExtent2D extent)
+{
+    // NOTE: the scaled scene covers the top left corner of the render targets
+    VkViewport viewport {
+        .x = 0,
+        .y = 0,
+        .width = (f32)extent.width,
+        .height = (f32)extent.height,
+        .minDepth = 0,
+        .maxDepth = 1,
+    };
+
+    VkRect2D scissor {
+        .offset = { 0, 0 },
+        .extent = extent,
+    };
+
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+static void depth_prepass(VkCommandBuffer cmd, VkExtent2D extent, occlusion::cull_phase_t phase)
+{
+    // NOTE: the early pass starts the depth of the frame, the late one adds what the pyramid revealed
+    VkRenderingAttachmentInfo depth_attachment {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .pNext = nullptr,
+        .imageView = state->depth.view,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+        .resolveMode = VK_RESOLVE_MODE_NONE,
+        .resolveImageView = VK_NULL_HANDLE,
+        .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .loadOp = phase == occlusion::CULL_PHASE_EARLY ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue = {
+            .depthStencil = { .depth = 1.0f, .stencil = 0 },
+        },
+    };
+
+    VkRenderingInfo rendering {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .renderArea = {
+            .offset = { 0, 0 },
+            .extent = extent,
+        },
+        .layerCount = 1,
+        .viewMask = 0,
+        .colorAttachmentCount = 0,
+        .pColorAttachments = nullptr,
+        .pDepthAttachment = &depth_attachment,
+        .pStencilAttachment = nullptr,
+    };
+
+    vkCmdBeginRendering(cmd, &rendering);
+    vulkan::context::begin_label(cmd, phase == occlusion::CULL_PHASE_EARLY ? "Depth prepass early" : "Depth prepass late", { 1, 0, 0, 1 });
+    set_viewport(cmd, extent);
+
+    if (state->clusters_enabled) {
+        clusters::draw_depth(cmd, state->current_frame, phase);
+    } else {
+        scene::draw_depth(cmd, state->current_frame, phase);
+    }
+
+    vulkan::context::end_label(cmd);
+    vkCmdEndRendering(cmd);
+
+    // NOTE: the next pass tests against this depth, whether it is the late prepass or the color pass
+    VkMemoryBarrier2 barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        .srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        .dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    };
+
+    VkDependencyInfo dep {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = nullptr,
+        .imageMemoryBarrierCount = 0,
+        .pImageMemoryBarriers = nullptr,
+    };
+    vkCmdPipelineBarrier2(cmd, &dep);
 }
 
 bool draw(void)
 {
+    RIN_NO_ALLOC("renderer::draw");
+
     VkDevice device = state->context->device->logical_device;
     vulkan::swapchain_t* swapchain = state->context->swapchain;
     VkResult vk_result = VK_SUCCESS;
     bool suboptimal = false;
 
+    vulkan::pipeline_table::update();
+
     vk_result = vkWaitForFences(device, 1, &state->fences[state->current_frame], VK_TRUE, UINT64_MAX);
     if (vk_result != VK_SUCCESS) {
         log::error("renderer::draw -> failed to wait for fences: %s", string_VkResult(vk_result));
         return false;
     }
 
+    // NOTE: a fence covers every submission before its own on the queue, so all frames up to this one are done
+    vulkan::memory::update(state->slot_frames[state->current_frame]);
+    vulkan::context::collect(state->slot_frames[state->current_frame]);
+    capture::update(state->slot_frames[state->current_frame]);
+
+    // NOTE: with a cap this is where the CPU waits for the display instead of queueing further ahead of it
+    vulkan::swapchain::wait_presents(state->queued_presents);
+    f64 input_time = window::get_poll_time();
+
     u32 image_index;
     vk_result = vkAcquireNextImageKHR(device, swapchain->handle, UINT64_MAX,
         state->image_acquired[state->current_frame], VK_NULL_HANDLE, &image_index);
@@ -375,17 +645,58 @@ bool draw(void)
         return false;
     }
 
+    // NOTE: the only descriptor set bind of the frame, every pipeline layout is compatible for set 0
+    vulkan::bindless::bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, state->pipeline_layout);
+    vulkan::bindless::bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, state->pipeline_layout);
+
+    // NOTE: the scene renders at the scaled extent and is upscaled into the swapchain image before the GUI
+    resolution::begin_frame(cmd, state->current_frame);
+    VkExtent2D extent = resolution::scaled_extent(swapchain->extent);
+    occlusion::set_extent(extent.width, extent.height);
+
+    // NOTE: both GPU driven paths draw depth first, see occlusion.hpp for the two culling phases
+    bool prepass = state->clusters_enabled || state->scene_enabled;
+    if (prepass) {
+        cull(cmd, extent, occlusion::CULL_PHASE_EARLY);
+        bin_lights(cmd, extent);
+    }
+
+    sprites::begin();
+    if (sprites::stress_enabled()) {
+        sprites::stress(swapchain->extent);
+    }
+    sprites::end(state->current_frame);
+
+    // NOTE: after the fence wait, the buffer it starts filling is no longer read by the GPU
+    if (debug_draw::stress_enabled()) {
+        debug_draw::stress(state->clusters_enabled ? clusters::half_extent() : scene::half_extent());
+    }
+    debug_draw::end();
+
     {
         vulkan::context::begin_label(cmd, "color attachment transition", { 1, 0, 0, 1 });
+        // NOTE: the previous frame may still be blitting from it, only an execution dependency is needed
         VkImageMemoryBarrier2 before_rendering = vulkan::context::image_layout_transition(
-            swapchain->images[image_index], VK_IMAGE_ASPECT_COLOR_BIT,
+            state->render_target.handle, VK_IMAGE_ASPECT_COLOR_BIT,
             VK_IMAGE_LAYOUT_UNDEFINED,
             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
             VK_ACCESS_2_NONE,
             VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_2_BLIT_BIT,
             VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
 
+        // NOTE: the previous contents are discarded, the wait covers the last frame still testing against it
+        VkImageMemoryBarrier2 depth_before_rendering = vulkan::context::image_layout_transition(
+            state->depth.handle, VK_IMAGE_ASPECT_DEPTH_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+            VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT);
+
+        VkImageMemoryBarrier2 barriers[] = { before_rendering, depth_before_rendering };
+
         VkDependencyInfo dep {
             .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
             .pNext = nullptr,
@@ -394,19 +705,26 @@ bool draw(void)
             .pMemoryBarriers = nullptr,
             .bufferMemoryBarrierCount = 0,
             .pBufferMemoryBarriers = nullptr,
-            .imageMemoryBarrierCount = 1,
-            .pImageMemoryBarriers = &before_rendering,
+            .imageMemoryBarrierCount = 2,
+            .pImageMemoryBarriers = barriers,
         };
         vkCmdPipelineBarrier2(cmd, &dep);
         vulkan::context::end_label(cmd);
     }
 
+    if (prepass) {
+        depth_prepass(cmd, extent, occlusion::CULL_PHASE_EARLY);
+        occlusion::build(cmd, state->depth);
+        cull(cmd, extent, occlusion::CULL_PHASE_LATE);
+        depth_prepass(cmd, extent, occlusion::CULL_PHASE_LATE);
+    }
+
     {
         // NOTE: rendering
         VkRenderingAttachmentInfo color_attachment {
             .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
             .pNext = nullptr,
-            .imageView = swapchain->views[image_index],
+            .imageView = state->render_target.view,
             .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
             .resolveMode = VK_RESOLVE_MODE_NONE,
             .resolveImageView = VK_NULL_HANDLE,
@@ -418,37 +736,170 @@ bool draw(void)
             },
         };
 
+        VkRenderingAttachmentInfo depth_attachment {
+            .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+            .pNext = nullptr,
+            .imageView = state->depth.view,
+            .imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+            .resolveMode = VK_RESOLVE_MODE_NONE,
+            .resolveImageView = VK_NULL_HANDLE,
+            .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .loadOp = prepass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .clearValue = {
+                .depthStencil = { .depth = 1.0f, .stencil = 0 },
+            },
+        };
+
         VkRenderingInfo rendering {
             .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
             .pNext = nullptr,
             .flags = 0,
             .renderArea = {
                 .offset = { 0, 0 },
-                .extent = swapchain->extent,
+                .extent = extent,
             },
             .layerCount = 1,
             .viewMask = 0,
             .colorAttachmentCount = 1,
             .pColorAttachments = &color_attachment,
-            .pDepthAttachment = nullptr,
+            .pDepthAttachment = &depth_attachment,
             .pStencilAttachment = nullptr,
         };
 
         vkCmdBeginRendering(cmd, &rendering);
         vulkan::context::begin_label(cmd, "Rendering", { 1, 0, 0, 1 });
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, state->pipeline);
-        vkCmdSetViewport(cmd, 0, 1, &swapchain->viewport);
-        vkCmdSetScissor(cmd, 0, 1, &swapchain->scissor);
+        set_viewport(cmd, extent);
+
+        // NOTE: draws fall back to the last ready variant, or are skipped, until the requested one compiles
+        u64 variant = vulkan::pipeline_table::request_variant(state->variants, state->features);
+        VkPipeline pipeline = state->fallback;
+        if (vulkan::pipeline_table::resolve(variant, &pipeline) == vulkan::pipeline_table::PIPELINE_STATUS_READY) {
+            state->fallback = pipeline;
+        }
+
+        if (state->clusters_enabled) {
+            clusters::draw(cmd, state->current_frame);
+        } else if (state->scene_enabled) {
+            scene::draw(cmd, state->current_frame);
+        } else if (pipeline != VK_NULL_HANDLE) {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+            draw_push_constants_t push_constants {
+                .vertices = state->quad.vertices.address,
+            };
+            vkCmdPushConstants(cmd, state->pipeline_layout, VK_SHADER_STAGE_ALL, 0, sizeof(push_constants), &push_constants);
 
-        memcpy(state->vertex_buffer.allocation_info.pMappedData, vertices, state->vertex_buffer.size);
-        VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(cmd, 0, 1, &state->vertex_buffer.handle, &offset);
+            mesh::draw(cmd, state->quad, 1);
+        }
+
+        // NOTE: world space like the scene, with the camera of whichever path is active
+        camera::camera_t camera = state->clusters_enabled ? clusters::current_camera() : scene::current_camera();
+        f32 aspect = (f32)extent.width / (f32)extent.height;
+        debug_draw::draw(cmd, camera::projection(camera, aspect) * camera::view(camera));
+
+        // NOTE: sprites are laid out in window pixels, the viewport scales them with the rest of the scene
+        sprites::draw(cmd, state->current_frame, swapchain->extent);
 
-        vkCmdDraw(cmd, 6, 1, 0, 0);
         vulkan::context::end_label(cmd);
         vkCmdEndRendering(cmd);
     }
 
+    resolution::end_scene(cmd, state->current_frame);
+
+    {
+        vulkan::context::begin_label(cmd, "upscale", { 1, 0, 0, 1 });
+        VkImageMemoryBarrier2 scene_to_src = vulkan::context::image_layout_transition(
+            state->render_target.handle, VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_ACCESS_2_TRANSFER_READ_BIT,
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_2_BLIT_BIT);
+
+        // NOTE: the acquire semaphore is waited on at the blit stage, so the transition happens after it
+        VkImageMemoryBarrier2 swapchain_to_dst = vulkan::context::image_layout_transition(
+            swapchain->images[image_index], VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_ACCESS_2_NONE,
+            VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_BLIT_BIT,
+            VK_PIPELINE_STAGE_2_BLIT_BIT);
+
+        VkImageMemoryBarrier2 before_blit[] = { scene_to_src, swapchain_to_dst };
+
+        VkDependencyInfo before_dep {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext = nullptr,
+            .dependencyFlags = 0,
+            .memoryBarrierCount = 0,
+            .pMemoryBarriers = nullptr,
+            .bufferMemoryBarrierCount = 0,
+            .pBufferMemoryBarriers = nullptr,
+            .imageMemoryBarrierCount = 2,
+            .pImageMemoryBarriers = before_blit,
+        };
+        vkCmdPipelineBarrier2(cmd, &before_dep);
+
+        // NOTE: bilinear upscale and conversion to the swapchain format, HDR values above 1 are clamped
+        VkImageBlit2 region {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2,
+            .pNext = nullptr,
+            .srcSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+            .srcOffsets = { { 0, 0, 0 }, { (i32)extent.width, (i32)extent.height, 1 } },
+            .dstSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+            .dstOffsets = { { 0, 0, 0 }, { (i32)swapchain->extent.width, (i32)swapchain->extent.height, 1 } },
+        };
+
+        VkBlitImageInfo2 blit {
+            .sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2,
+            .pNext = nullptr,
+            .srcImage = state->render_target.handle,
+            .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .dstImage = swapchain->images[image_index],
+            .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .regionCount = 1,
+            .pRegions = &region,
+            .filter = VK_FILTER_LINEAR,
+        };
+        vkCmdBlitImage2(cmd, &blit);
+
+        VkImageMemoryBarrier2 to_attachment = vulkan::context::image_layout_transition(
+            swapchain->images[image_index], VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_BLIT_BIT,
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+        VkDependencyInfo after_dep {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext = nullptr,
+            .dependencyFlags = 0,
+            .memoryBarrierCount = 0,
+            .pMemoryBarriers = nullptr,
+            .bufferMemoryBarrierCount = 0,
+            .pBufferMemoryBarriers = nullptr,
+            .imageMemoryBarrierCount = 1,
+            .pImageMemoryBarriers = &to_attachment,
+        };
+        vkCmdPipelineBarrier2(cmd, &after_dep);
+        vulkan::context::end_label(cmd);
+    }
+
     {
         VkRenderingAttachmentInfo color_attachment {
             .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
@@ -484,6 +935,9 @@ bool draw(void)
         vkCmdBeginRendering(cmd, &rendering);
         vulkan::context::begin_label(cmd, "ImGui", { 1, 0, 0, 1 });
 
+        // NOTE: ImGui allocates when a window or header opens for the first time and its draw buffers follow the UI
+        RIN_ALLOW_ALLOC("renderer GUI");
+
         gui::prepare();
 
         ImGui::Begin("Tool", nullptr, 0);
@@ -491,6 +945,109 @@ bool draw(void)
         ImGui::Text("FPS: %llu", clock::get_fps());
         ImGui::SliderInt("Frame Buffering", (i32*)&state->in_flight_count, 1, MAX_CONCURRENT_FRAMES);
         ImGui::Text("Current value: %d", state->in_flight_count);
+        ImGui::CheckboxFlags("Grayscale variant", &state->features, TRIANGLE_FEATURE_GRAYSCALE);
+        ImGui::Text("Cached pipelines: %u", vulkan::pipeline_table::count());
+
+        if (ImGui::CollapsingHeader("Present")) {
+            i32 policy = (i32)swapchain->policy;
+            if (ImGui::Combo("Policy", &policy, PRESENT_POLICY_NAMES, vulkan::PRESENT_POLICY_COUNT)) {
+                vulkan::swapchain::set_present_policy((vulkan::present_policy_t)policy);
+                state->recreate_requested = true;
+            }
+            ImGui::Text("Present mode: %s", string_VkPresentModeKHR(swapchain->present_mode));
+
+            if (state->context->device->present_wait) {
+                ImGui::SliderInt("Queued presents", (i32*)&state->queued_presents, 0, MAX_QUEUED_PRESENTS,
+                    state->queued_presents == 0 ? "uncapped" : "%d");
+                ImGui::TextDisabled("Display latency and input to photon are in the profiler");
+            } else {
+                ImGui::TextDisabled("No VK_KHR_present_wait, display latency is not measured");
+            }
+        }
+
+        if (ImGui::CollapsingHeader("GPU scene")) {
+            ImGui::Checkbox("Enabled", &state->scene_enabled);
+            scene::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("Meshlets")) {
+            ImGui::Checkbox("Enabled##clusters", &state->clusters_enabled);
+            clusters::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("Lights")) {
+            lights::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("Resolution")) {
+            resolution::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("Memory")) {
+            vulkan::memory::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("Driver host memory")) {
+            vulkan::host_memory::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("Capture")) {
+            capture::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("Occlusion")) {
+            occlusion::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("CPU culling")) {
+            culling::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("BVH")) {
+            bvh::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("Debug draw")) {
+            debug_draw::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("Sprites")) {
+            sprites::draw_gui();
+        }
+
+        if (ImGui::CollapsingHeader("Profiler")) {
+            profiler::stat_t stats[profiler::PROFILER_MAX_STATS];
+            u32 stat_count = profiler::snapshot(stats, profiler::PROFILER_MAX_STATS);
+            for (u32 i = 0; i < stat_count; i++) {
+                ImGui::Text("%s: %.3f %s (avg %.3f, max %.3f)", stats[i].name, stats[i].last, stats[i].unit,
+                    stats[i].average, stats[i].max);
+            }
+
+            if (ImGui::Button("Reset")) {
+                profiler::reset();
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Allocations")) {
+            if (!allocations::enabled()) {
+                ImGui::TextDisabled("Built without RIN_TRACK_ALLOCATIONS");
+            } else {
+                bool abort_on_violation = allocations::violation_mode() == allocations::VIOLATION_MODE_ABORT;
+                if (ImGui::Checkbox("Abort on allocations in no alloc regions", &abort_on_violation)) {
+                    allocations::set_violation_mode(abort_on_violation ? allocations::VIOLATION_MODE_ABORT : allocations::VIOLATION_MODE_LOG);
+                }
+
+                allocations::site_t sites[allocations::ALLOCATIONS_REPORT_SITES];
+                u32 site_count = allocations::snapshot(sites, allocations::ALLOCATIONS_REPORT_SITES);
+                for (u32 i = 0; i < site_count; i++) {
+                    char name[256];
+                    allocations::describe(sites[i].address, name, sizeof(name));
+                    ImGui::Text("%s: %llu this frame, %llu total%s%s", name, (unsigned long long)sites[i].frame_count,
+                        (unsigned long long)sites[i].total_count, sites[i].region != nullptr ? ", in " : "",
+                        sites[i].region != nullptr ? sites[i].region : "");
+                }
+            }
+        }
         ImGui::End();
 
         gui::draw(cmd);
@@ -499,15 +1056,18 @@ bool draw(void)
         vkCmdEndRendering(cmd);
     }
 
+    // NOTE: the final image, GUI included, the copy leaves it in transfer source layout
+    bool captured = capture::record(cmd, swapchain->images[image_index], swapchain->extent, swapchain->format.format);
+
     {
         vulkan::context::begin_label(cmd, "present mode transition", { 1, 0, 0, 1 });
         VkImageMemoryBarrier2 to_present = vulkan::context::image_layout_transition(
             swapchain->images[image_index], VK_IMAGE_ASPECT_COLOR_BIT,
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            captured ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
             VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            captured ? VK_ACCESS_2_NONE : VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
             VK_ACCESS_2_NONE,
-            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            captured ? VK_PIPELINE_STAGE_2_COPY_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
             VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT);
 
         VkDependencyInfo dep {
@@ -541,7 +1101,7 @@ bool draw(void)
         .pNext = nullptr,
         .semaphore = state->image_acquired[state->current_frame],
         .value = 0,
-        .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .stageMask = VK_PIPELINE_STAGE_2_BLIT_BIT, // first write to the swapchain image
         .deviceIndex = 0,
     };
 
@@ -571,28 +1131,17 @@ bool draw(void)
         log::error("renderer::draw -> failed to submit command buffer: %s", string_VkResult(vk_result));
         return false;
     }
+    state->slot_frames[state->current_frame] = vulkan::context::end_frame();
+    vulkan::host_memory::end_frame();
 
     // NOTE: present
 
-    VkPresentInfoKHR present {
-        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .pNext = nullptr,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &swapchain->render_semaphores[image_index],
-        .swapchainCount = 1,
-        .pSwapchains = &swapchain->handle,
-        .pImageIndices = &image_index,
-        .pResults = nullptr,
-    };
-
-    vk_result = vkQueuePresentKHR(state->context->device->graphics_queue.handle, &present);
+    bool out_of_date = false;
+    vk_result = vulkan::swapchain::present(state->context->device->graphics_queue.handle,
+        swapchain->render_semaphores[image_index], image_index, input_time);
     switch (vk_result) {
     case VK_ERROR_OUT_OF_DATE_KHR:
-        if (!resize()) {
-            log::error("renderer::draw -> failed to resize swapchain");
-            return false;
-        }
-        return true;
+        out_of_date = true;
         break;
     case VK_SUBOPTIMAL_KHR:
         suboptimal = true;
@@ -600,18 +1149,25 @@ bool draw(void)
     case VK_SUCCESS:
         break;
     default:
-        log::error("renderer::draw -> failed to acquire swapchain image index: %s", string_VkResult(vk_result));
+        log::error("renderer::draw -> failed to present swapchain image: %s", string_VkResult(vk_result));
         return false;
     };
 
-    if (suboptimal) {
+    state->current_frame = (state->current_frame + 1) % state->in_flight_count;
+
+    // NOTE: an out of date swapchain cannot present anymore, a suboptimal one keeps going until the size settles
+    if (suboptimal && !state->resize_requested) {
+        request_resize();
+    }
+
+    bool settled = state->resize_requested && clock::get_time_s() - state->resize_time >= RESIZE_DEBOUNCE_S;
+    if (out_of_date || settled || state->recreate_requested) {
         if (!resize()) {
             log::error("renderer::draw -> failed to resize swapchain");
             return false;
         }
     }
 
-    state->current_frame = (state->current_frame + 1) % state->in_flight_count;
     return true;
 }
 }
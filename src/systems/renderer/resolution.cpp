@@ -0,0 +1,184 @@
+#include "resolution.hpp"
+
+#include "core/logger.hpp"
+#include "core/profiler.hpp"
+#include "vk/host_memory.hpp"
+
+#include <glm/glm.hpp>
+#include <imgui.h>
+#include <vulkan/vk_enum_string_helper.h>
+
+namespace rin::renderer::resolution {
+
+constexpr f32 RESOLUTION_HEADROOM = 0.9f; // of the budget the controller aims for, absorbs frame to frame noise
+constexpr f32 RESOLUTION_DEAD_BAND = 0.05f; // relative error around the target left alone
+constexpr f32 RESOLUTION_DOWN_RATE = 0.3f; // fraction of the correction applied per frame
+constexpr f32 RESOLUTION_UP_RATE = 0.05f;
+constexpr f32 RESOLUTION_SMOOTHING = 0.2f; // weight of a new sample in the averaged GPU time
+
+struct state_t {
+    vulkan::context_t* context;
+    VkQueryPool query_pool; // two timestamps per frame slot, VK_NULL_HANDLE when the queue cannot time
+    f64 tick_ms; // timestampPeriod in milliseconds
+    u32 frame_count;
+    u32 written; // bit per frame slot, whether its timestamps were recorded at least once
+    bool dynamic; // controller on, the scale is left to the GUI otherwise
+    f32 scale;
+    f32 min_scale;
+    f32 budget_ms;
+    f32 gpu_ms; // averaged
+    f32 last_gpu_ms;
+};
+
+static state_t* state = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(vulkan::context_t* context, u32 frame_count)
+{
+    if (state != nullptr) {
+        log::error("resolution::create -> dynamic resolution has been already created");
+        return false;
+    }
+
+    state = (state_t*)calloc(1, sizeof(state_t));
+    state->context = context;
+    state->frame_count = frame_count;
+    state->dynamic = true;
+    state->scale = RESOLUTION_MAX_SCALE;
+    state->min_scale = 0.5f;
+    state->budget_ms = RESOLUTION_DEFAULT_BUDGET_MS;
+
+    const VkPhysicalDeviceLimits& limits = context->device->properties.limits;
+    if (!limits.timestampComputeAndGraphics) {
+        // NOTE: not fatal, the scale just stays where the GUI puts it
+        log::warn("resolution::create -> graphics queue has no timestamps, dynamic resolution disabled");
+        state->dynamic = false;
+        return true;
+    }
+    state->tick_ms = (f64)limits.timestampPeriod / 1e6;
+
+    VkQueryPoolCreateInfo pool_info {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2 * frame_count,
+        .pipelineStatistics = 0,
+    };
+
+    VkResult result = vkCreateQueryPool(context->device->logical_device, &pool_info, vulkan::host_memory::callbacks(), &state->query_pool);
+    if (result != VK_SUCCESS) {
+        log::error("resolution::create -> failed to create query pool: %s", string_VkResult(result));
+        destroy();
+        return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(void)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    if (state->query_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(state->context->device->logical_device, state->query_pool, vulkan::host_memory::callbacks());
+    }
+
+    free(state);
+    state = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void step(f32 gpu_ms)
+{
+    state->last_gpu_ms = gpu_ms;
+    state->gpu_ms = state->gpu_ms == 0.0f ? gpu_ms : glm::mix(state->gpu_ms, gpu_ms, RESOLUTION_SMOOTHING);
+
+    if (!state->dynamic) {
+        return;
+    }
+
+    f32 target_ms = state->budget_ms * RESOLUTION_HEADROOM;
+    if (glm::abs(state->gpu_ms - target_ms) < target_ms * RESOLUTION_DEAD_BAND) {
+        return;
+    }
+
+    // NOTE: the scene cost follows the pixel count, the square of the scale. Drops faster than it climbs back,
+    // a missed budget costs a frame while a low scale only costs sharpness
+    f32 ideal = state->scale * glm::sqrt(target_ms / glm::max(state->gpu_ms, 0.01f));
+    f32 rate = ideal < state->scale ? RESOLUTION_DOWN_RATE : RESOLUTION_UP_RATE;
+    state->scale = glm::clamp(state->scale + (ideal - state->scale) * rate, state->min_scale, RESOLUTION_MAX_SCALE);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void begin_frame(VkCommandBuffer cmd, u32 frame)
+{
+    profiler::record("render scale", "%", (f64)state->scale * 100.0);
+
+    if (state->query_pool == VK_NULL_HANDLE) {
+        return;
+    }
+
+    u32 first = frame * 2;
+    if ((state->written & (1u << frame)) != 0) {
+        u64 ticks[2] = {};
+        VkResult result = vkGetQueryPoolResults(state->context->device->logical_device, state->query_pool, first, 2,
+            sizeof(ticks), ticks, sizeof(u64), VK_QUERY_RESULT_64_BIT);
+
+        if (result == VK_SUCCESS && ticks[1] >= ticks[0]) {
+            f32 gpu_ms = (f32)((f64)(ticks[1] - ticks[0]) * state->tick_ms);
+            step(gpu_ms);
+            profiler::record("scene gpu", "ms", (f64)gpu_ms);
+        }
+    }
+
+    vkCmdResetQueryPool(cmd, state->query_pool, first, 2);
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, state->query_pool, first);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void end_scene(VkCommandBuffer cmd, u32 frame)
+{
+    if (state->query_pool == VK_NULL_HANDLE) {
+        return;
+    }
+
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, state->query_pool, frame * 2 + 1);
+    state->written |= 1u << frame;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+VkExtent2D scaled_extent(VkExtent2D full)
+{
+    return VkExtent2D {
+        .width = glm::clamp((u32)((f32)full.width * state->scale + 0.5f), 1u, full.width),
+        .height = glm::clamp((u32)((f32)full.height * state->scale + 0.5f), 1u, full.height),
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    if (state->query_pool != VK_NULL_HANDLE) {
+        ImGui::Checkbox("Dynamic resolution", &state->dynamic);
+    } else {
+        ImGui::TextDisabled("No timestamps on the graphics queue, fixed scale only");
+    }
+
+    if (state->dynamic) {
+        ImGui::SliderFloat("GPU budget", &state->budget_ms, 1.0f, 33.0f, "%.1f ms");
+        ImGui::SliderFloat("Minimum scale", &state->min_scale, RESOLUTION_MIN_SCALE, RESOLUTION_MAX_SCALE, "%.2f");
+    } else {
+        ImGui::SliderFloat("Scale", &state->scale, RESOLUTION_MIN_SCALE, RESOLUTION_MAX_SCALE, "%.2f");
+    }
+
+    ImGui::Text("Scale: %.0f%%, %.0f%% of the pixels", state->scale * 100.0f, state->scale * state->scale * 100.0f);
+    if (state->query_pool != VK_NULL_HANDLE) {
+        ImGui::Text("Scene GPU: %.3f ms (avg %.3f ms)", state->last_gpu_ms, state->gpu_ms);
+    }
+}
+
+}
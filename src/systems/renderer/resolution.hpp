@@ -0,0 +1,26 @@
+#pragma once
+
+#include "vk/types.hpp"
+
+namespace rin::renderer::resolution {
+
+constexpr f32 RESOLUTION_MIN_SCALE = 0.25f; // per axis, of the swapchain extent
+constexpr f32 RESOLUTION_MAX_SCALE = 1.0f;
+constexpr f32 RESOLUTION_DEFAULT_BUDGET_MS = 12.0f; // scene GPU time, the upscale and the GUI come on top
+
+// Dynamic resolution: the scene renders into the top left corner of targets sized to the swapchain, at a scale the
+// controller picks from the GPU time of the scene passes, and is then upscaled into the swapchain image.
+bool create(vulkan::context_t* context, u32 frame_count);
+void destroy(void);
+
+// begin_frame() reads the timestamps the slot wrote on its last use, its fence has been waited on, steps the
+// controller and writes the first timestamp of the frame. end_scene() writes the second one, before the upscale.
+void begin_frame(VkCommandBuffer cmd, u32 frame);
+void end_scene(VkCommandBuffer cmd, u32 frame);
+
+// Extent the scene renders at this frame, at least 1x1 and never larger than full.
+VkExtent2D scaled_extent(VkExtent2D full);
+
+void draw_gui(void);
+
+}
@@ -0,0 +1,882 @@
+#include "scene.hpp"
+
+#include "camera.hpp"
+#include "core/allocations.hpp"
+#include "core/clock.hpp"
+#include "core/containers/darray.hpp"
+#include "core/containers/hashmap.hpp"
+#include "core/hash.hpp"
+#include "core/jobs.hpp"
+#include "core/logger.hpp"
+#include "core/profiler.hpp"
+#include "lights.hpp"
+#include "mesh.hpp"
+#include "mesh_optimizer.hpp"
+#include "vertex_format.hpp"
+#include "vk/context.hpp"
+#include "vk/host_memory.hpp"
+#include "vk/pipeline.hpp"
+#include "vk/pipeline_table.hpp"
+#include "vk/utils.hpp"
+
+#include <cstring>
+#include <glm/gtc/constants.hpp>
+#include <imgui.h>
+
+namespace rin::renderer::scene {
+
+constexpr u32 SCENE_DEFAULT_INSTANCES = 10000;
+
+struct frame_resources_t {
+    vulkan::buffer_t frame; // host visible scene_frame_t
+    vulkan::buffer_t draws; // written by the cull passes, read as indirect commands
+    vulkan::buffer_t counts; // scene_counts_t
+    vulkan::buffer_t readback; // counts copied back for the stats
+    VkDeviceAddress lights; // light grid of the same slot
+};
+
+struct state_t {
+    vulkan::context_t* context;
+    darray<frame_resources_t> frames;
+    vulkan::buffer_t instances;
+    vulkan::buffer_t meshes;
+    vulkan::buffer_t vertices[2]; // per vertex_format_t, the draw reads the one matching its variant
+    vulkan::buffer_t indices;
+    vulkan::buffer_t visibility; // shared by every frame, each late pass leaves it for the next early one
+    bool reset_visibility; // instances changed, cleared by the next early cull()
+    VkIndexType index_type; // 16 bit unless a mesh has more vertices than they can reach
+    u32 mesh_count;
+    u32 instance_count;
+    i32 requested_count; // applied at the start of the next cull()
+    VkShaderModule cull_module;
+    VkShaderModule vert_module;
+    VkShaderModule frag_module;
+    VkPipelineLayout layout; // owned by the pipeline table
+    u64 cull_key;
+    vulkan::pipeline_table::variant_set_t* draw_variants; // specialized per scene_feature_t mask
+    vulkan::pipeline_table::variant_set_t* depth_variants; // same without a fragment shader, for the prepass
+    vertex_format::vertex_format_t vertex_format; // picked at load, can be overridden from the GUI
+    bool ready; // every pipeline resolved for the current frame
+    VkPipeline cull_pipeline;
+    VkPipeline depth_pipeline;
+    VkPipeline draw_pipeline;
+    camera::camera_t camera;
+    bool orbit;
+    f32 lod_scale;
+    scene_counts_t counts; // of the last frame read back
+    f64 record_time_s;
+};
+
+struct geometry_t {
+    darray<vertex_format::vertex_attributes_t> vertices;
+    darray<u32> indices;
+    darray<mesh_t> meshes;
+};
+
+struct fill_data_t {
+    instance_t* instances;
+    u32 mesh_count;
+    f32 extent;
+};
+
+static state_t* state = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static f32 unit_float(u32 x)
+{
+    return (f32)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void add_icosphere(geometry_t& geometry)
+{
+    const f32 t = (1.0f + glm::sqrt(5.0f)) * 0.5f;
+
+    darray<glm::vec3> positions { 1024, false };
+    const glm::vec3 base[12] = {
+        { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+        { 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+        { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 },
+    };
+    for (u32 i = 0; i < 12; i++) {
+        positions.push(glm::normalize(base[i]));
+    }
+
+    const u32 faces[20][3] = {
+        { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+        { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+        { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+        { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 },
+    };
+
+    // NOTE: levels[0] is the icosahedron, every level splits each triangle in 4 and only appends vertices,
+    // so all of them index the same vertex range and the mesh needs a single vertex offset
+    darray<u32> levels[SCENE_MAX_LODS] = { { true }, { true }, { true }, { true } };
+    for (u32 i = 0; i < 20; i++) {
+        u32 a = faces[i][0], b = faces[i][1], c = faces[i][2];
+
+        // NOTE: outward facing counter clockwise winding, subdivision preserves it
+        glm::vec3 normal = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+        if (glm::dot(normal, positions[a] + positions[b] + positions[c]) < 0.0f) {
+            u32 tmp = b;
+            b = c;
+            c = tmp;
+        }
+
+        levels[0].push(a);
+        levels[0].push(b);
+        levels[0].push(c);
+    }
+
+    hashmap<u32> midpoints { 1024 };
+    for (u32 level = 1; level < SCENE_MAX_LODS; level++) {
+        const darray<u32>& coarse = levels[level - 1];
+
+        for (size_t i = 0; i < coarse.len; i += 3) {
+            u32 corners[3] = { coarse[i], coarse[i + 1], coarse[i + 2] };
+            u32 mids[3];
+
+            for (u32 e = 0; e < 3; e++) {
+                u32 v0 = corners[e];
+                u32 v1 = corners[(e + 1) % 3];
+                u64 key = v0 < v1 ? ((u64)v0 << 32) | v1 : ((u64)v1 << 32) | v0;
+
+                u32* found = midpoints.find(key);
+                if (found != nullptr) {
+                    mids[e] = *found;
+                    continue;
+                }
+
+                mids[e] = (u32)positions.len;
+                positions.push(glm::normalize(positions[v0] + positions[v1]));
+                midpoints.insert(key, mids[e]);
+            }
+
+            const u32 split[4][3] = {
+                { corners[0], mids[0], mids[2] },
+                { corners[1], mids[1], mids[0] },
+                { corners[2], mids[2], mids[1] },
+                { mids[0], mids[1], mids[2] },
+            };
+
+            for (u32 j = 0; j < 4; j++) {
+                levels[level].push(split[j][0]);
+                levels[level].push(split[j][1]);
+                levels[level].push(split[j][2]);
+            }
+        }
+    }
+
+    mesh_t mesh {
+        .position_offset = glm::vec4(0.0f),
+        .position_scale = glm::vec4(0.0f),
+        .radius = 0.5f,
+        .vertex_offset = (i32)geometry.vertices.len,
+        .lod_count = SCENE_MAX_LODS,
+        .pad = 0,
+        .lods = {},
+    };
+
+    for (size_t i = 0; i < positions.len; i++) {
+        // NOTE: equirectangular UVs, the tangent follows increasing u around the Y axis
+        glm::vec3 n = positions[i];
+        glm::vec3 tangent = glm::vec3(-n.z, 0.0f, n.x);
+        tangent = glm::dot(tangent, tangent) > 1e-6f ? glm::normalize(tangent) : glm::vec3(1.0f, 0.0f, 0.0f);
+
+        geometry.vertices.push(vertex_format::vertex_attributes_t {
+            .position = n * 0.5f,
+            .normal = n,
+            .tangent = glm::vec4(tangent, 1.0f),
+            .uv = glm::vec2(glm::atan(n.x, n.z) / (2.0f * glm::pi<f32>()) + 0.5f, glm::acos(n.y) / glm::pi<f32>()),
+        });
+    }
+
+    for (u32 lod = 0; lod < SCENE_MAX_LODS; lod++) {
+        const darray<u32>& level = levels[SCENE_MAX_LODS - 1 - lod];
+        mesh.lods[lod] = mesh_lod_t { (u32)geometry.indices.len, (u32)level.len };
+        for (size_t i = 0; i < level.len; i++) {
+            geometry.indices.push(level[i]);
+        }
+    }
+
+    geometry.meshes.push(mesh);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void add_cube(geometry_t& geometry)
+{
+    mesh_t mesh {
+        .position_offset = glm::vec4(0.0f),
+        .position_scale = glm::vec4(0.0f),
+        .radius = glm::sqrt(3.0f) * 0.5f,
+        .vertex_offset = (i32)geometry.vertices.len,
+        .lod_count = 1,
+        .pad = 0,
+        .lods = {},
+    };
+    mesh.lods[0].first_index = (u32)geometry.indices.len;
+
+    const glm::vec3 normals[6] = {
+        { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+    };
+
+    for (u32 face = 0; face < 6; face++) {
+        glm::vec3 n = normals[face];
+        glm::vec3 u = glm::vec3(n.y, n.z, n.x);
+        glm::vec3 v = glm::cross(n, u);
+
+        u32 base = (u32)geometry.vertices.len - (u32)mesh.vertex_offset;
+        const glm::vec2 corners[4] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+        for (u32 i = 0; i < 4; i++) {
+            geometry.vertices.push(vertex_format::vertex_attributes_t {
+                .position = (n + u * corners[i].x + v * corners[i].y) * 0.5f,
+                .normal = n,
+                .tangent = glm::vec4(u, 1.0f),
+                .uv = corners[i] * 0.5f + 0.5f,
+            });
+        }
+
+        // NOTE: v = n x u so (u, v) is counter clockwise seen from outside
+        const u32 quad[6] = { 0, 1, 2, 0, 2, 3 };
+        for (u32 i = 0; i < 6; i++) {
+            geometry.indices.push(base + quad[i]);
+        }
+    }
+
+    mesh.lods[0].index_count = (u32)geometry.indices.len - mesh.lods[0].first_index;
+    geometry.meshes.push(mesh);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void fill_instances(u32 begin, u32 end, void* data)
+{
+    fill_data_t* fill = (fill_data_t*)data;
+
+    for (u32 i = begin; i < end; i++) {
+        u32 seed = i * 5;
+        glm::vec3 position {
+            (unit_float(hash::mix32(seed + 0)) - 0.5f) * fill->extent,
+            (unit_float(hash::mix32(seed + 1)) - 0.5f) * fill->extent,
+            (unit_float(hash::mix32(seed + 2)) - 0.5f) * fill->extent,
+        };
+        f32 scale = 0.3f + 0.7f * unit_float(hash::mix32(seed + 3));
+        u32 bits = hash::mix32(seed + 4);
+
+        fill->instances[i] = instance_t {
+            .position_scale = glm::vec4(position, scale),
+            .mesh = bits % fill->mesh_count,
+            .color = bits | 0xFF000000u,
+            .pad = { 0, 0 },
+        };
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool upload_instances(u32 count)
+{
+    RIN_ALLOW_ALLOC("scene::upload_instances on an instance count change");
+    darray<instance_t> instances { count, false };
+    instances.len = count;
+
+    // NOTE: keeps the density constant, roughly 2 units between neighbours
+    fill_data_t fill {
+        .instances = instances.data,
+        .mesh_count = state->mesh_count,
+        .extent = 2.0f * glm::pow((f32)count, 1.0f / 3.0f),
+    };
+    jobs::parallel_for(count, 4096, fill_instances, &fill);
+
+    if (!vulkan::context::upload_buffer(state->instances, 0, instances.data, sizeof(instance_t) * count)) {
+        log::error("scene::upload_instances -> failed to upload %u instances", count);
+        return false;
+    }
+
+    state->instance_count = count;
+    state->reset_visibility = true;
+    log::debug("scene: uploaded %u instances", count);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 optimize_geometry(geometry_t& geometry)
+{
+    u32 max_vertex_count = 0;
+
+    for (size_t m = 0; m < geometry.meshes.len; m++) {
+        const mesh_t& mesh = geometry.meshes[m];
+        u32 vertex_end = m + 1 < geometry.meshes.len ? (u32)geometry.meshes[m + 1].vertex_offset : (u32)geometry.vertices.len;
+        u32 vertex_count = vertex_end - (u32)mesh.vertex_offset;
+
+        // NOTE: indices are relative to vertex_offset, LODs are stored back to back from the most detailed one
+        u32* indices = geometry.indices.data + mesh.lods[0].first_index;
+        u32 index_count = 0;
+
+        mesh_optimizer::cache_stats_t before = mesh_optimizer::analyze_vertex_cache(
+            indices, mesh.lods[0].index_count, vertex_count, mesh_optimizer::MESH_OPTIMIZER_FIFO_SIZE);
+
+        for (u32 lod = 0; lod < mesh.lod_count; lod++) {
+            mesh_optimizer::optimize_vertex_cache(geometry.indices.data + mesh.lods[lod].first_index, mesh.lods[lod].index_count, vertex_count);
+            index_count += mesh.lods[lod].index_count;
+        }
+
+        // NOTE: every vertex is used by LOD 0, so the vertex count and the offsets of the next meshes stay the same
+        mesh_optimizer::optimize_vertex_fetch(geometry.vertices.data + mesh.vertex_offset, indices, index_count,
+            vertex_count, sizeof(vertex_format::vertex_attributes_t));
+
+        mesh_optimizer::cache_stats_t after = mesh_optimizer::analyze_vertex_cache(
+            indices, mesh.lods[0].index_count, vertex_count, mesh_optimizer::MESH_OPTIMIZER_FIFO_SIZE);
+
+        log::info("scene mesh %zu: %u vertices, LOD 0 ACMR %.3f -> %.3f", m, vertex_count, before.acmr, after.acmr);
+
+        if (vertex_count > max_vertex_count) {
+            max_vertex_count = vertex_count;
+        }
+    }
+
+    return max_vertex_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static vertex_format::vertex_format_t quantize_geometry(geometry_t& geometry, darray<vertex_format::quantized_vertex_t>& out)
+{
+    vertex_format::vertex_format_t format = vertex_format::VERTEX_FORMAT_QUANTIZED;
+    out.reserve(geometry.vertices.len);
+    out.len = geometry.vertices.len;
+
+    for (size_t m = 0; m < geometry.meshes.len; m++) {
+        mesh_t& mesh = geometry.meshes[m];
+        u32 vertex_end = m + 1 < geometry.meshes.len ? (u32)geometry.meshes[m + 1].vertex_offset : (u32)geometry.vertices.len;
+        u32 vertex_count = vertex_end - (u32)mesh.vertex_offset;
+
+        const vertex_format::vertex_attributes_t* vertices = geometry.vertices.data + mesh.vertex_offset;
+        vertex_format::quantization_t quantization = vertex_format::compute_quantization(vertices, vertex_count);
+        vertex_format::encode(vertices, vertex_count, quantization, out.data + mesh.vertex_offset);
+
+        mesh.position_offset = glm::vec4(quantization.offset, 0.0f);
+        mesh.position_scale = glm::vec4(quantization.scale, 0.0f);
+
+        // NOTE: the meshes share one draw, so a single mesh too large for 16 bits keeps everything in floats
+        if (vertex_format::choose_format(quantization, SCENE_MAX_POSITION_ERROR) != vertex_format::VERTEX_FORMAT_QUANTIZED) {
+            format = vertex_format::VERTEX_FORMAT_FLOAT;
+        }
+    }
+
+    log::info("scene vertices: %zu bytes as floats, %zu quantized, drawing %s",
+        sizeof(vertex_format::vertex_attributes_t) * geometry.vertices.len,
+        sizeof(vertex_format::quantized_vertex_t) * out.len,
+        format == vertex_format::VERTEX_FORMAT_QUANTIZED ? "quantized" : "floats");
+    return format;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool upload_geometry(void)
+{
+    geometry_t geometry {
+        .vertices = darray<vertex_format::vertex_attributes_t> { true },
+        .indices = darray<u32> { true },
+        .meshes = darray<mesh_t> { true },
+    };
+
+    add_icosphere(geometry);
+    add_cube(geometry);
+    state->mesh_count = (u32)geometry.meshes.len;
+    state->index_type = mesh::index_type(optimize_geometry(geometry));
+
+    // NOTE: both encodings are kept so the GUI can compare them, the quantized one is a fraction of the size
+    darray<vertex_format::quantized_vertex_t> quantized { true };
+    state->vertex_format = quantize_geometry(geometry, quantized);
+
+    // NOTE: every mesh shares the index buffer so it takes the widest type any of them needs
+    u32 index_count = (u32)geometry.indices.len;
+    darray<u8> packed { (u64)index_count * mesh::index_size(state->index_type), false };
+    mesh::write_indices(state->index_type, geometry.indices.data, index_count, packed.data);
+
+    const void* vertex_data[2] = { geometry.vertices.data, quantized.data };
+    for (u32 format = 0; format < 2; format++) {
+        vulkan::buffer_create_info_t vertex_info {
+            .size = (u64)vertex_format::stride((vertex_format::vertex_format_t)format) * geometry.vertices.len,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = true,
+            .tag = vulkan::MEMORY_TAG_GEOMETRY,
+        };
+
+        if (!vulkan::context::allocate_buffer(vertex_info, &state->vertices[format])
+            || !vulkan::context::upload_buffer(state->vertices[format], 0, vertex_data[format], vertex_info.size)) {
+            log::error("scene::upload_geometry -> failed to upload vertices");
+            return false;
+        }
+    }
+
+    vulkan::buffer_create_info_t index_info {
+        .size = (u64)index_count * mesh::index_size(state->index_type),
+        .usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = true,
+        .tag = vulkan::MEMORY_TAG_GEOMETRY,
+    };
+
+    vulkan::buffer_create_info_t mesh_info {
+        .size = sizeof(mesh_t) * geometry.meshes.len,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = true,
+        .tag = vulkan::MEMORY_TAG_GEOMETRY,
+    };
+
+    if (!vulkan::context::allocate_buffer(index_info, &state->indices)
+        || !vulkan::context::allocate_buffer(mesh_info, &state->meshes)) {
+        log::error("scene::upload_geometry -> failed to allocate geometry buffers");
+        return false;
+    }
+
+    return vulkan::context::upload_buffer(state->indices, 0, packed.data, index_info.size)
+        && vulkan::context::upload_buffer(state->meshes, 0, geometry.meshes.data, mesh_info.size);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(vulkan::context_t* context, u32 frame_count, VkFormat color_format, VkFormat depth_format)
+{
+    if (state != nullptr) {
+        log::error("scene::create -> scene has been already created");
+        return false;
+    }
+
+    state = (state_t*)calloc(1, sizeof(state_t));
+    state->context = context;
+    state->frames = darray<frame_resources_t> { frame_count, true };
+    state->frames.len = frame_count;
+    state->requested_count = SCENE_DEFAULT_INSTANCES;
+    state->orbit = true;
+    state->lod_scale = 8.0f;
+    state->camera = camera::camera_t {
+        .position = glm::vec3(0.0f),
+        .yaw = 0.0f,
+        .pitch = 0.0f,
+        .fov_y = glm::radians(60.0f),
+        .z_near = 0.1f,
+        .z_far = 1000.0f,
+    };
+
+    for (u32 i = 0; i < frame_count; i++) {
+        frame_resources_t& frame = state->frames[i];
+        frame.lights = lights::frame_address(i);
+
+        vulkan::buffer_create_info_t frame_info {
+            .size = sizeof(scene_frame_t),
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = false,
+            .tag = vulkan::MEMORY_TAG_SCENE,
+        };
+
+        vulkan::buffer_create_info_t draws_info {
+            .size = sizeof(VkDrawIndexedIndirectCommand) * SCENE_MAX_INSTANCES * 2,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = true,
+            .tag = vulkan::MEMORY_TAG_SCENE,
+        };
+
+        vulkan::buffer_create_info_t counts_info {
+            .size = sizeof(scene_counts_t),
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = true,
+            .tag = vulkan::MEMORY_TAG_SCENE,
+        };
+
+        vulkan::buffer_create_info_t readback_info {
+            .size = sizeof(scene_counts_t),
+            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .memory_usage = VMA_MEMORY_USAGE_AUTO,
+            .device_local = false,
+            .tag = vulkan::MEMORY_TAG_SCENE,
+        };
+
+        if (!vulkan::context::allocate_buffer(frame_info, &frame.frame)
+            || !vulkan::context::allocate_buffer(draws_info, &frame.draws)
+            || !vulkan::context::allocate_buffer(counts_info, &frame.counts)
+            || !vulkan::context::allocate_buffer(readback_info, &frame.readback)) {
+            log::error("scene::create -> failed to allocate frame buffers");
+            destroy();
+            return false;
+        }
+        memset(frame.readback.allocation_info.pMappedData, 0, sizeof(scene_counts_t));
+        vmaFlushAllocation(context->vma, frame.readback.memory, 0, VK_WHOLE_SIZE);
+    }
+
+    vulkan::buffer_create_info_t instance_info {
+        .size = sizeof(instance_t) * SCENE_MAX_INSTANCES,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = true,
+        .tag = vulkan::MEMORY_TAG_SCENE,
+    };
+
+    vulkan::buffer_create_info_t visibility_info {
+        .size = sizeof(u32) * SCENE_MAX_INSTANCES,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = true,
+        .tag = vulkan::MEMORY_TAG_SCENE,
+    };
+
+    if (!vulkan::context::allocate_buffer(instance_info, &state->instances)
+        || !vulkan::context::allocate_buffer(visibility_info, &state->visibility)) {
+        log::error("scene::create -> failed to allocate instance buffers");
+        destroy();
+        return false;
+    }
+
+    if (!upload_geometry() || !upload_instances(SCENE_DEFAULT_INSTANCES)) {
+        log::error("scene::create -> failed to upload scene data");
+        destroy();
+        return false;
+    }
+
+    VkDevice device = context->device->logical_device;
+    vulkan::reflection::shader_reflection_t cull_reflection {};
+    vulkan::reflection::shader_reflection_t vert_reflection {};
+    vulkan::reflection::shader_reflection_t frag_reflection {};
+
+    if (!vulkan::utils::load_shader_module(device, "resources/shaders/scene_cull.comp.spv", &state->cull_module, &cull_reflection)
+        || !vulkan::utils::load_shader_module(device, "resources/shaders/scene.vert.spv", &state->vert_module, &vert_reflection)
+        || !vulkan::utils::load_shader_module(device, "resources/shaders/scene.frag.spv", &state->frag_module, &frag_reflection)) {
+        log::error("scene::create -> failed to load shader modules");
+        destroy();
+        return false;
+    }
+
+    // NOTE: one layout for the cull and draw pipelines, the push constants are shared
+    const vulkan::reflection::shader_reflection_t* stages[] = { &cull_reflection, &vert_reflection, &frag_reflection };
+    if (!vulkan::pipeline_table::get_layout(stages, 3, &state->layout)) {
+        log::error("scene::create -> failed to create pipeline layout");
+        destroy();
+        return false;
+    }
+
+    vulkan::pipeline_builder_t cull_builder {};
+    cull_builder
+        .set_compute_shader(state->cull_module)
+        .set_layout(state->layout);
+    state->cull_key = vulkan::pipeline_table::request(cull_builder);
+
+    vulkan::pipeline_builder_t draw_builder {};
+    draw_builder
+        .set_multisampling_none()
+        .disable_blending()
+        .enable_depthtest(false, VK_COMPARE_OP_LESS_OR_EQUAL)
+        .set_color_attachment_format(color_format)
+        .set_depth_format(depth_format)
+        .set_cull_mode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE)
+        .set_polygon_mode(VK_POLYGON_MODE_FILL)
+        .set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+        .set_shaders(state->vert_module, state->frag_module)
+        .set_layout(state->layout);
+
+    // NOTE: both vertex formats are requested up front so switching them from the GUI doesn't stall
+    state->draw_variants = vulkan::pipeline_table::create_variant_set(draw_builder);
+    vulkan::pipeline_table::request_variant(state->draw_variants, 0);
+    vulkan::pipeline_table::request_variant(state->draw_variants, SCENE_FEATURE_QUANTIZED);
+
+    vulkan::pipeline_builder_t depth_builder = draw_builder;
+    depth_builder
+        .enable_depthtest(true, VK_COMPARE_OP_LESS)
+        .set_color_attachment_format(VK_FORMAT_UNDEFINED)
+        .set_shaders(state->vert_module, VK_NULL_HANDLE);
+
+    state->depth_variants = vulkan::pipeline_table::create_variant_set(depth_builder);
+    vulkan::pipeline_table::request_variant(state->depth_variants, 0);
+    vulkan::pipeline_table::request_variant(state->depth_variants, SCENE_FEATURE_QUANTIZED);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(void)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    VkDevice device = state->context->device->logical_device;
+    vkDeviceWaitIdle(device);
+
+    if (state->cull_module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, state->cull_module, vulkan::host_memory::callbacks());
+    }
+
+    if (state->vert_module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, state->vert_module, vulkan::host_memory::callbacks());
+    }
+
+    if (state->frag_module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, state->frag_module, vulkan::host_memory::callbacks());
+    }
+
+    for (size_t i = 0; i < state->frames.len; i++) {
+        vulkan::context::destroy_buffer(&state->frames[i].frame);
+        vulkan::context::destroy_buffer(&state->frames[i].draws);
+        vulkan::context::destroy_buffer(&state->frames[i].counts);
+        vulkan::context::destroy_buffer(&state->frames[i].readback);
+    }
+    state->frames.~darray();
+
+    vulkan::pipeline_table::destroy_variant_set(state->draw_variants);
+    vulkan::pipeline_table::destroy_variant_set(state->depth_variants);
+    vulkan::context::destroy_buffer(&state->instances);
+    vulkan::context::destroy_buffer(&state->visibility);
+    vulkan::context::destroy_buffer(&state->meshes);
+    vulkan::context::destroy_buffer(&state->vertices[vertex_format::VERTEX_FORMAT_FLOAT]);
+    vulkan::context::destroy_buffer(&state->vertices[vertex_format::VERTEX_FORMAT_QUANTIZED]);
+    vulkan::context::destroy_buffer(&state->indices);
+
+    free(state);
+    state = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static scene_push_constants_t push_constants(const frame_resources_t& frame, occlusion::cull_phase_t phase)
+{
+    return scene_push_constants_t {
+        .lights = frame.lights,
+        .frame = frame.frame.address,
+        .instances = state->instances.address,
+        .meshes = state->meshes.address,
+        .vertices = state->vertices[state->vertex_format].address,
+        .draws = frame.draws.address,
+        .counts = frame.counts.address,
+        .visibility = state->visibility.address,
+        .phase = phase,
+        .pad = 0,
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void memory_barrier(VkCommandBuffer cmd, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access,
+    VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access)
+{
+    VkMemoryBarrier2 barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = src_stage,
+        .srcAccessMask = src_access,
+        .dstStageMask = dst_stage,
+        .dstAccessMask = dst_access,
+    };
+
+    VkDependencyInfo dep {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = nullptr,
+        .imageMemoryBarrierCount = 0,
+        .pImageMemoryBarriers = nullptr,
+    };
+    vkCmdPipelineBarrier2(cmd, &dep);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void dispatch(VkCommandBuffer cmd, const frame_resources_t& frame, occlusion::cull_phase_t phase)
+{
+    scene_push_constants_t constants = push_constants(frame, phase);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, state->cull_pipeline);
+    vkCmdPushConstants(cmd, state->layout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+    vkCmdDispatch(cmd, (state->instance_count + SCENE_CULL_GROUP_SIZE - 1) / SCENE_CULL_GROUP_SIZE, 1, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void cull(VkCommandBuffer cmd, u32 frame_index, VkExtent2D extent, occlusion::cull_phase_t phase)
+{
+    f64 start = clock::get_time_s();
+    frame_resources_t& frame = state->frames[frame_index];
+
+    if (phase == occlusion::CULL_PHASE_LATE) {
+        if (!state->ready) {
+            return;
+        }
+
+        vulkan::context::begin_label(cmd, "scene cull late", { 0, 1, 0, 1 });
+        dispatch(cmd, frame, phase);
+
+        memory_barrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COPY_BIT,
+            VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
+
+        VkBufferCopy region {
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size = sizeof(scene_counts_t),
+        };
+        vkCmdCopyBuffer(cmd, frame.counts.handle, frame.readback.handle, 1, &region);
+
+        vulkan::context::end_label(cmd);
+        state->record_time_s += clock::get_time_s() - start;
+        return;
+    }
+
+    if ((u32)state->requested_count != state->instance_count) {
+        upload_instances((u32)state->requested_count);
+        state->requested_count = (i32)state->instance_count;
+    }
+
+    u32 features = state->vertex_format == vertex_format::VERTEX_FORMAT_QUANTIZED ? SCENE_FEATURE_QUANTIZED : 0;
+    u64 draw_key = vulkan::pipeline_table::request_variant(state->draw_variants, features);
+    u64 depth_key = vulkan::pipeline_table::request_variant(state->depth_variants, features);
+
+    state->ready = vulkan::pipeline_table::resolve(state->cull_key, &state->cull_pipeline) == vulkan::pipeline_table::PIPELINE_STATUS_READY
+        && vulkan::pipeline_table::resolve(depth_key, &state->depth_pipeline) == vulkan::pipeline_table::PIPELINE_STATUS_READY
+        && vulkan::pipeline_table::resolve(draw_key, &state->draw_pipeline) == vulkan::pipeline_table::PIPELINE_STATUS_READY;
+    if (!state->ready) {
+        return;
+    }
+
+    // NOTE: the fence of this frame slot has been waited on, so the counts from its last use are final, readback
+    // memory may be cached and is only up to date after an invalidate
+    vmaInvalidateAllocation(state->context->vma, frame.readback.memory, 0, VK_WHOLE_SIZE);
+    state->counts = *(scene_counts_t*)frame.readback.allocation_info.pMappedData;
+
+    f32 radius = glm::pow((f32)state->instance_count, 1.0f / 3.0f) * 1.5f + 4.0f;
+    if (state->orbit) {
+        f32 angle = (f32)clock::get_time_s() * 0.1f;
+        state->camera.position = glm::vec3(glm::sin(angle) * radius, radius * 0.3f, glm::cos(angle) * radius);
+        state->camera.yaw = angle;
+        state->camera.pitch = -glm::atan(0.3f);
+    }
+    state->camera.z_far = radius * 4.0f;
+
+    f32 aspect = (f32)extent.width / (f32)extent.height;
+    glm::mat4 view_projection = camera::projection(state->camera, aspect) * camera::view(state->camera);
+    camera::frustum_t frustum = camera::extract_frustum(view_projection);
+
+    scene_frame_t* data = (scene_frame_t*)frame.frame.allocation_info.pMappedData;
+    data->view_projection = view_projection;
+    memcpy(data->planes, frustum.planes, sizeof(data->planes));
+    data->camera_position = glm::vec4(state->camera.position, 1.0f);
+    data->pyramid = occlusion::pyramid();
+    data->lod_scale = state->lod_scale;
+    data->instance_count = state->instance_count;
+
+    vulkan::context::begin_label(cmd, "scene cull early", { 0, 1, 0, 1 });
+
+    vkCmdFillBuffer(cmd, frame.counts.handle, 0, sizeof(scene_counts_t), 0);
+    if (state->reset_visibility) {
+        // NOTE: nothing was seen yet, the late pass draws the first frame on its own
+        memory_barrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+        vkCmdFillBuffer(cmd, state->visibility.handle, 0, sizeof(u32) * state->instance_count, 0);
+        state->reset_visibility = false;
+    }
+
+    // NOTE: also orders this early pass after the late pass of the previous frame, which wrote the visibility
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_CLEAR_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+    dispatch(cmd, frame, phase);
+
+    memory_barrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+    vulkan::context::end_label(cmd);
+    state->record_time_s = clock::get_time_s() - start;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void draw_phase(VkCommandBuffer cmd, const frame_resources_t& frame, occlusion::cull_phase_t phase)
+{
+    vkCmdDrawIndexedIndirectCount(cmd, frame.draws.handle, sizeof(VkDrawIndexedIndirectCommand) * SCENE_MAX_INSTANCES * phase,
+        frame.counts.handle, sizeof(u32) * phase, state->instance_count, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_depth(VkCommandBuffer cmd, u32 frame_index, occlusion::cull_phase_t phase)
+{
+    if (!state->ready) {
+        return;
+    }
+
+    f64 start = clock::get_time_s();
+    frame_resources_t& frame = state->frames[frame_index];
+
+    vulkan::context::begin_label(cmd, phase == occlusion::CULL_PHASE_EARLY ? "scene depth early" : "scene depth late", { 0, 1, 0, 1 });
+
+    scene_push_constants_t constants = push_constants(frame, phase);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, state->depth_pipeline);
+    vkCmdPushConstants(cmd, state->layout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+    vkCmdBindIndexBuffer(cmd, state->indices.handle, 0, state->index_type);
+    draw_phase(cmd, frame, phase);
+
+    vulkan::context::end_label(cmd);
+    state->record_time_s += clock::get_time_s() - start;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw(VkCommandBuffer cmd, u32 frame_index)
+{
+    if (!state->ready) {
+        return;
+    }
+
+    f64 start = clock::get_time_s();
+    frame_resources_t& frame = state->frames[frame_index];
+
+    vulkan::context::begin_label(cmd, "scene draw", { 0, 1, 0, 1 });
+
+    // NOTE: depth is complete, every fragment but the visible ones fails the test and is never shaded
+    scene_push_constants_t constants = push_constants(frame, occlusion::CULL_PHASE_EARLY);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, state->draw_pipeline);
+    vkCmdPushConstants(cmd, state->layout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+    vkCmdBindIndexBuffer(cmd, state->indices.handle, 0, state->index_type);
+    draw_phase(cmd, frame, occlusion::CULL_PHASE_EARLY);
+    draw_phase(cmd, frame, occlusion::CULL_PHASE_LATE);
+
+    vulkan::context::end_label(cmd);
+
+    u32 visible = state->counts.draws[occlusion::CULL_PHASE_EARLY] + state->counts.draws[occlusion::CULL_PHASE_LATE];
+    state->record_time_s += clock::get_time_s() - start;
+    profiler::record("scene record", "ms", state->record_time_s * ms_per_s);
+    profiler::record("scene visible", "instances", (f64)visible);
+    profiler::record("scene occluded", "instances", (f64)state->counts.occluded);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+camera::camera_t current_camera(void)
+{
+    return state->camera;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+glm::vec3 half_extent(void)
+{
+    // NOTE: matches the cube upload_instances() spreads the instances over
+    return glm::vec3(glm::pow((f32)state->instance_count, 1.0f / 3.0f));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    ImGui::SliderInt("Instances", &state->requested_count, 100, SCENE_MAX_INSTANCES, "%d", ImGuiSliderFlags_Logarithmic);
+    ImGui::SliderFloat("LOD scale", &state->lod_scale, 1.0f, 64.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+    ImGui::Checkbox("Orbit camera", &state->orbit);
+
+    i32 format = (i32)state->vertex_format;
+    ImGui::RadioButton("Float vertices", &format, vertex_format::VERTEX_FORMAT_FLOAT);
+    ImGui::SameLine();
+    ImGui::RadioButton("Quantized vertices", &format, vertex_format::VERTEX_FORMAT_QUANTIZED);
+    state->vertex_format = (vertex_format::vertex_format_t)format;
+
+    u32 early = state->counts.draws[occlusion::CULL_PHASE_EARLY];
+    u32 late = state->counts.draws[occlusion::CULL_PHASE_LATE];
+    ImGui::Text("Visible: %u / %u", early + late, state->instance_count);
+    ImGui::Text("Early: %u, late: %u, occluded: %u", early, late, state->counts.occluded);
+    ImGui::Text("CPU record: %.3f ms", state->record_time_s * ms_per_s);
+}
+
+}
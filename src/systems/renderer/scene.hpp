@@ -0,0 +1,91 @@
+#pragma once
+
+#include "camera.hpp"
+#include "occlusion.hpp"
+#include "vk/types.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rin::renderer::scene {
+
+constexpr u32 SCENE_MAX_INSTANCES = 1 << 20;
+constexpr u32 SCENE_MAX_LODS = 4;
+constexpr u32 SCENE_CULL_GROUP_SIZE = 64; // local_size_x in scene_cull.comp
+constexpr f32 SCENE_MAX_POSITION_ERROR = 1e-4f; // meshes within it are drawn from quantized vertices
+
+// NOTE: must match the FEATURES bits in scene.vert
+enum scene_feature_t {
+    SCENE_FEATURE_QUANTIZED = 1 << 0,
+};
+
+// NOTE: the structs below mirror resources/shaders/scene.glsl, std430 layout
+struct scene_frame_t {
+    glm::mat4 view_projection;
+    glm::vec4 planes[6];
+    glm::vec4 camera_position;
+    occlusion::pyramid_t pyramid;
+    f32 lod_scale;
+    u32 instance_count;
+};
+
+struct instance_t {
+    glm::vec4 position_scale; // xyz position, w uniform scale
+    u32 mesh;
+    u32 color; // 0xAABBGGRR
+    u32 pad[2];
+};
+
+struct mesh_lod_t {
+    u32 first_index;
+    u32 index_count;
+};
+
+struct mesh_t {
+    glm::vec4 position_offset; // xyz, dequantization of VERTEX_FORMAT_QUANTIZED positions
+    glm::vec4 position_scale; // xyz
+    f32 radius; // bounding sphere around the mesh origin
+    i32 vertex_offset;
+    u32 lod_count;
+    u32 pad;
+    mesh_lod_t lods[SCENE_MAX_LODS]; // 0 is the most detailed
+};
+
+// NOTE: the draw commands of each phase start SCENE_MAX_INSTANCES apart, the counts are read back for the stats
+struct scene_counts_t {
+    u32 draws[2]; // per occlusion::cull_phase_t
+    u32 occluded; // in the frustum but rejected by the late pass
+    u32 pad;
+};
+
+struct scene_push_constants_t {
+    VkDeviceAddress lights; // lights::light_frame_t, first in every block so scene.frag finds it at offset 0
+    VkDeviceAddress frame;
+    VkDeviceAddress instances;
+    VkDeviceAddress meshes;
+    VkDeviceAddress vertices;
+    VkDeviceAddress draws;
+    VkDeviceAddress counts;
+    VkDeviceAddress visibility; // one u32 per instance, whether the last late pass saw it
+    u32 phase; // occlusion::cull_phase_t
+    u32 pad;
+};
+
+// Needs lights::create() to have run, every frame slot draws with the light grid of the same slot.
+bool create(vulkan::context_t* context, u32 frame_count, VkFormat color_format, VkFormat depth_format);
+void destroy(void);
+
+// All record into the frame command buffer: cull() outside of any rendering scope, the draws inside one.
+// The CPU cost is the same whatever the instance count, culling and LOD selection happen in a compute pass.
+// Every phase is culled then drawn into depth, see occlusion.hpp, and draw() shades what both phases kept
+// testing against that depth.
+void cull(VkCommandBuffer cmd, u32 frame, VkExtent2D extent, occlusion::cull_phase_t phase);
+void draw_depth(VkCommandBuffer cmd, u32 frame, occlusion::cull_phase_t phase);
+void draw(VkCommandBuffer cmd, u32 frame);
+
+// Camera of the last early cull() and half size of the box the instances fill around the origin, for the lights.
+camera::camera_t current_camera(void);
+glm::vec3 half_extent(void);
+
+void draw_gui(void);
+
+}
@@ -0,0 +1,531 @@
+#include "sprites.hpp"
+
+#include "core/clock.hpp"
+#include "core/containers/darray.hpp"
+#include "core/hash.hpp"
+#include "core/jobs.hpp"
+#include "core/logger.hpp"
+#include "core/profiler.hpp"
+#include "core/sort.hpp"
+#include "vk/bindless.hpp"
+#include "vk/context.hpp"
+#include "vk/host_memory.hpp"
+#include "vk/pipeline.hpp"
+#include "vk/pipeline_table.hpp"
+#include "vk/utils.hpp"
+
+#include <cstring>
+#include <imgui.h>
+#include <vulkan/vk_enum_string_helper.h>
+
+namespace rin::renderer::sprites {
+
+constexpr u32 SPRITES_BATCH_SIZE = 16384; // parallel_for batch for fill, key and copy passes
+constexpr u32 SPRITES_STRESS_TEXTURES = 4;
+constexpr u32 SPRITES_STRESS_TEXTURE_SIZE = 64;
+
+struct frame_t {
+    vulkan::buffer_t buffer; // host visible, sorted sprite_t records read by sprite.vert
+    u32 capacity;
+    u32 count;
+};
+
+struct state_t {
+    vulkan::context_t* context;
+    darray<frame_t> frames;
+    darray<sprite_t> sprites; // unsorted, filled between begin() and end()
+    darray<u32> keys;
+    darray<u32> order;
+    darray<u32> keys_scratch;
+    darray<u32> order_scratch;
+    darray<vulkan::image_t> textures;
+    VkSampler sampler;
+    u32 sampler_index;
+    VkShaderModule vert_module;
+    VkShaderModule frag_module;
+    VkPipelineLayout layout; // owned by the pipeline table
+    u64 pipeline_key;
+    u32 stress_textures[SPRITES_STRESS_TEXTURES];
+    bool stress;
+    bool sort;
+    i32 stress_count;
+    f64 fill_ms;
+    f64 sort_ms;
+    f64 copy_ms;
+};
+
+struct stress_data_t {
+    sprite_t* sprites;
+    const u32* textures;
+    glm::vec2 extent;
+    f32 time;
+};
+
+struct key_data_t {
+    const sprite_t* sprites;
+    u32* keys;
+    u32* order;
+};
+
+struct copy_data_t {
+    const sprite_t* src;
+    const u32* order;
+    sprite_t* dst;
+};
+
+static state_t* state = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static f32 unit_float(u32 x)
+{
+    return (f32)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool create_stress_textures(void)
+{
+    const u32 size = SPRITES_STRESS_TEXTURE_SIZE;
+    darray<u32> pixels { size * size, false };
+    pixels.len = size * size;
+
+    for (u32 t = 0; t < SPRITES_STRESS_TEXTURES; t++) {
+        for (u32 y = 0; y < size; y++) {
+            for (u32 x = 0; x < size; x++) {
+                glm::vec2 p = (glm::vec2((f32)x, (f32)y) + 0.5f) / (f32)size * 2.0f - 1.0f;
+                f32 alpha = 0.0f;
+
+                switch (t) {
+                case 0: // disc
+                    alpha = glm::clamp((1.0f - glm::length(p)) * 16.0f, 0.0f, 1.0f);
+                    break;
+                case 1: // ring
+                    alpha = glm::clamp((0.2f - glm::abs(glm::length(p) - 0.7f)) * 16.0f, 0.0f, 1.0f);
+                    break;
+                case 2: // diamond
+                    alpha = glm::clamp((1.0f - glm::abs(p.x) - glm::abs(p.y)) * 16.0f, 0.0f, 1.0f);
+                    break;
+                default: // square
+                    alpha = 1.0f;
+                    break;
+                }
+
+                // NOTE: white premultiplied by alpha, the sprite color tints it
+                u32 a = (u32)(alpha * 255.0f + 0.5f);
+                pixels[y * size + x] = (a << 24) | (a << 16) | (a << 8) | a;
+            }
+        }
+
+        state->stress_textures[t] = load_texture(pixels.data, size, size);
+        if (state->stress_textures[t] == vulkan::BINDLESS_INVALID_INDEX) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(vulkan::context_t* context, u32 frame_count, VkFormat color_format, VkFormat depth_format)
+{
+    if (state != nullptr) {
+        log::error("sprites::create -> sprite renderer has been already created");
+        return false;
+    }
+
+    state = (state_t*)calloc(1, sizeof(state_t));
+    state->context = context;
+    state->frames = darray<frame_t> { frame_count, true };
+    state->frames.len = frame_count;
+    state->sprites = darray<sprite_t> { SPRITES_INITIAL_CAPACITY, false };
+    state->keys = darray<u32> { SPRITES_INITIAL_CAPACITY, false };
+    state->order = darray<u32> { SPRITES_INITIAL_CAPACITY, false };
+    state->keys_scratch = darray<u32> { SPRITES_INITIAL_CAPACITY, false };
+    state->order_scratch = darray<u32> { SPRITES_INITIAL_CAPACITY, false };
+    state->textures = darray<vulkan::image_t> { true };
+    state->sampler_index = vulkan::BINDLESS_INVALID_INDEX;
+    state->sort = true;
+    state->stress_count = 1000000;
+
+    VkDevice device = context->device->logical_device;
+
+    VkSamplerCreateInfo sampler_info {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_NEVER,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+        .unnormalizedCoordinates = VK_FALSE,
+    };
+
+    VkResult result = vkCreateSampler(device, &sampler_info, vulkan::host_memory::callbacks(), &state->sampler);
+    if (result != VK_SUCCESS) {
+        log::error("sprites::create -> failed to create sampler: %s", string_VkResult(result));
+        destroy();
+        return false;
+    }
+
+    state->sampler_index = vulkan::bindless::register_sampler(state->sampler);
+    if (state->sampler_index == vulkan::BINDLESS_INVALID_INDEX) {
+        log::error("sprites::create -> failed to register sampler");
+        destroy();
+        return false;
+    }
+
+    if (!create_stress_textures()) {
+        log::error("sprites::create -> failed to create stress textures");
+        destroy();
+        return false;
+    }
+
+    vulkan::reflection::shader_reflection_t vert_reflection {};
+    vulkan::reflection::shader_reflection_t frag_reflection {};
+
+    if (!vulkan::utils::load_shader_module(device, "resources/shaders/sprite.vert.spv", &state->vert_module, &vert_reflection)
+        || !vulkan::utils::load_shader_module(device, "resources/shaders/sprite.frag.spv", &state->frag_module, &frag_reflection)) {
+        log::error("sprites::create -> failed to load shader modules");
+        destroy();
+        return false;
+    }
+
+    const vulkan::reflection::shader_reflection_t* stages[] = { &vert_reflection, &frag_reflection };
+    if (!vulkan::pipeline_table::get_layout(stages, 2, &state->layout)) {
+        log::error("sprites::create -> failed to create pipeline layout");
+        destroy();
+        return false;
+    }
+
+    // NOTE: sprites are sorted back to front on the CPU, so there is no depth test and no culling
+    vulkan::pipeline_builder_t builder {};
+    builder
+        .set_multisampling_none()
+        .enable_blending_alpha()
+        .disable_depthtest()
+        .set_color_attachment_format(color_format)
+        .set_depth_format(depth_format)
+        .set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE)
+        .set_polygon_mode(VK_POLYGON_MODE_FILL)
+        .set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+        .set_shaders(state->vert_module, state->frag_module)
+        .set_layout(state->layout);
+    state->pipeline_key = vulkan::pipeline_table::request(builder);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(void)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    VkDevice device = state->context->device->logical_device;
+    vkDeviceWaitIdle(device);
+
+    if (state->vert_module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, state->vert_module, vulkan::host_memory::callbacks());
+    }
+
+    if (state->frag_module != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device, state->frag_module, vulkan::host_memory::callbacks());
+    }
+
+    for (size_t i = 0; i < state->textures.len; i++) {
+        vulkan::context::destroy_image(&state->textures[i]);
+    }
+
+    if (state->sampler != VK_NULL_HANDLE) {
+        vulkan::bindless::release(vulkan::BINDLESS_TYPE_SAMPLER, state->sampler_index);
+        vkDestroySampler(device, state->sampler, vulkan::host_memory::callbacks());
+    }
+
+    for (size_t i = 0; i < state->frames.len; i++) {
+        vulkan::context::destroy_buffer(&state->frames[i].buffer);
+    }
+
+    state->frames.~darray();
+    state->sprites.~darray();
+    state->keys.~darray();
+    state->order.~darray();
+    state->keys_scratch.~darray();
+    state->order_scratch.~darray();
+    state->textures.~darray();
+
+    free(state);
+    state = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 load_texture(const u32* pixels, u32 width, u32 height)
+{
+    if (width == 0 || height == 0 || width > SPRITES_MAX_TEXTURE_SIZE || height > SPRITES_MAX_TEXTURE_SIZE) {
+        log::error("sprites::load_texture -> invalid texture size %ux%u", width, height);
+        return vulkan::BINDLESS_INVALID_INDEX;
+    }
+
+    vulkan::image_create_info_t info {
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .width = width,
+        .height = height,
+        .allocation_info = {
+            .flags = 0,
+            .usage = VMA_MEMORY_USAGE_AUTO,
+            .requiredFlags = 0,
+            .preferredFlags = 0,
+            .memoryTypeBits = 0,
+            .pool = VK_NULL_HANDLE,
+            .pUserData = nullptr,
+            .priority = 1.0f,
+        },
+        .type = vulkan::IMAGE_TYPE_COLOR,
+        .tag = vulkan::MEMORY_TAG_SPRITES,
+    };
+
+    vulkan::image_t image {};
+    if (!vulkan::context::allocate_image(info, &image)) {
+        log::error("sprites::load_texture -> failed to allocate image");
+        return vulkan::BINDLESS_INVALID_INDEX;
+    }
+
+    if (image.bindless_index == vulkan::BINDLESS_INVALID_INDEX
+        || !vulkan::context::upload_image(image, pixels, sizeof(u32) * width * height)) {
+        log::error("sprites::load_texture -> failed to upload image");
+        vulkan::context::destroy_image(&image);
+        return vulkan::BINDLESS_INVALID_INDEX;
+    }
+
+    state->textures.push(image);
+    return image.bindless_index;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void begin(void)
+{
+    state->sprites.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+sprite_t* push(u32 count)
+{
+    size_t first = state->sprites.len;
+    if (first + count > state->sprites.capacity) {
+        u64 capacity = state->sprites.capacity;
+        while (capacity < first + count) {
+            capacity *= 2;
+        }
+        state->sprites.reserve(capacity);
+    }
+
+    state->sprites.len += count;
+    return state->sprites.data + first;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void build_keys(u32 begin, u32 end, void* data)
+{
+    key_data_t* keys = (key_data_t*)data;
+
+    for (u32 i = begin; i < end; i++) {
+        // NOTE: far sprites get the smallest keys, ties are grouped by texture for sampling locality
+        const sprite_t& sprite = keys->sprites[i];
+        u32 depth = (u32)((1.0f - glm::clamp(sprite.depth, 0.0f, 1.0f)) * 65535.0f);
+        keys->keys[i] = (depth << 16) | (sprite.texture & 0xFFFF);
+        keys->order[i] = i;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void copy_sorted(u32 begin, u32 end, void* data)
+{
+    copy_data_t* copy = (copy_data_t*)data;
+
+    // NOTE: random reads, sequential writes since the destination is write combined memory
+    for (u32 i = begin; i < end; i++) {
+        copy->dst[i] = copy->src[copy->order[i]];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool ensure_frame_capacity(frame_t& frame, u32 count)
+{
+    if (count <= frame.capacity) {
+        return true;
+    }
+
+    u32 capacity = frame.capacity == 0 ? SPRITES_INITIAL_CAPACITY : frame.capacity;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    // NOTE: the fence of this frame slot has been waited on, the old buffer is no longer read
+    vulkan::context::destroy_buffer(&frame.buffer);
+    frame.capacity = 0;
+
+    vulkan::buffer_create_info_t info {
+        .size = sizeof(sprite_t) * capacity,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = false,
+        .tag = vulkan::MEMORY_TAG_SPRITES,
+    };
+
+    if (!vulkan::context::allocate_buffer(info, &frame.buffer)) {
+        log::error("sprites::ensure_frame_capacity -> failed to allocate %u sprites", capacity);
+        return false;
+    }
+
+    frame.capacity = capacity;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void end(u32 frame_index)
+{
+    frame_t& frame = state->frames[frame_index];
+    u32 count = (u32)state->sprites.len;
+    frame.count = 0;
+
+    if (count == 0 || !ensure_frame_capacity(frame, count)) {
+        return;
+    }
+
+    f64 start = clock::get_time_s();
+    sprite_t* dst = (sprite_t*)frame.buffer.allocation_info.pMappedData;
+
+    if (state->sort) {
+        state->keys.reserve(count);
+        state->order.reserve(count);
+        state->keys_scratch.reserve(count);
+        state->order_scratch.reserve(count);
+
+        key_data_t keys {
+            .sprites = state->sprites.data,
+            .keys = state->keys.data,
+            .order = state->order.data,
+        };
+        jobs::parallel_for(count, SPRITES_BATCH_SIZE, build_keys, &keys);
+
+        sort::radix_sort(state->keys.data, state->order.data, state->keys_scratch.data, state->order_scratch.data, count);
+        state->sort_ms = (clock::get_time_s() - start) * ms_per_s;
+        start = clock::get_time_s();
+
+        copy_data_t copy {
+            .src = state->sprites.data,
+            .order = state->order.data,
+            .dst = dst,
+        };
+        jobs::parallel_for(count, SPRITES_BATCH_SIZE, copy_sorted, &copy);
+    } else {
+        state->sort_ms = 0.0;
+        memcpy(dst, state->sprites.data, sizeof(sprite_t) * count);
+    }
+
+    state->copy_ms = (clock::get_time_s() - start) * ms_per_s;
+    profiler::record("sprites sort", "ms", state->sort_ms);
+    profiler::record("sprites copy", "ms", state->copy_ms);
+
+    frame.count = count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw(VkCommandBuffer cmd, u32 frame_index, VkExtent2D extent)
+{
+    const frame_t& frame = state->frames[frame_index];
+    if (frame.count == 0) {
+        return;
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (vulkan::pipeline_table::resolve(state->pipeline_key, &pipeline) != vulkan::pipeline_table::PIPELINE_STATUS_READY) {
+        return;
+    }
+
+    vulkan::context::begin_label(cmd, "sprites", { 0, 0, 1, 1 });
+
+    sprite_push_constants_t constants {
+        .sprites = frame.buffer.address,
+        .pixel_to_ndc = glm::vec2(2.0f / (f32)extent.width, 2.0f / (f32)extent.height),
+        .sampler_index = state->sampler_index,
+    };
+
+    // NOTE: textures are bindless, so every sprite of the frame goes out in a single instanced draw
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdPushConstants(cmd, state->layout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+    vkCmdDraw(cmd, 6, frame.count, 0, 0);
+
+    vulkan::context::end_label(cmd);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool stress_enabled(void)
+{
+    return state->stress;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void fill_stress(u32 begin, u32 end, void* data)
+{
+    stress_data_t* stress = (stress_data_t*)data;
+
+    for (u32 i = begin; i < end; i++) {
+        u32 seed = i * 6;
+        glm::vec2 origin = glm::vec2(unit_float(hash::mix32(seed)), unit_float(hash::mix32(seed + 1))) * stress->extent;
+        f32 phase = unit_float(hash::mix32(seed + 2)) * 6.2831853f;
+        f32 speed = 0.5f + unit_float(hash::mix32(seed + 3)) * 1.5f;
+        u32 bits = hash::mix32(seed + 4);
+        f32 size = 2.0f + unit_float(hash::mix32(seed + 5)) * 10.0f;
+
+        f32 angle = phase + stress->time * speed;
+        stress->sprites[i] = sprite_t {
+            .position = origin + glm::vec2(glm::cos(angle), glm::sin(angle)) * 24.0f,
+            .half_size = glm::vec2(size),
+            .rotation = angle,
+            .depth = unit_float(bits),
+            .color = (bits & 0x00FFFFFFu) | 0xC0000000u,
+            .texture = stress->textures[bits % SPRITES_STRESS_TEXTURES],
+        };
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void stress(VkExtent2D extent)
+{
+    f64 start = clock::get_time_s();
+    u32 count = (u32)state->stress_count;
+
+    stress_data_t data {
+        .sprites = push(count),
+        .textures = state->stress_textures,
+        .extent = glm::vec2((f32)extent.width, (f32)extent.height),
+        .time = (f32)clock::get_time_s(),
+    };
+    jobs::parallel_for(count, SPRITES_BATCH_SIZE, fill_stress, &data);
+
+    state->fill_ms = (clock::get_time_s() - start) * ms_per_s;
+    profiler::record("sprites fill", "ms", state->fill_ms);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    ImGui::Checkbox("Stress test", &state->stress);
+    ImGui::SliderInt("Sprites", &state->stress_count, 1000, 4000000, "%d", ImGuiSliderFlags_Logarithmic);
+    ImGui::Checkbox("Sort", &state->sort);
+    ImGui::Text("Frame time: %.3f ms", clock::get_frametime_ms());
+    ImGui::Text("Fill %.3f ms, sort %.3f ms, copy %.3f ms", state->fill_ms, state->sort_ms, state->copy_ms);
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vk/types.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rin::renderer::sprites {
+
+constexpr u32 SPRITES_INITIAL_CAPACITY = 1 << 16; // per frame, buffers grow by doubling
+constexpr u32 SPRITES_MAX_TEXTURE_SIZE = 4096;
+
+// NOTE: mirrors resources/shaders/sprite.glsl, std430 layout, one record per quad
+struct sprite_t {
+    glm::vec2 position; // center, in pixels from the top left corner
+    glm::vec2 half_size;
+    f32 rotation; // radians
+    f32 depth; // [0, 1], 1 is the farthest, drawn first
+    u32 color; // 0xAABBGGRR, multiplied with the texture
+    u32 texture; // from load_texture()
+};
+
+struct sprite_push_constants_t {
+    VkDeviceAddress sprites;
+    glm::vec2 pixel_to_ndc;
+    u32 sampler_index;
+};
+
+bool create(vulkan::context_t* context, u32 frame_count, VkFormat color_format, VkFormat depth_format);
+void destroy(void);
+
+// Uploads tightly packed premultiplied RGBA8 pixels and returns the texture index to store in sprite_t,
+// vulkan::BINDLESS_INVALID_INDEX on failure. Textures live until destroy().
+u32 load_texture(const u32* pixels, u32 width, u32 height);
+
+// A frame goes begin() -> push() -> end() -> draw(). push() only reserves the range, the caller fills it
+// and may do so from several threads, so one push per batch of sprites is enough.
+void begin(void);
+sprite_t* push(u32 count);
+
+// Sorts back to front then by texture with a radix sort and copies the result to the frame buffer.
+// Called outside of any rendering scope, draw() records one instanced draw inside it.
+void end(u32 frame);
+void draw(VkCommandBuffer cmd, u32 frame, VkExtent2D extent);
+
+// Stress benchmark, fills and animates up to millions of sprites every frame while it is enabled.
+bool stress_enabled(void);
+void stress(VkExtent2D extent);
+void draw_gui(void);
+
+}
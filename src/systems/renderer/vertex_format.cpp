@@ -0,0 +1,280 @@
+#include "vertex_format.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define VERTEX_FORMAT_SSE2 1
+#include <emmintrin.h>
+#else
+#define VERTEX_FORMAT_SSE2 0
+#endif
+
+namespace rin::renderer::vertex_format {
+
+constexpr f32 UNORM16_MAX = 65535.0f;
+constexpr f32 SNORM16_MAX = 32767.0f;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+quantization_t compute_quantization(const vertex_attributes_t* vertices, u32 count)
+{
+    if (count == 0) {
+        return quantization_t { glm::vec3(0.0f), glm::vec3(0.0f) };
+    }
+
+    glm::vec3 min = vertices[0].position;
+    glm::vec3 max = vertices[0].position;
+    for (u32 i = 1; i < count; i++) {
+        min = glm::min(min, vertices[i].position);
+        max = glm::max(max, vertices[i].position);
+    }
+
+    return quantization_t {
+        .offset = min,
+        .scale = (max - min) / UNORM16_MAX,
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+vertex_format_t choose_format(const quantization_t& quantization, f32 max_error)
+{
+    f32 step = glm::max(quantization.scale.x, glm::max(quantization.scale.y, quantization.scale.z));
+    return step * 0.5f <= max_error ? VERTEX_FORMAT_QUANTIZED : VERTEX_FORMAT_FLOAT;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 stride(vertex_format_t format)
+{
+    return format == VERTEX_FORMAT_QUANTIZED ? sizeof(quantized_vertex_t) : sizeof(vertex_attributes_t);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static glm::vec3 inverse_scale(const glm::vec3& scale)
+{
+    return glm::vec3(
+        scale.x > 0.0f ? 1.0f / scale.x : 0.0f,
+        scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+        scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u16 quantize_unorm16(f32 value)
+{
+    return (u16)lrintf(fminf(fmaxf(value, 0.0f), UNORM16_MAX));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 pack_snorm16x2(f32 x, f32 y)
+{
+    i32 qx = (i32)lrintf(fminf(fmaxf(x, -1.0f), 1.0f) * SNORM16_MAX);
+    i32 qy = (i32)lrintf(fminf(fmaxf(y, -1.0f), 1.0f) * SNORM16_MAX);
+    return ((u32)qx & 0xFFFF) | ((u32)qy << 16);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 encode_octahedral(const glm::vec3& v)
+{
+    // NOTE: copysign rather than a comparison so -0 folds the same way as the SSE2 path
+    f32 inv_l1 = 1.0f / (fabsf(v.x) + fabsf(v.y) + fabsf(v.z));
+    f32 x = v.x * inv_l1;
+    f32 y = v.y * inv_l1;
+
+    if (v.z < 0.0f) {
+        f32 folded_x = (1.0f - fabsf(y)) * copysignf(1.0f, x);
+        f32 folded_y = (1.0f - fabsf(x)) * copysignf(1.0f, y);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    return pack_snorm16x2(x, y);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u16 float_to_half(f32 value)
+{
+    // NOTE: round to nearest even, bit exact with the SSE2 version below (F. Giesen's float_to_half_fast3_rtne)
+    u32 f;
+    memcpy(&f, &value, sizeof(f));
+    u32 sign = f & 0x80000000u;
+    f ^= sign;
+
+    u32 half;
+    if (f >= (127 + 16) << 23) {
+        half = f > 0x7F800000u ? 0x7E00 : 0x7C00;
+    } else if (f < (127 - 14) << 23) {
+        const u32 magic_bits = ((127 - 15) + (23 - 10) + 1) << 23;
+        f32 magic;
+        memcpy(&magic, &magic_bits, sizeof(magic));
+
+        f32 shifted;
+        memcpy(&shifted, &f, sizeof(shifted));
+        shifted += magic;
+
+        u32 bits;
+        memcpy(&bits, &shifted, sizeof(bits));
+        half = bits - magic_bits;
+    } else {
+        u32 mantissa_odd = (f >> 13) & 1;
+        f += 0xFFF - ((u32)(127 - 15) << 23);
+        f += mantissa_odd;
+        half = f >> 13;
+    }
+
+    return (u16)(half | (sign >> 16));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void encode_scalar(const vertex_attributes_t* src, u32 count, const quantization_t& quantization, quantized_vertex_t* dst)
+{
+    glm::vec3 inv_scale = inverse_scale(quantization.scale);
+
+    for (u32 i = 0; i < count; i++) {
+        const vertex_attributes_t& v = src[i];
+        glm::vec3 p = (v.position - quantization.offset) * inv_scale;
+
+        dst[i] = quantized_vertex_t {
+            .position = { quantize_unorm16(p.x), quantize_unorm16(p.y), quantize_unorm16(p.z) },
+            .tangent_sign = (u16)(v.tangent.w < 0.0f ? 1 : 0),
+            .normal = encode_octahedral(v.normal),
+            .tangent = encode_octahedral(glm::vec3(v.tangent)),
+            .uv = (u32)float_to_half(v.uv.x) | ((u32)float_to_half(v.uv.y) << 16),
+        };
+    }
+}
+
+#if VERTEX_FORMAT_SSE2
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static __m128i pack_snorm16x2_sse2(__m128 x, __m128 y)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minus_one = _mm_set1_ps(-1.0f);
+    const __m128 snorm_max = _mm_set1_ps(SNORM16_MAX);
+
+    __m128i qx = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(x, minus_one), one), snorm_max));
+    __m128i qy = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(y, minus_one), one), snorm_max));
+    return _mm_or_si128(_mm_and_si128(qx, _mm_set1_epi32(0xFFFF)), _mm_slli_epi32(qy, 16));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static __m128i encode_octahedral_sse2(__m128 x, __m128 y, __m128 z)
+{
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    __m128 ax = _mm_andnot_ps(sign_mask, x);
+    __m128 ay = _mm_andnot_ps(sign_mask, y);
+    __m128 az = _mm_andnot_ps(sign_mask, z);
+    __m128 inv_l1 = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(ax, ay), az));
+
+    x = _mm_mul_ps(x, inv_l1);
+    y = _mm_mul_ps(y, inv_l1);
+    ax = _mm_andnot_ps(sign_mask, x);
+    ay = _mm_andnot_ps(sign_mask, y);
+
+    __m128 folded_x = _mm_or_ps(_mm_sub_ps(one, ay), _mm_and_ps(x, sign_mask));
+    __m128 folded_y = _mm_or_ps(_mm_sub_ps(one, ax), _mm_and_ps(y, sign_mask));
+
+    __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+    x = _mm_or_ps(_mm_and_ps(lower, folded_x), _mm_andnot_ps(lower, x));
+    y = _mm_or_ps(_mm_and_ps(lower, folded_y), _mm_andnot_ps(lower, y));
+
+    return pack_snorm16x2_sse2(x, y);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static __m128i float_to_half_sse2(__m128 f)
+{
+    const __m128i min_normal = _mm_set1_epi32((127 - 14) << 23);
+    const __m128i half_max = _mm_set1_epi32((127 + 16) << 23);
+    const __m128i subnormal_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normal_bias = _mm_set1_epi32(0xFFF - ((127 - 15) << 23));
+
+    __m128 sign = _mm_and_ps(f, _mm_set1_ps(-0.0f));
+    __m128 abs = _mm_xor_ps(f, sign);
+    __m128i abs_bits = _mm_castps_si128(abs);
+
+    __m128i is_nan = _mm_castps_si128(_mm_cmpunord_ps(abs, abs));
+    __m128i is_regular = _mm_cmpgt_epi32(half_max, abs_bits);
+    __m128i inf_or_nan = _mm_or_si128(_mm_and_si128(is_nan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7C00));
+
+    __m128i is_subnormal = _mm_cmpgt_epi32(min_normal, abs_bits);
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(abs, _mm_castsi128_ps(subnormal_magic))), subnormal_magic);
+
+    __m128i mantissa_odd = _mm_srai_epi32(_mm_slli_epi32(abs_bits, 31 - 13), 31);
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(abs_bits, normal_bias), mantissa_odd), 13);
+
+    __m128i finite = _mm_or_si128(_mm_and_si128(is_subnormal, subnormal), _mm_andnot_si128(is_subnormal, normal));
+    __m128i half = _mm_or_si128(_mm_and_si128(is_regular, finite), _mm_andnot_si128(is_regular, inf_or_nan));
+
+    return _mm_and_si128(_mm_or_si128(half, _mm_srli_epi32(_mm_castps_si128(sign), 16)), _mm_set1_epi32(0xFFFF));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void encode(const vertex_attributes_t* src, u32 count, const quantization_t& quantization, quantized_vertex_t* dst)
+{
+    glm::vec3 inv_scale = inverse_scale(quantization.scale);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 unorm_max = _mm_set1_ps(UNORM16_MAX);
+    const __m128 offset[3] = { _mm_set1_ps(quantization.offset.x), _mm_set1_ps(quantization.offset.y), _mm_set1_ps(quantization.offset.z) };
+    const __m128 scale[3] = { _mm_set1_ps(inv_scale.x), _mm_set1_ps(inv_scale.y), _mm_set1_ps(inv_scale.z) };
+
+    u32 simd_count = count & ~3u;
+    for (u32 i = 0; i < simd_count; i += 4) {
+        const vertex_attributes_t* v = src + i;
+
+        // NOTE: transpose four AoS vertices to SoA registers, one attribute component per register
+        __m128i position[3];
+        for (u32 c = 0; c < 3; c++) {
+            __m128 p = _mm_setr_ps(v[0].position[c], v[1].position[c], v[2].position[c], v[3].position[c]);
+            p = _mm_mul_ps(_mm_sub_ps(p, offset[c]), scale[c]);
+            position[c] = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(p, zero), unorm_max));
+        }
+
+        __m128i normal = encode_octahedral_sse2(
+            _mm_setr_ps(v[0].normal.x, v[1].normal.x, v[2].normal.x, v[3].normal.x),
+            _mm_setr_ps(v[0].normal.y, v[1].normal.y, v[2].normal.y, v[3].normal.y),
+            _mm_setr_ps(v[0].normal.z, v[1].normal.z, v[2].normal.z, v[3].normal.z));
+
+        __m128i tangent = encode_octahedral_sse2(
+            _mm_setr_ps(v[0].tangent.x, v[1].tangent.x, v[2].tangent.x, v[3].tangent.x),
+            _mm_setr_ps(v[0].tangent.y, v[1].tangent.y, v[2].tangent.y, v[3].tangent.y),
+            _mm_setr_ps(v[0].tangent.z, v[1].tangent.z, v[2].tangent.z, v[3].tangent.z));
+
+        __m128i uv = _mm_or_si128(
+            float_to_half_sse2(_mm_setr_ps(v[0].uv.x, v[1].uv.x, v[2].uv.x, v[3].uv.x)),
+            _mm_slli_epi32(float_to_half_sse2(_mm_setr_ps(v[0].uv.y, v[1].uv.y, v[2].uv.y, v[3].uv.y)), 16));
+
+        alignas(16) u32 lanes[6][4];
+        _mm_store_si128((__m128i*)lanes[0], position[0]);
+        _mm_store_si128((__m128i*)lanes[1], position[1]);
+        _mm_store_si128((__m128i*)lanes[2], position[2]);
+        _mm_store_si128((__m128i*)lanes[3], normal);
+        _mm_store_si128((__m128i*)lanes[4], tangent);
+        _mm_store_si128((__m128i*)lanes[5], uv);
+
+        for (u32 j = 0; j < 4; j++) {
+            dst[i + j] = quantized_vertex_t {
+                .position = { (u16)lanes[0][j], (u16)lanes[1][j], (u16)lanes[2][j] },
+                .tangent_sign = (u16)(v[j].tangent.w < 0.0f ? 1 : 0),
+                .normal = lanes[3][j],
+                .tangent = lanes[4][j],
+                .uv = lanes[5][j],
+            };
+        }
+    }
+
+    encode_scalar(src + simd_count, count - simd_count, quantization, dst + simd_count);
+}
+
+#else
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void encode(const vertex_attributes_t* src, u32 count, const quantization_t& quantization, quantized_vertex_t* dst)
+{
+    encode_scalar(src, count, quantization, dst);
+}
+
+#endif
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "core/defines.hpp"
+
+#include <glm/glm.hpp>
+
+namespace rin::renderer::vertex_format {
+
+enum vertex_format_t {
+    VERTEX_FORMAT_FLOAT, // vertex_attributes_t as is, 48 bytes
+    VERTEX_FORMAT_QUANTIZED, // quantized_vertex_t, 20 bytes
+};
+
+// Import format, tightly packed 32 bit floats
+struct vertex_attributes_t {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec4 tangent; // w is the bitangent sign
+    glm::vec2 uv;
+};
+
+// NOTE: decoded by the vertex shader, read as 5 raw words
+struct quantized_vertex_t {
+    u16 position[3]; // unorm16 inside the mesh bounding box, see quantization_t
+    u16 tangent_sign; // 1 when the bitangent is flipped
+    u32 normal; // octahedral snorm16x2
+    u32 tangent; // octahedral snorm16x2
+    u32 uv; // half2x16
+};
+
+// Per mesh dequantization, position = offset + unorm * scale
+struct quantization_t {
+    glm::vec3 offset;
+    glm::vec3 scale;
+};
+
+// 1/65535 of the bounding box, degenerate axes get a scale of zero and decode to the offset.
+quantization_t compute_quantization(const vertex_attributes_t* vertices, u32 count);
+
+// Quantized whenever the worst position error, half a quantization step, stays within max_error.
+vertex_format_t choose_format(const quantization_t& quantization, f32 max_error);
+u32 stride(vertex_format_t format);
+
+// SSE2 when available, four vertices per iteration, scalar for the tail and other targets.
+void encode(const vertex_attributes_t* src, u32 count, const quantization_t& quantization, quantized_vertex_t* dst);
+
+// Scalar reference used for the tail, also handy to check the SIMD path.
+void encode_scalar(const vertex_attributes_t* src, u32 count, const quantization_t& quantization, quantized_vertex_t* dst);
+
+}
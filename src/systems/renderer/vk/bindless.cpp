@@ -0,0 +1,269 @@
+#include "bindless.hpp"
+
+#include "core/logger.hpp"
+#include "host_memory.hpp"
+
+#include <cstdlib>
+#include <vulkan/vk_enum_string_helper.h>
+
+namespace rin::renderer::vulkan::bindless {
+
+static bindless_heap_t* heap = nullptr;
+
+static constexpr VkDescriptorType descriptor_types[BINDLESS_TYPE_COUNT] = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+};
+
+static u32 min(u32 a, u32 b) { return a < b ? a : b; }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(context_t* context)
+{
+    if (heap != nullptr) {
+        log::error("vulkan::bindless::create -> a bindless heap already exists");
+        return false;
+    }
+
+    heap = (bindless_heap_t*)calloc(1, sizeof(bindless_heap_t));
+    heap->context = context;
+    context->bindless = heap;
+
+    for (u32 i = 0; i < BINDLESS_TYPE_COUNT; i++) {
+        heap->free_slots[i] = darray<u32> { true };
+    }
+
+    // NOTE: clamp to the update after bind limits, the totals are the same on desktop drivers but not on mobile ones
+    const VkPhysicalDeviceDescriptorIndexingProperties& limits = context->device->descriptor_indexing;
+    heap->capacity[BINDLESS_TYPE_SAMPLED_IMAGE] = min(BINDLESS_MAX_SAMPLED_IMAGES,
+        min(limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages));
+    heap->capacity[BINDLESS_TYPE_STORAGE_BUFFER] = min(BINDLESS_MAX_STORAGE_BUFFERS,
+        min(limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers));
+    heap->capacity[BINDLESS_TYPE_SAMPLER] = min(BINDLESS_MAX_SAMPLERS,
+        min(limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers));
+
+    VkDevice device = context->device->logical_device;
+
+    VkDescriptorSetLayoutBinding bindings[BINDLESS_TYPE_COUNT];
+    VkDescriptorBindingFlags binding_flags[BINDLESS_TYPE_COUNT];
+    VkDescriptorPoolSize pool_sizes[BINDLESS_TYPE_COUNT];
+
+    for (u32 i = 0; i < BINDLESS_TYPE_COUNT; i++) {
+        bindings[i] = VkDescriptorSetLayoutBinding {
+            .binding = i,
+            .descriptorType = descriptor_types[i],
+            .descriptorCount = heap->capacity[i],
+            .stageFlags = VK_SHADER_STAGE_ALL,
+            .pImmutableSamplers = nullptr,
+        };
+
+        binding_flags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+            | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+            | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+        pool_sizes[i] = VkDescriptorPoolSize {
+            .type = descriptor_types[i],
+            .descriptorCount = heap->capacity[i],
+        };
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .pNext = nullptr,
+        .bindingCount = BINDLESS_TYPE_COUNT,
+        .pBindingFlags = binding_flags,
+    };
+
+    VkDescriptorSetLayoutCreateInfo layout_info {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &flags_info,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = BINDLESS_TYPE_COUNT,
+        .pBindings = bindings,
+    };
+
+    VkResult result = vkCreateDescriptorSetLayout(device, &layout_info, host_memory::callbacks(), &heap->layout);
+    if (result != VK_SUCCESS) {
+        log::error("vulkan::bindless::create -> failed to create descriptor set layout: %s", string_VkResult(result));
+        destroy();
+        return false;
+    }
+
+    VkDescriptorPoolCreateInfo pool_info {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = BINDLESS_TYPE_COUNT,
+        .pPoolSizes = pool_sizes,
+    };
+
+    result = vkCreateDescriptorPool(device, &pool_info, host_memory::callbacks(), &heap->pool);
+    if (result != VK_SUCCESS) {
+        log::error("vulkan::bindless::create -> failed to create descriptor pool: %s", string_VkResult(result));
+        destroy();
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo set_info {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .descriptorPool = heap->pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &heap->layout,
+    };
+
+    result = vkAllocateDescriptorSets(device, &set_info, &heap->set);
+    if (result != VK_SUCCESS) {
+        log::error("vulkan::bindless::create -> failed to allocate descriptor set: %s", string_VkResult(result));
+        destroy();
+        return false;
+    }
+
+    log::debug("bindless heap: %u images, %u storage buffers, %u samplers",
+        heap->capacity[BINDLESS_TYPE_SAMPLED_IMAGE],
+        heap->capacity[BINDLESS_TYPE_STORAGE_BUFFER],
+        heap->capacity[BINDLESS_TYPE_SAMPLER]);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(void)
+{
+    if (heap == nullptr) {
+        return;
+    }
+
+    VkDevice device = heap->context->device->logical_device;
+
+    // NOTE: the set goes away with its pool
+    if (heap->pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device, heap->pool, host_memory::callbacks());
+    }
+
+    if (heap->layout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device, heap->layout, host_memory::callbacks());
+    }
+
+    for (u32 i = 0; i < BINDLESS_TYPE_COUNT; i++) {
+        heap->free_slots[i].~darray();
+    }
+
+    heap->context->bindless = nullptr;
+    free(heap);
+    heap = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 acquire(bindless_type_t type)
+{
+    darray<u32>& free_slots = heap->free_slots[type];
+    if (free_slots.len > 0) {
+        u32 index = free_slots[free_slots.len - 1];
+        free_slots.len -= 1;
+        return index;
+    }
+
+    if (heap->high_water[type] == heap->capacity[type]) {
+        log::error("vulkan::bindless::acquire -> heap is full for %s", string_VkDescriptorType(descriptor_types[type]));
+        return BINDLESS_INVALID_INDEX;
+    }
+
+    return heap->high_water[type]++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void write(bindless_type_t type, u32 index, const VkDescriptorImageInfo* image, const VkDescriptorBufferInfo* buffer)
+{
+    VkWriteDescriptorSet write {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = heap->set,
+        .dstBinding = (u32)type,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = descriptor_types[type],
+        .pImageInfo = image,
+        .pBufferInfo = buffer,
+        .pTexelBufferView = nullptr,
+    };
+
+    vkUpdateDescriptorSets(heap->context->device->logical_device, 1, &write, 0, nullptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 register_image(VkImageView view, VkImageLayout layout)
+{
+    u32 index = acquire(BINDLESS_TYPE_SAMPLED_IMAGE);
+    if (index == BINDLESS_INVALID_INDEX) {
+        return index;
+    }
+
+    VkDescriptorImageInfo info {
+        .sampler = VK_NULL_HANDLE,
+        .imageView = view,
+        .imageLayout = layout,
+    };
+    write(BINDLESS_TYPE_SAMPLED_IMAGE, index, &info, nullptr);
+    return index;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 register_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    u32 index = acquire(BINDLESS_TYPE_STORAGE_BUFFER);
+    if (index == BINDLESS_INVALID_INDEX) {
+        return index;
+    }
+
+    VkDescriptorBufferInfo info {
+        .buffer = buffer,
+        .offset = offset,
+        .range = range,
+    };
+    write(BINDLESS_TYPE_STORAGE_BUFFER, index, nullptr, &info);
+    return index;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 register_sampler(VkSampler sampler)
+{
+    u32 index = acquire(BINDLESS_TYPE_SAMPLER);
+    if (index == BINDLESS_INVALID_INDEX) {
+        return index;
+    }
+
+    VkDescriptorImageInfo info {
+        .sampler = sampler,
+        .imageView = VK_NULL_HANDLE,
+        .imageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    write(BINDLESS_TYPE_SAMPLER, index, &info, nullptr);
+    return index;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void release(bindless_type_t type, u32 index)
+{
+    if (index == BINDLESS_INVALID_INDEX) {
+        return;
+    }
+
+    // NOTE: the stale descriptor stays in the slot, partially bound arrays only require dynamically used slots to be valid
+    heap->free_slots[type].push(index);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+VkDescriptorType descriptor_type(bindless_type_t type)
+{
+    return descriptor_types[type];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipelineLayout layout)
+{
+    vkCmdBindDescriptorSets(cmd, bind_point, layout, BINDLESS_SET, 1, &heap->set, 0, nullptr);
+}
+
+}
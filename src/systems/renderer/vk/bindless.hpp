@@ -0,0 +1,32 @@
+#pragma once
+
+#include "types.hpp"
+
+namespace rin::renderer::vulkan::bindless {
+
+// Set 0 of every pipeline layout, shaders declare it through resources/shaders/bindless.glsl
+constexpr u32 BINDLESS_SET = 0;
+constexpr u32 BINDLESS_MAX_SAMPLED_IMAGES = 16384;
+constexpr u32 BINDLESS_MAX_STORAGE_BUFFERS = 16384;
+constexpr u32 BINDLESS_MAX_SAMPLERS = 1024;
+
+// Every pipeline layout shares this push constant range so the bindless set stays bound across pipeline switches,
+// 128 bytes is the minimum maxPushConstantsSize guaranteed by the spec
+constexpr u32 BINDLESS_PUSH_CONSTANT_SIZE = 128;
+
+bool create(context_t* context);
+void destroy(void);
+
+// Writes the resource into a free slot of the heap and returns its index, BINDLESS_INVALID_INDEX when full.
+// Slots are recycled by release() so callers must make sure the GPU is done with the old resource first.
+u32 register_image(VkImageView view, VkImageLayout layout);
+u32 register_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+u32 register_sampler(VkSampler sampler);
+void release(bindless_type_t type, u32 index);
+
+VkDescriptorType descriptor_type(bindless_type_t type);
+
+// Binds the heap, once per command buffer and bind point is enough since every layout is compatible for set 0.
+void bind(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipelineLayout layout);
+
+}
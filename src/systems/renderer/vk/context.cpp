@@ -1,14 +1,19 @@
 #include "context.hpp"
 
+#include "bindless.hpp"
 #include "core/containers/darray.hpp"
 #include "core/logger.hpp"
 #include "device.hpp"
+#include "host_memory.hpp"
 #include "loader.hpp"
+#include "memory.hpp"
+#include "pipeline_table.hpp"
 #include "swapchain.hpp"
 #include "systems/window/window.hpp"
 #include "utils.hpp"
 
 #include <cstdlib>
+#include <cstring>
 #include <vulkan/vk_enum_string_helper.h>
 
 namespace rin::renderer::vulkan::context {
@@ -78,7 +83,7 @@ bool create(const char* app_name, bool enable_validation, context_t** out)
             return false;
         }
 
-        vk_result = vkCreateInstance(&instance_info, nullptr, &context->instance);
+        vk_result = vkCreateInstance(&instance_info, host_memory::callbacks(), &context->instance);
         if (vk_result != VK_SUCCESS) {
             log::error("vulkan::context::initialize -> failed to create instance: %s", string_VkResult(vk_result));
             destroy();
@@ -108,7 +113,7 @@ bool create(const char* app_name, bool enable_validation, context_t** out)
                 .pUserData = nullptr,
             };
 
-            vk_result = vkCreateDebugUtilsMessengerEXT(context->instance, &info, nullptr, &context->messenger);
+            vk_result = vkCreateDebugUtilsMessengerEXT(context->instance, &info, host_memory::callbacks(), &context->messenger);
             if (vk_result != VK_SUCCESS) {
                 log::error("vulkan::context::initialize -> failed to create debug messenger: %s", string_VkResult(vk_result));
                 destroy();
@@ -150,12 +155,17 @@ bool create(const char* app_name, bool enable_validation, context_t** out)
     }
     log::debug("===================================================");
 
+    VmaAllocatorCreateFlags vma_flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    if (context->device->memory_budget) {
+        vma_flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
+
     VmaAllocatorCreateInfo vma_info = {
-        .flags = 0,
+        .flags = vma_flags,
         .physicalDevice = context->device->physical_device,
         .device = context->device->logical_device,
         .preferredLargeHeapBlockSize = 0,
-        .pAllocationCallbacks = nullptr,
+        .pAllocationCallbacks = host_memory::callbacks(),
         .pDeviceMemoryCallbacks = nullptr,
         .pHeapSizeLimit = nullptr,
         .pVulkanFunctions = nullptr,
@@ -176,6 +186,28 @@ bool create(const char* app_name, bool enable_validation, context_t** out)
         return false;
     }
 
+    if (!bindless::create(context)) {
+        log::error("vulkan::context::create -> failed to create bindless heap");
+        destroy();
+        return false;
+    }
+
+    if (!memory::create(context)) {
+        log::error("vulkan::context::create -> failed to create memory pools");
+        destroy();
+        return false;
+    }
+
+    if (!pipeline_table::create(context)) {
+        log::error("vulkan::context::create -> failed to create pipeline table");
+        destroy();
+        return false;
+    }
+
+    context->deletion = (deletion_queue_t*)calloc(1, sizeof(deletion_queue_t));
+    context->deletion->entries = darray<deletion_t> { 64, true };
+    context->deletion->frame = 1;
+
     *out = context;
     return true;
 }
@@ -189,6 +221,29 @@ void destroy(void)
 
     log::debug("destroying vulkan context");
 
+    // NOTE: the device is idle by now, everything still queued goes before what it was created from
+    if (context->deletion != nullptr) {
+        log::debug("flushing vulkan deletion queue");
+        memory::end_defragmentation();
+        collect(UINT64_MAX);
+        context->deletion->entries.~darray();
+        free(context->deletion);
+        context->deletion = nullptr;
+    }
+
+    if (context->pipelines != nullptr) {
+        log::debug("destroying vulkan pipeline table");
+        pipeline_table::destroy();
+    }
+
+    log::debug("destroying vulkan memory pools");
+    memory::destroy();
+
+    if (context->bindless != nullptr) {
+        log::debug("destroying vulkan bindless heap");
+        bindless::destroy();
+    }
+
     if (context->vma != nullptr) {
         log::debug("destroying vulkan memory allocator");
         vmaDestroyAllocator(context->vma);
@@ -207,16 +262,17 @@ void destroy(void)
     if (context->instance != VK_NULL_HANDLE) {
         if (context->surface != VK_NULL_HANDLE) {
             log::debug("destroying vulkan surface");
+            // NOTE: created by glfw without callbacks, it has to go the same way
             vkDestroySurfaceKHR(context->instance, context->surface, nullptr);
         }
 
         if (context->messenger != VK_NULL_HANDLE) {
             log::debug("destroying vulkan debug messenger");
-            vkDestroyDebugUtilsMessengerEXT(context->instance, context->messenger, nullptr);
+            vkDestroyDebugUtilsMessengerEXT(context->instance, context->messenger, host_memory::callbacks());
         }
 
         log::debug("destroying vulkan instance");
-        vkDestroyInstance(context->instance, nullptr);
+        vkDestroyInstance(context->instance, host_memory::callbacks());
     }
 
     free(context);
@@ -226,29 +282,40 @@ void destroy(void)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool allocate_buffer(const buffer_create_info_t& info, buffer_t* out)
 {
+    if (memory::suballocate(info, out)) {
+        return true;
+    }
+
+    memory::memory_class_t memory_class = memory::classify(info);
+
     VkBufferCreateInfo buffer_info {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
         .size = info.size,
-        .usage = info.usage,
+        .usage = info.usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 0,
         .pQueueFamilyIndices = nullptr,
     };
 
     VmaAllocationCreateInfo vma_info {
-        .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+        .flags = memory::allocation_flags(memory_class),
         .usage = info.memory_usage,
         .requiredFlags = 0,
         .preferredFlags = 0,
         .memoryTypeBits = 0,
-        .pool = 0,
+        .pool = memory::pool(memory_class),
         .pUserData = nullptr,
         .priority = 0,
     };
 
     VkResult result = vmaCreateBuffer(context->vma, &buffer_info, &vma_info, &out->handle, &out->memory, &out->allocation_info);
+    if (result != VK_SUCCESS && vma_info.pool != VK_NULL_HANDLE) {
+        // NOTE: the pool is bound to a memory type the buffer may not support, or the buffer outgrows its blocks
+        vma_info.pool = VK_NULL_HANDLE;
+        result = vmaCreateBuffer(context->vma, &buffer_info, &vma_info, &out->handle, &out->memory, &out->allocation_info);
+    }
 
     if (result != VK_SUCCESS) {
         log::error("vulkan::context::allocate_buffer -> failed to allocate buffer: %s", string_VkResult(result));
@@ -256,11 +323,242 @@ bool allocate_buffer(const buffer_create_info_t& info, buffer_t* out)
     }
 
     out->memory_usage = info.memory_usage;
-    out->usage = info.usage;
+    out->usage = buffer_info.usage;
     out->size = info.size;
+    out->offset = 0;
+    out->suballocation = VK_NULL_HANDLE;
+    out->bindless_index = BINDLESS_INVALID_INDEX;
+    out->tag = info.tag;
+    memory::track(out->memory, info.tag);
+
+    VkBufferDeviceAddressInfo address_info {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .pNext = nullptr,
+        .buffer = out->handle,
+    };
+    out->address = vkGetBufferDeviceAddress(context->device->logical_device, &address_info);
+
+    if (info.usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+        out->bindless_index = bindless::register_buffer(out->handle, 0, VK_WHOLE_SIZE);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool begin_immediate(const char* caller, VkCommandPool* pool, VkCommandBuffer* cmd)
+{
+    VkDevice device = context->device->logical_device;
+
+    VkCommandPoolCreateInfo pool_info {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = (u32)context->device->graphics_queue.family,
+    };
+
+    VkResult result = vkCreateCommandPool(device, &pool_info, host_memory::callbacks(), pool);
+    if (result != VK_SUCCESS) {
+        log::error("vulkan::context::%s -> failed to create command pool: %s", caller, string_VkResult(result));
+        return false;
+    }
+
+    VkCommandBufferAllocateInfo alloc_info {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .commandPool = *pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    vkAllocateCommandBuffers(device, &alloc_info, cmd);
+
+    VkCommandBufferBeginInfo begin_info {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr,
+    };
+    vkBeginCommandBuffer(*cmd, &begin_info);
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool end_immediate(const char* caller, VkCommandPool pool, VkCommandBuffer cmd)
+{
+    vkEndCommandBuffer(cmd);
+
+    VkCommandBufferSubmitInfo cmd_submit {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .pNext = nullptr,
+        .commandBuffer = cmd,
+        .deviceMask = 0,
+    };
+
+    VkSubmitInfo2 submit_info {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .pNext = nullptr,
+        .flags = 0,
+        .waitSemaphoreInfoCount = 0,
+        .pWaitSemaphoreInfos = nullptr,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &cmd_submit,
+        .signalSemaphoreInfoCount = 0,
+        .pSignalSemaphoreInfos = nullptr,
+    };
+
+    // NOTE: waiting for the whole queue also keeps the copy from racing frames still reading the destination
+    vkQueueWaitIdle(context->device->graphics_queue.handle);
+    VkResult result = vkQueueSubmit2(context->device->graphics_queue.handle, 1, &submit_info, VK_NULL_HANDLE);
+    if (result == VK_SUCCESS) {
+        result = vkQueueWaitIdle(context->device->graphics_queue.handle);
+    }
+
+    vkDestroyCommandPool(context->device->logical_device, pool, host_memory::callbacks());
+
+    if (result != VK_SUCCESS) {
+        log::error("vulkan::context::%s -> failed to submit copy: %s", caller, string_VkResult(result));
+        return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool allocate_staging(const char* caller, const void* data, u64 size, buffer_t* out)
+{
+    buffer_create_info_t staging_info {
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = false,
+        .tag = MEMORY_TAG_STAGING,
+    };
+
+    if (!allocate_buffer(staging_info, out)) {
+        log::error("vulkan::context::%s -> failed to allocate staging buffer", caller);
+        return false;
+    }
+
+    memcpy(out->allocation_info.pMappedData, data, size);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool upload_buffer(const buffer_t& dst, u64 offset, const void* data, u64 size)
+{
+    buffer_t staging {};
+    if (!allocate_staging("upload_buffer", data, size, &staging)) {
+        return false;
+    }
+
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    if (!begin_immediate("upload_buffer", &pool, &cmd)) {
+        destroy_buffer(&staging);
+        return false;
+    }
+
+    VkBufferCopy region {
+        .srcOffset = 0,
+        .dstOffset = offset,
+        .size = size,
+    };
+    vkCmdCopyBuffer(cmd, staging.handle, dst.handle, 1, &region);
+
+    bool result = end_immediate("upload_buffer", pool, cmd);
+    destroy_buffer(&staging);
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool upload_image(const image_t& dst, const void* pixels, u64 size)
+{
+    buffer_t staging {};
+    if (!allocate_staging("upload_image", pixels, size, &staging)) {
+        return false;
+    }
+
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    if (!begin_immediate("upload_image", &pool, &cmd)) {
+        destroy_buffer(&staging);
+        return false;
+    }
+
+    VkImageMemoryBarrier2 to_transfer = image_layout_transition(
+        dst.handle, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_ACCESS_2_NONE,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_NONE,
+        VK_PIPELINE_STAGE_2_COPY_BIT);
+
+    VkDependencyInfo dep {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 0,
+        .pMemoryBarriers = nullptr,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = nullptr,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &to_transfer,
+    };
+    vkCmdPipelineBarrier2(cmd, &dep);
+
+    VkBufferImageCopy region {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = { dst.width, dst.height, 1 },
+    };
+    vkCmdCopyBufferToImage(cmd, staging.handle, dst.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // NOTE: the bindless descriptor of sampled images is written with the read only layout
+    VkImageMemoryBarrier2 to_read = image_layout_transition(
+        dst.handle, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+        VK_PIPELINE_STAGE_2_COPY_BIT,
+        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+    dep.pImageMemoryBarriers = &to_read;
+    vkCmdPipelineBarrier2(cmd, &dep);
+
+    bool result = end_immediate("upload_image", pool, cmd);
+    destroy_buffer(&staging);
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy_buffer(buffer_t* buffer)
+{
+    if (buffer->handle == VK_NULL_HANDLE) {
+        return;
+    }
+
+    bindless::release(BINDLESS_TYPE_STORAGE_BUFFER, buffer->bindless_index);
+    if (buffer->suballocation != VK_NULL_HANDLE) {
+        memory::free_suballocation(buffer);
+    } else {
+        memory::untrack(buffer->memory, buffer->tag);
+        vmaDestroyBuffer(context->vma, buffer->handle, buffer->memory);
+    }
+    buffer->handle = VK_NULL_HANDLE;
+    buffer->memory = nullptr;
+    buffer->address = 0;
+    buffer->bindless_index = BINDLESS_INVALID_INDEX;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool allocate_image(const image_create_info_t& info, image_t* out)
 {
@@ -286,17 +584,55 @@ bool allocate_image(const image_create_info_t& info, image_t* out)
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
     };
 
+    VmaAllocationCreateInfo vma_info = info.allocation_info;
+    if (vma_info.pool == VK_NULL_HANDLE) {
+        vma_info.pool = memory::pool(memory::classify(info));
+    }
+
     VkImage image = VK_NULL_HANDLE;
     VmaAllocation allocation = nullptr;
-    VkResult result = vmaCreateImage(context->vma, &image_info, &info.allocation_info, &image, &allocation, nullptr);
+    VkResult result = vmaCreateImage(context->vma, &image_info, &vma_info, &image, &allocation, nullptr);
+    if (result != VK_SUCCESS && vma_info.pool != info.allocation_info.pool) {
+        vma_info.pool = VK_NULL_HANDLE;
+        result = vmaCreateImage(context->vma, &image_info, &vma_info, &image, &allocation, nullptr);
+    }
 
     if (result != VK_SUCCESS) {
         log::error("vulkan::context::allocate_image -> failed to allocate image: %s", string_VkResult(result));
         return false;
     }
 
+    VkImageView view = VK_NULL_HANDLE;
+    if (!create_image_view(image, info.format, info.type, &view)) {
+        vmaDestroyImage(context->vma, image, allocation);
+        return false;
+    }
+
+    out->handle = image;
+    out->view = view;
+    out->memory = allocation;
+    out->type = info.type;
+    out->format = info.format;
+    out->width = info.width;
+    out->height = info.height;
+    out->allocation_info = info.allocation_info;
+    out->usage = info.usage;
+    out->bindless_index = BINDLESS_INVALID_INDEX;
+    out->tag = info.tag;
+    memory::track(allocation, info.tag);
+
+    if (info.usage & VK_IMAGE_USAGE_SAMPLED_BIT) {
+        out->bindless_index = bindless::register_image(view, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create_image_view(VkImage image, VkFormat format, image_type_t type, VkImageView* out)
+{
     VkImageAspectFlags aspect = 0;
-    switch (info.type) {
+    switch (type) {
     case IMAGE_TYPE_COLOR:
         aspect = VK_IMAGE_ASPECT_COLOR_BIT;
         break;
@@ -313,7 +649,7 @@ bool allocate_image(const image_create_info_t& info, image_t* out)
         .flags = 0,
         .image = image,
         .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .format = info.format,
+        .format = format,
         .components = {
             .r = VK_COMPONENT_SWIZZLE_IDENTITY,
             .g = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -329,27 +665,188 @@ bool allocate_image(const image_create_info_t& info, image_t* out)
         },
     };
 
-    VkImageView view = VK_NULL_HANDLE;
-    result = vkCreateImageView(context->device->logical_device, &view_info, nullptr, &view);
+    VkResult result = vkCreateImageView(context->device->logical_device, &view_info, host_memory::callbacks(), out);
 
     if (result != VK_SUCCESS) {
-        log::error("vulkan::context::allocate_image -> failed to create image view: %s", string_VkResult(result));
+        log::error("vulkan::context::create_image_view -> failed to create image view: %s", string_VkResult(result));
         return false;
     }
 
-    out->handle = image;
-    out->view = view;
-    out->memory = allocation;
-    out->type = info.type;
-    out->format = info.format;
-    out->width = info.width;
-    out->height = info.height;
-    out->allocation_info = info.allocation_info;
-    out->usage = info.usage;
-
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy_image(image_t* image)
+{
+    if (image->handle == VK_NULL_HANDLE) {
+        return;
+    }
+
+    bindless::release(BINDLESS_TYPE_SAMPLED_IMAGE, image->bindless_index);
+    vkDestroyImageView(context->device->logical_device, image->view, host_memory::callbacks());
+    memory::untrack(image->memory, image->tag);
+    vmaDestroyImage(context->vma, image->handle, image->memory);
+    image->handle = VK_NULL_HANDLE;
+    image->view = VK_NULL_HANDLE;
+    image->memory = nullptr;
+    image->bindless_index = BINDLESS_INVALID_INDEX;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u64 end_frame(void)
+{
+    u64 submitted = context->deletion->frame;
+    context->deletion->frame += 1;
+    return submitted;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void destroy_entry(deletion_t& entry)
+{
+    VkDevice device = context->device->logical_device;
+
+    switch (entry.type) {
+    case DELETION_TYPE_BUFFER:
+        destroy_buffer(&entry.buffer);
+        break;
+    case DELETION_TYPE_IMAGE:
+        destroy_image(&entry.image);
+        break;
+    case DELETION_TYPE_IMAGE_VIEW:
+        vkDestroyImageView(device, entry.view, host_memory::callbacks());
+        break;
+    case DELETION_TYPE_PIPELINE:
+        vkDestroyPipeline(device, entry.pipeline, host_memory::callbacks());
+        break;
+    case DELETION_TYPE_DESCRIPTOR_SET:
+        vkFreeDescriptorSets(device, entry.descriptor_set.pool, 1, &entry.descriptor_set.set);
+        break;
+    case DELETION_TYPE_COMMAND_POOL:
+        vkDestroyCommandPool(device, entry.command_pool, host_memory::callbacks());
+        break;
+    case DELETION_TYPE_SEMAPHORE:
+        vkDestroySemaphore(device, entry.semaphore, host_memory::callbacks());
+        break;
+    case DELETION_TYPE_SWAPCHAIN:
+        vkDestroySwapchainKHR(device, entry.swapchain, host_memory::callbacks());
+        break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void collect(u64 completed_frame)
+{
+    // NOTE: held back while defragmenting, nothing leaves the pools while VMA is moving allocations between blocks
+    if (memory::defragmenting()) {
+        return;
+    }
+
+    darray<deletion_t>& entries = context->deletion->entries;
+
+    // NOTE: frames never decrease along the queue, the completed entries are always a prefix
+    size_t count = 0;
+    while (count < entries.len && entries[count].frame <= completed_frame) {
+        destroy_entry(entries[count]);
+        count++;
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    memmove(entries.data, entries.data + count, (entries.len - count) * sizeof(deletion_t));
+    entries.len -= count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static deletion_t* push_entry(deletion_type_t type)
+{
+    deletion_t entry {};
+    entry.type = type;
+    entry.frame = context->deletion->frame;
+    context->deletion->entries.push(entry);
+    return &context->deletion->entries[context->deletion->entries.len - 1];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void retire_buffer(buffer_t* buffer)
+{
+    if (buffer->handle == VK_NULL_HANDLE) {
+        return;
+    }
+
+    push_entry(DELETION_TYPE_BUFFER)->buffer = *buffer;
+    *buffer = {};
+    buffer->bindless_index = BINDLESS_INVALID_INDEX;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void retire_image(image_t* image)
+{
+    if (image->handle == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // NOTE: a retired image is no longer the owner defragmentation would move
+    if (image->memory != nullptr) {
+        vmaSetAllocationUserData(context->vma, image->memory, nullptr);
+    }
+
+    push_entry(DELETION_TYPE_IMAGE)->image = *image;
+    *image = {};
+    image->bindless_index = BINDLESS_INVALID_INDEX;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void retire_image_view(VkImageView view)
+{
+    if (view != VK_NULL_HANDLE) {
+        push_entry(DELETION_TYPE_IMAGE_VIEW)->view = view;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void retire_pipeline(VkPipeline pipeline)
+{
+    if (pipeline != VK_NULL_HANDLE) {
+        push_entry(DELETION_TYPE_PIPELINE)->pipeline = pipeline;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void retire_descriptor_set(VkDescriptorPool pool, VkDescriptorSet set)
+{
+    if (set != VK_NULL_HANDLE) {
+        deletion_t* entry = push_entry(DELETION_TYPE_DESCRIPTOR_SET);
+        entry->descriptor_set.pool = pool;
+        entry->descriptor_set.set = set;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void retire_command_pool(VkCommandPool pool)
+{
+    if (pool != VK_NULL_HANDLE) {
+        push_entry(DELETION_TYPE_COMMAND_POOL)->command_pool = pool;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void retire_semaphore(VkSemaphore semaphore)
+{
+    if (semaphore != VK_NULL_HANDLE) {
+        push_entry(DELETION_TYPE_SEMAPHORE)->semaphore = semaphore;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void retire_swapchain(VkSwapchainKHR swapchain)
+{
+    if (swapchain != VK_NULL_HANDLE) {
+        push_entry(DELETION_TYPE_SWAPCHAIN)->swapchain = swapchain;
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void begin_label(VkCommandBuffer cmd, const char* name, const glm::vec4& color)
 {
@@ -13,6 +13,35 @@ void begin_label(VkCommandBuffer cmd, const char* name, const glm::vec4& color);
 void end_label(VkCommandBuffer cmd);
 bool allocate_image(const image_create_info_t& info, image_t* out);
 bool allocate_buffer(const buffer_create_info_t& info, buffer_t* out);
+bool create_image_view(VkImage image, VkFormat format, image_type_t type, VkImageView* out);
+
+// Copies data into a device local buffer through a staging buffer, blocks until the copy completed
+// so it is meant for load time uploads rather than per frame streaming.
+bool upload_buffer(const buffer_t& dst, u64 offset, const void* data, u64 size);
+
+// Same for the whole first mip of a color image, which is left in VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL.
+bool upload_image(const image_t& dst, const void* pixels, u64 size);
+
+// Sampled images and storage buffers get a slot in the bindless heap, destroying them releases it.
+void destroy_image(image_t* image);
+void destroy_buffer(buffer_t* buffer);
+
+// Deletion queue: objects frames in flight may still use are retired with the frame being recorded and destroyed
+// in batches by collect() once that frame has completed, so freeing at runtime never waits on the device.
+// end_frame() is called right after each frame submit, it returns the value the submitted frame is known by.
+u64 end_frame(void);
+void collect(u64 completed_frame);
+
+// The retire_ functions take ownership, images and buffers are cleared like destroy_image() and destroy_buffer().
+// Descriptor sets need a pool created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT.
+void retire_buffer(buffer_t* buffer);
+void retire_image(image_t* image);
+void retire_image_view(VkImageView view);
+void retire_pipeline(VkPipeline pipeline);
+void retire_descriptor_set(VkDescriptorPool pool, VkDescriptorSet set);
+void retire_command_pool(VkCommandPool pool);
+void retire_semaphore(VkSemaphore semaphore);
+void retire_swapchain(VkSwapchainKHR swapchain);
 
 inline VkImageMemoryBarrier2 image_layout_transition(
     VkImage image, VkImageAspectFlags aspect_mask,
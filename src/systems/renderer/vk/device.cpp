@@ -1,6 +1,7 @@
 #include "device.hpp"
 
 #include "core/logger.hpp"
+#include "host_memory.hpp"
 #include "loader.hpp"
 #include "utils.hpp"
 
@@ -47,8 +48,119 @@ bool create(context_t* context)
     vkGetPhysicalDeviceFeatures(device->physical_device, &device->features);
     vkGetPhysicalDeviceMemoryProperties(device->physical_device, &device->memory);
 
+    device->descriptor_indexing = VkPhysicalDeviceDescriptorIndexingProperties {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES,
+        .pNext = nullptr,
+    };
+
+    VkPhysicalDeviceProperties2 properties2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &device->descriptor_indexing,
+        .properties = {},
+    };
+    vkGetPhysicalDeviceProperties2(device->physical_device, &properties2);
+    device->descriptor_indexing.pNext = nullptr;
+
+    // NOTE: bindless, vertex pulling and indirect draws rely on these, they are optional even on 1.4
+    // NOTE: value initialized, the struct has far too many members to spell out for a query
+    VkPhysicalDeviceVulkan12Features support12 {};
+    support12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    support12.pNext = nullptr;
+
+    VkPhysicalDeviceFeatures2 support = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &support12,
+        .features = {},
+    };
+    vkGetPhysicalDeviceFeatures2(device->physical_device, &support);
+
+    if (!support12.shaderSampledImageArrayNonUniformIndexing
+        || !support12.shaderStorageBufferArrayNonUniformIndexing
+        || !support12.descriptorBindingSampledImageUpdateAfterBind
+        || !support12.descriptorBindingStorageBufferUpdateAfterBind
+        || !support12.descriptorBindingUpdateUnusedWhilePending
+        || !support12.descriptorBindingPartiallyBound
+        || !support12.runtimeDescriptorArray) {
+        log::error("vulkan::device::create -> device does not support the descriptor indexing features required for bindless");
+        destroy();
+        return false;
+    }
+
+    if (!support12.bufferDeviceAddress) {
+        log::error("vulkan::device::create -> device does not support buffer device address");
+        destroy();
+        return false;
+    }
+
+    if (!support12.drawIndirectCount || !support.features.multiDrawIndirect || !support.features.drawIndirectFirstInstance) {
+        log::error("vulkan::device::create -> device does not support multi draw indirect with count");
+        destroy();
+        return false;
+    }
+
+    // NOTE: meshlets are drawn through task and mesh shaders when the device has them, a compute pass otherwise
+    VkPhysicalDeviceMeshShaderFeaturesEXT mesh_support = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+        .pNext = nullptr,
+        .taskShader = VK_FALSE,
+        .meshShader = VK_FALSE,
+        .multiviewMeshShader = VK_FALSE,
+        .primitiveFragmentShadingRateMeshShader = VK_FALSE,
+        .meshShaderQueries = VK_FALSE,
+    };
+
+    if (utils::supports_device_extension(device->physical_device, VK_EXT_MESH_SHADER_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 mesh_query = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &mesh_support,
+            .features = {},
+        };
+        vkGetPhysicalDeviceFeatures2(device->physical_device, &mesh_query);
+        device->mesh_shader = mesh_support.taskShader && mesh_support.meshShader;
+    }
+    log::info("Mesh shaders: %s", device->mesh_shader ? "supported" : "not supported, using the compute fallback");
+
+    // NOTE: present ids and waits measure when frames reach the display and cap how many are queued for it
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_support = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+        .pNext = nullptr,
+        .presentId = VK_FALSE,
+    };
+
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_support = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+        .pNext = &present_id_support,
+        .presentWait = VK_FALSE,
+    };
+
+    if (utils::supports_device_extension(device->physical_device, VK_KHR_PRESENT_ID_EXTENSION_NAME)
+        && utils::supports_device_extension(device->physical_device, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 present_query = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &present_wait_support,
+            .features = {},
+        };
+        vkGetPhysicalDeviceFeatures2(device->physical_device, &present_query);
+        device->present_wait = present_id_support.presentId && present_wait_support.presentWait;
+    }
+    log::info("Present wait: %s", device->present_wait ? "supported" : "not supported, display latency is not measured");
+
+    // NOTE: without it VMA only knows its own allocations, other processes and the driver stay invisible to the budget
+    device->memory_budget = utils::supports_device_extension(device->physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    log::info("Memory budget: %s", device->memory_budget ? "supported" : "not supported, budgets are estimated");
+
     darray<const char*> required_extensions { true };
     required_extensions.push("VK_KHR_swapchain");
+    if (device->mesh_shader) {
+        required_extensions.push(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    }
+    if (device->present_wait) {
+        required_extensions.push(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        required_extensions.push(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
+    if (device->memory_budget) {
+        required_extensions.push(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
 
     if (!utils::load_device_extensions(device->physical_device, &device_info, required_extensions)) {
         log::error("vulkan_device_create -> device does not supports all required extensions");
@@ -101,15 +213,57 @@ bool create(context_t* context)
     device_info.pQueueCreateInfos = queue_infos.data;
     device_info.queueCreateInfoCount = queue_infos.len;
 
-    VkPhysicalDeviceTimelineSemaphoreFeatures tim_sem = {
-        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+    // NOTE: value initialized like support12, only the features the renderer relies on are enabled
+    VkPhysicalDeviceVulkan12Features features12 {};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.pNext = nullptr;
+    features12.drawIndirectCount = VK_TRUE;
+    features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    features12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+    features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features12.descriptorBindingPartiallyBound = VK_TRUE;
+    features12.runtimeDescriptorArray = VK_TRUE;
+    features12.timelineSemaphore = VK_TRUE;
+    features12.bufferDeviceAddress = VK_TRUE;
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT mesh_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
         .pNext = nullptr,
-        .timelineSemaphore = VK_TRUE,
+        .taskShader = VK_TRUE,
+        .meshShader = VK_TRUE,
+        .multiviewMeshShader = VK_FALSE,
+        .primitiveFragmentShadingRateMeshShader = VK_FALSE,
+        .meshShaderQueries = VK_FALSE,
     };
 
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+        .pNext = nullptr,
+        .presentId = VK_TRUE,
+    };
+
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+        .pNext = &present_id_features,
+        .presentWait = VK_TRUE,
+    };
+
+    // NOTE: only chained when supported, an unknown structure would fail the device creation
+    if (device->mesh_shader) {
+        mesh_features.pNext = features12.pNext;
+        features12.pNext = &mesh_features;
+    }
+
+    if (device->present_wait) {
+        present_id_features.pNext = features12.pNext;
+        features12.pNext = &present_wait_features;
+    }
+
     VkPhysicalDeviceSynchronization2Features sync2 = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES,
-        .pNext = &tim_sem,
+        .pNext = &features12,
         .synchronization2 = VK_TRUE,
     };
 
@@ -119,10 +273,19 @@ bool create(context_t* context)
         .dynamicRendering = VK_TRUE,
     };
 
-    device_info.pNext = &dyn_ren;
+    // NOTE: core features go through the chain as well, pEnabledFeatures must stay null
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &dyn_ren,
+        .features = {},
+    };
+    features.features.multiDrawIndirect = VK_TRUE;
+    features.features.drawIndirectFirstInstance = VK_TRUE;
+
+    device_info.pNext = &features;
 
     // NOTE: create device
-    VkResult result = vkCreateDevice(device->physical_device, &device_info, nullptr, &device->logical_device);
+    VkResult result = vkCreateDevice(device->physical_device, &device_info, host_memory::callbacks(), &device->logical_device);
     if (result != VK_SUCCESS) {
         log::error("vulkan_device_create -> failed to create logical device: %s", string_VkResult(result));
         destroy();
@@ -148,7 +311,7 @@ void destroy(void)
     }
 
     if (device->logical_device != VK_NULL_HANDLE) {
-        vkDestroyDevice(device->logical_device, nullptr);
+        vkDestroyDevice(device->logical_device, host_memory::callbacks());
     }
 
     device->context->device = nullptr;
@@ -0,0 +1,205 @@
+#include "host_memory.hpp"
+
+#include "core/logger.hpp"
+#include "core/profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <imgui.h>
+
+namespace rin::renderer::vulkan::host_memory {
+
+constexpr const char* SCOPE_NAMES[HOST_MEMORY_SCOPE_COUNT] = {
+    "Command",
+    "Object",
+    "Cache",
+    "Device",
+    "Instance",
+};
+
+// NOTE: sits right before the pointer handed out, the alignment padding goes in front of it
+struct header_t {
+    u64 size;
+    u32 offset; // from the start of the malloc block to the pointer handed out
+    u32 scope;
+};
+
+// NOTE: plain statics rather than a created state, the callbacks are needed before anything else exists and
+// VkAllocationCallbacks must stay valid until the instance is gone
+static std::atomic<u64> scope_bytes[HOST_MEMORY_SCOPE_COUNT];
+static std::atomic<u64> scope_peak[HOST_MEMORY_SCOPE_COUNT];
+static std::atomic<u64> scope_allocations[HOST_MEMORY_SCOPE_COUNT];
+static std::atomic<u64> scope_calls[HOST_MEMORY_SCOPE_COUNT];
+static std::atomic<u64> total_bytes;
+static std::atomic<u64> internal_bytes; // allocated by the driver itself, only reported to us
+static std::atomic<u64> frame_calls;
+static std::atomic<u64> failures; // refused by the limit
+static std::atomic<u64> limit { HOST_MEMORY_DEFAULT_LIMIT };
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void account(u32 scope, u64 size)
+{
+    u64 bytes = scope_bytes[scope].fetch_add(size, std::memory_order_relaxed) + size;
+    u64 peak = scope_peak[scope].load(std::memory_order_relaxed);
+    while (bytes > peak && !scope_peak[scope].compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) { }
+
+    scope_allocations[scope].fetch_add(1, std::memory_order_relaxed);
+    scope_calls[scope].fetch_add(1, std::memory_order_relaxed);
+    total_bytes.fetch_add(size, std::memory_order_relaxed);
+    frame_calls.fetch_add(1, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void* VKAPI_CALL allocate(void*, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (size == 0) {
+        return nullptr;
+    }
+
+    u64 cap = limit.load(std::memory_order_relaxed);
+    if (cap != 0 && total_bytes.load(std::memory_order_relaxed) + size > cap) {
+        failures.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    // NOTE: malloc rather than aligned_alloc, it is missing on Windows and realloc needs the size anyway
+    alignment = std::max(alignment, alignof(header_t));
+    u8* block = (u8*)malloc(size + sizeof(header_t) + alignment);
+    if (block == nullptr) {
+        return nullptr;
+    }
+
+    uintptr_t address = ((uintptr_t)block + sizeof(header_t) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    header_t* header = (header_t*)address - 1;
+    header->size = size;
+    header->offset = (u32)(address - (uintptr_t)block);
+    header->scope = (u32)scope;
+
+    account(header->scope, size);
+    return (void*)address;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void VKAPI_CALL release(void*, void* memory)
+{
+    if (memory == nullptr) {
+        return;
+    }
+
+    header_t* header = (header_t*)memory - 1;
+    scope_bytes[header->scope].fetch_sub(header->size, std::memory_order_relaxed);
+    scope_allocations[header->scope].fetch_sub(1, std::memory_order_relaxed);
+    total_bytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+    free((u8*)memory - header->offset);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void* VKAPI_CALL reallocate(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (original == nullptr) {
+        return allocate(user_data, size, alignment, scope);
+    }
+
+    if (size == 0) {
+        release(user_data, original);
+        return nullptr;
+    }
+
+    // NOTE: the original stays valid when the new allocation fails, as the spec requires
+    void* memory = allocate(user_data, size, alignment, scope);
+    if (memory == nullptr) {
+        return nullptr;
+    }
+
+    const header_t* header = (const header_t*)original - 1;
+    memcpy(memory, original, std::min((u64)size, header->size));
+    release(user_data, original);
+    return memory;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void VKAPI_CALL internal_allocation(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+{
+    internal_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void VKAPI_CALL internal_free(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+{
+    internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+static const VkAllocationCallbacks CALLBACKS {
+    .pUserData = nullptr,
+    .pfnAllocation = allocate,
+    .pfnReallocation = reallocate,
+    .pfnFree = release,
+    .pfnInternalAllocation = internal_allocation,
+    .pfnInternalFree = internal_free,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+const VkAllocationCallbacks* callbacks(void)
+{
+    return &CALLBACKS;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void set_limit(u64 bytes)
+{
+    limit.store(bytes, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+scope_stats_t scope_stats(VkSystemAllocationScope scope)
+{
+    return scope_stats_t {
+        .bytes = scope_bytes[scope].load(std::memory_order_relaxed),
+        .peak = scope_peak[scope].load(std::memory_order_relaxed),
+        .allocations = scope_allocations[scope].load(std::memory_order_relaxed),
+        .calls = scope_calls[scope].load(std::memory_order_relaxed),
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void end_frame(void)
+{
+    u64 calls = frame_calls.exchange(0, std::memory_order_relaxed);
+    profiler::record("driver allocations", "calls", (f64)calls);
+    profiler::record("driver memory", "KB", (f64)total_bytes.load(std::memory_order_relaxed) / 1024.0);
+
+    if (calls > HOST_MEMORY_STORM_CALLS) {
+        log::warn("host_memory -> %llu driver allocations in one frame", (unsigned long long)calls);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    for (u32 i = 0; i < HOST_MEMORY_SCOPE_COUNT; i++) {
+        scope_stats_t stats = scope_stats((VkSystemAllocationScope)i);
+        ImGui::Text("%s: %llu allocations, %.1f KB (peak %.1f KB), %llu calls", SCOPE_NAMES[i],
+            (unsigned long long)stats.allocations, (f64)stats.bytes / 1024.0, (f64)stats.peak / 1024.0,
+            (unsigned long long)stats.calls);
+    }
+
+    ImGui::Text("Total: %.1f KB, driver internal %.1f KB", (f64)total_bytes.load(std::memory_order_relaxed) / 1024.0,
+        (f64)internal_bytes.load(std::memory_order_relaxed) / 1024.0);
+
+    // NOTE: 0 is uncapped, a cap below the live total makes every further allocation fail
+    u32 limit_mb = (u32)(limit.load(std::memory_order_relaxed) / (1024 * 1024));
+    if (ImGui::InputScalar("Limit (MB)", ImGuiDataType_U32, &limit_mb)) {
+        set_limit((u64)limit_mb * 1024 * 1024);
+    }
+
+    u64 refused = failures.load(std::memory_order_relaxed);
+    if (refused > 0) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%llu allocations refused by the limit", (unsigned long long)refused);
+    }
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "types.hpp"
+
+namespace rin::renderer::vulkan::host_memory {
+
+constexpr u32 HOST_MEMORY_SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+constexpr u64 HOST_MEMORY_DEFAULT_LIMIT = 0; // bytes, 0 leaves the driver uncapped
+constexpr u64 HOST_MEMORY_STORM_CALLS = 512; // allocation calls in one frame reported as a storm
+
+struct scope_stats_t {
+    u64 bytes; // live
+    u64 peak;
+    u64 allocations; // live
+    u64 calls; // allocations and reallocations since startup
+};
+
+// Callbacks every vkCreate*, vkDestroy* and the VMA allocator pass, so the host memory the driver and VMA allocate
+// is accounted per VkSystemAllocationScope. Always the same pointer, objects must be destroyed with the callbacks
+// they were created with. Thread safe, drivers allocate from whatever thread creates the object.
+const VkAllocationCallbacks* callbacks(void);
+
+// Allocations that would take the live total above the limit fail, the call then returns
+// VK_ERROR_OUT_OF_HOST_MEMORY. 0 removes the cap.
+void set_limit(u64 bytes);
+
+scope_stats_t scope_stats(VkSystemAllocationScope scope);
+
+// Records the allocation calls of the frame and the live total as profiler stats, warns when the calls exceed
+// HOST_MEMORY_STORM_CALLS. Called once per frame.
+void end_frame(void);
+
+void draw_gui(void);
+
+}
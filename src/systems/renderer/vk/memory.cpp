@@ -0,0 +1,717 @@
+#include "memory.hpp"
+
+#include "bindless.hpp"
+#include "context.hpp"
+#include "core/logger.hpp"
+#include "core/profiler.hpp"
+#include "host_memory.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <imgui.h>
+#include <vulkan/vk_enum_string_helper.h>
+
+namespace rin::renderer::vulkan::memory {
+
+constexpr u32 MEMORY_DEFRAG_CHECK_FRAMES = 120; // between fragmentation checks of the automatic mode
+
+constexpr const char* CLASS_NAMES[MEMORY_CLASS_COUNT] = {
+    "Static",
+    "Upload",
+    "Readback",
+    "Targets",
+};
+
+constexpr const char* TAG_NAMES[MEMORY_TAG_COUNT] = {
+    "Geometry",
+    "Scene",
+    "Clusters",
+    "Lights",
+    "Occlusion",
+    "Sprites",
+    "Targets",
+    "Staging",
+    "Capture",
+    "Debug draw",
+    "Small block arena",
+};
+
+// NOTE: handles replaced by a move of the open pass, destroyed when it ends
+struct moved_image_t {
+    VkImage handle;
+    VkImageView view;
+    u32 bindless_index;
+};
+
+struct state_t {
+    context_t* context;
+    VmaPool pools[MEMORY_CLASS_COUNT];
+    buffer_t arena; // backs every suballocation
+    VmaVirtualBlock arena_block;
+    u64 arena_alignment;
+    VmaDefragmentationContext defrag; // non null while defragmenting
+    VmaDefragmentationPassMoveInfo pass;
+    bool pass_open;
+    u64 pass_frame; // deletion queue frame the pass ends after
+    u32 pass_count; // of the ongoing or last defragmentation
+    darray<moved_image_t> moved;
+    VmaDefragmentationStats last_stats;
+    bool automatic;
+    u32 frames_since_check;
+    u64 tag_bytes[MEMORY_TAG_COUNT];
+    u32 tag_allocations[MEMORY_TAG_COUNT];
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    bool over_budget; // device local usage above the budget at the last refresh, warned once per crossing
+};
+
+static state_t* state = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+VmaAllocationCreateFlags allocation_flags(memory_class_t memory_class)
+{
+    switch (memory_class) {
+    case MEMORY_CLASS_UPLOAD:
+        return VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    case MEMORY_CLASS_READBACK:
+        return VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+    default:
+        return 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool create_pool(memory_class_t memory_class, u32 type_index)
+{
+    VmaPoolCreateInfo info {
+        .memoryTypeIndex = type_index,
+        .flags = 0,
+        .blockSize = 0, // VMA default, 256 MB blocks on large heaps
+        .minBlockCount = 0,
+        .maxBlockCount = 0,
+        .priority = memory_class == MEMORY_CLASS_TARGETS ? 1.0f : 0.5f,
+        .minAllocationAlignment = 0,
+        .pMemoryAllocateNext = nullptr,
+    };
+
+    VkResult result = vmaCreatePool(state->context->vma, &info, &state->pools[memory_class]);
+    if (result != VK_SUCCESS) {
+        log::error("memory::create -> failed to create the %s pool: %s", CLASS_NAMES[memory_class], string_VkResult(result));
+        return false;
+    }
+
+    vmaSetPoolName(state->context->vma, state->pools[memory_class], CLASS_NAMES[memory_class]);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool create_buffer_pool(memory_class_t memory_class, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage)
+{
+    // NOTE: a pool is tied to one memory type, the one a representative buffer of the class resolves to
+    VkBufferCreateInfo buffer_info {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .size = 64 * 1024,
+        .usage = usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+    };
+
+    VmaAllocationCreateInfo allocation_info {
+        .flags = allocation_flags(memory_class),
+        .usage = memory_usage,
+        .requiredFlags = 0,
+        .preferredFlags = 0,
+        .memoryTypeBits = 0,
+        .pool = VK_NULL_HANDLE,
+        .pUserData = nullptr,
+        .priority = 0,
+    };
+
+    u32 type_index = 0;
+    VkResult result = vmaFindMemoryTypeIndexForBufferInfo(state->context->vma, &buffer_info, &allocation_info, &type_index);
+    if (result != VK_SUCCESS) {
+        log::error("memory::create -> no memory type for the %s pool: %s", CLASS_NAMES[memory_class], string_VkResult(result));
+        return false;
+    }
+
+    return create_pool(memory_class, type_index);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool create_target_pool(void)
+{
+    VkImageCreateInfo image_info {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R16G16B16A16_SFLOAT,
+        .extent = { .width = 256, .height = 256, .depth = 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    VmaAllocationCreateInfo allocation_info {
+        .flags = 0,
+        .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        .requiredFlags = 0,
+        .preferredFlags = 0,
+        .memoryTypeBits = 0,
+        .pool = VK_NULL_HANDLE,
+        .pUserData = nullptr,
+        .priority = 0,
+    };
+
+    u32 type_index = 0;
+    VkResult result = vmaFindMemoryTypeIndexForImageInfo(state->context->vma, &image_info, &allocation_info, &type_index);
+    if (result != VK_SUCCESS) {
+        log::error("memory::create -> no memory type for the targets pool: %s", string_VkResult(result));
+        return false;
+    }
+
+    return create_pool(MEMORY_CLASS_TARGETS, type_index);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(context_t* context)
+{
+    if (state != nullptr) {
+        log::error("memory::create -> memory pools have been already created");
+        return false;
+    }
+
+    state = (state_t*)calloc(1, sizeof(state_t));
+    state->context = context;
+    state->moved = darray<moved_image_t> { true };
+
+    constexpr VkBufferUsageFlags device_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+        | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+        | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    bool created = create_buffer_pool(MEMORY_CLASS_STATIC, device_usage, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE)
+        && create_buffer_pool(MEMORY_CLASS_UPLOAD, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO)
+        && create_buffer_pool(MEMORY_CLASS_READBACK, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_AUTO)
+        && create_target_pool();
+
+    if (!created) {
+        destroy();
+        return false;
+    }
+
+    // NOTE: allocated before the virtual block exists, so it does not try to suballocate itself
+    buffer_create_info_t arena_info {
+        .size = MEMORY_ARENA_SIZE,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        .memory_usage = VMA_MEMORY_USAGE_AUTO,
+        .device_local = false,
+        .tag = MEMORY_TAG_ARENA,
+    };
+
+    if (!context::allocate_buffer(arena_info, &state->arena)) {
+        log::error("memory::create -> failed to allocate the small block arena");
+        destroy();
+        return false;
+    }
+
+    // NOTE: the blocks are long lived and mostly allocated at startup, the linear algorithm packs them back to back
+    VmaVirtualBlockCreateInfo block_info {
+        .size = MEMORY_ARENA_SIZE,
+        .flags = VMA_VIRTUAL_BLOCK_CREATE_LINEAR_ALGORITHM_BIT,
+        .pAllocationCallbacks = host_memory::callbacks(),
+    };
+
+    VkResult result = vmaCreateVirtualBlock(&block_info, &state->arena_block);
+    if (result != VK_SUCCESS) {
+        log::error("memory::create -> failed to create the small block arena: %s", string_VkResult(result));
+        destroy();
+        return false;
+    }
+
+    const VkPhysicalDeviceLimits& limits = context->device->properties.limits;
+    state->arena_alignment = std::max({ limits.minStorageBufferOffsetAlignment, limits.minUniformBufferOffsetAlignment, (VkDeviceSize)16 });
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(void)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    end_defragmentation();
+
+    if (state->arena_block != VK_NULL_HANDLE) {
+        // NOTE: anything still in the arena leaked with its owner, the block only asserts on it
+        vmaClearVirtualBlock(state->arena_block);
+        vmaDestroyVirtualBlock(state->arena_block);
+    }
+    context::destroy_buffer(&state->arena);
+
+    for (u32 i = 0; i < MEMORY_CLASS_COUNT; i++) {
+        if (state->pools[i] != VK_NULL_HANDLE) {
+            vmaDestroyPool(state->context->vma, state->pools[i]);
+        }
+    }
+
+    state->moved.~darray();
+    free(state);
+    state = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+memory_class_t classify(const buffer_create_info_t& info)
+{
+    if (info.device_local) {
+        return MEMORY_CLASS_STATIC;
+    }
+
+    // NOTE: host visible copy destinations are only ever read back by the CPU
+    if (info.usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) {
+        return MEMORY_CLASS_READBACK;
+    }
+
+    return MEMORY_CLASS_UPLOAD;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+memory_class_t classify(const image_create_info_t& info)
+{
+    if (info.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
+        return MEMORY_CLASS_TARGETS;
+    }
+
+    return MEMORY_CLASS_STATIC;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+VmaPool pool(memory_class_t memory_class)
+{
+    if (state == nullptr || (memory_class == MEMORY_CLASS_TARGETS && state->defrag != nullptr)) {
+        return VK_NULL_HANDLE;
+    }
+
+    return state->pools[memory_class];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool suballocate(const buffer_create_info_t& info, buffer_t* out)
+{
+    // NOTE: only blocks no command addresses through handle and offset, copies and binds need a buffer of their own
+    constexpr VkBufferUsageFlags shareable = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    if (state == nullptr || state->arena_block == VK_NULL_HANDLE || info.device_local
+        || info.size > MEMORY_SMALL_BLOCK_MAX || (info.usage & ~shareable) != 0) {
+        return false;
+    }
+
+    VmaVirtualAllocationCreateInfo allocation_info {
+        .size = info.size,
+        .alignment = state->arena_alignment,
+        .flags = 0,
+        .pUserData = nullptr,
+    };
+
+    VmaVirtualAllocation allocation = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    if (vmaVirtualAllocate(state->arena_block, &allocation_info, &allocation, &offset) != VK_SUCCESS) {
+        return false;
+    }
+
+    *out = {};
+    out->handle = state->arena.handle;
+    out->memory = nullptr;
+    out->allocation_info = state->arena.allocation_info;
+    out->allocation_info.offset += offset;
+    out->allocation_info.size = info.size;
+    out->allocation_info.pMappedData = (u8*)state->arena.allocation_info.pMappedData + offset;
+    out->size = info.size;
+    out->usage = info.usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    out->memory_usage = info.memory_usage;
+    out->address = state->arena.address + offset;
+    out->offset = offset;
+    out->suballocation = allocation;
+    out->bindless_index = BINDLESS_INVALID_INDEX;
+    out->tag = info.tag;
+
+    if (info.usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+        out->bindless_index = bindless::register_buffer(out->handle, offset, info.size);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void free_suballocation(buffer_t* buffer)
+{
+    vmaVirtualFree(state->arena_block, buffer->suballocation);
+    buffer->suballocation = VK_NULL_HANDLE;
+    buffer->offset = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void track(VmaAllocation allocation, memory_tag_t tag)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    VmaAllocationInfo info {};
+    vmaGetAllocationInfo(state->context->vma, allocation, &info);
+    vmaSetAllocationName(state->context->vma, allocation, TAG_NAMES[tag]);
+
+    state->tag_bytes[tag] += info.size;
+    state->tag_allocations[tag] += 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void untrack(VmaAllocation allocation, memory_tag_t tag)
+{
+    if (state == nullptr) {
+        return;
+    }
+
+    VmaAllocationInfo info {};
+    vmaGetAllocationInfo(state->context->vma, allocation, &info);
+
+    state->tag_bytes[tag] -= info.size;
+    state->tag_allocations[tag] -= 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+budget_t device_local_budget(void)
+{
+    budget_t total {};
+
+    const VkPhysicalDeviceMemoryProperties& memory = state->context->device->memory;
+    for (u32 i = 0; i < memory.memoryHeapCount; i++) {
+        if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            total.usage += state->budgets[i].usage;
+            total.budget += state->budgets[i].budget;
+        }
+    }
+
+    return total;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void refresh_budgets(void)
+{
+    // NOTE: cheap, VMA only queries the driver again every few allocations and counts its own in between
+    vmaGetHeapBudgets(state->context->vma, state->budgets);
+
+    budget_t device = device_local_budget();
+    profiler::record("device memory", "MB", (f64)device.usage / (1024.0 * 1024.0));
+
+    bool over_budget = device.usage > device.budget;
+    if (over_budget && !state->over_budget) {
+        log::warn("memory -> device local usage of %.0f MB exceeds the %.0f MB budget",
+            (f64)device.usage / (1024.0 * 1024.0), (f64)device.budget / (1024.0 * 1024.0));
+    }
+    state->over_budget = over_budget;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool dump_statistics(const char* path)
+{
+    char* json = nullptr;
+    vmaBuildStatsString(state->context->vma, &json, VK_TRUE);
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        log::error("memory::dump_statistics -> failed to open %s", path);
+        vmaFreeStatsString(state->context->vma, json);
+        return false;
+    }
+
+    file << json;
+    vmaFreeStatsString(state->context->vma, json);
+
+    log::info("memory -> statistics written to %s", path);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void set_movable(image_t* image)
+{
+    if (image->memory != nullptr) {
+        vmaSetAllocationUserData(state->context->vma, image->memory, image);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static f32 fragmentation(const VmaDetailedStatistics& stats)
+{
+    // NOTE: 0 when the free memory is one range, close to 1 when it is scattered in small ones
+    u64 unused = stats.statistics.blockBytes - stats.statistics.allocationBytes;
+    if (unused == 0 || stats.unusedRangeCount == 0) {
+        return 0.0f;
+    }
+
+    return 1.0f - (f32)((f64)stats.unusedRangeSizeMax / (f64)unused);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void begin_defragmentation(void)
+{
+    if (state->defrag != nullptr) {
+        return;
+    }
+
+    VmaDefragmentationInfo info {
+        .flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT,
+        .pool = state->pools[MEMORY_CLASS_TARGETS],
+        .maxBytesPerPass = MEMORY_DEFRAG_BYTES_PER_PASS,
+        .maxAllocationsPerPass = MEMORY_DEFRAG_MOVES_PER_PASS,
+        .pfnBreakCallback = nullptr,
+        .pBreakCallbackUserData = nullptr,
+    };
+
+    VkResult result = vmaBeginDefragmentation(state->context->vma, &info, &state->defrag);
+    if (result != VK_SUCCESS) {
+        log::error("memory::begin_defragmentation -> failed to begin defragmentation: %s", string_VkResult(result));
+        state->defrag = nullptr;
+        return;
+    }
+
+    state->pass_count = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void finish_defragmentation(void)
+{
+    vmaEndDefragmentation(state->context->vma, state->defrag, &state->last_stats);
+    state->defrag = nullptr;
+
+    log::info("memory -> defragmented the targets pool in %u passes, moved %u allocations, %.2f MB, freed %u blocks",
+        state->pass_count, state->last_stats.allocationsMoved, (f64)state->last_stats.bytesMoved / (1024.0 * 1024.0),
+        state->last_stats.deviceMemoryBlocksFreed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool move_image(image_t* image, VmaAllocation allocation)
+{
+    VkDevice device = state->context->device->logical_device;
+
+    VkImageCreateInfo image_info {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = image->format,
+        .extent = { .width = image->width, .height = image->height, .depth = 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = image->usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    VkImage handle = VK_NULL_HANDLE;
+    if (vkCreateImage(device, &image_info, host_memory::callbacks(), &handle) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkImageView view = VK_NULL_HANDLE;
+    if (vmaBindImageMemory(state->context->vma, allocation, handle) != VK_SUCCESS
+        || !context::create_image_view(handle, image->format, image->type, &view)) {
+        vkDestroyImage(device, handle, host_memory::callbacks());
+        return false;
+    }
+
+    // NOTE: the old handles stay valid for the frames in flight, the owner switches to the new ones right away.
+    // Attachments are redrawn from an undefined layout every frame, nothing needs copying
+    state->moved.push(moved_image_t {
+        .handle = image->handle,
+        .view = image->view,
+        .bindless_index = image->bindless_index,
+    });
+
+    image->handle = handle;
+    image->view = view;
+    if (image->bindless_index != BINDLESS_INVALID_INDEX) {
+        image->bindless_index = bindless::register_image(view, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void begin_pass(void)
+{
+    VkResult result = vmaBeginDefragmentationPass(state->context->vma, state->defrag, &state->pass);
+    if (result == VK_SUCCESS) {
+        finish_defragmentation(); // nothing left to move
+        return;
+    }
+
+    if (result != VK_INCOMPLETE) {
+        log::error("memory::update -> failed to begin a defragmentation pass: %s", string_VkResult(result));
+        finish_defragmentation();
+        return;
+    }
+
+    for (u32 i = 0; i < state->pass.moveCount; i++) {
+        VmaDefragmentationMove& move = state->pass.pMoves[i];
+
+        VmaAllocationInfo info {};
+        vmaGetAllocationInfo(state->context->vma, move.srcAllocation, &info);
+
+        image_t* image = (image_t*)info.pUserData;
+        if (image == nullptr || !move_image(image, move.dstTmpAllocation)) {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+        }
+    }
+
+    state->pass_open = true;
+    state->pass_frame = state->context->deletion->frame;
+    state->pass_count += 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void end_pass(void)
+{
+    VkDevice device = state->context->device->logical_device;
+
+    for (u32 i = 0; i < state->moved.len; i++) {
+        const moved_image_t& moved = state->moved[i];
+        bindless::release(BINDLESS_TYPE_SAMPLED_IMAGE, moved.bindless_index);
+        vkDestroyImageView(device, moved.view, host_memory::callbacks());
+        vkDestroyImage(device, moved.handle, host_memory::callbacks());
+    }
+    state->moved.len = 0;
+
+    state->pass_open = false;
+    if (vmaEndDefragmentationPass(state->context->vma, state->defrag, &state->pass) == VK_SUCCESS) {
+        finish_defragmentation();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void update(u64 completed_frame)
+{
+    refresh_budgets();
+
+    if (state->defrag == nullptr) {
+        if (!state->automatic || ++state->frames_since_check < MEMORY_DEFRAG_CHECK_FRAMES) {
+            return;
+        }
+        state->frames_since_check = 0;
+
+        VmaDetailedStatistics stats {};
+        vmaCalculatePoolStatistics(state->context->vma, state->pools[MEMORY_CLASS_TARGETS], &stats);
+        if (fragmentation(stats) > MEMORY_DEFRAG_THRESHOLD) {
+            begin_defragmentation();
+        }
+        return;
+    }
+
+    // NOTE: one pass in flight, the next one starts the frame after it ended
+    if (!state->pass_open) {
+        begin_pass();
+    } else if (completed_frame >= state->pass_frame) {
+        end_pass();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool defragmenting(void)
+{
+    return state != nullptr && state->defrag != nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void end_defragmentation(void)
+{
+    if (!defragmenting()) {
+        return;
+    }
+
+    if (state->pass_open) {
+        end_pass();
+    }
+
+    if (state->defrag != nullptr) {
+        finish_defragmentation();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void draw_gui(void)
+{
+    constexpr f64 mb = 1024.0 * 1024.0;
+
+    const VkPhysicalDeviceMemoryProperties& memory = state->context->device->memory;
+    if (!state->context->device->memory_budget) {
+        ImGui::TextDisabled("No VK_EXT_memory_budget, budgets are estimated from the heap sizes");
+    }
+
+    for (u32 i = 0; i < memory.memoryHeapCount; i++) {
+        const VmaBudget& budget = state->budgets[i];
+        bool device_local = memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+
+        char label[64];
+        snprintf(label, sizeof(label), "%.0f / %.0f MB", (f64)budget.usage / mb, (f64)budget.budget / mb);
+
+        ImGui::Text("Heap %u%s, %.0f MB: %u blocks, %u allocations, %.2f MB allocated", i, device_local ? " (device local)" : "",
+            (f64)memory.memoryHeaps[i].size / mb, budget.statistics.blockCount, budget.statistics.allocationCount,
+            (f64)budget.statistics.allocationBytes / mb);
+        ImGui::ProgressBar(budget.budget > 0 ? (f32)((f64)budget.usage / (f64)budget.budget) : 0.0f, ImVec2(-1.0f, 0.0f), label);
+    }
+
+    VmaTotalStatistics total {};
+    vmaCalculateStatistics(state->context->vma, &total);
+    ImGui::Text("Total: %u blocks, %u allocations, %.2f / %.2f MB, largest free range %.2f MB", total.total.statistics.blockCount,
+        total.total.statistics.allocationCount, (f64)total.total.statistics.allocationBytes / mb,
+        (f64)total.total.statistics.blockBytes / mb, (f64)total.total.unusedRangeSizeMax / mb);
+
+    ImGui::Separator();
+    for (u32 i = 0; i < MEMORY_TAG_COUNT; i++) {
+        if (state->tag_allocations[i] > 0) {
+            ImGui::Text("%s: %u allocations, %.2f MB", TAG_NAMES[i], state->tag_allocations[i], (f64)state->tag_bytes[i] / mb);
+        }
+    }
+
+    if (ImGui::Button("Dump statistics")) {
+        dump_statistics(MEMORY_STATS_PATH);
+    }
+
+    ImGui::Separator();
+    for (u32 i = 0; i < MEMORY_CLASS_COUNT; i++) {
+        VmaDetailedStatistics stats {};
+        vmaCalculatePoolStatistics(state->context->vma, state->pools[i], &stats);
+        ImGui::Text("%s: %u blocks, %u allocations, %.2f / %.2f MB, fragmentation %.0f%%", CLASS_NAMES[i],
+            stats.statistics.blockCount, stats.statistics.allocationCount, (f64)stats.statistics.allocationBytes / mb,
+            (f64)stats.statistics.blockBytes / mb, fragmentation(stats) * 100.0f);
+    }
+
+    VmaStatistics arena {};
+    vmaGetVirtualBlockStatistics(state->arena_block, &arena);
+    ImGui::Text("Small block arena: %u blocks, %.1f / %.1f KB", arena.allocationCount,
+        (f64)arena.allocationBytes / 1024.0, (f64)arena.blockBytes / 1024.0);
+
+    ImGui::Checkbox("Automatic defragmentation", &state->automatic);
+    if (state->defrag != nullptr) {
+        ImGui::Text("Defragmenting targets, pass %u", state->pass_count);
+    } else if (ImGui::Button("Defragment targets")) {
+        begin_defragmentation();
+    }
+
+    ImGui::Text("Last defragmentation: %u moves, %.2f MB, %u blocks freed", state->last_stats.allocationsMoved,
+        (f64)state->last_stats.bytesMoved / mb, state->last_stats.deviceMemoryBlocksFreed);
+}
+
+}
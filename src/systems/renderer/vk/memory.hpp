@@ -0,0 +1,72 @@
+#pragma once
+
+#include "types.hpp"
+
+namespace rin::renderer::vulkan::memory {
+
+constexpr u64 MEMORY_SMALL_BLOCK_MAX = 4 * 1024; // host written storage and uniform buffers up to this share the arena
+constexpr u64 MEMORY_ARENA_SIZE = 4 * 1024 * 1024;
+constexpr u64 MEMORY_DEFRAG_BYTES_PER_PASS = 64 * 1024 * 1024;
+constexpr u32 MEMORY_DEFRAG_MOVES_PER_PASS = 8;
+constexpr f32 MEMORY_DEFRAG_THRESHOLD = 0.5f; // fragmentation the automatic mode starts a defragmentation at
+constexpr const char* MEMORY_STATS_PATH = "memory_stats.json";
+
+struct budget_t {
+    u64 usage; // bytes in use by the process, VMA blocks and everything else it allocated
+    u64 budget; // bytes the process can use before allocations fail or the OS starts evicting
+};
+
+enum memory_class_t {
+    MEMORY_CLASS_STATIC, // device local buffers, geometry and GPU written data
+    MEMORY_CLASS_UPLOAD, // host written every frame or once, sequential writes only
+    MEMORY_CLASS_READBACK, // host read copies of GPU results, cached for random access
+    MEMORY_CLASS_TARGETS, // attachments, the only images defragmentation moves
+    MEMORY_CLASS_COUNT,
+};
+
+// One VMA pool per class, created with the allocator. Allocations a pool cannot take, a memory type it was not
+// created for or a size above its blocks, fall back to the default pools.
+bool create(context_t* context);
+void destroy(void);
+
+memory_class_t classify(const buffer_create_info_t& info);
+memory_class_t classify(const image_create_info_t& info);
+VmaAllocationCreateFlags allocation_flags(memory_class_t memory_class);
+
+// Accounts an allocation to its subsystem and names it after it in the VMA statistics.
+void track(VmaAllocation allocation, memory_tag_t tag);
+void untrack(VmaAllocation allocation, memory_tag_t tag);
+
+// Sum over the device local heaps, refreshed by update() every frame. With VK_EXT_memory_budget it includes other
+// processes and the driver, it is the signal streaming and eviction decisions read rather than their own counts.
+budget_t device_local_budget(void);
+
+// Writes vmaBuildStatsString() with the detailed map, every block and named allocation, as JSON.
+bool dump_statistics(const char* path);
+
+// VK_NULL_HANDLE while defragmenting targets, allocations stay out of a pool being compacted.
+VmaPool pool(memory_class_t memory_class);
+
+// Small host written blocks share one mapped buffer through a linear VMA virtual block instead of an allocation
+// each. The buffer_t keeps the arena handle with its offset, so it must only be used through address, mapped
+// pointer or bindless index. Returns false when the block does not qualify or the arena is full.
+bool suballocate(const buffer_create_info_t& info, buffer_t* out);
+void free_suballocation(buffer_t* buffer);
+
+// Lets defragmentation move the image, only for attachments whose content is redrawn every frame: moves recreate
+// the image and view in place in *image and do not copy. The pointer must stay valid until the image is retired.
+void set_movable(image_t* image);
+
+// Defragmentation runs incrementally over the targets pool, one pass in flight at a time. A pass is ended once the
+// frames that used the old images have completed, update() is called every frame before context::collect() and
+// refreshes the heap budgets.
+void begin_defragmentation(void);
+void update(u64 completed_frame);
+bool defragmenting(void);
+
+// Ends an ongoing defragmentation, the device must be idle.
+void end_defragmentation(void);
+
+void draw_gui(void);
+
+}
@@ -1,6 +1,8 @@
 #include "pipeline.hpp"
 
+#include "core/hash.hpp"
 #include "core/logger.hpp"
+#include "host_memory.hpp"
 
 #include <vulkan/vk_enum_string_helper.h>
 
@@ -17,11 +19,30 @@ pipeline_builder_t& pipeline_builder_t::disable_blending(void)
     return *this;
 }
 
+pipeline_builder_t& pipeline_builder_t::enable_blending_alpha(void)
+{
+    // NOTE: premultiplied alpha, out = src + dst * (1 - src.a)
+    m_blending_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+        | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    m_blending_attachment.blendEnable = VK_TRUE;
+    m_blending_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    m_blending_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    m_blending_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+    m_blending_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    m_blending_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    m_blending_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    return *this;
+}
+
 pipeline_builder_t& pipeline_builder_t::set_shaders(VkShaderModule vertex, VkShaderModule fragment)
 {
-    m_shader_stages.clear();
+    // NOTE: constants set for the previous shaders don't apply to the new ones
+    for (u32 i = 0; i < PIPELINE_MAX_SHADER_STAGES; i++) {
+        m_specialization[i] = {};
+    }
 
-    m_shader_stages.push(VkPipelineShaderStageCreateInfo {
+    m_shader_stages[0] = VkPipelineShaderStageCreateInfo {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
@@ -29,17 +50,87 @@ pipeline_builder_t& pipeline_builder_t::set_shaders(VkShaderModule vertex, VkSha
         .module = vertex,
         .pName = "main",
         .pSpecializationInfo = nullptr,
-    });
+    };
+    m_shader_stage_count = 1;
+
+    if (fragment != VK_NULL_HANDLE) {
+        m_shader_stages[m_shader_stage_count++] = VkPipelineShaderStageCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragment,
+            .pName = "main",
+            .pSpecializationInfo = nullptr,
+        };
+    }
 
-    m_shader_stages.push(VkPipelineShaderStageCreateInfo {
+    return *this;
+}
+
+pipeline_builder_t& pipeline_builder_t::set_compute_shader(VkShaderModule compute)
+{
+    // NOTE: constants set for the previous shaders don't apply to the new ones
+    for (u32 i = 0; i < PIPELINE_MAX_SHADER_STAGES; i++) {
+        m_specialization[i] = {};
+    }
+
+    m_shader_stages[0] = VkPipelineShaderStageCreateInfo {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
-        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-        .module = fragment,
+        .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+        .module = compute,
         .pName = "main",
         .pSpecializationInfo = nullptr,
-    });
+    };
+
+    m_shader_stage_count = 1;
+    return *this;
+}
+
+pipeline_builder_t& pipeline_builder_t::set_mesh_shaders(VkShaderModule task, VkShaderModule mesh, VkShaderModule fragment)
+{
+    // NOTE: constants set for the previous shaders don't apply to the new ones
+    for (u32 i = 0; i < PIPELINE_MAX_SHADER_STAGES; i++) {
+        m_specialization[i] = {};
+    }
+
+    m_shader_stage_count = 0;
+
+    if (task != VK_NULL_HANDLE) {
+        m_shader_stages[m_shader_stage_count++] = VkPipelineShaderStageCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_TASK_BIT_EXT,
+            .module = task,
+            .pName = "main",
+            .pSpecializationInfo = nullptr,
+        };
+    }
+
+    m_shader_stages[m_shader_stage_count++] = VkPipelineShaderStageCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .stage = VK_SHADER_STAGE_MESH_BIT_EXT,
+        .module = mesh,
+        .pName = "main",
+        .pSpecializationInfo = nullptr,
+    };
+
+    if (fragment != VK_NULL_HANDLE) {
+        m_shader_stages[m_shader_stage_count++] = VkPipelineShaderStageCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragment,
+            .pName = "main",
+            .pSpecializationInfo = nullptr,
+        };
+    }
 
     return *this;
 }
@@ -83,8 +174,7 @@ pipeline_builder_t& pipeline_builder_t::set_multisampling_none(void)
 pipeline_builder_t& pipeline_builder_t::set_color_attachment_format(VkFormat format)
 {
     m_color_attachment_format = format;
-    m_rendering.colorAttachmentCount = 1;
-    m_rendering.pColorAttachmentFormats = &m_color_attachment_format;
+    m_rendering.colorAttachmentCount = format != VK_FORMAT_UNDEFINED ? 1 : 0;
 
     return *this;
 }
@@ -117,17 +207,85 @@ pipeline_builder_t& pipeline_builder_t::disable_depthtest(void)
     return *this;
 }
 
+pipeline_builder_t& pipeline_builder_t::enable_depthtest(bool depth_write, VkCompareOp op)
+{
+    m_depth_stencil.depthTestEnable = VK_TRUE;
+    m_depth_stencil.depthWriteEnable = depth_write;
+    m_depth_stencil.depthCompareOp = op;
+    m_depth_stencil.depthBoundsTestEnable = VK_FALSE;
+    m_depth_stencil.stencilTestEnable = VK_FALSE;
+    m_depth_stencil.front = {};
+    m_depth_stencil.back = {};
+    m_depth_stencil.minDepthBounds = 0.0f;
+    m_depth_stencil.maxDepthBounds = 1.0f;
+
+    return *this;
+}
+
 pipeline_builder_t& pipeline_builder_t::set_vertex_state(
-    u32 bindings_count, VkVertexInputBindingDescription* bindings,
-    u32 attributes_count, VkVertexInputAttributeDescription* attributes)
+    u32 bindings_count, const VkVertexInputBindingDescription* bindings,
+    u32 attributes_count, const VkVertexInputAttributeDescription* attributes)
 {
+    if (bindings_count > PIPELINE_MAX_VERTEX_BINDINGS || attributes_count > PIPELINE_MAX_VERTEX_ATTRIBUTES) {
+        log::error("pipeline_builder_t::set_vertex_state -> too many bindings (%u) or attributes (%u)", bindings_count, attributes_count);
+        return *this;
+    }
+
+    for (u32 i = 0; i < bindings_count; i++) {
+        m_vertex_bindings[i] = bindings[i];
+    }
+
+    for (u32 i = 0; i < attributes_count; i++) {
+        m_vertex_attributes[i] = attributes[i];
+    }
+
     m_vertex_state.vertexBindingDescriptionCount = bindings_count;
-    m_vertex_state.pVertexBindingDescriptions = bindings;
     m_vertex_state.vertexAttributeDescriptionCount = attributes_count;
-    m_vertex_state.pVertexAttributeDescriptions = attributes;
     return *this;
 }
 
+pipeline_builder_t& pipeline_builder_t::set_specialization_constant(VkShaderStageFlags stages, u32 constant_id, u32 value)
+{
+    for (u32 i = 0; i < m_shader_stage_count; i++) {
+        if (!(stages & m_shader_stages[i].stage)) {
+            continue;
+        }
+
+        specialization_t* spec = &m_specialization[i];
+
+        u32 index = 0;
+        while (index < spec->count && spec->entries[index].constantID != constant_id) {
+            index++;
+        }
+
+        if (index == PIPELINE_MAX_SPECIALIZATION_CONSTANTS) {
+            log::error("pipeline_builder_t::set_specialization_constant -> too many constants for stage %u", i);
+            continue;
+        }
+
+        if (index == spec->count) {
+            spec->entries[index] = VkSpecializationMapEntry {
+                .constantID = constant_id,
+                .offset = index * (u32)sizeof(u32),
+                .size = sizeof(u32),
+            };
+            spec->count += 1;
+        }
+
+        spec->data[index] = value;
+    }
+
+    return *this;
+}
+
+pipeline_builder_t& pipeline_builder_t::set_features(u32 features)
+{
+    return set_specialization_constant(
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT
+            | VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
+        PIPELINE_FEATURES_CONSTANT_ID, features);
+}
+
 void pipeline_builder_t::clear(void)
 {
     m_input_assembly = VkPipelineInputAssemblyStateCreateInfo {
@@ -232,12 +390,136 @@ void pipeline_builder_t::clear(void)
 
     m_viewport = {};
     m_scissor = VkRect2D {};
+    m_color_attachment_format = VK_FORMAT_UNDEFINED;
+
+    for (u32 i = 0; i < PIPELINE_MAX_SHADER_STAGES; i++) {
+        m_shader_stages[i] = {};
+        m_specialization[i] = {};
+    }
+    m_shader_stage_count = 0;
+
+    for (u32 i = 0; i < PIPELINE_MAX_VERTEX_BINDINGS; i++) {
+        m_vertex_bindings[i] = {};
+    }
+
+    for (u32 i = 0; i < PIPELINE_MAX_VERTEX_ATTRIBUTES; i++) {
+        m_vertex_attributes[i] = {};
+    }
+}
 
-    m_shader_stages.clear();
+u64 pipeline_builder_t::hash(void) const
+{
+    // NOTE: fields are hashed one by one, the create infos carry sType/pNext padding that would make
+    // the key depend on garbage bytes and on where the builder lives in memory
+    u64 key = hash::FNV_OFFSET_BASIS;
+
+    key = hash::combine(key, m_shader_stage_count);
+    for (u32 i = 0; i < m_shader_stage_count; i++) {
+        key = hash::combine(key, m_shader_stages[i].stage);
+        key = hash::combine(key, m_shader_stages[i].module);
+
+        const specialization_t& spec = m_specialization[i];
+        key = hash::combine(key, spec.count);
+        key = hash::fnv1a(spec.entries, sizeof(VkSpecializationMapEntry) * spec.count, key);
+        key = hash::fnv1a(spec.data, sizeof(u32) * spec.count, key);
+    }
+
+    key = hash::combine(key, m_vertex_state.vertexBindingDescriptionCount);
+    key = hash::fnv1a(m_vertex_bindings, sizeof(VkVertexInputBindingDescription) * m_vertex_state.vertexBindingDescriptionCount, key);
+    key = hash::combine(key, m_vertex_state.vertexAttributeDescriptionCount);
+    key = hash::fnv1a(m_vertex_attributes, sizeof(VkVertexInputAttributeDescription) * m_vertex_state.vertexAttributeDescriptionCount, key);
+
+    key = hash::combine(key, m_input_assembly.topology);
+    key = hash::combine(key, m_input_assembly.primitiveRestartEnable);
+
+    key = hash::combine(key, m_rasterizer.depthClampEnable);
+    key = hash::combine(key, m_rasterizer.rasterizerDiscardEnable);
+    key = hash::combine(key, m_rasterizer.polygonMode);
+    key = hash::combine(key, m_rasterizer.cullMode);
+    key = hash::combine(key, m_rasterizer.frontFace);
+    key = hash::combine(key, m_rasterizer.depthBiasEnable);
+    key = hash::combine(key, m_rasterizer.depthBiasConstantFactor);
+    key = hash::combine(key, m_rasterizer.depthBiasClamp);
+    key = hash::combine(key, m_rasterizer.depthBiasSlopeFactor);
+    key = hash::combine(key, m_rasterizer.lineWidth);
+
+    key = hash::combine(key, m_multisampling.rasterizationSamples);
+    key = hash::combine(key, m_multisampling.sampleShadingEnable);
+    key = hash::combine(key, m_multisampling.minSampleShading);
+    key = hash::combine(key, m_multisampling.alphaToCoverageEnable);
+    key = hash::combine(key, m_multisampling.alphaToOneEnable);
+
+    key = hash::combine(key, m_blending_attachment);
+
+    key = hash::combine(key, m_depth_stencil.depthTestEnable);
+    key = hash::combine(key, m_depth_stencil.depthWriteEnable);
+    key = hash::combine(key, m_depth_stencil.depthCompareOp);
+    key = hash::combine(key, m_depth_stencil.depthBoundsTestEnable);
+    key = hash::combine(key, m_depth_stencil.stencilTestEnable);
+    key = hash::combine(key, m_depth_stencil.front);
+    key = hash::combine(key, m_depth_stencil.back);
+    key = hash::combine(key, m_depth_stencil.minDepthBounds);
+    key = hash::combine(key, m_depth_stencil.maxDepthBounds);
+
+    key = hash::combine(key, m_rendering.viewMask);
+    key = hash::combine(key, m_rendering.colorAttachmentCount);
+    key = hash::combine(key, m_color_attachment_format);
+    key = hash::combine(key, m_rendering.depthAttachmentFormat);
+    key = hash::combine(key, m_rendering.stencilAttachmentFormat);
+
+    key = hash::combine(key, m_layout);
+    return key;
 }
 
-bool pipeline_builder_t::build(VkDevice device, VkPipeline* out)
+bool pipeline_builder_t::build(VkDevice device, VkPipelineCache cache, VkPipeline* out)
 {
+    VkPipelineRenderingCreateInfo rendering = m_rendering;
+    rendering.pColorAttachmentFormats = m_rendering.colorAttachmentCount > 0 ? &m_color_attachment_format : nullptr;
+
+    VkPipelineShaderStageCreateInfo stages[PIPELINE_MAX_SHADER_STAGES];
+    VkSpecializationInfo specialization[PIPELINE_MAX_SHADER_STAGES];
+    for (u32 i = 0; i < m_shader_stage_count; i++) {
+        stages[i] = m_shader_stages[i];
+
+        if (m_specialization[i].count > 0) {
+            specialization[i] = VkSpecializationInfo {
+                .mapEntryCount = m_specialization[i].count,
+                .pMapEntries = m_specialization[i].entries,
+                .dataSize = m_specialization[i].count * sizeof(u32),
+                .pData = m_specialization[i].data,
+            };
+            stages[i].pSpecializationInfo = &specialization[i];
+        }
+    }
+
+    if (m_shader_stage_count == 1 && stages[0].stage == VK_SHADER_STAGE_COMPUTE_BIT) {
+        VkComputePipelineCreateInfo compute_info {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = stages[0],
+            .layout = m_layout,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex = 0,
+        };
+
+        VkResult result = vkCreateComputePipelines(device, cache, 1, &compute_info, host_memory::callbacks(), out);
+        if (result != VK_SUCCESS) {
+            log::error("failed to create compute pipeline: %s", string_VkResult(result));
+            clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertex_state = m_vertex_state;
+    vertex_state.pVertexBindingDescriptions = m_vertex_bindings;
+    vertex_state.pVertexAttributeDescriptions = m_vertex_attributes;
+
+    // NOTE: mesh pipelines have no vertex input stage, both states must be left out
+    bool mesh_pipeline = stages[0].stage == VK_SHADER_STAGE_TASK_BIT_EXT || stages[0].stage == VK_SHADER_STAGE_MESH_BIT_EXT;
+
     VkPipelineViewportStateCreateInfo viewport_state {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .pNext = nullptr,
@@ -254,7 +536,7 @@ bool pipeline_builder_t::build(VkDevice device, VkPipeline* out)
         .flags = 0,
         .logicOpEnable = 0,
         .logicOp = VK_LOGIC_OP_COPY,
-        .attachmentCount = 1,
+        .attachmentCount = m_rendering.colorAttachmentCount,
         .pAttachments = &m_blending_attachment,
         .blendConstants = { 0, 0, 0, 0 },
     };
@@ -274,12 +556,12 @@ bool pipeline_builder_t::build(VkDevice device, VkPipeline* out)
 
     VkGraphicsPipelineCreateInfo pipeline_info {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .pNext = &m_rendering,
+        .pNext = &rendering,
         .flags = 0,
-        .stageCount = (u32)m_shader_stages.len,
-        .pStages = m_shader_stages.data,
-        .pVertexInputState = &m_vertex_state,
-        .pInputAssemblyState = &m_input_assembly,
+        .stageCount = m_shader_stage_count,
+        .pStages = stages,
+        .pVertexInputState = mesh_pipeline ? nullptr : &vertex_state,
+        .pInputAssemblyState = mesh_pipeline ? nullptr : &m_input_assembly,
         .pTessellationState = nullptr,
         .pViewportState = &viewport_state,
         .pRasterizationState = &m_rasterizer,
@@ -294,7 +576,7 @@ bool pipeline_builder_t::build(VkDevice device, VkPipeline* out)
         .basePipelineIndex = 0,
     };
 
-    VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, out);
+    VkResult result = vkCreateGraphicsPipelines(device, cache, 1, &pipeline_info, host_memory::callbacks(), out);
     if (result != VK_SUCCESS) {
         log::error("failed to create pipeline: %s", string_VkResult(result));
         clear();
@@ -1,33 +1,64 @@
 #pragma once
 
-#include "core/containers/darray.hpp"
+#include "core/defines.hpp"
 
 #include <volk.h>
 
 namespace rin::renderer::vulkan {
 
+constexpr u32 PIPELINE_MAX_SHADER_STAGES = 3; // task, mesh and fragment
+constexpr u32 PIPELINE_MAX_VERTEX_BINDINGS = 4;
+constexpr u32 PIPELINE_MAX_VERTEX_ATTRIBUTES = 16;
+constexpr u32 PIPELINE_MAX_SPECIALIZATION_CONSTANTS = 16;
+
+// Shaders read their variant feature mask from this constant:
+//     layout (constant_id = 0) const uint FEATURES = 0;
+constexpr u32 PIPELINE_FEATURES_CONSTANT_ID = 0;
+
+struct specialization_t {
+    VkSpecializationMapEntry entries[PIPELINE_MAX_SPECIALIZATION_CONSTANTS];
+    u32 data[PIPELINE_MAX_SPECIALIZATION_CONSTANTS];
+    u32 count;
+};
+
+// NOTE: the builder owns every array it points to, so it can be copied around and hashed safely,
+// pointers between the create infos are only wired up inside build()
 class pipeline_builder_t {
 public:
     pipeline_builder_t(void) { clear(); }
-    bool build(VkDevice device, VkPipeline* out);
+    bool build(VkDevice device, VkPipelineCache cache, VkPipeline* out);
     void clear(void);
+    u64 hash(void) const;
 
     pipeline_builder_t& disable_blending(void);
+    pipeline_builder_t& enable_blending_alpha(void);
+    // NOTE: fragment may be VK_NULL_HANDLE for depth only pipelines, with no color attachment format
     pipeline_builder_t& set_shaders(VkShaderModule vertex, VkShaderModule fragment);
+    pipeline_builder_t& set_compute_shader(VkShaderModule compute); // every other state is ignored by build()
+    // NOTE: task and fragment are optional, vertex input and topology are ignored, the device must have VK_EXT_mesh_shader
+    pipeline_builder_t& set_mesh_shaders(VkShaderModule task, VkShaderModule mesh, VkShaderModule fragment);
     pipeline_builder_t& set_layout(VkPipelineLayout layout);
     pipeline_builder_t& set_input_topology(VkPrimitiveTopology topology);
     pipeline_builder_t& set_polygon_mode(VkPolygonMode mode);
     pipeline_builder_t& set_cull_mode(VkCullModeFlags mode, VkFrontFace face);
     pipeline_builder_t& set_multisampling_none(void);
-    pipeline_builder_t& set_color_attachment_format(VkFormat format);
+    pipeline_builder_t& set_color_attachment_format(VkFormat format); // VK_FORMAT_UNDEFINED for no color attachment
     pipeline_builder_t& set_depth_format(VkFormat format);
     pipeline_builder_t& disable_depthtest(void);
+    pipeline_builder_t& enable_depthtest(bool depth_write, VkCompareOp op);
     pipeline_builder_t& set_vertex_state(
-        u32 bindings_count, VkVertexInputBindingDescription* bindings,
-        u32 attributes_count, VkVertexInputAttributeDescription* attributes);
+        u32 bindings_count, const VkVertexInputBindingDescription* bindings,
+        u32 attributes_count, const VkVertexInputAttributeDescription* attributes);
+    // NOTE: applies to the stages set so far, call it after set_shaders()/set_compute_shader()
+    pipeline_builder_t& set_specialization_constant(VkShaderStageFlags stages, u32 constant_id, u32 value);
+    pipeline_builder_t& set_features(u32 features);
 
 private:
-    darray<VkPipelineShaderStageCreateInfo> m_shader_stages { true };
+    VkPipelineShaderStageCreateInfo m_shader_stages[PIPELINE_MAX_SHADER_STAGES];
+    u32 m_shader_stage_count;
+    specialization_t m_specialization[PIPELINE_MAX_SHADER_STAGES]; // indexed like m_shader_stages
+    VkVertexInputBindingDescription m_vertex_bindings[PIPELINE_MAX_VERTEX_BINDINGS];
+    VkVertexInputAttributeDescription m_vertex_attributes[PIPELINE_MAX_VERTEX_ATTRIBUTES];
     VkPipelineInputAssemblyStateCreateInfo m_input_assembly;
     VkPipelineColorBlendAttachmentState m_blending_attachment;
     VkPipelineDepthStencilStateCreateInfo m_depth_stencil;
@@ -0,0 +1,466 @@
+#include "pipeline_table.hpp"
+
+#include "bindless.hpp"
+#include "core/allocations.hpp"
+#include "core/clock.hpp"
+#include "core/hash.hpp"
+#include "core/jobs.hpp"
+#include "core/logger.hpp"
+#include "core/profiler.hpp"
+#include "host_memory.hpp"
+
+#include <vulkan/vk_enum_string_helper.h>
+
+namespace rin::renderer::vulkan {
+
+struct pipeline_job_t {
+    pipeline_builder_t builder; // private copy, the requester's builder may be gone by the time the job runs
+    VkDevice device;
+    VkPipelineCache cache;
+    jobs::counter_t counter;
+    VkPipeline handle;
+    bool success;
+    f64 queued_at;
+    f64 started_at;
+    f64 finished_at;
+};
+
+}
+
+namespace rin::renderer::vulkan::pipeline_table {
+
+static pipeline_table_t* table = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool create(context_t* context)
+{
+    if (table != nullptr) {
+        log::error("vulkan::pipeline_table::create -> a pipeline table already exists");
+        return false;
+    }
+
+    table = (pipeline_table_t*)calloc(1, sizeof(pipeline_table_t));
+    table->context = context;
+    table->pipelines = hashmap<pipeline_entry_t> { 64 };
+    table->pending = darray<u64> { true };
+    table->set_layouts = hashmap<VkDescriptorSetLayout> { 16 };
+    table->layouts = hashmap<VkPipelineLayout> { 16 };
+
+    VkPipelineCacheCreateInfo cache_info {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .initialDataSize = 0,
+        .pInitialData = nullptr,
+    };
+
+    VkResult result = vkCreatePipelineCache(context->device->logical_device, &cache_info, host_memory::callbacks(), &table->cache);
+    if (result != VK_SUCCESS) {
+        log::error("vulkan::pipeline_table::create -> failed to create pipeline cache: %s", string_VkResult(result));
+        destroy();
+        return false;
+    }
+
+    context->pipelines = table;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void compile(void* data)
+{
+    pipeline_job_t* job = (pipeline_job_t*)data;
+    job->started_at = clock::get_time_s();
+    job->success = job->builder.build(job->device, job->cache, &job->handle);
+    job->finished_at = clock::get_time_s();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Moves the result of a finished job into its entry, the job must be done.
+static void finalize(u64 key, pipeline_entry_t* entry)
+{
+    pipeline_job_t* job = entry->job;
+
+    if (job->success) {
+        entry->handle = job->handle;
+        log::debug("pipeline table: compiled pipeline %llx in %.3f ms", key, (job->finished_at - job->started_at) * ms_per_s);
+    } else {
+        entry->failed = true;
+        log::error("vulkan::pipeline_table -> failed to compile pipeline %llx", key);
+    }
+
+    profiler::record("pipeline compile", "ms", (job->finished_at - job->started_at) * ms_per_s);
+    profiler::record("pipeline latency", "ms", (job->finished_at - job->queued_at) * ms_per_s);
+
+    free(job);
+    entry->job = nullptr;
+
+    for (size_t i = 0; i < table->pending.len; i++) {
+        if (table->pending[i] == key) {
+            table->pending[i] = table->pending[table->pending.len - 1];
+            table->pending.len -= 1;
+            break;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void drain(void)
+{
+    if (table == nullptr) {
+        return;
+    }
+
+    while (table->pending.len > 0) {
+        u64 key = table->pending[table->pending.len - 1];
+        pipeline_entry_t* entry = table->pipelines.find(key);
+        jobs::wait(&entry->job->counter);
+        finalize(key, entry);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy(void)
+{
+    if (table == nullptr) {
+        return;
+    }
+
+    VkDevice device = table->context->device->logical_device;
+
+    // NOTE: workers still hold builder copies and write into the jobs, drain them first
+    drain();
+
+    for (size_t i = 0; i < table->pipelines.capacity; i++) {
+        if (table->pipelines.keys[i] != 0 && table->pipelines.values[i].handle != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, table->pipelines.values[i].handle, host_memory::callbacks());
+        }
+    }
+    table->pipelines.~hashmap();
+    table->pending.~darray();
+
+    for (size_t i = 0; i < table->layouts.capacity; i++) {
+        if (table->layouts.keys[i] != 0) {
+            vkDestroyPipelineLayout(device, table->layouts.values[i], host_memory::callbacks());
+        }
+    }
+    table->layouts.~hashmap();
+
+    for (size_t i = 0; i < table->set_layouts.capacity; i++) {
+        if (table->set_layouts.keys[i] != 0) {
+            vkDestroyDescriptorSetLayout(device, table->set_layouts.values[i], host_memory::callbacks());
+        }
+    }
+    table->set_layouts.~hashmap();
+
+    if (table->cache != VK_NULL_HANDLE) {
+        vkDestroyPipelineCache(device, table->cache, host_memory::callbacks());
+    }
+
+    table->context->pipelines = nullptr;
+    free(table);
+    table = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool get(pipeline_builder_t& builder, VkPipeline* out)
+{
+    u64 key = builder.hash();
+
+    pipeline_entry_t* cached = table->pipelines.find(key);
+    if (cached != nullptr) {
+        if (cached->job != nullptr) {
+            jobs::wait(&cached->job->counter);
+            finalize(key, cached);
+        }
+
+        if (cached->failed) {
+            return false;
+        }
+
+        *out = cached->handle;
+        return true;
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (!builder.build(table->context->device->logical_device, table->cache, &pipeline)) {
+        log::error("vulkan::pipeline_table::get -> failed to build pipeline %llx", key);
+        return false;
+    }
+
+    table->pipelines.insert(key, pipeline_entry_t { pipeline, nullptr, false });
+    log::debug("pipeline table: built pipeline %llx (%u cached)", key, count());
+
+    *out = pipeline;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u64 request(const pipeline_builder_t& builder)
+{
+    u64 key = builder.hash();
+    if (table->pipelines.find(key) != nullptr) {
+        return key;
+    }
+
+    RIN_ALLOW_ALLOC("pipeline_table::request of a new pipeline");
+
+    pipeline_job_t* job = (pipeline_job_t*)calloc(1, sizeof(pipeline_job_t));
+    job->builder = builder;
+    job->device = table->context->device->logical_device;
+    job->cache = table->cache;
+    job->queued_at = clock::get_time_s();
+
+    table->pipelines.insert(key, pipeline_entry_t { VK_NULL_HANDLE, job, false });
+    table->pending.push(key);
+    // NOTE: off the main queue so a parallel_for on the main thread never ends up compiling
+    jobs::submit_background(compile, job, &job->counter);
+
+    return key;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+pipeline_status_t resolve(u64 key, VkPipeline* out)
+{
+    pipeline_entry_t* entry = table->pipelines.find(key);
+    if (entry == nullptr) {
+        return PIPELINE_STATUS_FAILED;
+    }
+
+    if (entry->job != nullptr) {
+        if (!jobs::is_done(&entry->job->counter)) {
+            return PIPELINE_STATUS_PENDING;
+        }
+        finalize(key, entry);
+    }
+
+    if (entry->failed) {
+        return PIPELINE_STATUS_FAILED;
+    }
+
+    *out = entry->handle;
+    return PIPELINE_STATUS_READY;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool get_set_layout(const VkDescriptorSetLayoutBinding* bindings, u32 binding_count, VkDescriptorSetLayout* out)
+{
+    u64 key = hash::combine(hash::FNV_OFFSET_BASIS, binding_count);
+    for (u32 i = 0; i < binding_count; i++) {
+        key = hash::combine(key, bindings[i].binding);
+        key = hash::combine(key, bindings[i].descriptorType);
+        key = hash::combine(key, bindings[i].descriptorCount);
+        key = hash::combine(key, bindings[i].stageFlags);
+    }
+
+    VkDescriptorSetLayout* cached = table->set_layouts.find(key);
+    if (cached != nullptr) {
+        *out = *cached;
+        return true;
+    }
+
+    VkDescriptorSetLayoutCreateInfo info {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .bindingCount = binding_count,
+        .pBindings = bindings,
+    };
+
+    VkResult result = vkCreateDescriptorSetLayout(table->context->device->logical_device, &info, host_memory::callbacks(), out);
+    if (result != VK_SUCCESS) {
+        log::error("vulkan::pipeline_table::get_layout -> failed to create descriptor set layout: %s", string_VkResult(result));
+        return false;
+    }
+
+    table->set_layouts.insert(key, *out);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool get_layout(const reflection::shader_reflection_t* const* stages, u32 stage_count, VkPipelineLayout* out)
+{
+    using namespace reflection;
+
+    VkDescriptorSetLayoutBinding bindings[REFLECTION_MAX_SETS][REFLECTION_MAX_BINDINGS];
+    u32 binding_counts[REFLECTION_MAX_SETS] = {};
+    u32 set_count = bindless::BINDLESS_SET + 1;
+
+    for (u32 i = 0; i < stage_count; i++) {
+        const shader_reflection_t* stage = stages[i];
+
+        for (u32 j = 0; j < stage->binding_count; j++) {
+            const binding_t& reflected = stage->bindings[j];
+
+            if (reflected.set >= REFLECTION_MAX_SETS) {
+                log::error("vulkan::pipeline_table::get_layout -> set %u is out of range", reflected.set);
+                return false;
+            }
+
+            // NOTE: the bindless set is shared by every layout, shaders only have to agree with it
+            if (reflected.set == bindless::BINDLESS_SET) {
+                if (reflected.binding >= BINDLESS_TYPE_COUNT
+                    || reflected.type != bindless::descriptor_type((bindless_type_t)reflected.binding)) {
+                    log::error("vulkan::pipeline_table::get_layout -> set %u binding %u does not match the bindless heap", reflected.set, reflected.binding);
+                    return false;
+                }
+                continue;
+            }
+
+            if (reflected.count == 0) {
+                log::error("vulkan::pipeline_table::get_layout -> set %u binding %u is runtime sized outside the bindless set", reflected.set, reflected.binding);
+                return false;
+            }
+
+            VkDescriptorSetLayoutBinding* set = bindings[reflected.set];
+            u32& count = binding_counts[reflected.set];
+
+            u32 k = 0;
+            while (k < count && set[k].binding != reflected.binding) {
+                k++;
+            }
+
+            if (k < count) {
+                if (set[k].descriptorType != reflected.type) {
+                    log::error("vulkan::pipeline_table::get_layout -> stages disagree on set %u binding %u", reflected.set, reflected.binding);
+                    return false;
+                }
+                set[k].stageFlags |= reflected.stages;
+                set[k].descriptorCount = reflected.count > set[k].descriptorCount ? reflected.count : set[k].descriptorCount;
+                continue;
+            }
+
+            // NOTE: keep bindings sorted so the same set hashes the same whatever the stage order
+            while (k > 0 && set[k - 1].binding > reflected.binding) {
+                set[k] = set[k - 1];
+                k--;
+            }
+
+            set[k] = VkDescriptorSetLayoutBinding {
+                .binding = reflected.binding,
+                .descriptorType = reflected.type,
+                .descriptorCount = reflected.count,
+                .stageFlags = reflected.stages,
+                .pImmutableSamplers = nullptr,
+            };
+            count += 1;
+            set_count = reflected.set + 1 > set_count ? reflected.set + 1 : set_count;
+        }
+
+        if (stage->push_constant_size > bindless::BINDLESS_PUSH_CONSTANT_SIZE) {
+            log::error("vulkan::pipeline_table::get_layout -> push constant block of %u bytes exceeds %u",
+                stage->push_constant_size, bindless::BINDLESS_PUSH_CONSTANT_SIZE);
+            return false;
+        }
+    }
+
+    // NOTE: the range is the same for every layout, otherwise they would not be compatible for the bindless set
+    VkPushConstantRange push_range {
+        .stageFlags = VK_SHADER_STAGE_ALL,
+        .offset = 0,
+        .size = bindless::BINDLESS_PUSH_CONSTANT_SIZE,
+    };
+
+    VkDescriptorSetLayout set_layouts[REFLECTION_MAX_SETS];
+    set_layouts[bindless::BINDLESS_SET] = table->context->bindless->layout;
+    u64 key = hash::combine(hash::FNV_OFFSET_BASIS, set_count);
+    for (u32 i = bindless::BINDLESS_SET + 1; i < set_count; i++) {
+        if (!get_set_layout(bindings[i], binding_counts[i], &set_layouts[i])) {
+            return false;
+        }
+        key = hash::combine(key, set_layouts[i]);
+    }
+    key = hash::combine(key, push_range);
+
+    VkPipelineLayout* cached = table->layouts.find(key);
+    if (cached != nullptr) {
+        *out = *cached;
+        return true;
+    }
+
+    VkPipelineLayoutCreateInfo layout_info {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .setLayoutCount = set_count,
+        .pSetLayouts = set_layouts,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+
+    VkResult result = vkCreatePipelineLayout(table->context->device->logical_device, &layout_info, host_memory::callbacks(), out);
+    if (result != VK_SUCCESS) {
+        log::error("vulkan::pipeline_table::get_layout -> failed to create pipeline layout: %s", string_VkResult(result));
+        return false;
+    }
+
+    table->layouts.insert(key, *out);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+variant_set_t* create_variant_set(const pipeline_builder_t& base)
+{
+    variant_set_t* set = (variant_set_t*)calloc(1, sizeof(variant_set_t));
+    set->base = base;
+    set->keys = hashmap<u64> { 8 };
+    return set;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void destroy_variant_set(variant_set_t* set)
+{
+    if (set == nullptr) {
+        return;
+    }
+
+    // NOTE: pipelines stay in the table, they are released with it
+    set->keys.~hashmap();
+    free(set);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u64 request_variant(variant_set_t* set, u32 features)
+{
+    // NOTE: hashmap keys can't be 0, tag the mask so features 0 and 1 don't alias
+    u64 variant = (u64)features | (1ull << 32);
+
+    u64* cached = set->keys.find(variant);
+    if (cached != nullptr) {
+        return *cached;
+    }
+
+    RIN_ALLOW_ALLOC("pipeline_table::request_variant of a new feature mask");
+
+    pipeline_builder_t builder = set->base;
+    builder.set_features(features);
+
+    u64 key = request(builder);
+    set->keys.insert(variant, key);
+    return key;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void update(void)
+{
+    size_t i = 0;
+    while (i < table->pending.len) {
+        u64 key = table->pending[i];
+        pipeline_entry_t* entry = table->pipelines.find(key);
+
+        if (jobs::is_done(&entry->job->counter)) {
+            finalize(key, entry); // swap removes index i, don't advance
+        } else {
+            i += 1;
+        }
+    }
+
+    profiler::record("pipeline queue depth", "", (f64)table->pending.len);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+u32 count(void)
+{
+    return (u32)table->pipelines.len;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "pipeline.hpp"
+#include "reflection.hpp"
+#include "types.hpp"
+
+namespace rin::renderer::vulkan::pipeline_table {
+
+enum pipeline_status_t {
+    PIPELINE_STATUS_PENDING,
+    PIPELINE_STATUS_READY,
+    PIPELINE_STATUS_FAILED,
+};
+
+// A base pipeline state whose shaders branch on the FEATURES specialization constant, every feature mask
+// is specialized on first use so the driver can fold the branches away, pipelines live in the table.
+struct variant_set_t {
+    pipeline_builder_t base;
+    hashmap<u64> keys; // feature mask -> pipeline table key
+};
+
+bool create(context_t* context);
+void destroy(void);
+
+// Waits for every queued compilation, call it before destroying any shader module or layout they may use.
+void drain(void);
+
+// Returns the pipeline matching the builder state, building and caching it on the first request.
+// Blocks until the pipeline exists, waiting on an in flight compilation if there is one.
+// Shader modules and layouts are part of the key, so they must outlive every request made with them.
+bool get(pipeline_builder_t& builder, VkPipeline* out);
+
+// Queues the compilation on a worker thread if the state is unknown and returns its key right away.
+u64 request(const pipeline_builder_t& builder);
+
+// O(1) lookup of a requested pipeline, out is left untouched unless the pipeline is ready
+// so callers can preload it with a fallback pipeline.
+pipeline_status_t resolve(u64 key, VkPipeline* out);
+
+// Builds the pipeline layout described by the reflected stages, merging bindings shared across stages.
+// Set 0 is always the bindless heap and the push constant range is fixed, so every layout is compatible for set 0.
+// Layouts and descriptor set layouts are cached and owned by the table.
+bool get_layout(const reflection::shader_reflection_t* const* stages, u32 stage_count, VkPipelineLayout* out);
+
+variant_set_t* create_variant_set(const pipeline_builder_t& base);
+void destroy_variant_set(variant_set_t* set);
+
+// Same as request() for the base state specialized with features, repeated lookups skip hashing the builder.
+u64 request_variant(variant_set_t* set, u32 features);
+
+// Swaps in finished compilations and records compile latency and queue depth, once per frame.
+void update(void);
+u32 count(void);
+
+}
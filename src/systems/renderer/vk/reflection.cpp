@@ -0,0 +1,410 @@
+#include "reflection.hpp"
+
+#include "core/containers/darray.hpp"
+#include "core/logger.hpp"
+
+#include <cstdlib>
+
+namespace rin::renderer::vulkan::reflection {
+
+constexpr u32 SPIRV_MAGIC = 0x07230203;
+constexpr u32 SPIRV_HEADER_WORDS = 5;
+
+// NOTE: only the subset of the SPIR-V grammar needed to walk interface variables and their types
+enum spirv_op_t : u16 {
+    OP_ENTRY_POINT = 15,
+    OP_TYPE_BOOL = 20,
+    OP_TYPE_INT = 21,
+    OP_TYPE_FLOAT = 22,
+    OP_TYPE_VECTOR = 23,
+    OP_TYPE_MATRIX = 24,
+    OP_TYPE_IMAGE = 25,
+    OP_TYPE_SAMPLER = 26,
+    OP_TYPE_SAMPLED_IMAGE = 27,
+    OP_TYPE_ARRAY = 28,
+    OP_TYPE_RUNTIME_ARRAY = 29,
+    OP_TYPE_STRUCT = 30,
+    OP_TYPE_POINTER = 32,
+    OP_CONSTANT = 43,
+    OP_SPEC_CONSTANT = 50,
+    OP_VARIABLE = 59,
+    OP_DECORATE = 71,
+    OP_MEMBER_DECORATE = 72,
+    OP_TYPE_ACCELERATION_STRUCTURE = 5341,
+};
+
+enum spirv_decoration_t : u32 {
+    DECORATION_BLOCK = 2,
+    DECORATION_BUFFER_BLOCK = 3,
+    DECORATION_ARRAY_STRIDE = 6,
+    DECORATION_MATRIX_STRIDE = 7,
+    DECORATION_BINDING = 33,
+    DECORATION_DESCRIPTOR_SET = 34,
+    DECORATION_OFFSET = 35,
+};
+
+enum spirv_storage_class_t : u32 {
+    STORAGE_CLASS_UNIFORM_CONSTANT = 0,
+    STORAGE_CLASS_UNIFORM = 2,
+    STORAGE_CLASS_PUSH_CONSTANT = 9,
+    STORAGE_CLASS_STORAGE_BUFFER = 12,
+};
+
+enum spirv_execution_model_t : u32 {
+    EXECUTION_MODEL_VERTEX = 0,
+    EXECUTION_MODEL_TESSELLATION_CONTROL = 1,
+    EXECUTION_MODEL_TESSELLATION_EVALUATION = 2,
+    EXECUTION_MODEL_GEOMETRY = 3,
+    EXECUTION_MODEL_FRAGMENT = 4,
+    EXECUTION_MODEL_GLCOMPUTE = 5,
+    EXECUTION_MODEL_TASK_EXT = 5364,
+    EXECUTION_MODEL_MESH_EXT = 5365,
+};
+
+enum id_flag_t : u32 {
+    ID_FLAG_BLOCK = 1 << 0,
+    ID_FLAG_BUFFER_BLOCK = 1 << 1,
+    ID_FLAG_BINDING = 1 << 2,
+    ID_FLAG_SET = 1 << 3,
+};
+
+struct id_t {
+    u16 opcode;
+    u32 offset; // word offset of the defining instruction
+    u32 flags;
+    u32 binding;
+    u32 set;
+    u32 array_stride;
+};
+
+struct member_decoration_t {
+    u32 id;
+    u32 member;
+    u32 offset;
+    u32 matrix_stride;
+};
+
+struct parser_t {
+    const u32* code;
+    size_t word_count;
+    u32 bound;
+    id_t* ids;
+    darray<member_decoration_t> members;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static const u32* definition(const parser_t& parser, u32 id)
+{
+    if (id >= parser.bound || parser.ids[id].opcode == 0) {
+        return nullptr;
+    }
+    return parser.code + parser.ids[id].offset;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static member_decoration_t* find_member(parser_t& parser, u32 id, u32 member)
+{
+    for (size_t i = 0; i < parser.members.len; i++) {
+        if (parser.members[i].id == id && parser.members[i].member == member) {
+            return &parser.members[i];
+        }
+    }
+
+    parser.members.push(member_decoration_t { id, member, 0, 0 });
+    return &parser.members[parser.members.len - 1];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 constant_value(const parser_t& parser, u32 id)
+{
+    const u32* inst = definition(parser, id);
+    if (inst == nullptr || (parser.ids[id].opcode != OP_CONSTANT && parser.ids[id].opcode != OP_SPEC_CONSTANT)) {
+        return 0;
+    }
+    return inst[3]; // result type, result id, value (low word)
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static u32 type_size(parser_t& parser, u32 type_id, u32 matrix_stride)
+{
+    const u32* inst = definition(parser, type_id);
+    if (inst == nullptr) {
+        return 0;
+    }
+
+    switch (parser.ids[type_id].opcode) {
+    case OP_TYPE_BOOL:
+        return 4;
+    case OP_TYPE_INT:
+    case OP_TYPE_FLOAT:
+        return inst[2] / 8;
+    case OP_TYPE_VECTOR:
+        return type_size(parser, inst[2], 0) * inst[3];
+    case OP_TYPE_MATRIX: {
+        u32 column = matrix_stride > 0 ? matrix_stride : type_size(parser, inst[2], 0);
+        return column * inst[3];
+    }
+    case OP_TYPE_ARRAY: {
+        u32 length = constant_value(parser, inst[3]);
+        u32 stride = parser.ids[type_id].array_stride;
+        return length * (stride > 0 ? stride : type_size(parser, inst[2], matrix_stride));
+    }
+    case OP_TYPE_POINTER:
+        return 8; // buffer references
+    case OP_TYPE_STRUCT: {
+        u32 size = 0;
+        u32 member_count = (inst[0] >> 16) - 2;
+        for (u32 i = 0; i < member_count; i++) {
+            member_decoration_t* member = find_member(parser, type_id, i);
+            u32 end = member->offset + type_size(parser, inst[2 + i], member->matrix_stride);
+            size = end > size ? end : size;
+        }
+        return size;
+    }
+    default:
+        return 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool reflect_binding(const parser_t& parser, u32 variable, u32 storage_class, u32 type_id, shader_reflection_t* out)
+{
+    binding_t binding {};
+    binding.set = parser.ids[variable].set;
+    binding.binding = parser.ids[variable].binding;
+    binding.stages = out->stage;
+    binding.count = 1;
+
+    const u32* inst = definition(parser, type_id);
+    if (inst != nullptr && parser.ids[type_id].opcode == OP_TYPE_ARRAY) {
+        binding.count = constant_value(parser, inst[3]);
+        type_id = inst[2];
+    } else if (inst != nullptr && parser.ids[type_id].opcode == OP_TYPE_RUNTIME_ARRAY) {
+        binding.count = 0;
+        type_id = inst[2];
+    }
+
+    inst = definition(parser, type_id);
+    if (inst == nullptr) {
+        return false;
+    }
+
+    switch (parser.ids[type_id].opcode) {
+    case OP_TYPE_SAMPLER:
+        binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+        break;
+    case OP_TYPE_SAMPLED_IMAGE:
+        binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        break;
+    case OP_TYPE_IMAGE: {
+        // sampled type, dim, depth, arrayed, ms, sampled, format
+        u32 dim = inst[3];
+        u32 sampled = inst[7];
+        if (dim == 6) { // SubpassData
+            binding.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        } else if (dim == 5) { // Buffer
+            binding.type = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        } else {
+            binding.type = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+        break;
+    }
+    case OP_TYPE_STRUCT:
+        if (storage_class == STORAGE_CLASS_STORAGE_BUFFER || (parser.ids[type_id].flags & ID_FLAG_BUFFER_BLOCK)) {
+            binding.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        } else {
+            binding.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        }
+        break;
+    case OP_TYPE_ACCELERATION_STRUCTURE:
+        binding.type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+        break;
+    default:
+        log::error("vulkan::reflection -> unsupported descriptor type for set %u binding %u", binding.set, binding.binding);
+        return false;
+    }
+
+    if (out->binding_count == REFLECTION_MAX_BINDINGS) {
+        log::error("vulkan::reflection -> too many descriptor bindings");
+        return false;
+    }
+    out->bindings[out->binding_count++] = binding;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static VkShaderStageFlagBits to_stage(u32 execution_model)
+{
+    switch (execution_model) {
+    case EXECUTION_MODEL_VERTEX:
+        return VK_SHADER_STAGE_VERTEX_BIT;
+    case EXECUTION_MODEL_TESSELLATION_CONTROL:
+        return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case EXECUTION_MODEL_TESSELLATION_EVALUATION:
+        return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case EXECUTION_MODEL_GEOMETRY:
+        return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case EXECUTION_MODEL_FRAGMENT:
+        return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case EXECUTION_MODEL_GLCOMPUTE:
+        return VK_SHADER_STAGE_COMPUTE_BIT;
+    case EXECUTION_MODEL_TASK_EXT:
+        return VK_SHADER_STAGE_TASK_BIT_EXT;
+    case EXECUTION_MODEL_MESH_EXT:
+        return VK_SHADER_STAGE_MESH_BIT_EXT;
+    default:
+        return VK_SHADER_STAGE_ALL;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool reflect(const u32* code, size_t word_count, shader_reflection_t* out)
+{
+    *out = {};
+
+    if (word_count < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC) {
+        log::error("vulkan::reflection::reflect -> not a SPIR-V module");
+        return false;
+    }
+
+    parser_t parser {
+        .code = code,
+        .word_count = word_count,
+        .bound = code[3],
+        .ids = (id_t*)calloc(code[3], sizeof(id_t)),
+        .members = darray<member_decoration_t> { true },
+    };
+
+    bool has_entry_point = false;
+
+    // NOTE: first pass records where every id is defined and how it is decorated,
+    // decorations come before the types they apply to so nothing can be resolved yet
+    size_t cursor = SPIRV_HEADER_WORDS;
+    while (cursor < word_count) {
+        const u32* inst = code + cursor;
+        u16 opcode = inst[0] & 0xFFFF;
+        u32 length = inst[0] >> 16;
+
+        if (length == 0 || cursor + length > word_count) {
+            log::error("vulkan::reflection::reflect -> malformed instruction at word %zu", cursor);
+            free(parser.ids);
+            return false;
+        }
+
+        switch (opcode) {
+        case OP_ENTRY_POINT:
+            if (!has_entry_point) {
+                out->stage = to_stage(inst[1]);
+                has_entry_point = true;
+            }
+            break;
+        case OP_DECORATE: {
+            if (inst[1] >= parser.bound) {
+                break;
+            }
+            id_t* id = &parser.ids[inst[1]];
+            switch (inst[2]) {
+            case DECORATION_BLOCK:
+                id->flags |= ID_FLAG_BLOCK;
+                break;
+            case DECORATION_BUFFER_BLOCK:
+                id->flags |= ID_FLAG_BUFFER_BLOCK;
+                break;
+            case DECORATION_ARRAY_STRIDE:
+                id->array_stride = inst[3];
+                break;
+            case DECORATION_BINDING:
+                id->flags |= ID_FLAG_BINDING;
+                id->binding = inst[3];
+                break;
+            case DECORATION_DESCRIPTOR_SET:
+                id->flags |= ID_FLAG_SET;
+                id->set = inst[3];
+                break;
+            default:
+                break;
+            }
+            break;
+        }
+        case OP_MEMBER_DECORATE:
+            if (inst[3] == DECORATION_OFFSET) {
+                find_member(parser, inst[1], inst[2])->offset = inst[4];
+            } else if (inst[3] == DECORATION_MATRIX_STRIDE) {
+                find_member(parser, inst[1], inst[2])->matrix_stride = inst[4];
+            }
+            break;
+        case OP_TYPE_BOOL:
+        case OP_TYPE_INT:
+        case OP_TYPE_FLOAT:
+        case OP_TYPE_VECTOR:
+        case OP_TYPE_MATRIX:
+        case OP_TYPE_IMAGE:
+        case OP_TYPE_SAMPLER:
+        case OP_TYPE_SAMPLED_IMAGE:
+        case OP_TYPE_ARRAY:
+        case OP_TYPE_RUNTIME_ARRAY:
+        case OP_TYPE_STRUCT:
+        case OP_TYPE_POINTER:
+        case OP_TYPE_ACCELERATION_STRUCTURE:
+            if (inst[1] < parser.bound) {
+                parser.ids[inst[1]].opcode = opcode;
+                parser.ids[inst[1]].offset = cursor;
+            }
+            break;
+        case OP_CONSTANT:
+        case OP_SPEC_CONSTANT:
+        case OP_VARIABLE:
+            if (inst[2] < parser.bound) {
+                parser.ids[inst[2]].opcode = opcode;
+                parser.ids[inst[2]].offset = cursor;
+            }
+            break;
+        default:
+            break;
+        }
+
+        cursor += length;
+    }
+
+    if (!has_entry_point) {
+        log::error("vulkan::reflection::reflect -> module has no entry point");
+        free(parser.ids);
+        return false;
+    }
+
+    // NOTE: second pass, resolve every global variable through its pointer type
+    bool success = true;
+    for (u32 id = 0; id < parser.bound && success; id++) {
+        if (parser.ids[id].opcode != OP_VARIABLE) {
+            continue;
+        }
+
+        const u32* variable = code + parser.ids[id].offset;
+        u32 storage_class = variable[3];
+        const u32* pointer = definition(parser, variable[1]);
+        if (pointer == nullptr || parser.ids[variable[1]].opcode != OP_TYPE_POINTER) {
+            continue;
+        }
+        u32 pointee = pointer[3];
+
+        switch (storage_class) {
+        case STORAGE_CLASS_UNIFORM_CONSTANT:
+        case STORAGE_CLASS_UNIFORM:
+        case STORAGE_CLASS_STORAGE_BUFFER:
+            if (parser.ids[id].flags & (ID_FLAG_BINDING | ID_FLAG_SET)) {
+                success = reflect_binding(parser, id, storage_class, pointee, out);
+            }
+            break;
+        case STORAGE_CLASS_PUSH_CONSTANT:
+            out->push_constant_size = type_size(parser, pointee, 0);
+            break;
+        default:
+            break;
+        }
+    }
+
+    free(parser.ids);
+    return success;
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "core/defines.hpp"
+
+#include <cstddef>
+#include <volk.h>
+
+namespace rin::renderer::vulkan::reflection {
+
+constexpr u32 REFLECTION_MAX_BINDINGS = 32;
+constexpr u32 REFLECTION_MAX_SETS = 4;
+
+struct binding_t {
+    u32 set;
+    u32 binding;
+    VkDescriptorType type;
+    u32 count; // 0 for runtime sized arrays
+    VkShaderStageFlags stages;
+};
+
+struct shader_reflection_t {
+    VkShaderStageFlagBits stage;
+    binding_t bindings[REFLECTION_MAX_BINDINGS];
+    u32 binding_count;
+    u32 push_constant_size; // 0 when the stage declares no push constant block
+};
+
+// Parses the SPIR-V binary directly, no external reflection library involved.
+bool reflect(const u32* code, size_t word_count, shader_reflection_t* out);
+
+}
@@ -1,30 +1,51 @@
 #include "swapchain.hpp"
 
+#include "context.hpp"
+#include "core/clock.hpp"
 #include "core/logger.hpp"
+#include "core/profiler.hpp"
+#include "host_memory.hpp"
 
 #include <algorithm>
 #include <vulkan/vk_enum_string_helper.h>
 
 namespace rin::renderer::vulkan::swapchain {
 
+struct present_record_t {
+    u64 id;
+    f64 present_time; // vkQueuePresentKHR returned
+    f64 input_time;
+};
+
 static swapchain_t* swapchain = nullptr;
+static present_record_t records[SWAPCHAIN_PRESENT_HISTORY] = {};
+
+constexpr VkPresentModeKHR policy_modes[PRESENT_POLICY_COUNT] = {
+    VK_PRESENT_MODE_FIFO_KHR,
+    VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+    VK_PRESENT_MODE_MAILBOX_KHR,
+    VK_PRESENT_MODE_IMMEDIATE_KHR,
+};
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-VkPresentModeKHR choose_present_mode(context_t* context)
+VkPresentModeKHR choose_present_mode(context_t* context, present_policy_t policy)
 {
+    VkPresentModeKHR wanted = policy_modes[policy];
+
     u32 count = 0;
     vkGetPhysicalDeviceSurfacePresentModesKHR(context->device->physical_device, context->surface, &count, nullptr);
     VkPresentModeKHR* modes = (VkPresentModeKHR*)malloc(sizeof(VkPresentModeKHR) * count);
     vkGetPhysicalDeviceSurfacePresentModesKHR(context->device->physical_device, context->surface, &count, modes);
 
     for (u32 i = 0; i < count; i++) {
-        if (modes[i] == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+        if (modes[i] == wanted) {
             free(modes);
-            return VK_PRESENT_MODE_IMMEDIATE_KHR;
+            return wanted;
         }
     }
 
     free(modes);
+    log::warn("vulkan::swapchain -> %s is not supported by the surface, using FIFO", string_VkPresentModeKHR(wanted));
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -78,6 +99,7 @@ bool create(context_t* context, VkExtent2D window_extent)
         swapchain->views = darray<VkImageView>(true);
         swapchain->render_semaphores = darray<VkSemaphore>(true);
         swapchain->context = context;
+        swapchain->policy = PRESENT_POLICY_IMMEDIATE;
     }
 
     swapchain->viewport = VkViewport {
@@ -98,7 +120,7 @@ bool create(context_t* context, VkExtent2D window_extent)
     VkDevice device = swapchain->context->device->logical_device;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, context->surface, &swapchain->capabilities);
 
-    swapchain->present_mode = choose_present_mode(context);
+    swapchain->present_mode = choose_present_mode(context, swapchain->policy);
     swapchain->format = choose_format(context);
     swapchain->extent = choose_extent(window_extent);
 
@@ -114,6 +136,12 @@ bool create(context_t* context, VkExtent2D window_extent)
     usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
     usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
+    // NOTE: optional, frame capture copies out of the swapchain image and is disabled without it
+    if (swapchain->capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    swapchain->usage = usage;
+
     VkSwapchainCreateInfoKHR create_info = {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         .pNext = nullptr,
@@ -135,21 +163,23 @@ bool create(context_t* context, VkExtent2D window_extent)
         .oldSwapchain = VK_NULL_HANDLE,
     };
 
+    // NOTE: on a resize the old handle is already in the deletion queue, it is never destroyed here
     VkSwapchainKHR old_handle = swapchain->handle;
     if (old_handle != VK_NULL_HANDLE) {
         create_info.oldSwapchain = old_handle;
     }
 
-    VkResult result = vkCreateSwapchainKHR(device, &create_info, nullptr, &swapchain->handle);
+    VkSwapchainKHR handle = VK_NULL_HANDLE;
+    VkResult result = vkCreateSwapchainKHR(device, &create_info, host_memory::callbacks(), &handle);
+    swapchain->handle = handle;
     if (result != VK_SUCCESS) {
         log::error("vulkan::swapchain::create -> failed to create swapchain: %s", string_VkResult(result));
         destroy();
         return false;
     }
 
-    if (old_handle != VK_NULL_HANDLE) {
-        vkDestroySwapchainKHR(device, old_handle, nullptr);
-    }
+    // NOTE: ids keep increasing across swapchains, the ones presented to the old swapchain are never waited on
+    swapchain->displayed_id = swapchain->present_id;
 
     // NOTE: images
     u32 img_count = 0;
@@ -187,7 +217,7 @@ bool create(context_t* context, VkExtent2D window_extent)
         };
 
         VkImageView view = VK_NULL_HANDLE;
-        result = vkCreateImageView(device, &view_info, nullptr, &view);
+        result = vkCreateImageView(device, &view_info, host_memory::callbacks(), &view);
         if (result != VK_SUCCESS) {
             log::error("vulkan::swapchain::create -> failed to create image view: %s", string_VkResult(result));
             destroy();
@@ -207,7 +237,7 @@ bool create(context_t* context, VkExtent2D window_extent)
         };
 
         VkSemaphore sem;
-        result = vkCreateSemaphore(device, &sem_info, nullptr, &sem);
+        result = vkCreateSemaphore(device, &sem_info, host_memory::callbacks(), &sem);
         if (result != VK_SUCCESS) {
             log::error("vulkan::swapchain::create -> failed to create semaphore: %s", string_VkResult(result));
             destroy();
@@ -222,6 +252,7 @@ bool create(context_t* context, VkExtent2D window_extent)
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool resize(VkExtent2D window_extent)
 {
     if (swapchain == nullptr) {
@@ -229,13 +260,13 @@ bool resize(VkExtent2D window_extent)
         return false;
     }
 
-    VkDevice device = swapchain->context->device->logical_device;
-    vkDeviceWaitIdle(device);
-
+    // NOTE: the render semaphores are waited on by presents, which no fence covers. The frame being recorded is
+    // submitted after them, once it completes so have they. The handle stays set, create() passes it as oldSwapchain
     for (u32 i = 0; i < swapchain->images.len; i++) { // both views and render_semaphores have the same len as images
-        vkDestroyImageView(device, swapchain->views[i], nullptr);
-        vkDestroySemaphore(device, swapchain->render_semaphores[i], nullptr);
+        context::retire_image_view(swapchain->views[i]);
+        context::retire_semaphore(swapchain->render_semaphores[i]);
     }
+    context::retire_swapchain(swapchain->handle);
 
     swapchain->images.clear();
     swapchain->views.clear();
@@ -249,24 +280,123 @@ bool resize(VkExtent2D window_extent)
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void set_present_policy(present_policy_t policy)
+{
+    swapchain->policy = policy;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+VkResult present(VkQueue queue, VkSemaphore wait, u32 image_index, f64 input_time)
+{
+    bool tracked = swapchain->context->device->present_wait;
+    u64 id = swapchain->present_id + 1;
+
+    VkPresentIdKHR present_id {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .pNext = nullptr,
+        .swapchainCount = 1,
+        .pPresentIds = &id,
+    };
+
+    VkPresentInfoKHR present {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .pNext = tracked ? &present_id : nullptr,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &wait,
+        .swapchainCount = 1,
+        .pSwapchains = &swapchain->handle,
+        .pImageIndices = &image_index,
+        .pResults = nullptr,
+    };
+
+    VkResult result = vkQueuePresentKHR(queue, &present);
+    if (tracked && (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)) {
+        swapchain->present_id = id;
+        records[id % SWAPCHAIN_PRESENT_HISTORY] = present_record_t {
+            .id = id,
+            .present_time = clock::get_time_s(),
+            .input_time = input_time,
+        };
+    }
+
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Every id up to this one is on screen or was replaced by a later one, mailbox drops frames.
+static void mark_displayed(u64 id)
+{
+    f64 now = clock::get_time_s();
+    for (u64 i = swapchain->displayed_id + 1; i <= id; i++) {
+        const present_record_t& record = records[i % SWAPCHAIN_PRESENT_HISTORY];
+        if (record.id != i) {
+            continue;
+        }
+
+        profiler::record("present latency", "ms", (now - record.present_time) * ms_per_s);
+        if (record.input_time > 0.0) {
+            profiler::record("input to photon", "ms", (now - record.input_time) * ms_per_s);
+        }
+    }
+    swapchain->displayed_id = id;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void wait_presents(u32 max_queued)
+{
+    if (!swapchain->context->device->present_wait || swapchain->present_id == 0) {
+        return;
+    }
+
+    VkDevice device = swapchain->context->device->logical_device;
+
+    // NOTE: polled once per frame, a present found here was shown up to a frame earlier, the stats overestimate.
+    // The capped wait below returns as the present is shown, with the cap on the numbers are exact
+    while (swapchain->displayed_id < swapchain->present_id) {
+        u64 id = swapchain->displayed_id + 1;
+        if (vkWaitForPresentKHR(device, swapchain->handle, id, 0) != VK_SUCCESS) {
+            break;
+        }
+        mark_displayed(id);
+    }
+
+    profiler::record("queued presents", "", (f64)(swapchain->present_id - swapchain->displayed_id));
+
+    if (max_queued == 0 || swapchain->present_id - swapchain->displayed_id <= max_queued) {
+        return;
+    }
+
+    u64 id = swapchain->present_id - max_queued;
+    VkResult result = vkWaitForPresentKHR(device, swapchain->handle, id, SWAPCHAIN_PRESENT_TIMEOUT_NS);
+    if (result == VK_SUCCESS) {
+        mark_displayed(id);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void destroy(void)
 {
     if (swapchain == nullptr) {
         return;
     }
 
+    // NOTE: shutdown or a failed create, nothing here is time critical
     VkDevice device = swapchain->context->device->logical_device;
     vkDeviceWaitIdle(device);
 
     for (u32 i = 0; i < swapchain->images.len; i++) {
-        vkDestroyImageView(device, swapchain->views[i], nullptr);
-        vkDestroySemaphore(device, swapchain->render_semaphores[i], nullptr);
+        vkDestroyImageView(device, swapchain->views[i], host_memory::callbacks());
+        vkDestroySemaphore(device, swapchain->render_semaphores[i], host_memory::callbacks());
     }
 
     if (swapchain->handle != VK_NULL_HANDLE) {
-        vkDestroySwapchainKHR(device, swapchain->handle, nullptr);
+        vkDestroySwapchainKHR(device, swapchain->handle, host_memory::callbacks());
     }
 
+    swapchain->images.~darray();
+    swapchain->views.~darray();
+    swapchain->render_semaphores.~darray();
     swapchain->context->swapchain = nullptr;
     free(swapchain);
     swapchain = nullptr;
@@ -4,8 +4,26 @@
 
 namespace rin::renderer::vulkan::swapchain {
 
+constexpr u32 SWAPCHAIN_PRESENT_HISTORY = 16; // presents remembered for the latency stats, more than can be queued
+constexpr u64 SWAPCHAIN_PRESENT_TIMEOUT_NS = 100'000'000; // an occluded window may never show a frame
+
 bool create(context_t* context, VkExtent2D window_extent);
+
+// Recreates the swapchain passing the current one as oldSwapchain, without waiting on the device. The old handle,
+// views and semaphores go through the context deletion queue, frames in flight keep presenting them meanwhile.
 bool resize(VkExtent2D window_extent);
+
+// Takes effect on the next resize(), which the caller triggers once no acquired image is left to present.
+void set_present_policy(present_policy_t policy);
+
+// Presents image_index tagged with the next present id, input_time is when the input the frame shows was sampled.
+VkResult present(VkQueue queue, VkSemaphore wait, u32 image_index, f64 input_time);
+
+// Records the presents that reached the display since the last call into the "present latency" and
+// "input to photon" stats, then blocks until at most max_queued presents are waiting for the display,
+// 0 leaves them uncapped. Only measures and caps with VK_KHR_present_wait.
+void wait_presents(u32 max_queued);
+
 void destroy(void);
 
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core/containers/darray.hpp"
+#include "core/containers/hashmap.hpp"
 #include "core/defines.hpp"
 
 // clang-format off
@@ -28,6 +29,18 @@ struct device_t {
     VkPhysicalDeviceProperties properties;
     VkPhysicalDeviceFeatures features;
     VkPhysicalDeviceMemoryProperties memory;
+    VkPhysicalDeviceDescriptorIndexingProperties descriptor_indexing;
+    bool mesh_shader; // VK_EXT_mesh_shader with task shaders, optional, lavapipe and older GPUs lack it
+    bool present_wait; // VK_KHR_present_id and VK_KHR_present_wait, optional, presents are untracked without them
+    bool memory_budget; // VK_EXT_memory_budget, optional, VMA estimates budgets from its own allocations without it
+};
+
+enum present_policy_t {
+    PRESENT_POLICY_FIFO, // vsync, always supported
+    PRESENT_POLICY_FIFO_RELAXED, // vsync, a late frame is shown right away and tears
+    PRESENT_POLICY_MAILBOX, // no tearing, a newer frame replaces the queued one, the GPU is not throttled
+    PRESENT_POLICY_IMMEDIATE, // no vsync, lowest latency, tears
+    PRESENT_POLICY_COUNT,
 };
 
 struct swapchain_t {
@@ -35,7 +48,11 @@ struct swapchain_t {
     VkSwapchainKHR handle;
     VkExtent2D extent;
     VkSurfaceFormatKHR format;
+    VkImageUsageFlags usage;
+    present_policy_t policy; // requested, present_mode falls back to FIFO when the surface lacks it
     VkPresentModeKHR present_mode;
+    u64 present_id; // of the last present, only tagged when device->present_wait
+    u64 displayed_id; // last present id known to be on screen
     darray<VkImage> images;
     darray<VkImageView> views;
     u32 min_image_count;
@@ -45,6 +62,43 @@ struct swapchain_t {
     VkRect2D scissor;
 };
 
+constexpr u32 BINDLESS_INVALID_INDEX = ~0u;
+
+enum bindless_type_t {
+    BINDLESS_TYPE_SAMPLED_IMAGE, // doubles as the binding number inside the bindless set
+    BINDLESS_TYPE_STORAGE_BUFFER,
+    BINDLESS_TYPE_SAMPLER,
+    BINDLESS_TYPE_COUNT,
+};
+
+struct bindless_heap_t {
+    context_t* context;
+    VkDescriptorPool pool;
+    VkDescriptorSetLayout layout;
+    VkDescriptorSet set;
+    u32 capacity[BINDLESS_TYPE_COUNT];
+    u32 high_water[BINDLESS_TYPE_COUNT]; // slots below this were handed out at least once
+    darray<u32> free_slots[BINDLESS_TYPE_COUNT];
+};
+
+struct pipeline_job_t;
+struct deletion_queue_t;
+
+struct pipeline_entry_t {
+    VkPipeline handle;
+    pipeline_job_t* job; // non null while the pipeline is compiling on a worker
+    bool failed;
+};
+
+struct pipeline_table_t {
+    context_t* context;
+    VkPipelineCache cache;
+    hashmap<pipeline_entry_t> pipelines; // keyed on pipeline_builder_t::hash()
+    darray<u64> pending; // keys with a compilation in flight
+    hashmap<VkDescriptorSetLayout> set_layouts; // keyed on the reflected bindings of one set
+    hashmap<VkPipelineLayout> layouts; // keyed on set layouts and push constant range
+};
+
 struct context_t {
     bool validation;
     VkInstance instance;
@@ -52,9 +106,28 @@ struct context_t {
     VkSurfaceKHR surface;
     device_t* device;
     swapchain_t* swapchain;
+    pipeline_table_t* pipelines;
+    bindless_heap_t* bindless;
+    deletion_queue_t* deletion;
     VmaAllocator vma;
 };
 
+// Subsystem an allocation is accounted to, the Memory panel breaks usage down by it
+enum memory_tag_t {
+    MEMORY_TAG_GEOMETRY, // vertices, indices and meshlets
+    MEMORY_TAG_SCENE,
+    MEMORY_TAG_CLUSTERS,
+    MEMORY_TAG_LIGHTS,
+    MEMORY_TAG_OCCLUSION,
+    MEMORY_TAG_SPRITES,
+    MEMORY_TAG_TARGETS,
+    MEMORY_TAG_STAGING,
+    MEMORY_TAG_CAPTURE, // frame capture readback ring
+    MEMORY_TAG_DEBUG_DRAW,
+    MEMORY_TAG_ARENA, // the small block arena, suballocations are not accounted on their own
+    MEMORY_TAG_COUNT,
+};
+
 enum image_type_t {
     IMAGE_TYPE_COLOR,
     IMAGE_TYPE_DEPTH,
@@ -66,6 +139,7 @@ struct image_create_info_t {
     u32 width, height;
     VmaAllocationCreateInfo allocation_info;
     image_type_t type;
+    memory_tag_t tag;
 };
 
 struct image_t {
@@ -77,12 +151,16 @@ struct image_t {
     image_type_t type;
     VmaAllocation memory;
     VmaAllocationCreateInfo allocation_info;
+    u32 bindless_index; // BINDLESS_INVALID_INDEX unless the image is sampled
+    memory_tag_t tag;
 };
 
 struct buffer_create_info_t {
     u64 size;
     VkBufferUsageFlags usage;
     VmaMemoryUsage memory_usage;
+    bool device_local; // not mapped, filled by the GPU or through context::upload_buffer
+    memory_tag_t tag;
 };
 
 struct buffer_t {
@@ -92,6 +170,45 @@ struct buffer_t {
     u64 size;
     VkBufferUsageFlags usage;
     VmaMemoryUsage memory_usage;
+    VkDeviceAddress address; // every buffer is addressable, shaders read through buffer references
+    u32 bindless_index; // BINDLESS_INVALID_INDEX unless the buffer is a storage buffer
+    VmaVirtualAllocation suballocation; // VK_NULL_HANDLE unless the block lives in the small block arena
+    u64 offset; // into handle, non zero only for suballocations
+    memory_tag_t tag;
+};
+
+enum deletion_type_t {
+    DELETION_TYPE_BUFFER,
+    DELETION_TYPE_IMAGE,
+    DELETION_TYPE_IMAGE_VIEW,
+    DELETION_TYPE_PIPELINE,
+    DELETION_TYPE_DESCRIPTOR_SET,
+    DELETION_TYPE_COMMAND_POOL,
+    DELETION_TYPE_SEMAPHORE,
+    DELETION_TYPE_SWAPCHAIN,
+};
+
+struct deletion_t {
+    deletion_type_t type;
+    u64 frame; // destroyed once this frame has completed
+    union {
+        buffer_t buffer;
+        image_t image;
+        VkImageView view;
+        VkPipeline pipeline;
+        struct {
+            VkDescriptorPool pool;
+            VkDescriptorSet set;
+        } descriptor_set;
+        VkCommandPool command_pool;
+        VkSemaphore semaphore;
+        VkSwapchainKHR swapchain;
+    };
+};
+
+struct deletion_queue_t {
+    darray<deletion_t> entries; // in retire order, so frames never decrease along it
+    u64 frame; // the one being recorded, tags everything retired now
 };
 
 }
@@ -1,6 +1,7 @@
 #include "utils.hpp"
 
 #include "core/logger.hpp"
+#include "host_memory.hpp"
 
 #include <cstring>
 #include <fstream>
@@ -14,6 +15,12 @@ static bool supports_required_extensions(VkExtensionProperties*, size_t, const d
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool load_shader_module(VkDevice device, const char* filePath, VkShaderModule* out)
+{
+    return load_shader_module(device, filePath, out, nullptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool load_shader_module(VkDevice device, const char* filePath, VkShaderModule* out, reflection::shader_reflection_t* outReflection)
 {
     std::ifstream file(filePath, std::ios::ate | std::ios::binary);
 
@@ -31,6 +38,11 @@ bool load_shader_module(VkDevice device, const char* filePath, VkShaderModule* o
     file.read((char*)buffer.data, fileSize);
     file.close();
 
+    if (outReflection != nullptr && !reflection::reflect(buffer.data, buffer.capacity, outReflection)) {
+        log::error("vulkan::utils::load_shader_module -> failed to reflect %s", filePath);
+        return false;
+    }
+
     VkShaderModuleCreateInfo info {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
         .pNext = nullptr,
@@ -40,7 +52,7 @@ bool load_shader_module(VkDevice device, const char* filePath, VkShaderModule* o
     };
 
     VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device, &info, nullptr, &shaderModule) != VK_SUCCESS) {
+    if (vkCreateShaderModule(device, &info, host_memory::callbacks(), &shaderModule) != VK_SUCCESS) {
         return false;
     }
 
@@ -108,6 +120,23 @@ bool load_device_extensions(VkPhysicalDevice device, VkDeviceCreateInfo* create_
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool supports_device_extension(VkPhysicalDevice device, const char* name)
+{
+    u32 count = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
+    VkExtensionProperties* props = (VkExtensionProperties*)malloc(sizeof(VkExtensionProperties) * count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, props);
+
+    bool found = false;
+    for (u32 i = 0; i < count && !found; i++) {
+        found = strcmp(name, props[i].extensionName) == 0;
+    }
+
+    free(props);
+    return found;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 static bool supports_required_layers(VkLayerProperties* supported, size_t supported_len, const darray<const char*>& required)
 {
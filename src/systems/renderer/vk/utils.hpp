@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core/containers/darray.hpp"
+#include "reflection.hpp"
 
 #include <volk.h>
 
@@ -9,6 +10,8 @@ namespace rin::renderer::vulkan::utils {
 bool load_instance_layers(VkInstanceCreateInfo* create_info, darray<const char*>& required_layers);
 bool load_instance_extensions(VkInstanceCreateInfo* create_info, darray<const char*>& required_extensions);
 bool load_device_extensions(VkPhysicalDevice device, VkDeviceCreateInfo* create_info, darray<const char*>& required_extensions);
+bool supports_device_extension(VkPhysicalDevice device, const char* name); // for optional extensions, checked before load_device_extensions
 bool load_shader_module(VkDevice device, const char* filePath, VkShaderModule* outShaderModule);
+bool load_shader_module(VkDevice device, const char* filePath, VkShaderModule* outShaderModule, reflection::shader_reflection_t* outReflection);
 
 }
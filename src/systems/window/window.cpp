@@ -1,5 +1,6 @@
 #include "window.hpp"
 
+#include "core/clock.hpp"
 #include "core/logger.hpp"
 #include "systems/renderer/renderer.hpp"
 
@@ -16,6 +17,7 @@
 namespace rin::window {
 
 static GLFWwindow* window = nullptr;
+static f64 poll_time = 0.0;
 
 static void on_error(int code, const char* message)
 {
@@ -94,6 +96,12 @@ void show(void)
 void poll(void)
 {
     glfwPollEvents();
+    poll_time = clock::get_time_s();
+}
+
+f64 get_poll_time(void)
+{
+    return poll_time;
 }
 
 void wait_events(void)
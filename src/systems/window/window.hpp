@@ -17,6 +17,9 @@ void get_monitor_size(u32* out_width, u32* out_height);
 void poll(void);
 void wait_events(void);
 
+// Time of the last poll(), when input was last sampled, used for input to photon estimates.
+f64 get_poll_time(void);
+
 void get_vulkan_extensions(darray<const char*>& buffer);
 bool create_vulkan_surface(VkInstance instance, VkSurfaceKHR* out_surface);
 void init_imgui_vulkan(void);